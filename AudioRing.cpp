@@ -0,0 +1,350 @@
+/****************************************************************************************
+*
+*     AudioRing
+*
+*            , 
+*           .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+
+#include "Log.h"
+#include "AudioRing.h"
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+AudioRing::AudioRing()
+{
+	m_pBlocks = NULL;
+	m_pSamples = NULL;
+	m_cBlocks = 0;
+	m_cSamplesPerBlock = 0;
+
+	m_cWrittenBlocks = 0;
+	m_iWriteBlock = 0;
+	m_cReadBlocks = 0;
+	m_iReadBlock = 0;
+	m_MaxFillLevel = 0;
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .
+*
+****************************************************************************************/
+
+AudioRing::~AudioRing()
+{
+	Free();
+}
+
+/****************************************************************************************
+*
+*    Create
+*
+*   
+*       cBlocks -    
+*       cSamplesPerBlock -     
+*
+*    
+*       true,    ; false,     .
+*
+*     .  ,   , .  , 
+*              .
+*
+*   
+*
+*            2^32 ,
+*               
+*   :      ,   0xFFFFFFFF  0x100000000
+*           .      
+*     (m_iWriteBlock  m_iReadBlock),     
+*    ,       
+*   :        .
+*
+****************************************************************************************/
+
+bool AudioRing::Create(
+	__in DWORD cBlocks,
+	__in DWORD cSamplesPerBlock)
+{
+	Free();
+
+	m_pBlocks = (AUDIOBLOCK *) HeapAlloc(GetProcessHeap(), 0,
+		cBlocks * sizeof(AUDIOBLOCK));
+
+	m_pSamples = (SHORT *) HeapAlloc(GetProcessHeap(), 0,
+		cBlocks * cSamplesPerBlock * sizeof(SHORT));
+
+	if (m_pBlocks == NULL || m_pSamples == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		Free();
+		return false;
+	}
+
+	for (DWORD i = 0; i < cBlocks; i++)
+	{
+		m_pBlocks[i].CaptureTime = 0;
+		m_pBlocks[i].iBlock = 0;
+		m_pBlocks[i].cSamples = 0;
+		m_pBlocks[i].pSamples = m_pSamples + i * cSamplesPerBlock;
+	}
+
+	m_cBlocks = cBlocks;
+	m_cSamplesPerBlock = cSamplesPerBlock;
+
+	m_cWrittenBlocks = 0;
+	m_iWriteBlock = 0;
+	m_cReadBlocks = 0;
+	m_iReadBlock = 0;
+	m_MaxFillLevel = 0;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GetWriteBlock
+*
+*   
+*       
+*
+*    
+*            NULL,   .
+*
+*     ,       
+*      CommitWriteBlock.    .
+*
+****************************************************************************************/
+
+AUDIOBLOCK *AudioRing::GetWriteBlock()
+{
+	//      ;    
+	LONG cReadBlocks = m_cReadBlocks;
+
+	if ((DWORD) (m_cWrittenBlocks - cReadBlocks) >= m_cBlocks) return NULL;
+
+	return &m_pBlocks[m_iWriteBlock];
+}
+
+/****************************************************************************************
+*
+*    CommitWriteBlock
+*
+*   
+*       
+*
+*    
+*       
+*
+*      ,   GetWriteBlock  
+*    .    .
+*
+*   
+*
+*    InterlockedExchange    ,   
+*           ,  
+*    .
+*
+****************************************************************************************/
+
+void AudioRing::CommitWriteBlock()
+{
+	if (++m_iWriteBlock == m_cBlocks) m_iWriteBlock = 0;
+
+	LONG cWrittenBlocks = m_cWrittenBlocks + 1;
+
+	InterlockedExchange(&m_cWrittenBlocks, cWrittenBlocks);
+
+	LONG FillLevel = cWrittenBlocks - m_cReadBlocks;
+
+	if (FillLevel > m_MaxFillLevel) InterlockedExchange(&m_MaxFillLevel, FillLevel);
+}
+
+/****************************************************************************************
+*
+*    GetReadBlock
+*
+*   
+*       
+*
+*    
+*              NULL,   .
+*
+*       .    ,  
+*        ReleaseReadBlock.    .
+*
+*   
+*
+*    Visual C++     ,   
+*   volatile-,   ,     
+*     .
+*
+****************************************************************************************/
+
+AUDIOBLOCK *AudioRing::GetReadBlock()
+{
+	if (m_cWrittenBlocks == m_cReadBlocks) return NULL;
+
+	return &m_pBlocks[m_iReadBlock];
+}
+
+/****************************************************************************************
+*
+*    ReleaseReadBlock
+*
+*   
+*       
+*
+*    
+*       
+*
+*    ,   GetReadBlock,     
+*     .    .
+*
+****************************************************************************************/
+
+void AudioRing::ReleaseReadBlock()
+{
+	if (++m_iReadBlock == m_cBlocks) m_iReadBlock = 0;
+
+	InterlockedExchange(&m_cReadBlocks, m_cReadBlocks + 1);
+}
+
+/****************************************************************************************
+*
+*    GetFillLevel
+*
+*   
+*       
+*
+*    
+*         .
+*
+*     ,  ,     
+*   .         ,    
+*      .
+*
+****************************************************************************************/
+
+DWORD AudioRing::GetFillLevel()
+{
+	LONG cReadBlocks = m_cReadBlocks;
+
+	return (DWORD) (m_cWrittenBlocks - cReadBlocks);
+}
+
+/****************************************************************************************
+*
+*    GetMaxFillLevel
+*
+*   
+*       
+*
+*    
+*          .
+*
+*           .
+*         ,     
+*    .
+*
+****************************************************************************************/
+
+DWORD AudioRing::GetMaxFillLevel()
+{
+	return (DWORD) m_MaxFillLevel;
+}
+
+/****************************************************************************************
+*
+*    GetBlockCount
+*
+*   
+*       
+*
+*    
+*          .
+*
+*     ,    .
+*
+****************************************************************************************/
+
+DWORD AudioRing::GetBlockCount()
+{
+	return m_cBlocks;
+}
+
+/****************************************************************************************
+*
+*    GetSamplesPerBlock
+*
+*   
+*       
+*
+*    
+*           .
+*
+*        ,    .
+*
+****************************************************************************************/
+
+DWORD AudioRing::GetSamplesPerBlock()
+{
+	return m_cSamplesPerBlock;
+}
+
+/****************************************************************************************
+*
+*    Free
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .
+*
+****************************************************************************************/
+
+void AudioRing::Free()
+{
+	if (m_pBlocks != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pBlocks);
+		m_pBlocks = NULL;
+	}
+
+	if (m_pSamples != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pSamples);
+		m_pSamples = NULL;
+	}
+
+	m_cBlocks = 0;
+	m_cSamplesPerBlock = 0;
+}
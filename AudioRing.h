@@ -0,0 +1,118 @@
+/****************************************************************************************
+*
+*     AudioRing
+*
+*             
+*    .       (  ),  
+*      ;     .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//      ;     
+//    ,         
+#define CACHE_LINE_SIZE		64
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,    
+struct AUDIOBLOCK {
+	LONGLONG CaptureTime; //      
+						  //  (.  PitchSource::Capture)
+	DWORD iBlock; //     ,   
+	DWORD cSamples; //    
+	SHORT *pSamples; //    (16 ,  )
+};
+
+/****************************************************************************************
+*
+*    AudioRing
+*
+****************************************************************************************/
+
+class AudioRing
+{
+	//  
+	AUDIOBLOCK *m_pBlocks;
+
+	// ,         
+	SHORT *m_pSamples;
+
+	//    
+	DWORD m_cBlocks;
+
+	//     
+	DWORD m_cSamplesPerBlock;
+
+	//  ,     ;  
+	//  
+	volatile LONG m_cWrittenBlocks;
+
+	//  ,    ;   
+	// 
+	DWORD m_iWriteBlock;
+
+	BYTE m_WriterPadding[CACHE_LINE_SIZE];
+
+	//  ,     ;  
+	//  
+	volatile LONG m_cReadBlocks;
+
+	//  ,    ;  
+	//  
+	DWORD m_iReadBlock;
+
+	BYTE m_ReaderPadding[CACHE_LINE_SIZE];
+
+	//        ; 
+	//   
+	volatile LONG m_MaxFillLevel;
+
+public:
+
+	AudioRing();
+	~AudioRing();
+
+	//  
+	bool Create(
+		__in DWORD cBlocks,
+		__in DWORD cSamplesPerBlock);
+
+	//   ,     
+	AUDIOBLOCK *GetWriteBlock();
+
+	//     
+	void CommitWriteBlock();
+
+	//     
+	AUDIOBLOCK *GetReadBlock();
+
+	//   
+	void ReleaseReadBlock();
+
+	//    
+	DWORD GetFillLevel();
+
+	//     
+	DWORD GetMaxFillLevel();
+
+	//     
+	DWORD GetBlockCount();
+
+	//      
+	DWORD GetSamplesPerBlock();
+
+	//    
+	void Free();
+};
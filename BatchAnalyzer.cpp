@@ -0,0 +1,841 @@
+/****************************************************************************************
+*
+*           
+*
+*     MIDI-  -      ,
+*             ,     
+*   ,         .
+*        (  -   
+*    ).        DirectDraw; 
+*   ShowError      HEADLESS.
+*
+*        ,   
+*   ,   ,  ,     
+*   .     , ,     
+*    ,      GetNextSingingEvent, GetNextMeasure 
+*   GetNextTempo,          
+*   ,     :   , 
+*         .
+*
+*    : SingoscopeBatch <  > [ ]
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <locale.h>
+
+#include "Log.h"
+#include "Trace.h"
+#include "TextMessages.h"
+#include "ShowError.h"
+#include "Song.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiPart.h"
+#include "MidiLyric.h"
+#include "MidiSong.h"
+#include "MidiFile.h"
+#include "SongFile.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//       
+#define DEFAULT_CODE_PAGE					CP_ACP
+
+//     
+#define DEFAULT_CONCORD_NOTE_CHOICE			CHOOSE_MIN_NOTE_NUMBER
+
+//      ( ,     )
+#define DEFAULT_QUANTIZE_STEP_DENOMINATOR	32
+
+//      g_pFiles
+#define INITIAL_FILE_ARRAY_SIZE				256
+
+//     32-   FNV-1a
+#define CHECKSUM_OFFSET_BASIS				2166136261
+#define CHECKSUM_PRIME						16777619
+
+//   
+#define EXIT_CODE_ALL_FILES_LOADED			0
+#define EXIT_CODE_SOME_FILES_FAILED			1
+#define EXIT_CODE_INVALID_ARGUMENTS			2
+#define EXIT_CODE_FATAL_ERROR				3
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,       
+struct FILEINFO
+{
+	LPTSTR pszFileName; //   
+	DWORD cbFile; //    
+	bool bIsLoaded; // true,    
+	MIDIFILERESULT Result; //   
+	DWORD SystemError; //       
+	DWORD cVocalParts; //    
+	DWORD cPrunedCandidates; //  ,  
+	DWORD QuantizeStepDenominator; //    ,  
+								   //   ,  ,   
+								   //  
+	DWORD SongChecksum; //     ,    
+						// 
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//     
+static FILEINFO *g_pFiles = NULL;
+
+//      g_pFiles
+static DWORD g_cFiles = 0;
+
+//  ,       g_pFiles
+static DWORD g_cMaxFiles = 0;
+
+//       g_pFiles; -
+//  ,     InterlockedIncrement
+static volatile LONG g_iNextFile = 0;
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static int AnalyzeFiles(
+	__in LPCTSTR pszPath,
+	__in_opt LPCTSTR pszThreads);
+
+static bool FindSongFiles(
+	__in LPCTSTR pszDirectory);
+
+static bool AddFile(
+	__in LPCTSTR pszDirectory,
+	__in LPCTSTR pszFileName,
+	__in DWORD cbFile);
+
+static bool IsSongFileName(
+	__in LPCTSTR pszFileName);
+
+static DWORD WINAPI AnalyzerThreadProc(
+	__in LPVOID lpParameter);
+
+static void AnalyzeFile(
+	__inout FILEINFO *pFileInfo);
+
+static DWORD GetSongChecksum(
+	__in Song *pSong);
+
+static DWORD AddToChecksum(
+	__in DWORD Checksum,
+	__in const void *pData,
+	__in DWORD cbData);
+
+static LPCTSTR GetResultName(
+	__in FILEINFO *pFileInfo);
+
+static void FreeFiles();
+
+/****************************************************************************************
+*
+*    _tmain
+*
+*   .   main  MSDN.
+*
+****************************************************************************************/
+
+int __cdecl _tmain(
+	int argc,
+	TCHAR *argv[])
+{
+	//   OEM-,      
+	setlocale(LC_ALL, ".OCP");
+
+	if (argc < 2 || argc > 3)
+	{
+		_tprintf(TEXT("usage: SingoscopeBatch <directory | file> [threads]\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	INITLOG(TEXT("batchlog.txt"));
+	INITTRACE(TEXT("batchtrace.json"));
+
+	int ExitCode = EXIT_CODE_FATAL_ERROR;
+
+	if (!TextMessages_Init())
+	{
+		LOG("TextMessages_Init failed\n");
+	}
+	else if (!ShowError_Init())
+	{
+		LOG("ShowError_Init failed\n");
+	}
+	else
+	{
+		ExitCode = AnalyzeFiles(argv[1], (argc == 3) ? argv[2] : NULL);
+	}
+
+	FreeFiles();
+
+	ShowError_Uninit();
+	TextMessages_Uninit();
+
+	UNINITTRACE();
+	UNINITLOG();
+
+	return ExitCode;
+}
+
+/****************************************************************************************
+*
+*    AnalyzeFiles
+*
+*   
+*       pszPath -   ,  ,     
+*                      
+*       pszThreads -   ,  ,   
+*                     -;     NULL, 
+*                          
+*
+*    
+*         .
+*
+*       ,      
+*      ,        
+*         .      
+*    .
+*
+****************************************************************************************/
+
+static int AnalyzeFiles(
+	__in LPCTSTR pszPath,
+	__in_opt LPCTSTR pszThreads)
+{
+	//     
+	// --------------------------------------
+
+	DWORD Attributes = GetFileAttributes(pszPath);
+
+	if (Attributes == INVALID_FILE_ATTRIBUTES)
+	{
+		_tprintf(TEXT("cannot access %s (error %u)\n"), pszPath, GetLastError());
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	if (Attributes & FILE_ATTRIBUTE_DIRECTORY)
+	{
+		if (!FindSongFiles(pszPath))
+		{
+			LOG("FindSongFiles failed\n");
+			return EXIT_CODE_FATAL_ERROR;
+		}
+	}
+	else
+	{
+		WIN32_FILE_ATTRIBUTE_DATA FileData;
+
+		if (!GetFileAttributesEx(pszPath, GetFileExInfoStandard, &FileData))
+		{
+			_tprintf(TEXT("cannot access %s (error %u)\n"), pszPath, GetLastError());
+			return EXIT_CODE_INVALID_ARGUMENTS;
+		}
+
+		if (!AddFile(NULL, pszPath, FileData.nFileSizeLow))
+		{
+			LOG("AddFile failed\n");
+			return EXIT_CODE_FATAL_ERROR;
+		}
+	}
+
+	//   -
+	// ------------------------------------------
+
+	DWORD cThreads;
+
+	if (pszThreads != NULL)
+	{
+		cThreads = _tcstoul(pszThreads, NULL, 10);
+
+		if (cThreads == 0)
+		{
+			_tprintf(TEXT("invalid number of threads: %s\n"), pszThreads);
+			return EXIT_CODE_INVALID_ARGUMENTS;
+		}
+	}
+	else
+	{
+		SYSTEM_INFO SystemInfo;
+		GetSystemInfo(&SystemInfo);
+		cThreads = SystemInfo.dwNumberOfProcessors;
+	}
+
+	//  WaitForMultipleObjects     MAXIMUM_WAIT_OBJECTS
+	// ,   ,  ,  
+	if (cThreads > MAXIMUM_WAIT_OBJECTS) cThreads = MAXIMUM_WAIT_OBJECTS;
+	if (cThreads > g_cFiles) cThreads = g_cFiles;
+
+	//     ,     
+	//        ,    
+	if (cThreads > 1) MidiFile::SetMaxScoringThreads(1);
+
+	//  
+	// ------------------
+
+	LARGE_INTEGER Frequency, StartTime, EndTime;
+	QueryPerformanceFrequency(&Frequency);
+	QueryPerformanceCounter(&StartTime);
+
+	if (cThreads > 0)
+	{
+		HANDLE hThreads[MAXIMUM_WAIT_OBJECTS];
+
+		DWORD cStartedThreads = 0;
+
+		for (DWORD i = 0; i < cThreads; i++)
+		{
+			hThreads[cStartedThreads] = CreateThread(NULL, 0, AnalyzerThreadProc, NULL, 0,
+				NULL);
+
+			if (hThreads[cStartedThreads] == NULL)
+			{
+				LOG("CreateThread failed (error %u)\n", GetLastError());
+				continue;
+			}
+
+			cStartedThreads++;
+		}
+
+		//       ,    
+		// 
+		if (cStartedThreads == 0)
+		{
+			AnalyzerThreadProc(NULL);
+		}
+		else
+		{
+			WaitForMultipleObjects(cStartedThreads, hThreads, TRUE, INFINITE);
+
+			for (DWORD i = 0; i < cStartedThreads; i++) CloseHandle(hThreads[i]);
+		}
+	}
+
+	QueryPerformanceCounter(&EndTime);
+
+	//  
+	// ------------------
+
+	DWORD cLoadedFiles = 0;
+	ULONGLONG cbTotal = 0;
+	DWORD cPrunedCandidates = 0;
+
+	for (DWORD i = 0; i < g_cFiles; i++)
+	{
+		FILEINFO *pFileInfo = &g_pFiles[i];
+
+		if (pFileInfo->bIsLoaded) cLoadedFiles++;
+		cbTotal += pFileInfo->cbFile;
+		cPrunedCandidates += pFileInfo->cPrunedCandidates;
+
+		_tprintf(TEXT("%s\t%u\t%u\t%u\t%08X\t%s\n"), GetResultName(pFileInfo),
+			pFileInfo->cVocalParts, pFileInfo->QuantizeStepDenominator,
+			pFileInfo->cbFile, pFileInfo->SongChecksum, pFileInfo->pszFileName);
+	}
+
+	double Seconds = (double) (EndTime.QuadPart - StartTime.QuadPart) /
+		Frequency.QuadPart;
+
+	_tprintf(TEXT("files: %u, loaded: %u, failed: %u, threads: %u\n"), g_cFiles,
+		cLoadedFiles, g_cFiles - cLoadedFiles, cThreads);
+
+	_tprintf(TEXT("pruned candidates: %u\n"), cPrunedCandidates);
+
+	if (Seconds > 0)
+	{
+		_tprintf(TEXT("time: %.3f s, %.1f files/s, %.2f MB/s\n"), Seconds,
+			g_cFiles / Seconds, cbTotal / (1024.0 * 1024.0) / Seconds);
+	}
+
+	return (cLoadedFiles == g_cFiles) ? EXIT_CODE_ALL_FILES_LOADED :
+		EXIT_CODE_SOME_FILES_FAILED;
+}
+
+/****************************************************************************************
+*
+*    FindSongFiles
+*
+*   
+*       pszDirectory -   ,  ,    
+*                      
+*
+*    
+*       true,    ; false,     .
+*
+*      g_pFiles          
+*   . ,    , .
+*
+****************************************************************************************/
+
+static bool FindSongFiles(
+	__in LPCTSTR pszDirectory)
+{
+	//       
+	TCHAR pszPattern[MAX_PATH];
+
+	if (lstrlen(pszDirectory) + 2 >= MAX_PATH)
+	{
+		LOG("directory name is too long\n");
+		return true;
+	}
+
+	lstrcpy(pszPattern, pszDirectory);
+	lstrcat(pszPattern, TEXT("\\*"));
+
+	WIN32_FIND_DATA FindData;
+
+	HANDLE hFind = FindFirstFile(pszPattern, &FindData);
+
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		LOG("FindFirstFile failed (error %u)\n", GetLastError());
+		return true;
+	}
+
+	bool bResult = true;
+
+	do
+	{
+		if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			//     
+			if (lstrcmp(FindData.cFileName, TEXT(".")) == 0 ||
+				lstrcmp(FindData.cFileName, TEXT("..")) == 0)
+			{
+				continue;
+			}
+
+			//   
+			TCHAR pszSubdirectory[MAX_PATH];
+
+			if (lstrlen(pszDirectory) + 1 + lstrlen(FindData.cFileName) >= MAX_PATH)
+			{
+				LOG("directory name is too long\n");
+				continue;
+			}
+
+			lstrcpy(pszSubdirectory, pszDirectory);
+			lstrcat(pszSubdirectory, TEXT("\\"));
+			lstrcat(pszSubdirectory, FindData.cFileName);
+
+			if (!FindSongFiles(pszSubdirectory))
+			{
+				bResult = false;
+				break;
+			}
+		}
+		else if (IsSongFileName(FindData.cFileName))
+		{
+			if (!AddFile(pszDirectory, FindData.cFileName, FindData.nFileSizeLow))
+			{
+				bResult = false;
+				break;
+			}
+		}
+	}
+	while (FindNextFile(hFind, &FindData));
+
+	FindClose(hFind);
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    AddFile
+*
+*   
+*       pszDirectory -   ,  ,    
+*                      ,  ;      NULL,
+*                        pszFileName    
+*       pszFileName -   ,  ,    
+*                     
+*       cbFile -    
+*
+*    
+*       true,    ; false,     .
+*
+*        g_pFiles.
+*
+****************************************************************************************/
+
+static bool AddFile(
+	__in LPCTSTR pszDirectory,
+	__in LPCTSTR pszFileName,
+	__in DWORD cbFile)
+{
+	//   g_pFiles,       
+	if (g_cFiles == g_cMaxFiles)
+	{
+		DWORD cNewMaxFiles = (g_cMaxFiles == 0) ? INITIAL_FILE_ARRAY_SIZE :
+			g_cMaxFiles * 2;
+
+		FILEINFO *pNewFiles;
+
+		if (g_pFiles == NULL)
+		{
+			pNewFiles = (FILEINFO *) HeapAlloc(GetProcessHeap(), 0,
+				cNewMaxFiles * sizeof(FILEINFO));
+		}
+		else
+		{
+			pNewFiles = (FILEINFO *) HeapReAlloc(GetProcessHeap(), 0, g_pFiles,
+				cNewMaxFiles * sizeof(FILEINFO));
+		}
+
+		if (pNewFiles == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return false;
+		}
+
+		g_pFiles = pNewFiles;
+		g_cMaxFiles = cNewMaxFiles;
+	}
+
+	//       (  )
+	DWORD cchFullName = lstrlen(pszFileName);
+	if (pszDirectory != NULL) cchFullName += lstrlen(pszDirectory) + 1;
+
+	LPTSTR pszFullName = (LPTSTR) HeapAlloc(GetProcessHeap(), 0,
+		(cchFullName + 1) * sizeof(TCHAR));
+
+	if (pszFullName == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		return false;
+	}
+
+	if (pszDirectory != NULL)
+	{
+		lstrcpy(pszFullName, pszDirectory);
+		lstrcat(pszFullName, TEXT("\\"));
+		lstrcat(pszFullName, pszFileName);
+	}
+	else
+	{
+		lstrcpy(pszFullName, pszFileName);
+	}
+
+	FILEINFO *pFileInfo = &g_pFiles[g_cFiles++];
+
+	pFileInfo->pszFileName = pszFullName;
+	pFileInfo->cbFile = cbFile;
+	pFileInfo->bIsLoaded = false;
+	pFileInfo->Result = MIDIFILE_SUCCESS;
+	pFileInfo->SystemError = ERROR_SUCCESS;
+	pFileInfo->cVocalParts = 0;
+	pFileInfo->cPrunedCandidates = 0;
+	pFileInfo->QuantizeStepDenominator = 0;
+	pFileInfo->SongChecksum = 0;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    IsSongFileName
+*
+*   
+*       pszFileName -   ,  ,    
+*                     
+*
+*    
+*       true,      MIDI-  -; 
+*       false.
+*
+*   ,      ,     (  
+*   ,      ).
+*
+****************************************************************************************/
+
+static bool IsSongFileName(
+	__in LPCTSTR pszFileName)
+{
+	LPCTSTR pszExtension = NULL;
+
+	for (LPCTSTR pCurChar = pszFileName; *pCurChar != 0; pCurChar++)
+	{
+		if (*pCurChar == TEXT('.')) pszExtension = pCurChar;
+	}
+
+	if (pszExtension == NULL) return false;
+
+	return _tcsicmp(pszExtension, TEXT(".mid")) == 0 ||
+		_tcsicmp(pszExtension, TEXT(".midi")) == 0 ||
+		_tcsicmp(pszExtension, TEXT(".rmi")) == 0 ||
+		_tcsicmp(pszExtension, TEXT(".kar")) == 0;
+}
+
+/****************************************************************************************
+*
+*    AnalyzerThreadProc
+*
+*   
+*       lpParameter -  
+*
+*    
+*       .
+*
+*      .    g_pFiles 
+*          ,    . 
+*       ,      
+*    ,     .
+*
+****************************************************************************************/
+
+static DWORD WINAPI AnalyzerThreadProc(
+	__in LPVOID lpParameter)
+{
+	while (true)
+	{
+		DWORD iFile = (DWORD) InterlockedIncrement(&g_iNextFile) - 1;
+
+		if (iFile >= g_cFiles) break;
+
+		AnalyzeFile(&g_pFiles[iFile]);
+	}
+
+	TRACE_THREAD_END();
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    AnalyzeFile
+*
+*   
+*       pFileInfo -   ,   
+*
+*    
+*       
+*
+*      ,         
+*      ,     pFileInfo. 
+*     ,     .
+*
+****************************************************************************************/
+
+static void AnalyzeFile(
+	__inout FILEINFO *pFileInfo)
+{
+	SongFile File;
+
+	pFileInfo->bIsLoaded = File.LoadFile(pFileInfo->pszFileName, DEFAULT_CODE_PAGE,
+		DEFAULT_CONCORD_NOTE_CHOICE, LOADFILE_MAP);
+
+	pFileInfo->Result = File.GetLastResult(&pFileInfo->SystemError);
+	pFileInfo->cVocalParts = File.GetVocalPartCount();
+	pFileInfo->cPrunedCandidates = File.GetPrunedCandidateCount();
+
+	if (!pFileInfo->bIsLoaded) return;
+
+	Song *pSong = File.CreateSong(DEFAULT_QUANTIZE_STEP_DENOMINATOR,
+		&pFileInfo->QuantizeStepDenominator);
+
+	if (pSong == NULL)
+	{
+		LOG("SongFile::CreateSong failed\n");
+		pFileInfo->bIsLoaded = false;
+		pFileInfo->Result = MIDIFILE_CANT_ALLOC_MEMORY;
+		pFileInfo->QuantizeStepDenominator = 0;
+		return;
+	}
+
+	pFileInfo->SongChecksum = GetSongChecksum(pSong);
+
+	delete pSong;
+}
+
+/****************************************************************************************
+*
+*    GetSongChecksum
+*
+*   
+*       pSong -   
+*
+*    
+*         .
+*
+*      FNV-1a     ( ,  
+*         ),    . 
+*    ,        ,  
+*           .
+*
+****************************************************************************************/
+
+static DWORD GetSongChecksum(
+	__in Song *pSong)
+{
+	DWORD Checksum = CHECKSUM_OFFSET_BASIS;
+
+	pSong->ResetCurrentPosition();
+
+	DWORD NoteNumber;
+	double PauseLength;
+	double NoteLength;
+	LPCWSTR pwsNoteText;
+	DWORD cchNoteText;
+
+	while (pSong->GetNextSingingEvent(&NoteNumber, &PauseLength, &NoteLength,
+		&pwsNoteText, &cchNoteText))
+	{
+		Checksum = AddToChecksum(Checksum, &NoteNumber, sizeof(NoteNumber));
+		Checksum = AddToChecksum(Checksum, &PauseLength, sizeof(PauseLength));
+		Checksum = AddToChecksum(Checksum, &NoteLength, sizeof(NoteLength));
+		Checksum = AddToChecksum(Checksum, &cchNoteText, sizeof(cchNoteText));
+
+		if (pwsNoteText != NULL)
+		{
+			Checksum = AddToChecksum(Checksum, pwsNoteText, cchNoteText * sizeof(WCHAR));
+		}
+	}
+
+	DWORD Numerator;
+	DWORD Denominator;
+
+	while (pSong->GetNextMeasure(&Numerator, &Denominator))
+	{
+		Checksum = AddToChecksum(Checksum, &Numerator, sizeof(Numerator));
+		Checksum = AddToChecksum(Checksum, &Denominator, sizeof(Denominator));
+	}
+
+	double Offset;
+	double BPM;
+
+	while (pSong->GetNextTempo(&Offset, &BPM))
+	{
+		Checksum = AddToChecksum(Checksum, &Offset, sizeof(Offset));
+		Checksum = AddToChecksum(Checksum, &BPM, sizeof(BPM));
+	}
+
+	pSong->ResetCurrentPosition();
+
+	return Checksum;
+}
+
+/****************************************************************************************
+*
+*    AddToChecksum
+*
+*   
+*       Checksum -    
+*       pData -    
+*       cbData -     
+*
+*    
+*          .
+*
+****************************************************************************************/
+
+static DWORD AddToChecksum(
+	__in DWORD Checksum,
+	__in const void *pData,
+	__in DWORD cbData)
+{
+	const BYTE *pBytes = (const BYTE *) pData;
+
+	for (DWORD i = 0; i < cbData; i++)
+	{
+		Checksum = (Checksum ^ pBytes[i]) * CHECKSUM_PRIME;
+	}
+
+	return Checksum;
+}
+
+/****************************************************************************************
+*
+*    GetResultName
+*
+*   
+*       pFileInfo -   ,   
+*
+*    
+*              .
+*
+*           .
+*
+****************************************************************************************/
+
+static LPCTSTR GetResultName(
+	__in FILEINFO *pFileInfo)
+{
+	if (!pFileInfo->bIsLoaded && pFileInfo->SystemError != ERROR_SUCCESS)
+	{
+		return TEXT("SYSTEM_ERROR");
+	}
+
+	switch (pFileInfo->Result)
+	{
+		case MIDIFILE_SUCCESS:
+			return TEXT("SUCCESS");
+		case MIDIFILE_INVALID_FORMAT:
+			return TEXT("INVALID_FORMAT");
+		case MIDIFILE_UNSUPPORTED_FORMAT:
+			return TEXT("UNSUPPORTED_FORMAT");
+		case MIDIFILE_NO_LYRIC:
+			return TEXT("NO_LYRIC");
+		case MIDIFILE_NO_VOCAL_PARTS:
+			return TEXT("NO_VOCAL_PARTS");
+		case MIDIFILE_CANT_ALLOC_MEMORY:
+			return TEXT("CANT_ALLOC_MEMORY");
+	}
+
+	return TEXT("UNKNOWN");
+}
+
+/****************************************************************************************
+*
+*    FreeFiles
+*
+*   
+*       
+*
+*    
+*       
+*
+*     g_pFiles.
+*
+****************************************************************************************/
+
+static void FreeFiles()
+{
+	if (g_pFiles == NULL) return;
+
+	for (DWORD i = 0; i < g_cFiles; i++)
+	{
+		HeapFree(GetProcessHeap(), 0, g_pFiles[i].pszFileName);
+	}
+
+	HeapFree(GetProcessHeap(), 0, g_pFiles);
+
+	g_pFiles = NULL;
+	g_cFiles = 0;
+	g_cMaxFiles = 0;
+}
@@ -0,0 +1,483 @@
+/****************************************************************************************
+*
+*          
+*
+*     MIDI-  -  ,      
+*       MidiTrack ( AttachToTrack),   
+*             
+*          .     
+*       MidiStreamParser,    .
+*          .
+*
+*    : SingoscopeBench <> [ ]
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <locale.h>
+
+#include "Log.h"
+#include "MidiTrack.h"
+#include "MidiStreamParser.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//     
+#define DEFAULT_REPEAT_COUNT			100
+
+//    MIDI- (    )  
+#define CHUNK_HEADER_SIZE				8
+
+//   ,     MidiStreamParser
+#define STREAM_CHUNK_SIZE				4096
+
+//   
+#define EXIT_CODE_SUCCESS				0
+#define EXIT_CODE_INVALID_FILE			1
+#define EXIT_CODE_INVALID_ARGUMENTS		2
+#define EXIT_CODE_FATAL_ERROR			3
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,   
+struct TRACKINFO
+{
+	BYTE *pFirstByte; //     
+	DWORD cbTrack; //  ,   
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+inline DWORD GetBigEndianDword(PBYTE pBytes)
+{
+	return pBytes[0] << 24 | pBytes[1] << 16 | pBytes[2] << 8 | pBytes[3];
+}
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static int BenchmarkFile(
+	__in LPCTSTR pszFileName,
+	__in DWORD cRepeats);
+
+static BYTE *LoadFile(
+	__in LPCTSTR pszFileName,
+	__out DWORD *pcbFile);
+
+static DWORD FindTracks(
+	__in BYTE *pFile,
+	__in DWORD cbFile,
+	__out TRACKINFO *pTracks);
+
+static ULONGLONG StreamFile(
+	__inout MidiStreamParser *pParser,
+	__in BYTE *pFile,
+	__in DWORD cbFile);
+
+/****************************************************************************************
+*
+*    _tmain
+*
+*   .   main  MSDN.
+*
+****************************************************************************************/
+
+int __cdecl _tmain(
+	int argc,
+	TCHAR *argv[])
+{
+	//   OEM-,      
+	setlocale(LC_ALL, ".OCP");
+
+	if (argc < 2 || argc > 3)
+	{
+		_tprintf(TEXT("usage: SingoscopeBench <file> [repeats]\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	DWORD cRepeats = DEFAULT_REPEAT_COUNT;
+
+	if (argc == 3)
+	{
+		cRepeats = _tcstoul(argv[2], NULL, 10);
+
+		if (cRepeats == 0)
+		{
+			_tprintf(TEXT("invalid number of repeats: %s\n"), argv[2]);
+			return EXIT_CODE_INVALID_ARGUMENTS;
+		}
+	}
+
+	INITLOG(TEXT("benchlog.txt"));
+
+	int ExitCode = BenchmarkFile(argv[1], cRepeats);
+
+	UNINITLOG();
+
+	return ExitCode;
+}
+
+/****************************************************************************************
+*
+*    BenchmarkFile
+*
+*   
+*       pszFileName -   ,  ,    
+*                     
+*       cRepeats -      
+*
+*    
+*         .
+*
+*    , cRepeats          
+*   .       , 
+*      .
+*
+****************************************************************************************/
+
+static int BenchmarkFile(
+	__in LPCTSTR pszFileName,
+	__in DWORD cRepeats)
+{
+	DWORD cbFile;
+
+	BYTE *pFile = LoadFile(pszFileName, &cbFile);
+
+	if (pFile == NULL) return EXIT_CODE_INVALID_FILE;
+
+	//      CHUNK_HEADER_SIZE ,    
+	//    ,  cbFile / CHUNK_HEADER_SIZE
+	TRACKINFO *pTracks = (TRACKINFO *) HeapAlloc(GetProcessHeap(), 0,
+		(cbFile / CHUNK_HEADER_SIZE + 1) * sizeof(TRACKINFO));
+
+	if (pTracks == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		HeapFree(GetProcessHeap(), 0, pFile);
+		return EXIT_CODE_FATAL_ERROR;
+	}
+
+	DWORD cTracks = FindTracks(pFile, cbFile, pTracks);
+
+	if (cTracks == 0)
+	{
+		_tprintf(TEXT("%s is not a MIDI file\n"), pszFileName);
+		HeapFree(GetProcessHeap(), 0, pTracks);
+		HeapFree(GetProcessHeap(), 0, pFile);
+		return EXIT_CODE_INVALID_FILE;
+	}
+
+	//        
+	ULONGLONG cbTracks = 0;
+	ULONGLONG cEvents = 0;
+
+	//  ,    
+	DWORD cFailedTracks = 0;
+
+	LARGE_INTEGER Frequency;
+	QueryPerformanceFrequency(&Frequency);
+
+	//           
+	LONGLONG ctBest = 0;
+	LONGLONG ctTotal = 0;
+
+	MidiTrack Track;
+
+	for (DWORD iRepeat = 0; iRepeat < cRepeats; iRepeat++)
+	{
+		LARGE_INTEGER StartTime, EndTime;
+		QueryPerformanceCounter(&StartTime);
+
+		for (DWORD i = 0; i < cTracks; i++)
+		{
+			MIDITRACKRESULT Result = Track.AttachToTrack(pTracks[i].pFirstByte,
+				pTracks[i].cbTrack);
+
+			//         
+			if (iRepeat != 0) continue;
+
+			cbTracks += pTracks[i].cbTrack;
+
+			if (Result == MIDITRACK_SUCCESS)
+			{
+				cEvents += Track.GetEventCount();
+			}
+			else
+			{
+				cFailedTracks++;
+			}
+		}
+
+		QueryPerformanceCounter(&EndTime);
+
+		LONGLONG ctElapsed = EndTime.QuadPart - StartTime.QuadPart;
+
+		if (iRepeat == 0 || ctElapsed < ctBest) ctBest = ctElapsed;
+		ctTotal += ctElapsed;
+	}
+
+	//  
+	// ------------------
+
+	double BestSeconds = (double) ctBest / Frequency.QuadPart;
+	double MeanSeconds = (double) ctTotal / Frequency.QuadPart / cRepeats;
+
+	_tprintf(TEXT("file: %s\n"), pszFileName);
+
+	_tprintf(TEXT("tracks: %u, failed: %u, bytes: %I64u, events: %I64u\n"), cTracks,
+		cFailedTracks, cbTracks, cEvents);
+
+	_tprintf(TEXT("repeats: %u, best: %.3f ms, mean: %.3f ms\n"), cRepeats,
+		BestSeconds * 1000, MeanSeconds * 1000);
+
+	if (BestSeconds > 0)
+	{
+		_tprintf(TEXT("speed: %.2f MB/s, %.2f Mevents/s\n"),
+			cbTracks / (1024.0 * 1024.0) / BestSeconds, cEvents / 1e6 / BestSeconds);
+	}
+
+	//      
+	// ------------------------------------------------
+
+	MidiStreamParser Parser;
+
+	ULONGLONG cStreamEvents = 0;
+
+	for (DWORD iRepeat = 0; iRepeat < cRepeats; iRepeat++)
+	{
+		LARGE_INTEGER StartTime, EndTime;
+		QueryPerformanceCounter(&StartTime);
+
+		cStreamEvents = StreamFile(&Parser, pFile, cbFile);
+
+		QueryPerformanceCounter(&EndTime);
+
+		LONGLONG ctElapsed = EndTime.QuadPart - StartTime.QuadPart;
+
+		if (iRepeat == 0 || ctElapsed < ctBest) ctBest = ctElapsed;
+	}
+
+	BestSeconds = (double) ctBest / Frequency.QuadPart;
+
+	_tprintf(TEXT("stream: %u-byte chunks, events: %I64u, best: %.3f ms\n"),
+		STREAM_CHUNK_SIZE, cStreamEvents, BestSeconds * 1000);
+
+	if (BestSeconds > 0)
+	{
+		_tprintf(TEXT("stream speed: %.2f MB/s, %.2f Mevents/s\n"),
+			cbFile / (1024.0 * 1024.0) / BestSeconds, cStreamEvents / 1e6 / BestSeconds);
+	}
+
+	HeapFree(GetProcessHeap(), 0, pTracks);
+	HeapFree(GetProcessHeap(), 0, pFile);
+
+	return EXIT_CODE_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    LoadFile
+*
+*   
+*       pszFileName -   ,  ,    
+*                     
+*       pcbFile -   ,        
+*
+*    
+*          ,    ;  NULL.
+*
+*       ,    .  
+*    HeapFree.
+*
+****************************************************************************************/
+
+static BYTE *LoadFile(
+	__in LPCTSTR pszFileName,
+	__out DWORD *pcbFile)
+{
+	HANDLE hFile = CreateFile(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		_tprintf(TEXT("cannot open %s (error %u)\n"), pszFileName, GetLastError());
+		return NULL;
+	}
+
+	DWORD cbFile = GetFileSize(hFile, NULL);
+
+	if (cbFile == INVALID_FILE_SIZE || cbFile == 0)
+	{
+		_tprintf(TEXT("cannot get size of %s (error %u)\n"), pszFileName,
+			GetLastError());
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	BYTE *pFile = (BYTE *) HeapAlloc(GetProcessHeap(), 0, cbFile);
+
+	if (pFile == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	DWORD cbRead;
+
+	if (!ReadFile(hFile, pFile, cbFile, &cbRead, NULL) || cbRead != cbFile)
+	{
+		_tprintf(TEXT("cannot read %s (error %u)\n"), pszFileName, GetLastError());
+		HeapFree(GetProcessHeap(), 0, pFile);
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	CloseHandle(hFile);
+
+	*pcbFile = cbFile;
+
+	return pFile;
+}
+
+/****************************************************************************************
+*
+*    FindTracks
+*
+*   
+*       pFile -    
+*       cbFile -    
+*       pTracks -   ,      ; 
+*                   cbFile / CHUNK_HEADER_SIZE + 1 
+*
+*    
+*           ,      
+*       MIDI-.
+*
+*      (   "MTrk")   ,    
+*   MidiFile::AssignFile:       ,  ,
+*      ,    .
+*
+****************************************************************************************/
+
+static DWORD FindTracks(
+	__in BYTE *pFile,
+	__in DWORD cbFile,
+	__out TRACKINFO *pTracks)
+{
+	//  MIDI-  14 
+	if (cbFile < 14 || GetBigEndianDword(pFile) != 'MThd') return 0;
+
+	DWORD cTracks = 0;
+	DWORD iCurByte = 14;
+
+	while (iCurByte + 7 < cbFile)
+	{
+		//    
+		DWORD CurChunkSignature = GetBigEndianDword(pFile + iCurByte);
+		iCurByte += 4;
+
+		//       
+		DWORD cbChunk = GetBigEndianDword(pFile + iCurByte);
+		iCurByte += 4;
+
+		//        ,  
+		//    
+		if (iCurByte + cbChunk > cbFile) cbChunk = cbFile - iCurByte;
+
+		if (CurChunkSignature == 'MTrk' && cbChunk > 0)
+		{
+			pTracks[cTracks].pFirstByte = pFile + iCurByte;
+			pTracks[cTracks].cbTrack = cbChunk;
+			cTracks++;
+		}
+
+		iCurByte += cbChunk;
+	}
+
+	return cTracks;
+}
+
+/****************************************************************************************
+*
+*    StreamFile
+*
+*   
+*       pParser -   ,  
+*       pFile -    
+*       cbFile -    
+*
+*    
+*        ,   pParser.
+*
+*      MidiStreamParser,     
+*   STREAM_CHUNK_SIZE .
+*
+****************************************************************************************/
+
+static ULONGLONG StreamFile(
+	__inout MidiStreamParser *pParser,
+	__in BYTE *pFile,
+	__in DWORD cbFile)
+{
+	ULONGLONG cEvents = 0;
+
+	//       
+	DWORD ChunkOffset = 0;
+
+	pParser->Reset();
+
+	while (true)
+	{
+		MIDISTREAMEVENT Event;
+
+		MIDISTREAMRESULT Result = pParser->GetNextEvent(&Event);
+
+		if (Result == MIDISTREAM_EVENT)
+		{
+			cEvents++;
+		}
+		else if (Result == MIDISTREAM_NEED_MORE_DATA)
+		{
+			if (ChunkOffset == cbFile)
+			{
+				pParser->SetEndOfInput();
+				continue;
+			}
+
+			DWORD cbChunk = cbFile - ChunkOffset;
+			if (cbChunk > STREAM_CHUNK_SIZE) cbChunk = STREAM_CHUNK_SIZE;
+
+			pParser->Feed(pFile + ChunkOffset, cbChunk);
+			ChunkOffset += cbChunk;
+		}
+		else if (Result != MIDISTREAM_HEADER && Result != MIDISTREAM_TRACK_END &&
+			Result != MIDISTREAM_INVALID_TRACK)
+		{
+			break;
+		}
+	}
+
+	return cEvents;
+}
@@ -0,0 +1,556 @@
+/****************************************************************************************
+*
+*     FilePitchSource
+*
+*           , 
+*      WAV-    .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+
+#include "Log.h"
+#include "AudioRing.h"
+#include "PitchSource.h"
+#include "FilePitchSource.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//   RIFF-
+#define RIFF_CHUNK_ID				0x46464952 // "RIFF"
+#define WAVE_FORM_TYPE				0x45564157 // "WAVE"
+#define FMT_CHUNK_ID				0x20746D66 // "fmt "
+#define DATA_CHUNK_ID				0x61746164 // "data"
+
+//      "fmt "
+#define WAVE_FORMAT_PCM_TAG			0x0001
+#define WAVE_FORMAT_EXTENSIBLE_TAG	0xFFFE
+
+//    "fmt ",    
+#define FMT_CHUNK_MIN_SIZE			16
+
+//   "fmt "  WAVE_FORMAT_EXTENSIBLE ( WAVEFORMATEXTENSIBLE)
+//      SubFormat
+#define FMT_CHUNK_EXTENSIBLE_SIZE	40
+#define FMT_SUBFORMAT_OFFSET		24
+
+//   ,    
+#define MAX_WAVE_CHANNELS			2
+
+//      
+#define MIN_SAMPLE_RATE				8000
+#define MAX_SAMPLE_RATE				192000
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//  PCM   WAVE_FORMAT_EXTENSIBLE (KSDATAFORMAT_SUBTYPE_PCM 
+// ksmedia.h)
+static const GUID g_SubtypePcm =
+	{0x00000001, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       pszFileName -    WAV-  NULL,    
+*                      
+*       SampleRate -      ; 
+*                    WAV-  
+*       bIsPaced - true,        , 
+*                   ; false,    
+*
+*    
+*       
+*
+*     .       
+*     :      ,   .
+*
+****************************************************************************************/
+
+FilePitchSource::FilePitchSource(
+	__in_opt LPCTSTR pszFileName,
+	__in DWORD SampleRate,
+	__in bool bIsPaced) : PitchSource(bIsPaced)
+{
+	if (pszFileName != NULL)
+	{
+		lstrcpyn(m_pszFileName, pszFileName, MAX_PATH);
+	}
+	else
+	{
+		m_pszFileName[0] = 0;
+	}
+
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_bCloseFile = false;
+	m_InputSampleRate = SampleRate;
+	m_cChannels = 1;
+	m_cbDataLeft = 0;
+	m_pReadBuffer = NULL;
+	m_cbReadBuffer = 0;
+	m_bIsPaced = bIsPaced;
+
+	LARGE_INTEGER Frequency;
+	QueryPerformanceFrequency(&Frequency);
+	m_TimerFrequency = Frequency.QuadPart;
+
+	m_StartTime = 0;
+	m_cReadSamples = 0;
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*     ,       , 
+*      .
+*
+****************************************************************************************/
+
+FilePitchSource::~FilePitchSource()
+{
+	Stop();
+
+	if (m_pReadBuffer != NULL) HeapFree(GetProcessHeap(), 0, m_pReadBuffer);
+}
+
+/****************************************************************************************
+*
+*    OpenInput
+*
+*   
+*       pSampleRate -   ,     
+*                     
+*
+*    
+*       true,       ;  false.
+*
+*    WAV-          
+*    .   PitchSource::Start.
+*
+****************************************************************************************/
+
+bool FilePitchSource::OpenInput(
+	__out DWORD *pSampleRate)
+{
+	if (m_pszFileName[0] == 0)
+	{
+		m_hFile = GetStdHandle(STD_INPUT_HANDLE);
+
+		if (m_hFile == INVALID_HANDLE_VALUE || m_hFile == NULL)
+		{
+			LOG("GetStdHandle failed (error %u)\n", GetLastError());
+			return false;
+		}
+
+		m_bCloseFile = false;
+		m_cChannels = 1;
+		m_cbDataLeft = MAXDWORD;
+	}
+	else
+	{
+		m_hFile = CreateFile(m_pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+		if (m_hFile == INVALID_HANDLE_VALUE)
+		{
+			LOG("CreateFile failed (error %u)\n", GetLastError());
+			return false;
+		}
+
+		m_bCloseFile = true;
+	}
+
+	//    Sleep,   ; 
+	//   CloseInput
+	if (m_bIsPaced) timeBeginPeriod(1);
+
+	if (m_bCloseFile && !ReadWaveHeader())
+	{
+		CloseInput();
+		return false;
+	}
+
+	if (m_InputSampleRate < MIN_SAMPLE_RATE || m_InputSampleRate > MAX_SAMPLE_RATE)
+	{
+		LOG("unsupported sample rate %u\n", m_InputSampleRate);
+		CloseInput();
+		return false;
+	}
+
+	LARGE_INTEGER StartTime;
+	QueryPerformanceCounter(&StartTime);
+	m_StartTime = StartTime.QuadPart;
+
+	m_cReadSamples = 0;
+
+	*pSampleRate = m_InputSampleRate;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    ReadInput
+*
+*   
+*       pSamples -   ,     
+*       cSamples -    
+*
+*    
+*           ,   , 
+*           .
+*
+*        ,    ,  
+*    .         , 
+*          .  
+*   .
+*
+****************************************************************************************/
+
+DWORD FilePitchSource::ReadInput(
+	__out SHORT *pSamples,
+	__in DWORD cSamples)
+{
+	DWORD cbFrame = m_cChannels * sizeof(SHORT);
+
+	DWORD cbData = cSamples * cbFrame;
+
+	if (cbData > m_cbDataLeft) cbData = m_cbDataLeft - m_cbDataLeft % cbFrame;
+
+	if (cbData == 0) return 0;
+
+	//        
+	SHORT *pReadBuffer = pSamples;
+
+	if (m_cChannels > 1)
+	{
+		if (m_cbReadBuffer < cbData)
+		{
+			if (m_pReadBuffer != NULL) HeapFree(GetProcessHeap(), 0, m_pReadBuffer);
+
+			m_pReadBuffer = (SHORT *) HeapAlloc(GetProcessHeap(), 0, cbData);
+
+			if (m_pReadBuffer == NULL)
+			{
+				LOG("HeapAlloc failed\n");
+				m_cbReadBuffer = 0;
+				return 0;
+			}
+
+			m_cbReadBuffer = cbData;
+		}
+
+		pReadBuffer = m_pReadBuffer;
+	}
+
+	DWORD cbRead = ReadBytes(pReadBuffer, cbData);
+
+	if (m_cbDataLeft != MAXDWORD) m_cbDataLeft -= cbRead;
+
+	//    
+	DWORD cReadSamples = cbRead / cbFrame;
+
+	if (m_cChannels > 1)
+	{
+		for (DWORD i = 0; i < cReadSamples; i++)
+		{
+			pSamples[i] = (SHORT) ((pReadBuffer[2 * i] + pReadBuffer[2 * i + 1]) / 2);
+		}
+	}
+
+	m_cReadSamples += cReadSamples;
+
+	if (m_bIsPaced && cReadSamples != 0)
+	{
+		// ,       
+		LONGLONG DueTime = m_StartTime +
+			(LONGLONG) (m_cReadSamples * m_TimerFrequency / m_InputSampleRate);
+
+		while (!IsStopping())
+		{
+			LARGE_INTEGER CurrentTime;
+			QueryPerformanceCounter(&CurrentTime);
+
+			if (CurrentTime.QuadPart >= DueTime) break;
+
+			Sleep((DWORD) ((DueTime - CurrentTime.QuadPart) * 1000 / m_TimerFrequency));
+		}
+	}
+
+	if (IsStopping()) return 0;
+
+	return cReadSamples;
+}
+
+/****************************************************************************************
+*
+*    CloseInput
+*
+*   
+*       
+*
+*    
+*       
+*
+*    .    .
+*
+****************************************************************************************/
+
+void FilePitchSource::CloseInput()
+{
+	if (m_hFile == INVALID_HANDLE_VALUE) return;
+
+	if (m_bCloseFile) CloseHandle(m_hFile);
+
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_bCloseFile = false;
+
+	if (m_bIsPaced) timeEndPeriod(1);
+}
+
+/****************************************************************************************
+*
+*    ReadWaveHeader
+*
+*   
+*       
+*
+*    
+*       true,        ;  false.
+*
+*     RIFF-      "data",    
+*         .   PCM 
+*   16      ,      WAVE_FORMAT_EXTENSIBLE 
+*    PCM.
+*
+****************************************************************************************/
+
+bool FilePitchSource::ReadWaveHeader()
+{
+	DWORD Header[3];
+
+	if (ReadBytes(Header, sizeof(Header)) != sizeof(Header) ||
+		Header[0] != RIFF_CHUNK_ID || Header[2] != WAVE_FORM_TYPE)
+	{
+		LOG("not a RIFF WAVE file\n");
+		return false;
+	}
+
+	bool bIsFormatFound = false;
+
+	for (;;)
+	{
+		//    
+		DWORD ChunkHeader[2];
+
+		if (ReadBytes(ChunkHeader, sizeof(ChunkHeader)) != sizeof(ChunkHeader))
+		{
+			LOG("data chunk not found\n");
+			return false;
+		}
+
+		DWORD cbChunk = ChunkHeader[1];
+
+		if (ChunkHeader[0] == FMT_CHUNK_ID)
+		{
+			if (cbChunk < FMT_CHUNK_MIN_SIZE)
+			{
+				LOG("invalid fmt chunk\n");
+				return false;
+			}
+
+			//   WAVEFORMATEX: wFormatTag, nChannels, nSamplesPerSec,
+			// nAvgBytesPerSec, nBlockAlign, wBitsPerSample
+			BYTE Format[FMT_CHUNK_MIN_SIZE];
+
+			if (ReadBytes(Format, sizeof(Format)) != sizeof(Format)) return false;
+
+			WORD FormatTag = *(WORD *) &Format[0];
+			WORD cChannels = *(WORD *) &Format[2];
+			DWORD SampleRate = *(DWORD *) &Format[4];
+			WORD BitsPerSample = *(WORD *) &Format[14];
+
+			if ((FormatTag != WAVE_FORMAT_PCM_TAG &&
+				FormatTag != WAVE_FORMAT_EXTENSIBLE_TAG) || BitsPerSample != 16 ||
+				cChannels == 0 || cChannels > MAX_WAVE_CHANNELS)
+			{
+				LOG("unsupported wave format %u, %u channels, %u bits\n", FormatTag,
+					cChannels, BitsPerSample);
+				return false;
+			}
+
+			cbChunk -= FMT_CHUNK_MIN_SIZE;
+
+			if (FormatTag == WAVE_FORMAT_EXTENSIBLE_TAG)
+			{
+				//     SubFormat;   , ,
+				// IEEE float   
+				if (cbChunk < FMT_CHUNK_EXTENSIBLE_SIZE - FMT_CHUNK_MIN_SIZE)
+				{
+					LOG("invalid fmt chunk\n");
+					return false;
+				}
+
+				BYTE Extension[FMT_CHUNK_EXTENSIBLE_SIZE - FMT_CHUNK_MIN_SIZE];
+
+				if (ReadBytes(Extension, sizeof(Extension)) != sizeof(Extension))
+				{
+					return false;
+				}
+
+				GUID SubFormat;
+				CopyMemory(&SubFormat, &Extension[FMT_SUBFORMAT_OFFSET -
+					FMT_CHUNK_MIN_SIZE], sizeof(GUID));
+
+				if (!IsEqualGUID(SubFormat, g_SubtypePcm))
+				{
+					LOG("unsupported wave subformat\n");
+					return false;
+				}
+
+				cbChunk -= sizeof(Extension);
+			}
+
+			m_cChannels = cChannels;
+			m_InputSampleRate = SampleRate;
+			bIsFormatFound = true;
+		}
+		else if (ChunkHeader[0] == DATA_CHUNK_ID)
+		{
+			if (!bIsFormatFound)
+			{
+				LOG("fmt chunk not found\n");
+				return false;
+			}
+
+			m_cbDataLeft = cbChunk;
+
+			return true;
+		}
+
+		//     
+		if (!SkipBytes((ULONGLONG) cbChunk + (ChunkHeader[1] & 1))) return false;
+	}
+}
+
+/****************************************************************************************
+*
+*    ReadBytes
+*
+*   
+*       pData -   ,     
+*       cbData -  ,   
+*
+*    
+*         .   cbData,     
+*        .
+*
+*        .  (pipe)   
+*   ,   ReadFile ,    .
+*
+****************************************************************************************/
+
+DWORD FilePitchSource::ReadBytes(
+	__out_bcount(cbData) LPVOID pData,
+	__in DWORD cbData)
+{
+	DWORD cbTotalRead = 0;
+
+	while (cbTotalRead < cbData)
+	{
+		DWORD cbRead;
+
+		if (!ReadFile(m_hFile, (BYTE *) pData + cbTotalRead, cbData - cbTotalRead,
+			&cbRead, NULL))
+		{
+			//    
+			if (GetLastError() == ERROR_BROKEN_PIPE) break;
+
+			LOG("ReadFile failed (error %u)\n", GetLastError());
+			break;
+		}
+
+		if (cbRead == 0) break;
+
+		cbTotalRead += cbRead;
+	}
+
+	return cbTotalRead;
+}
+
+/****************************************************************************************
+*
+*    SkipBytes
+*
+*   
+*       cbData -  ,   
+*
+*    
+*       true,   ;  false.
+*
+*          .   
+*       (    ),   
+*   .
+*
+****************************************************************************************/
+
+bool FilePitchSource::SkipBytes(
+	__in ULONGLONG cbData)
+{
+	if (cbData == 0) return true;
+
+	LARGE_INTEGER FileSize;
+
+	if (!GetFileSizeEx(m_hFile, &FileSize))
+	{
+		LOG("GetFileSizeEx failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	//     
+	LARGE_INTEGER Distance;
+	Distance.QuadPart = 0;
+
+	LARGE_INTEGER Position;
+
+	if (!SetFilePointerEx(m_hFile, Distance, &Position, FILE_CURRENT))
+	{
+		LOG("SetFilePointerEx failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	if (Position.QuadPart > FileSize.QuadPart ||
+		cbData > (ULONGLONG) (FileSize.QuadPart - Position.QuadPart))
+	{
+		LOG("chunk extends past the end of file\n");
+		return false;
+	}
+
+	Distance.QuadPart = (LONGLONG) cbData;
+
+	if (!SetFilePointerEx(m_hFile, Distance, NULL, FILE_CURRENT))
+	{
+		LOG("SetFilePointerEx failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,90 @@
+/****************************************************************************************
+*
+*     FilePitchSource
+*
+*           , 
+*      WAV- (PCM, 16 ,    )   
+*    (PCM, 16 ,  ,  ).    
+*              
+*   ,      .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*    FilePitchSource
+*
+****************************************************************************************/
+
+class FilePitchSource : public PitchSource
+{
+	//  WAV-;     
+	TCHAR m_pszFileName[MAX_PATH];
+
+	//      
+	HANDLE m_hFile;
+
+	// true,   m_hFile  
+	bool m_bCloseFile;
+
+	//  ;      , 
+	// WAV-   
+	DWORD m_InputSampleRate;
+
+	//    
+	DWORD m_cChannels;
+
+	//    ,    ;  
+	//  - MAXDWORD
+	DWORD m_cbDataLeft;
+
+	//           
+	SHORT *m_pReadBuffer;
+	DWORD m_cbReadBuffer;
+
+	// true,       
+	bool m_bIsPaced;
+
+	//          
+	LONGLONG m_TimerFrequency;
+	LONGLONG m_StartTime;
+
+	//       
+	ULONGLONG m_cReadSamples;
+
+	//   WAV-    
+	bool ReadWaveHeader();
+
+	//      
+	DWORD ReadBytes(
+		__out_bcount(cbData) LPVOID pData,
+		__in DWORD cbData);
+
+	//     
+	bool SkipBytes(
+		__in ULONGLONG cbData);
+
+protected:
+
+	//  
+	virtual bool OpenInput(
+		__out DWORD *pSampleRate);
+
+	//    
+	virtual DWORD ReadInput(
+		__out SHORT *pSamples,
+		__in DWORD cSamples);
+
+	//  
+	virtual void CloseInput();
+
+public:
+
+	FilePitchSource(
+		__in_opt LPCTSTR pszFileName,
+		__in DWORD SampleRate,
+		__in bool bIsPaced);
+	virtual ~FilePitchSource();
+};
@@ -206,6 +206,7 @@ static LRESULT CALLBACK FrameWndProc(
 			switch (LOWORD(wParam))
 			{
 				case IDC_OPENFILE:
+				case IDC_NEXTVOCALPART:
 				{
 					SendMessage(g_hwndStave, WM_COMMAND, wParam, lParam);
 					return 0;
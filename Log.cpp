@@ -4,6 +4,15 @@
 *
 *        .
 *
+*         ,   -.
+*           ,
+*       (     
+*   ;      ,    
+*    ,   ),   .  
+*   ,  ,     
+*     .   LOG     ,  
+*       ,    .
+*
 *   :     , 2007-2010
 *
 ****************************************************************************************/
@@ -24,9 +33,42 @@
 *
 ****************************************************************************************/
 
-//  ,    Log_Log
+//  ,    Log_Log,  -  
 #define MAX_LOG_MSG_SIZE	2048
 
+//     ;  
+#define LOG_QUEUE_SIZE		1024
+
+//       ,   ;
+//    
+#define LOG_RECORD_SIZE		512
+
+// ,   -  ,  
+#define LOG_WRITER_PERIOD	20
+
+//  ,   -      
+#define LOG_WRITE_BUFFER_SIZE	65536
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,    
+struct LOGRECORD
+{
+	//   :       ,  
+	//   ;     -   
+	// 
+	volatile LONG Sequence;
+
+	DWORD Time; //        Log_Init
+	DWORD ThreadId; //  ,  
+	DWORD cchText; //     
+	char pText[LOG_RECORD_SIZE]; //  
+};
+
 /****************************************************************************************
 *
 *    
@@ -36,6 +78,39 @@
 //  - 
 static HANDLE g_hLogFile = INVALID_HANDLE_VALUE;
 
+//  
+static LOGRECORD *g_pQueue = NULL;
+
+//     ,    
+static volatile LONG g_iNextEnqueue = 0;
+
+//   ,   -
+static LONG g_iNextDequeue = 0;
+
+//  ,  -  
+static volatile LONG g_cDroppedRecords = 0;
+
+//  -  ,      
+static HANDLE g_hWriterThread = NULL;
+static HANDLE g_hStopEvent = NULL;
+
+//  GetTickCount    Log_Init
+static DWORD g_StartTime;
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static DWORD WINAPI WriterThreadProc(
+	__in LPVOID lpParameter);
+
+static void WriteRecords(
+	__inout char *pWriteBuffer,
+	__inout bool *pbIsLineStart,
+	__inout DWORD *pLineThreadId);
+
 /****************************************************************************************
 *
 *    Log_Init
@@ -46,7 +121,9 @@ static HANDLE g_hLogFile = INVALID_HANDLE_VALUE;
 *    
 *       
 *
-*    -   ,   pszFileName.
+*    -   ,   pszFileName,  
+*   -.  -   ,  
+*      .
 *
 ****************************************************************************************/
 
@@ -64,6 +141,38 @@ void Log_Init(
 		MessageBox(NULL, TEXT("Cannot create log file"), NULL, MB_OK);
 		return;
 	}
+
+	g_StartTime = GetTickCount();
+
+	g_pQueue = (LOGRECORD *) HeapAlloc(GetProcessHeap(), 0,
+		LOG_QUEUE_SIZE * sizeof(LOGRECORD));
+
+	if (g_pQueue == NULL) return;
+
+	for (LONG i = 0; i < LOG_QUEUE_SIZE; i++) g_pQueue[i].Sequence = i;
+
+	g_iNextEnqueue = 0;
+	g_iNextDequeue = 0;
+	g_cDroppedRecords = 0;
+
+	g_hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (g_hStopEvent != NULL)
+	{
+		g_hWriterThread = CreateThread(NULL, 0, WriterThreadProc, NULL, 0, NULL);
+	}
+
+	if (g_hWriterThread == NULL)
+	{
+		if (g_hStopEvent != NULL)
+		{
+			CloseHandle(g_hStopEvent);
+			g_hStopEvent = NULL;
+		}
+
+		HeapFree(GetProcessHeap(), 0, g_pQueue);
+		g_pQueue = NULL;
+	}
 }
 
 /****************************************************************************************
@@ -76,15 +185,37 @@ void Log_Init(
 *    
 *       
 *
-*    - .
+*   ,  -     ,  
+*   - .
+*
+*   
+*
+*      : ,     (,
+*         ),   LOG   ,
+*       ,       . 
+*      ,    , . 
+*       .
 *
 ****************************************************************************************/
 
 void Log_Uninit()
 {
+	if (g_hWriterThread != NULL)
+	{
+		SetEvent(g_hStopEvent);
+		WaitForSingleObject(g_hWriterThread, INFINITE);
+
+		CloseHandle(g_hWriterThread);
+		g_hWriterThread = NULL;
+
+		CloseHandle(g_hStopEvent);
+		g_hStopEvent = NULL;
+	}
+
 	if (g_hLogFile != INVALID_HANDLE_VALUE)
 	{
 		CloseHandle(g_hLogFile);
+		g_hLogFile = INVALID_HANDLE_VALUE;
 	}
 }
 
@@ -99,8 +230,10 @@ void Log_Uninit()
 *    
 *       
 *
-*        .    ,
-*     GetLastError.
+*         ;    
+*   -.      ,   :  
+*   ,  .    ,  
+*   GetLastError.
 *
 ****************************************************************************************/
 
@@ -110,20 +243,225 @@ void Log_Log(
 {
 	DWORD dwError = GetLastError();
 
-	char pBuf[MAX_LOG_MSG_SIZE];
-
 	va_list params;
 	va_start(params, pszMsg);
 
-	int cchBuf = _vsnprintf(pBuf, MAX_LOG_MSG_SIZE, pszMsg, params);
+	if (g_pQueue == NULL)
+	{
+		// -  ;   
+		char pBuf[MAX_LOG_MSG_SIZE];
 
-	if (cchBuf == -1) cchBuf = MAX_LOG_MSG_SIZE;
+		int cchBuf = _vsnprintf(pBuf, MAX_LOG_MSG_SIZE, pszMsg, params);
 
-	DWORD cbWritten;
+		if (cchBuf == -1) cchBuf = MAX_LOG_MSG_SIZE;
+
+		DWORD cbWritten;
+
+		WriteFile(g_hLogFile, pBuf, cchBuf, &cbWritten, NULL);
+
+		va_end(params);
+		SetLastError(dwError);
+		return;
+	}
+
+	//   :  ,     
+	//  ;        , 
+	//     
+	LOGRECORD *pRecord;
+	LONG iEnqueue = g_iNextEnqueue;
+
+	while (true)
+	{
+		pRecord = &g_pQueue[iEnqueue & (LOG_QUEUE_SIZE - 1)];
+
+		LONG Difference = pRecord->Sequence - iEnqueue;
+
+		if (Difference == 0)
+		{
+			LONG iPrevEnqueue = InterlockedCompareExchange(&g_iNextEnqueue,
+				iEnqueue + 1, iEnqueue);
+
+			if (iPrevEnqueue == iEnqueue) break;
+
+			iEnqueue = iPrevEnqueue;
+		}
+		else if (Difference < 0)
+		{
+			//     -:  
+			InterlockedIncrement(&g_cDroppedRecords);
+
+			va_end(params);
+			SetLastError(dwError);
+			return;
+		}
+		else
+		{
+			iEnqueue = g_iNextEnqueue;
+		}
+	}
+
+	int cchText = _vsnprintf(pRecord->pText, LOG_RECORD_SIZE, pszMsg, params);
+
+	if (cchText < 0 || cchText >= LOG_RECORD_SIZE) cchText = LOG_RECORD_SIZE - 1;
+
+	pRecord->cchText = cchText;
+	pRecord->Time = GetTickCount() - g_StartTime;
+	pRecord->ThreadId = GetCurrentThreadId();
 
-	WriteFile(g_hLogFile, pBuf, cchBuf, &cbWritten, NULL);
+	//   -; InterlockedExchange ,   
+	//    ,    
+	InterlockedExchange(&pRecord->Sequence, iEnqueue + 1);
 
+	va_end(params);
 	SetLastError(dwError);
 }
 
+/****************************************************************************************
+*
+*    WriterThreadProc
+*
+*   
+*       lpParameter -  
+*
+*    
+*       .
+*
+*     -.  LOG_WRITER_PERIOD 
+*         ,      
+*       .
+*
+****************************************************************************************/
+
+static DWORD WINAPI WriterThreadProc(
+	__in LPVOID lpParameter)
+{
+	char *pWriteBuffer = (char *) HeapAlloc(GetProcessHeap(), 0,
+		LOG_WRITE_BUFFER_SIZE);
+
+	if (pWriteBuffer == NULL) return 0;
+
+	// true,       
+	bool bIsLineStart = true;
+
+	//  ,   
+	DWORD LineThreadId = 0;
+
+	//   ,      
+	LONG cReportedDroppedRecords = 0;
+
+	bool bStop = false;
+
+	while (!bStop)
+	{
+		bStop = WaitForSingleObject(g_hStopEvent, LOG_WRITER_PERIOD) == WAIT_OBJECT_0;
+
+		//        ,  
+		//   ;      
+		WriteRecords(pWriteBuffer, &bIsLineStart, &LineThreadId);
+
+		LONG cDroppedRecords = g_cDroppedRecords;
+
+		if (cDroppedRecords != cReportedDroppedRecords)
+		{
+			int cchText = _snprintf(pWriteBuffer, LOG_WRITE_BUFFER_SIZE,
+				"%s*** %d log messages dropped\n", bIsLineStart ? "" : "\n",
+				cDroppedRecords - cReportedDroppedRecords);
+
+			DWORD cbWritten;
+
+			if (cchText > 0)
+			{
+				WriteFile(g_hLogFile, pWriteBuffer, cchText, &cbWritten, NULL);
+			}
+
+			bIsLineStart = true;
+			cReportedDroppedRecords = cDroppedRecords;
+		}
+	}
+
+	HeapFree(GetProcessHeap(), 0, pWriteBuffer);
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    WriteRecords
+*
+*   
+*       pWriteBuffer -     LOG_WRITE_BUFFER_SIZE 
+*       pbIsLineStart -   ,   true,  
+*                           ;  
+*       pLineThreadId -    ,  
+*                       ;  
+*
+*    
+*       
+*
+*               
+*   ,    ,      WriteFile.
+*    ,     ,   
+*      Log_Init   .  , 
+*    ,  ,      , 
+*        .
+*
+****************************************************************************************/
+
+static void WriteRecords(
+	__inout char *pWriteBuffer,
+	__inout bool *pbIsLineStart,
+	__inout DWORD *pLineThreadId)
+{
+	DWORD cchBuffer = 0;
+	DWORD cbWritten;
+
+	while (true)
+	{
+		LOGRECORD *pRecord = &g_pQueue[g_iNextDequeue & (LOG_QUEUE_SIZE - 1)];
+
+		//    
+		if (pRecord->Sequence != g_iNextDequeue + 1) break;
+
+		//  ,        
+		// LOG_RECORD_SIZE + 32 
+		if (cchBuffer + LOG_RECORD_SIZE + 32 > LOG_WRITE_BUFFER_SIZE)
+		{
+			WriteFile(g_hLogFile, pWriteBuffer, cchBuffer, &cbWritten, NULL);
+			cchBuffer = 0;
+		}
+
+		if (!*pbIsLineStart && pRecord->ThreadId != *pLineThreadId)
+		{
+			pWriteBuffer[cchBuffer++] = '\n';
+			*pbIsLineStart = true;
+		}
+
+		if (*pbIsLineStart)
+		{
+			*pLineThreadId = pRecord->ThreadId;
+
+			int cchHeader = _snprintf(pWriteBuffer + cchBuffer, 32, "%10u.%03u %5u: ",
+				pRecord->Time / 1000, pRecord->Time % 1000, pRecord->ThreadId);
+
+			if (cchHeader > 0) cchBuffer += cchHeader;
+		}
+
+		CopyMemory(pWriteBuffer + cchBuffer, pRecord->pText, pRecord->cchText);
+		cchBuffer += pRecord->cchText;
+
+		if (pRecord->cchText != 0)
+		{
+			*pbIsLineStart = pRecord->pText[pRecord->cchText - 1] == '\n';
+		}
+
+		//    ,      
+		//   
+		InterlockedExchange(&pRecord->Sequence, g_iNextDequeue + LOG_QUEUE_SIZE);
+
+		g_iNextDequeue++;
+	}
+
+	if (cchBuffer != 0) WriteFile(g_hLogFile, pWriteBuffer, cchBuffer, &cbWritten, NULL);
+}
+
 #endif // #ifdef DEBUGLOG
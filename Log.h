@@ -2,7 +2,8 @@
 *
 *     Log
 *
-*        .
+*        .    
+*    ,   LOG     .
 *
 *   :     , 2007-2010
 *
@@ -36,7 +37,9 @@
 *    
 *       
 *
-*    -   ,   pszFileName.
+*    -   ,   pszFileName,  
+*   -.  -   ,  
+*      .
 *
 ****************************************************************************************/
 
@@ -69,7 +72,9 @@ void Log_Init(
 *    
 *       
 *
-*    - .
+*   ,  -     ,  
+*   - . ,       
+*    , .
 *
 ****************************************************************************************/
 
@@ -104,8 +109,10 @@ void Log_Uninit();
 *    
 *       
 *
-*        .    ,
-*     GetLastError.
+*         ;    
+*   -.      ,   :  
+*   ,  .    ,  
+*   GetLastError.
 *
 ****************************************************************************************/
 
@@ -12,6 +12,7 @@
 #include <windows.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "TextMessages.h"
 #include "ShowError.h"
 #include "Video.h"
@@ -57,6 +58,7 @@ int WINAPI WinMain(
 	int nCmdShow)
 {
 	INITLOG(TEXT("log.txt"));
+	INITTRACE(TEXT("trace.json"));
 
 	g_hInstance = hInstance;
 
@@ -88,6 +90,7 @@ exit:
 
 	UninitApp();
 
+	UNINITTRACE();
 	UNINITLOG();
 
 	return 0;
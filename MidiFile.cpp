@@ -14,6 +14,7 @@
 #include <math.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "Song.h"
 #include "MidiLibrary.h"
 #include "MidiTrack.h"
@@ -53,14 +54,23 @@
 // MIDI-   
 #define MAX_VOCAL_PART_LYRIC_DISTANCE		500
 
+//       -    
+#define INITIAL_CANDIDATE_ARRAY_SIZE		64
+
+//   ,    (.  StartScoringPool)
+#define SCORING_POOL_NOT_STARTED			0
+#define SCORING_POOL_STARTING				1
+#define SCORING_POOL_STARTED				2
+#define SCORING_POOL_FAILED					3
+
 /****************************************************************************************
 *
 *    
 *
 ****************************************************************************************/
 
-// ,  ,       ;
-//    FindVocalParts
+// ,  ,       
+//  
 struct VOCAL_PART_LIMITATIONS {
 	double OverlapsThreshold;	//       
 								//        
@@ -90,6 +100,62 @@ inline DWORD Distance(DWORD Number1, DWORD Number2)
 	return Number2 - Number1;
 }
 
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//   ,       ;
+//   "     "
+static DWORD g_cMaxScoringThreads = 0;
+
+//   ,   ;    
+//      
+static volatile LONG g_ScoringPoolState = SCORING_POOL_NOT_STARTED;
+
+//   
+static DWORD g_cScoringPoolThreads = 0;
+
+//    ,  ,    
+// (  ); ,        
+// ,   
+static HANDLE volatile g_hScoringPoolReadyEvent = NULL;
+
+//  ,  ,   ScoreCandidates,  
+//     ;      
+static CRITICAL_SECTION g_csScoringPool;
+
+// ,         
+// g_pScoringJob,  ,    ,  
+// 
+static HANDLE g_hScoringStartSemaphore = NULL;
+static HANDLE g_hScoringDoneEvent = NULL;
+
+//    SCORINGJOB,    
+static LPVOID g_pScoringJob = NULL;
+
+// ,        
+//  :
+// 1)         
+//             ;
+// 2)      ,   
+//     
+static const VOCAL_PART_LIMITATIONS g_VocalPartLimitations[] =
+{
+	{ 0.0, IDENTICAL_START | IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, IDENTICAL_START | IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, IDENTICAL_START | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, 0 },
+};
+
+//     ;     
+//    ,       32
+static const DWORD g_cVocalPartStages =
+	sizeof(g_VocalPartLimitations) / sizeof(g_VocalPartLimitations[0]);
+
 /****************************************************************************************
 *
 *   
@@ -107,6 +173,8 @@ inline DWORD Distance(DWORD Number1, DWORD Number2)
 MidiFile::MidiFile()
 {
 	m_pFile = NULL;
+	m_cbFile = 0;
+	m_FileBufferType = FILEBUFFER_HEAP;
 
 	m_cTicksPerMidiQuarterNote = 0;
 
@@ -115,10 +183,16 @@ MidiFile::MidiFile()
 
 	m_DefaultCodePage = CP_ACP;
 	m_ConcordNoteChoice = CHOOSE_MIN_NOTE_NUMBER;
-	m_LyricEventType = 0;
-	m_pLyricTrack = NULL;
+	m_pLyric = NULL;
 
 	m_pVocalPartList = NULL;
+	m_cPrunedCandidates = 0;
+
+	ZeroMemory(m_StageTimes, sizeof(m_StageTimes));
+
+	m_pStageProc = NULL;
+	m_pStageContext = NULL;
+	m_pCancelFlag = NULL;
 }
 
 /****************************************************************************************
@@ -157,7 +231,7 @@ MidiFile::~MidiFile()
 *
 *          .   
 *         :
-*   1)   ;
+*   1)           ;
 *   2)       .
 *
 ****************************************************************************************/
@@ -236,8 +310,14 @@ MIDIFILERESULT MidiFile::SetConcordNoteChoice(
 *
 *   
 *       pFile -    ,    ;   
-*                 HeapAlloc
+*                  HeapAlloc,    ,
+*                 MapViewOfFile (     
+*                  )
 *		cbFile -    
+*       FileBufferType -     : FILEBUFFER_HEAP - 
+*                          HeapAlloc, FILEBUFFER_MAPPED_VIEW - 
+*                          ;     
+*                         FILEBUFFER_HEAP
 *
 *    
 *       MIDIFILE_SUCCESS -     (    
@@ -250,26 +330,45 @@ MIDIFILERESULT MidiFile::SetConcordNoteChoice(
 *       MIDIFILE_NO_LYRIC -    ;
 *       MIDIFILE_NO_VOCAL_PARTS -       (  , 
 *                                       );
-*       MIDIFILE_CANT_ALLOC_MEMORY -    .
+*       MIDIFILE_CANT_ALLOC_MEMORY -    ;
+*       MIDIFILE_CANCELLED -    (.  SetLoadControl).
 *
 *        .      ,
 *       pFile,    , .. 
-*        .  ,   
+*         ( HeapFree 
+*   UnmapViewOfFile      FileBufferType). 
+*    MidiTrack      ,   ,   
+*      .  ,   
 *   ,    :
 *   1)   ;
 *   2)   ;
 *   3)       .
 *
+*           
+*   GetStageTime.         ,
+*     SetLoadControl.
+*
 ****************************************************************************************/
 
 MIDIFILERESULT MidiFile::AssignFile(
 	__in BYTE *pFile,
-	__in DWORD cbFile)
+	__in DWORD cbFile,
+	__in FILEBUFFERTYPE FileBufferType)
 {
+	TRACE_ZONE("MidiFile::AssignFile");
+
 	//      - ,    
 	//   
 	Free();
 
+	ZeroMemory(m_StageTimes, sizeof(m_StageTimes));
+
+	if (!BeginStage(MIDIFILE_STAGE_ATTACH_TRACKS)) return MIDIFILE_CANCELLED;
+
+	//        
+	LARGE_INTEGER StageStartTime;
+	QueryPerformanceCounter(&StageStartTime);
+
 	if (pFile == NULL) return MIDIFILE_INVALID_FORMAT;
 
 	//   
@@ -375,6 +474,10 @@ MIDIFILERESULT MidiFile::AssignFile(
    	DWORD iCurTrack = 0;
 	while (iCurByte + 7 < cbFile)
 	{
+		//      ,   
+		//    
+		if (IsCancelled()) return MIDIFILE_CANCELLED;
+
 		//    
 		DWORD CurChunkSignature = GetBigEndianDword(pFile + iCurByte);
 		iCurByte += 4;
@@ -390,7 +493,16 @@ MIDIFILERESULT MidiFile::AssignFile(
 		if (CurChunkSignature == 'MTrk' && cbChunk > 0)
 		{
 			//     MidiTrack    MIDI-
-			if (m_MidiTracks[iCurTrack].AttachToTrack(pFile + iCurByte, cbChunk))
+			MIDITRACKRESULT TrackResult = m_MidiTracks[iCurTrack].AttachToTrack(
+				pFile + iCurByte, cbChunk);
+
+			if (TrackResult == MIDITRACK_CANT_ALLOC_MEMORY)
+			{
+				LOG("MidiTrack::AttachToTrack failed\n");
+				return MIDIFILE_CANT_ALLOC_MEMORY;
+			}
+
+			if (TrackResult == MIDITRACK_SUCCESS)
 			{
 				//    ,    
 				iCurTrack++;
@@ -411,24 +523,39 @@ MIDIFILERESULT MidiFile::AssignFile(
 	//       m_MidiTracks
 	m_cTracks = iCurTrack;
 
+	EndStage(MIDIFILE_STAGE_ATTACH_TRACKS, &StageStartTime);
+
+	if (!BeginStage(MIDIFILE_STAGE_FIND_LYRIC)) return MIDIFILE_CANCELLED;
+
 	//   
 	MIDIFILERESULT Res = FindLyric();
+
+	EndStage(MIDIFILE_STAGE_FIND_LYRIC, &StageStartTime);
+
 	if (Res != MIDIFILE_SUCCESS)
 	{
 		LOG("lyric not found\n");
 		return Res;
 	}
 
+	if (!BeginStage(MIDIFILE_STAGE_FIND_VOCAL_PARTS)) return MIDIFILE_CANCELLED;
+
 	//   
 	Res = FindVocalParts();
+
+	EndStage(MIDIFILE_STAGE_FIND_VOCAL_PARTS, &StageStartTime);
+
 	if (Res != MIDIFILE_SUCCESS)
 	{
 		LOG("vocal parts not found\n");
 		return Res;
 	}
 
-	//     ,    MIDI-
+	//     ,    MIDI-,  
+	//    
 	m_pFile = pFile;
+	m_cbFile = cbFile;
+	m_FileBufferType = FileBufferType;
 
 	return MIDIFILE_SUCCESS;
 }
@@ -438,27 +565,56 @@ MIDIFILERESULT MidiFile::AssignFile(
 *    CreateSong
 *
 *   
-*       
+*       iVocalPart -       ,  
+*                          ;  
+*                        , ..  , 
+*                      
+*       cMaxMeasures -     ,   
+*                      ;      ,   
+*                      ;       
+*       pbTruncated -   ,     true, 
+*                         cMaxMeasures ,  false, 
+*                       ;    NULL;  
+*                         NULL
 *
 *    
 *           Song,  NULL,   .  ,
-*               .
+*               ; 
+*       , NULL ,   iVocalPart    
+*        .
 *
 *      Song,   .
 *
 *   
 *
-*         ,     
-*     m_pVocalPartList.
+*         ,    
+*     m_pVocalPartList   iVocalPart.    
+*   ,    ,       
+*        .
+*
+*       cMaxMeasures,      
+*   ,   ,       
+*   cMaxMeasures,         
+*      .        ,
+*     (       
+*   ,          ),  
+*     ,     ,    , 
+*     .
 *
 ****************************************************************************************/
 
-Song *MidiFile::CreateSong()
+Song *MidiFile::CreateSong(
+	__in DWORD iVocalPart,
+	__in DWORD cMaxMeasures,
+	__out_opt bool *pbTruncated)
 {
-	if (m_pVocalPartList == NULL) return NULL;
+	TRACE_ZONE("MidiFile::CreateSong");
+
+	//       m_pVocalPartList  
+	// iVocalPart
+	VOCALPARTINFO *pVocalPart = FindVocalPart(iVocalPart);
 
-	//        m_pVocalPartList
-	VOCALPARTINFO *pVocalPart = m_pVocalPartList;
+	if (pVocalPart == NULL) return NULL;
 
 	//     m_MidiTracks,     
 	DWORD iTrack = pVocalPart->iTrack;
@@ -469,18 +625,24 @@ Song *MidiFile::CreateSong()
 	//  ,     
 	DWORD Instrument = pVocalPart->Instrument;
 
+	// ,        
+	DWORD ctMaxNoteOn = (cMaxMeasures == 0) ? MAXDWORD : GetTicksToMeasure(cMaxMeasures);
+
 	//    MidiSong
 	MidiSong MidiSong;
 
+	// , ,      ctMaxNoteOn
+	bool bTruncated;
+
 	//  
-	if (!CreateSes(iTrack, Channel, Instrument, &MidiSong))
+	if (!CreateSes(iTrack, Channel, Instrument, ctMaxNoteOn, &MidiSong, &bTruncated))
 	{
 		LOG("MidiFile::CreateSes failed\n");
 		return NULL;
 	}
 
 	//   
-	if (!CreateMeasureSequence(&MidiSong))
+	if (!CreateMeasureSequence(&MidiSong, bTruncated ? ctMaxNoteOn : MAXDWORD))
 	{
 		LOG("MidiFile::CreateMeasureSequence failed\n");
 		return NULL;
@@ -508,9 +670,290 @@ Song *MidiFile::CreateSong()
 		return NULL;
 	}
 
+	if (pbTruncated != NULL) *pbTruncated = bTruncated;
+
 	return pSong;
 }
 
+/****************************************************************************************
+*
+*    GetVocalPartCount
+*
+*   
+*       
+*
+*    
+*             m_pVocalPartList.
+*
+*      ,     .
+*
+****************************************************************************************/
+
+DWORD MidiFile::GetVocalPartCount()
+{
+	DWORD cVocalParts = 0;
+
+	for (VOCALPARTINFO *pCurVocalPart = m_pVocalPartList; pCurVocalPart != NULL;
+		pCurVocalPart = pCurVocalPart->pNext)
+	{
+		cVocalParts++;
+	}
+
+	return cVocalParts;
+}
+
+/****************************************************************************************
+*
+*    GetVocalPartInfo
+*
+*   
+*       iVocalPart -       ,  
+*                          
+*       piTrack -   ,      , 
+*                    ;    NULL
+*       pChannel -   ,      
+*                     ANY_CHANNEL;    NULL
+*       pInstrument -   ,     
+*                         ANY_INSTRUMENT;  
+*                      NULL
+*       pPartLyricDistance -   ,     
+*                                   MIDI-;
+*                               NULL
+*
+*    
+*       true,      iVocalPart ;  false.
+*
+*         .   
+*   GetVocalPartCount  CreateSong      .
+*
+****************************************************************************************/
+
+bool MidiFile::GetVocalPartInfo(
+	__in DWORD iVocalPart,
+	__out_opt DWORD *piTrack,
+	__out_opt DWORD *pChannel,
+	__out_opt DWORD *pInstrument,
+	__out_opt double *pPartLyricDistance)
+{
+	VOCALPARTINFO *pVocalPart = FindVocalPart(iVocalPart);
+
+	if (pVocalPart == NULL) return false;
+
+	if (piTrack != NULL) *piTrack = pVocalPart->iTrack;
+	if (pChannel != NULL) *pChannel = pVocalPart->Channel;
+	if (pInstrument != NULL) *pInstrument = pVocalPart->Instrument;
+	if (pPartLyricDistance != NULL) *pPartLyricDistance = pVocalPart->PartLyricDistance;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GetPrunedCandidateCount
+*
+*   
+*       
+*
+*    
+*         - ,  .
+*
+*      - ,     
+*         ,    
+*   MAX_VOCAL_PART_LYRIC_DISTANCE.
+*
+****************************************************************************************/
+
+DWORD MidiFile::GetPrunedCandidateCount()
+{
+	return m_cPrunedCandidates;
+}
+
+/****************************************************************************************
+*
+*    GetEventCount
+*
+*   
+*       
+*
+*    
+*                 ,
+*          .
+*
+*         .
+*
+****************************************************************************************/
+
+DWORD MidiFile::GetEventCount()
+{
+	DWORD cEvents = 0;
+
+	for (DWORD i = 0; i < m_cTracks; i++) cEvents += m_MidiTracks[i].GetEventCount();
+
+	return cEvents;
+}
+
+/****************************************************************************************
+*
+*    GetMemorySize
+*
+*   
+*       
+*
+*    
+*            ,    .
+*
+*     ,    :  
+*    MIDI-,   ,     
+*    .     .
+*
+****************************************************************************************/
+
+DWORD MidiFile::GetMemorySize()
+{
+	if (m_pFile == NULL) return 0;
+
+	DWORD cbMemory = m_cbFile + m_cTracks * sizeof(MidiTrack);
+
+	for (DWORD i = 0; i < m_cTracks; i++) cbMemory += m_MidiTracks[i].GetMemorySize();
+
+	if (m_pLyric != NULL) cbMemory += sizeof(MidiLyric) + m_pLyric->GetMemorySize();
+
+	cbMemory += GetVocalPartCount() * sizeof(VOCALPARTINFO);
+
+	return cbMemory;
+}
+
+/****************************************************************************************
+*
+*    GetStageTime
+*
+*   
+*       Stage -    
+*
+*    
+*             (. 
+*       QueryPerformanceFrequency)  ,      AssignFile
+*          .
+*
+*          
+*   AssignFile.       .
+*
+****************************************************************************************/
+
+LONGLONG MidiFile::GetStageTime(
+	__in MIDIFILESTAGE Stage)
+{
+	return m_StageTimes[Stage];
+}
+
+/****************************************************************************************
+*
+*    SetLoadControl
+*
+*   
+*       pStageProc -   ,      
+*                       ,  NULL
+*       pStageContext - ,    pStageProc
+*       pCancelFlag -      NULL
+*
+*    
+*       
+*
+*    ,      ,   .
+*    pStageProc    ,    AssignFile. 
+*          ;   AssignFile
+*         (  ,  
+*        - )   MIDIFILE_CANCELLED.
+*     ,     .
+*
+****************************************************************************************/
+
+void MidiFile::SetLoadControl(
+	__in_opt MIDIFILESTAGEPROC pStageProc,
+	__in_opt LPVOID pStageContext,
+	__in_opt volatile LONG *pCancelFlag)
+{
+	m_pStageProc = pStageProc;
+	m_pStageContext = pStageContext;
+	m_pCancelFlag = pCancelFlag;
+}
+
+/****************************************************************************************
+*
+*    BeginStage
+*
+*   
+*       Stage -     
+*
+*    
+*       true,    ; false,    .
+*
+*      ,     ,  ,
+*     SetLoadControl.
+*
+****************************************************************************************/
+
+bool MidiFile::BeginStage(
+	__in MIDIFILESTAGE Stage)
+{
+	if (IsCancelled())
+	{
+		LOG("loading cancelled\n");
+		return false;
+	}
+
+	if (m_pStageProc != NULL) m_pStageProc(Stage, m_pStageContext);
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    IsCancelled
+*
+*   
+*       
+*
+*    
+*       true,    ;  false.
+*
+*     ,   SetLoadControl.
+*
+****************************************************************************************/
+
+bool MidiFile::IsCancelled()
+{
+	return m_pCancelFlag != NULL && *m_pCancelFlag != 0;
+}
+
+/****************************************************************************************
+*
+*    EndStage
+*
+*   
+*       Stage -     
+*       pStageStartTime -   ,     
+*                         ;        
+*
+*    
+*       
+*
+*         .
+*
+****************************************************************************************/
+
+void MidiFile::EndStage(
+	__in MIDIFILESTAGE Stage,
+	__inout LARGE_INTEGER *pStageStartTime)
+{
+	LARGE_INTEGER StageEndTime;
+	QueryPerformanceCounter(&StageEndTime);
+
+	m_StageTimes[Stage] = StageEndTime.QuadPart - pStageStartTime->QuadPart;
+
+	*pStageStartTime = StageEndTime;
+}
+
 /****************************************************************************************
 *
 *    Free
@@ -536,22 +979,32 @@ void MidiFile::Free()
 	}
 	m_pVocalPartList = NULL;
 
-	if (m_pLyricTrack != NULL)
+	if (m_pLyric != NULL)
 	{
-		delete m_pLyricTrack;
-		m_pLyricTrack = NULL;
+		delete m_pLyric;
+		m_pLyric = NULL;
 	}
 
 	if (m_MidiTracks != NULL)
 	{
-		delete m_MidiTracks;
+		delete[] m_MidiTracks;
 		m_MidiTracks = NULL;
 	}
 
 	if (m_pFile != NULL)
 	{
-		HeapFree(GetProcessHeap(), 0, m_pFile);
+		if (m_FileBufferType == FILEBUFFER_MAPPED_VIEW)
+		{
+			UnmapViewOfFile(m_pFile);
+		}
+		else
+		{
+			HeapFree(GetProcessHeap(), 0, m_pFile);
+		}
+
 		m_pFile = NULL;
+		m_cbFile = 0;
+		m_FileBufferType = FILEBUFFER_HEAP;
 	}
 }
 
@@ -568,24 +1021,52 @@ void MidiFile::Free()
 *       MIDIFILE_CANT_ALLOC_MEMORY -    .
 *
 *     .        LYRIC, 
-*     TEXT_EVENT.        MidiTrack,
-*                
-*   m_pLyricTrack.  ,   m_LyricEventType   
-*   ,      .
+*     TEXT_EVENT.        m_pLyric
+*       MidiLyric,     
+*     .         ,
+*      ,       .
+*
+*   
+*
+*       ,      
+*   .         MidiLyric 
+*         ,    
+*     .
 *
 ****************************************************************************************/
 
 MIDIFILERESULT MidiFile::FindLyric()
 {
-	if (m_pLyricTrack != NULL)
+	TRACE_ZONE("MidiFile::FindLyric");
+
+	//   ,  
+	if (m_pLyric != NULL)
 	{
-		//     MidiTrack,      
-		delete m_pLyricTrack;
-		m_pLyricTrack = NULL;
+		delete m_pLyric;
+		m_pLyric = NULL;
 	}
 
 	if (m_MidiTracks == NULL) return MIDIFILE_NO_LYRIC;
 
+	//   MidiLyric,       ,
+	//       
+	MidiLyric *pBestLyric = new MidiLyric;
+
+	//   MidiLyric,      
+	//  
+	MidiLyric *pCurLyric = new MidiLyric;
+
+	if (pBestLyric == NULL || pCurLyric == NULL)
+	{
+		LOG("operator new failed\n");
+		if (pBestLyric != NULL) delete pBestLyric;
+		if (pCurLyric != NULL) delete pCurLyric;
+		return MIDIFILE_CANT_ALLOC_MEMORY;
+	}
+
+	//    
+	MIDIFILERESULT Result;
+
 	//   ,     ;
 	//      LYRIC
 	DWORD CurLyricEventType = LYRIC;
@@ -593,84 +1074,67 @@ MIDIFILERESULT MidiFile::FindLyric()
 	//      : LYRIC  TEXT_EVENT
 	while(true)
 	{
-		//     m_MidiTracks,    
-		//        CurLyricEventType
-		DWORD iTrackWithMaxSymbols = 0;
-
-		//       CurLyricEventType  
-		// iTrackWithMaxSymbols,      
+		//       CurLyricEventType 
+		//  pBestLyric,      
 		DWORD cMaxSymbols = 0;
 
-		//     CurLyricEventType  
-		// iTrackWithMaxSymbols
+		//     CurLyricEventType  
+		// pBestLyric
 		DWORD cEventsInTrackWithMaxSymbols = 0;
 
+		// ,  true,     
+		bool bIsOutOfMemory = false;
+
 		//      m_MidiTracks
 		for (DWORD i = 0; i < m_cTracks; i++)
 		{
-			//       CurLyricEventType 
-			//  
-			DWORD cSymbolsInTrack = 0;
-
-			//     CurLyricEventType   
-			DWORD cEventsInTrack = 0;
-
-			//   MidiLyric     
-			// CurLyricEventType   
-			MidiLyric Lyric;
-
-			//      CurLyricEventType
-			//   
-			Lyric.InitSearch(&m_MidiTracks[i], CurLyricEventType, m_DefaultCodePage);
-
-			//       CurLyricEventType  
+			//     CurLyricEventType  
 			// 
-			while (true)
+			if (pCurLyric->Decode(&m_MidiTracks[i], CurLyricEventType,
+				m_DefaultCodePage) != MIDILYRIC_SUCCESS)
 			{
-				//       
-				DWORD cchEventText;
-
-				//      CurLyricEventType
-				MIDILYRICRESULT Res = Lyric.GetNextValidEvent(NULL, NULL, &cchEventText);
-
-				//    CurLyricEventType    ,
-				//   
-				if (Res == MIDILYRIC_LYRIC_END) break;
-
-				cSymbolsInTrack += cchEventText;
-				cEventsInTrack++;
+				LOG("MidiLyric::Decode failed\n");
+				bIsOutOfMemory = true;
+				break;
 			}
 
+			//       CurLyricEventType 
+			//  
+			DWORD cSymbolsInTrack = pCurLyric->GetSymbolCount();
+
 			if (cSymbolsInTrack > cMaxSymbols)
 			{
 				//       CurLyricEventType
 				//        
 
-				iTrackWithMaxSymbols = i;
 				cMaxSymbols = cSymbolsInTrack;
-				cEventsInTrackWithMaxSymbols = cEventsInTrack;
+				cEventsInTrackWithMaxSymbols = pCurLyric->GetEventCount();
+
+				//     ,  
+				//       
+				MidiLyric *pTempLyric = pBestLyric;
+				pBestLyric = pCurLyric;
+				pCurLyric = pTempLyric;
 			}
 		}
 
+		if (bIsOutOfMemory)
+		{
+			Result = MIDIFILE_CANT_ALLOC_MEMORY;
+			break;
+		}
+
 		if (CurLyricEventType == LYRIC)
 		{
 			if (cEventsInTrackWithMaxSymbols > 0)
 			{
-				//   ;
-				//    MidiTrack -  ,
-				//      ;
-				m_pLyricTrack = m_MidiTracks[iTrackWithMaxSymbols].Duplicate();
-
-				if (m_pLyricTrack == NULL)
-				{
-					LOG("MidiTrack::Duplicate failed\n");
-					return MIDIFILE_CANT_ALLOC_MEMORY;
-				}
-
-				//       LYRIC
-				m_LyricEventType = LYRIC;
+				//       LYRIC;  
+				//      
+				m_pLyric = pBestLyric;
+				pBestLyric = NULL;
 
-				return MIDIFILE_SUCCESS;
+				Result = MIDIFILE_SUCCESS;
+				break;
 			}
 
 			//      LYRIC  ,
@@ -681,27 +1145,25 @@ MIDIFILERESULT MidiFile::FindLyric()
 		{
 			if (cEventsInTrackWithMaxSymbols >= MIN_TEXT_EVENTS_FOR_LYRIC_TRACK)
 			{
-				//   ;
-				//    MidiTrack -  ,
-				//      ;
-				m_pLyricTrack = m_MidiTracks[iTrackWithMaxSymbols].Duplicate();
-
-				if (m_pLyricTrack == NULL)
-				{
-					LOG("MidiTrack::Duplicate failed\n");
-					return MIDIFILE_CANT_ALLOC_MEMORY;
-				}
+				//       TEXT_EVENT; 
+				//       
+				m_pLyric = pBestLyric;
+				pBestLyric = NULL;
 
-                //       TEXT_EVENT
-				m_LyricEventType = TEXT_EVENT;
-
-				return MIDIFILE_SUCCESS;
+				Result = MIDIFILE_SUCCESS;
+				break;
 			}
 
 			//    
-			return MIDIFILE_NO_LYRIC;
+			Result = MIDIFILE_NO_LYRIC;
+			break;
 		}
 	}
+
+	if (pBestLyric != NULL) delete pBestLyric;
+	delete pCurLyric;
+
+	return Result;
 }
 
 /****************************************************************************************
@@ -714,23 +1176,44 @@ MIDIFILERESULT MidiFile::FindLyric()
 *    
 *       MIDIFILE_SUCCESS -      ;
 *       MIDIFILE_NO_VOCAL_PARTS -      ;
-*       MIDIFILE_CANT_ALLOC_MEMORY -    .
+*       MIDIFILE_CANT_ALLOC_MEMORY -    ;
+*       MIDIFILE_CANCELLED -   (.  SetLoadControl).
 *
 *     .
 *
 *   
 *
-*         .    
-*   ,          .  
-*    -     -      
-*   .       MAX_VOCAL_PART_LYRIC_DISTANCE,
-*     ,       
-*   m_pVocalPartList.
+*          (. 
+*   g_VocalPartLimitations).     ,    
+*        .    -   
+*    -       .   
+*      MAX_VOCAL_PART_LYRIC_DISTANCE,   ,
+*          m_pVocalPartList.   
+*       ,    ,   
+*    MAX_VOCAL_PART_LYRIC_DISTANCE (    
+*   GetPrunedCandidateCount).         
+*    :        ,   
+*   .
+*
+*    -       ( " -
+*   ",    PROGRAM_CHANGE),    ,   
+*       .      ,  
+*   GetPartLyricDistance       ,  ,  
+*     .         ,
+*    (.  ScoreCandidates):    ,  
+*    ,         
+*     .     ,    , 
+*     m_pVocalPartList    ,     
+*     ( ,   ,   ),
+*             
+*    .
 *
 ****************************************************************************************/
 
 MIDIFILERESULT MidiFile::FindVocalParts()
 {
+	TRACE_ZONE("MidiFile::FindVocalParts");
+
 	//    
 	VOCALPARTINFO *pCurVocalPart = m_pVocalPartList;
 	while (pCurVocalPart != NULL)
@@ -741,183 +1224,612 @@ MIDIFILERESULT MidiFile::FindVocalParts()
 	}
 	m_pVocalPartList = NULL;
 
-	// ,        
-	//  :
-	// 1)         
-	//             ;
-	// 2)      ,   
-	//     
-	VOCAL_PART_LIMITATIONS Limitations[] =
-	{
-		{ 0.0, IDENTICAL_START | IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
-		{ 0.5, IDENTICAL_START | IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
-		{ 0.5, IDENTICAL_START | LIMIT_NOTES_PER_METAEVENT },
-		{ 0.5, IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
-		{ 0.5, LIMIT_NOTES_PER_METAEVENT },
-		{ 0.5, 0 },
-	};
+	m_cPrunedCandidates = 0;
 
-	const DWORD cStages = sizeof(Limitations) / sizeof(Limitations[0]);
+	//   - ,   
+	CANDIDATEINFO *pCandidates;
 
-	//      
-	for (DWORD iStage = 0; iStage < cStages; iStage++)
-	{
-		//      m_MidiTracks
-		for (DWORD iCurTrack = 0; iCurTrack < m_cTracks; iCurTrack++)
-		{
-			// ,     ,    ;
-			//       [i][j]  true,   
-			//  ,    i  j
-			bool DoesPartExist[MAX_MIDI_CHANNELS][MAX_MIDI_INSTRUMENTS];
+	//     pCandidates
+	DWORD cCandidates;
 
-			//    DoesPartExist  false
-			for (DWORD i = 0; i < MAX_MIDI_CHANNELS; i++)
-				for (DWORD j = 0; j < MAX_MIDI_INSTRUMENTS; j++)
-					DoesPartExist[i][j] = false;
+	//    - 
+	MIDIFILERESULT Result = FindCandidates(&pCandidates, &cCandidates);
 
-			//     ;
-			//       DoesPartExist   true
-			DWORD cPartsInTrack = 0;
+	if (Result != MIDIFILE_SUCCESS)
+	{
+		LOG("MidiFile::FindCandidates failed\n");
+		return Result;
+	}
 
-			//      
-			m_MidiTracks[iCurTrack].ResetCurrentPosition();
+	//          ,    
+	if (cCandidates == 0) return MIDIFILE_NO_VOCAL_PARTS;
 
-			//      ,     
-			while (true)
+	//           
+	ScoreCandidates(pCandidates, cCandidates);
+
+	//   ,        
+	if (IsCancelled())
+	{
+		HeapFree(GetProcessHeap(), 0, pCandidates);
+		return MIDIFILE_CANCELLED;
+	}
+
+	//  ,    (    )
+	CANDIDATEINFO *pTrackCandidates = (CANDIDATEINFO *) HeapAlloc(GetProcessHeap(), 0,
+		m_cTracks * sizeof(CANDIDATEINFO));
+
+	if (pTrackCandidates == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		HeapFree(GetProcessHeap(), 0, pCandidates);
+		return MIDIFILE_CANT_ALLOC_MEMORY;
+	}
+
+	//  ,   
+	DWORD cTrackCandidates = 0;
+
+	// ,  true,   -     
+	bool bIsOutOfMemory = false;
+
+	//   ,    :      2
+	//  ,      
+	for (DWORD iCandidate = 0; iCandidate < cCandidates; )
+	{
+		DWORD iCurTrack = pCandidates[iCandidate].iTrack;
+
+		//     
+		DWORD cPartsInTrack = 0;
+
+		//    (.. ,   )   
+		DWORD cEmptyParts = 0;
+
+		for (; iCandidate < cCandidates &&
+			pCandidates[iCandidate].iTrack == iCurTrack; iCandidate++)
+		{
+			cPartsInTrack++;
+
+			DISTANCERESULT DistanceRes = pCandidates[iCandidate].DistanceRes;
+
+			if (DistanceRes == DISTANCE_NO_NOTES)
+			{
+				cEmptyParts++;
+			}
+			else if (DistanceRes == DISTANCE_CANT_ALLOC_MEMORY)
 			{
-				//      
-				PBYTE pEventData;
+				bIsOutOfMemory = true;
+			}
+		}
+
+		if (cPartsInTrack - cEmptyParts > 1)
+		{
+			CANDIDATEINFO *pTrackCandidate = &pTrackCandidates[cTrackCandidates++];
+
+			pTrackCandidate->iTrack = iCurTrack;
+			pTrackCandidate->Channel = ANY_CHANNEL;
+			pTrackCandidate->Instrument = ANY_INSTRUMENT;
+		}
+	}
 
-				//   
-				DWORD EventChannel;
+	if (bIsOutOfMemory)
+	{
+		LOG("MidiFile::GetPartLyricDistance failed\n");
+		HeapFree(GetProcessHeap(), 0, pTrackCandidates);
+		HeapFree(GetProcessHeap(), 0, pCandidates);
+		return MIDIFILE_CANT_ALLOC_MEMORY;
+	}
 
-				//    
-				DWORD EventType = m_MidiTracks[iCurTrack].GetNextEvent(NULL,
-					&pEventData, &EventChannel);
+	//      
+	ScoreCandidates(pTrackCandidates, cTrackCandidates);
 
-				//       ,   
-				if (EventType == REAL_TRACK_END) break;
+	if (IsCancelled())
+	{
+		HeapFree(GetProcessHeap(), 0, pTrackCandidates);
+		HeapFree(GetProcessHeap(), 0, pCandidates);
+		return MIDIFILE_CANCELLED;
+	}
+
+	Result = MIDIFILE_NO_VOCAL_PARTS;
+
+	//      
+	for (DWORD iStage = 0; iStage < g_cVocalPartStages; iStage++)
+	{
+		TRACE_ZONE_ARG("MidiFile::FindVocalParts stage", iStage);
+
+		//   ,   
+		DWORD iTrackCandidate = 0;
+
+		//           
+		// m_pVocalPartList; ,   , 
+		//     
+		for (DWORD iCandidate = 0; iCandidate < cCandidates; iCandidate++)
+		{
+			if (!AddScoredCandidate(&pCandidates[iCandidate], iStage))
+			{
+				bIsOutOfMemory = true;
+				break;
+			}
 
-				//   ,   PROGRAM_CHANGE
-				if (EventType != PROGRAM_CHANGE) continue;
+			DWORD iCurTrack = pCandidates[iCandidate].iTrack;
 
-				//   
-				DWORD EventInstrument = *pEventData;
+			//      ,     
+			if (iCandidate + 1 < cCandidates &&
+				pCandidates[iCandidate + 1].iTrack == iCurTrack)
+			{
+				continue;
+			}
 
-				if (!DoesPartExist[EventChannel][EventInstrument])
+			if (iTrackCandidate < cTrackCandidates &&
+				pTrackCandidates[iTrackCandidate].iTrack == iCurTrack)
+			{
+				if (!AddScoredCandidate(&pTrackCandidates[iTrackCandidate++], iStage))
 				{
-					//      ,   
-					// EventChannel  EventInstrument
-					DoesPartExist[EventChannel][EventInstrument] = true;
-					cPartsInTrack++;
+					bIsOutOfMemory = true;
+					break;
 				}
 			}
+		}
+
+		if (bIsOutOfMemory)
+		{
+			Result = MIDIFILE_CANT_ALLOC_MEMORY;
+			break;
+		}
+
+		if (m_pVocalPartList != NULL)
+		{
+			//      ,   
+			Result = MIDIFILE_SUCCESS;
+			break;
+		}
+	}
+
+	HeapFree(GetProcessHeap(), 0, pTrackCandidates);
+	HeapFree(GetProcessHeap(), 0, pCandidates);
+
+	return Result;
+}
+
+/****************************************************************************************
+*
+*    FindCandidates
+*
+*   
+*       ppCandidates -   ,      
+*                        - ;   
+*                      HeapAlloc,      ;  
+*                      ,     NULL
+*       pcCandidates -   ,     
+*                          - 
+*
+*    
+*       MIDIFILE_SUCCESS -   ;
+*       MIDIFILE_CANT_ALLOC_MEMORY -    .
+*
+*      -    .  
+*    " - ",       PROGRAM_CHANGE. 
+*      ,   -   ,    
+*   . ,   ,    .
+*
+****************************************************************************************/
 
-			//      ,     
-			if (cPartsInTrack == 0) continue;
+MIDIFILERESULT MidiFile::FindCandidates(
+	__out CANDIDATEINFO **ppCandidates,
+	__out DWORD *pcCandidates)
+{
+	TRACE_ZONE("MidiFile::FindCandidates");
+
+	CANDIDATEINFO *pCandidates = NULL;
+	DWORD cCandidates = 0;
+
+	//  ,       pCandidates
+	DWORD cMaxCandidates = 0;
+
+	//      m_MidiTracks
+	for (DWORD iCurTrack = 0; iCurTrack < m_cTracks; iCurTrack++)
+	{
+		// ,     ,    ;
+		//       [i][j]  true,   
+		//  ,    i  j
+		bool DoesPartExist[MAX_MIDI_CHANNELS][MAX_MIDI_INSTRUMENTS];
+
+		//    DoesPartExist  false
+		for (DWORD i = 0; i < MAX_MIDI_CHANNELS; i++)
+			for (DWORD j = 0; j < MAX_MIDI_INSTRUMENTS; j++)
+				DoesPartExist[i][j] = false;
+
+		//     
+		DWORD cEvents = m_MidiTracks[iCurTrack].GetEventCount();
+
+		//      ,     
+		for (DWORD iEvent = 0; iEvent < cEvents; iEvent++)
+		{
+			//      
+			PBYTE pEventData;
 
-            //    (.. ,   )  
-            //   DoesPartExist
-			DWORD cEmptyParts = 0;
+			//   
+			DWORD EventChannel;
 
-            //      DoesPartExist:   
+			//    
+			DWORD EventType = m_MidiTracks[iCurTrack].GetEvent(iEvent, NULL,
+				&pEventData, &EventChannel);
 
-			for (DWORD CurChannel = 0; CurChannel < MAX_MIDI_CHANNELS; CurChannel++)
+			//   ,   PROGRAM_CHANGE
+			if (EventType != PROGRAM_CHANGE) continue;
+
+			//      ,   
+			// EventChannel  EventInstrument
+			DWORD EventInstrument = *pEventData;
+
+			DoesPartExist[EventChannel][EventInstrument] = true;
+		}
+
+		//      
+		for (DWORD CurChannel = 0; CurChannel < MAX_MIDI_CHANNELS; CurChannel++)
+		{
+			for (DWORD CurInstr = 0; CurInstr < MAX_MIDI_INSTRUMENTS; CurInstr++)
 			{
-				for (DWORD CurInstr = 0; CurInstr < MAX_MIDI_INSTRUMENTS; CurInstr++)
-				{
-					//      ,    CurChannel
-                    //  CurInstr,      
-					if (!DoesPartExist[CurChannel][CurInstr]) continue;
+				if (!DoesPartExist[CurChannel][CurInstr]) continue;
 
-					// ,    GetPartLyricDistance  
-					//         MIDI-
-					double PartLyricDistance;
+				//  ,       
+				if (cCandidates == cMaxCandidates)
+				{
+					DWORD cNewMaxCandidates = (cMaxCandidates == 0) ?
+						INITIAL_CANDIDATE_ARRAY_SIZE : cMaxCandidates * 2;
 
-					//        
-					DISTANCERESULT DistanceRes = GetPartLyricDistance(iCurTrack,
-						CurChannel, CurInstr, Limitations[iStage].OverlapsThreshold,
-						Limitations[iStage].fCriteria, &PartLyricDistance);
+					CANDIDATEINFO *pNewCandidates;
 
-					if (DistanceRes == DISTANCE_CANT_ALLOC_MEMORY)
+					if (pCandidates == NULL)
 					{
-						LOG("MidiFile::GetPartLyricDistance failed\n");
-						return MIDIFILE_CANT_ALLOC_MEMORY;
+						pNewCandidates = (CANDIDATEINFO *) HeapAlloc(GetProcessHeap(), 0,
+							cNewMaxCandidates * sizeof(CANDIDATEINFO));
 					}
-					else if (DistanceRes == DISTANCE_NO_NOTES)
+					else
 					{
-						cEmptyParts++;
+						pNewCandidates = (CANDIDATEINFO *) HeapReAlloc(GetProcessHeap(),
+							0, pCandidates, cNewMaxCandidates * sizeof(CANDIDATEINFO));
 					}
-					else if (DistanceRes == DISTANCE_SUCCESS)
+
+					if (pNewCandidates == NULL)
 					{
-						//         
-						//    MAX_VOCAL_PART_LYRIC_DISTANCE,  
-						//      m_pVocalPartList
-						if (PartLyricDistance <= MAX_VOCAL_PART_LYRIC_DISTANCE)
+						LOG("HeapAlloc failed\n");
+
+						if (pCandidates != NULL)
 						{
-							bool bIsPartAdded = AddVocalPart(iCurTrack, CurChannel,
-								CurInstr, PartLyricDistance);
-
-							if (!bIsPartAdded)
-							{
-								LOG("MidiFile::AddVocalPart failed\n");
-								return MIDIFILE_CANT_ALLOC_MEMORY;
-							}
+							HeapFree(GetProcessHeap(), 0, pCandidates);
 						}
+
+						return MIDIFILE_CANT_ALLOC_MEMORY;
 					}
+
+					pCandidates = pNewCandidates;
+					cMaxCandidates = cNewMaxCandidates;
 				}
+
+				pCandidates[cCandidates].iTrack = iCurTrack;
+				pCandidates[cCandidates].Channel = CurChannel;
+				pCandidates[cCandidates].Instrument = CurInstr;
+				cCandidates++;
 			}
+		}
+	}
 
-			//       2  ,
-			//  ,       
-			if (cPartsInTrack - cEmptyParts > 1)
-			{
-				// ,    GetPartLyricDistance  
-				//  ,   ,   
-				//   MIDI-
-				double PartLyricDistance;
-
-				//    ,   ,
-				//   
-				DISTANCERESULT DistanceRes = GetPartLyricDistance(iCurTrack,
-					ANY_CHANNEL, ANY_INSTRUMENT, Limitations[iStage].OverlapsThreshold,
-					Limitations[iStage].fCriteria, &PartLyricDistance);
-
-				if (DistanceRes == DISTANCE_CANT_ALLOC_MEMORY)
-				{
-					LOG("MidiFile::GetPartLyricDistance failed\n");
-					return MIDIFILE_CANT_ALLOC_MEMORY;
-				}
-				else if (DistanceRes == DISTANCE_SUCCESS)
-				{
-					//      , 
-					//  ,     
-					// MAX_VOCAL_PART_LYRIC_DISTANCE,     
-					//   m_pVocalPartList
-					if (PartLyricDistance <= MAX_VOCAL_PART_LYRIC_DISTANCE)
-					{
-						bool bIsPartAdded = AddVocalPart(iCurTrack, ANY_CHANNEL,
-							ANY_INSTRUMENT, PartLyricDistance);
+	*ppCandidates = pCandidates;
+	*pcCandidates = cCandidates;
 
-						if (!bIsPartAdded)
-						{
-							LOG("MidiFile::AddVocalPart failed\n");
-							return MIDIFILE_CANT_ALLOC_MEMORY;
-						}
-					}
-				}
+	return MIDIFILE_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    ScoreCandidates
+*
+*   
+*       pCandidates -     - 
+*       cCandidates -     pCandidates
+*
+*    
+*       
+*
+*          pCandidates    
+*   DistanceRes, fPassedStages  PartLyricDistance    
+*   GetPartLyricDistance. ,    , 
+*     m_cPrunedCandidates.    ,  
+*     ,      .
+*
+*   
+*
+*       ,      
+*   (  g_cMaxScoringThreads     ).  
+*     ,     (.  StartScoringPool),  
+*             .
+*        ,     
+*         ,    
+*    .        ,  
+*     ,   GetPartLyricDistance     ,
+*       .
+*
+****************************************************************************************/
+
+void MidiFile::ScoreCandidates(
+	__inout CANDIDATEINFO *pCandidates,
+	__in DWORD cCandidates)
+{
+	if (cCandidates == 0) return;
+
+	TRACE_ZONE("MidiFile::ScoreCandidates");
+	TRACE_COUNTER("MidiFile::ScoreCandidates candidates", cCandidates);
+
+	SCORINGJOB Job;
+
+	Job.pMidiFile = this;
+	Job.pCandidates = pCandidates;
+	Job.cCandidates = cCandidates;
+	Job.iNextCandidate = 0;
+	Job.ctMaxPartLyricDistance =
+		MAX_VOCAL_PART_LYRIC_DISTANCE * m_cTicksPerMidiQuarterNote;
+
+	//   ,   
+	DWORD cMaxThreads = g_cMaxScoringThreads;
+
+	if (cMaxThreads == 0)
+	{
+		SYSTEM_INFO SystemInfo;
+		GetSystemInfo(&SystemInfo);
+		cMaxThreads = SystemInfo.dwNumberOfProcessors;
+	}
+
+	if (cMaxThreads > MAXIMUM_WAIT_OBJECTS) cMaxThreads = MAXIMUM_WAIT_OBJECTS;
+
+	DWORD cThreads = (cMaxThreads > cCandidates) ? cCandidates : cMaxThreads;
+
+	//   ,      
+	DWORD cPoolThreads = 0;
+
+	// ,  true,     
+	bool bIsPoolEntered = false;
+
+	if (cThreads > 1 && StartScoringPool(cMaxThreads - 1) &&
+		TryEnterCriticalSection(&g_csScoringPool))
+	{
+		bIsPoolEntered = true;
+
+		cPoolThreads = cThreads - 1;
+		if (cPoolThreads > g_cScoringPoolThreads) cPoolThreads = g_cScoringPoolThreads;
+
+		Job.cPendingThreads = cPoolThreads;
+		g_pScoringJob = &Job;
+
+		ReleaseSemaphore(g_hScoringStartSemaphore, cPoolThreads, NULL);
+	}
+
+	ScoreJobCandidates(&Job);
+
+	if (bIsPoolEntered)
+	{
+		//   ,     
+		WaitForSingleObject(g_hScoringDoneEvent, INFINITE);
+
+		g_pScoringJob = NULL;
+
+		LeaveCriticalSection(&g_csScoringPool);
+	}
+
+	if (IsCancelled()) return;
+
+	for (DWORD iCandidate = 0; iCandidate < cCandidates; iCandidate++)
+	{
+		if (pCandidates[iCandidate].DistanceRes == DISTANCE_CUTOFF_EXCEEDED)
+		{
+			m_cPrunedCandidates++;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    StartScoringPool
+*
+*   
+*       cThreads -    
+*
+*    
+*       true,    (  );  false.
+*
+*        ,   .   
+*    ,      ,  
+*   SetMaxScoringThreads     .    
+*    ,    .     ,
+*       .
+*
+*   
+*
+*       Windows 2000,    InitOnceExecuteOnce,
+*       ,   
+*   g_ScoringPoolState   SCORING_POOL_NOT_STARTED  SCORING_POOL_STARTING,
+*        g_hScoringPoolReadyEvent.   
+*   ,   ,       ;
+*     .     ,    
+*     ,      .
+*
+****************************************************************************************/
+
+bool MidiFile::StartScoringPool(
+	__in DWORD cThreads)
+{
+	LONG State = g_ScoringPoolState;
+
+	if (State == SCORING_POOL_STARTED || State == SCORING_POOL_FAILED)
+	{
+		return State == SCORING_POOL_STARTED;
+	}
+
+	if (g_hScoringPoolReadyEvent == NULL)
+	{
+		HANDLE hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		if (hEvent == NULL)
+		{
+			LOG("CreateEvent failed (error %u)\n", GetLastError());
+			return false;
+		}
+
+		PVOID pOldEvent = InterlockedCompareExchangePointer(
+			(PVOID volatile *) &g_hScoringPoolReadyEvent, hEvent, NULL);
+
+		if (pOldEvent != NULL)
+		{
+			CloseHandle(hEvent);
+		}
+	}
+
+	State = InterlockedCompareExchange(&g_ScoringPoolState, SCORING_POOL_STARTING,
+		SCORING_POOL_NOT_STARTED);
+
+	if (State != SCORING_POOL_NOT_STARTED)
+	{
+		if (State == SCORING_POOL_STARTING)
+		{
+			WaitForSingleObject(g_hScoringPoolReadyEvent, INFINITE);
+		}
+
+		return g_ScoringPoolState == SCORING_POOL_STARTED;
+	}
+
+	InitializeCriticalSection(&g_csScoringPool);
+
+	g_hScoringStartSemaphore = CreateSemaphore(NULL, 0, cThreads, NULL);
+	g_hScoringDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	if (g_hScoringStartSemaphore == NULL || g_hScoringDoneEvent == NULL)
+	{
+		LOG("CreateSemaphore or CreateEvent failed (error %u)\n", GetLastError());
+	}
+	else
+	{
+		for (DWORD i = 0; i < cThreads; i++)
+		{
+			HANDLE hThread = CreateThread(NULL, 0, ScoringThreadProc, NULL, 0, NULL);
+
+			if (hThread == NULL)
+			{
+				LOG("CreateThread failed (error %u)\n", GetLastError());
+				break;
 			}
+
+			//    ,     
+			CloseHandle(hThread);
+
+			g_cScoringPoolThreads++;
 		}
+	}
 
-		if (m_pVocalPartList != NULL)
+	InterlockedExchange(&g_ScoringPoolState, (g_cScoringPoolThreads != 0) ?
+		SCORING_POOL_STARTED : SCORING_POOL_FAILED);
+
+	SetEvent(g_hScoringPoolReadyEvent);
+
+	return g_cScoringPoolThreads != 0;
+}
+
+/****************************************************************************************
+*
+*    ScoringThreadProc
+*
+*   
+*       lpParameter -  
+*
+*    
+*       .
+*
+*      ,   .  
+*    g_hScoringStartSemaphore,       
+*   g_pScoringJob   . ,   , 
+*    g_hScoringDoneEvent.      .
+*
+****************************************************************************************/
+
+DWORD WINAPI MidiFile::ScoringThreadProc(
+	__in LPVOID lpParameter)
+{
+	for (;;)
+	{
+		WaitForSingleObject(g_hScoringStartSemaphore, INFINITE);
+
+		SCORINGJOB *pJob = (SCORINGJOB *) g_pScoringJob;
+
+		pJob->pMidiFile->ScoreJobCandidates(pJob);
+
+		if (InterlockedDecrement(&pJob->cPendingThreads) == 0)
 		{
-			//      ,   
-			return MIDIFILE_SUCCESS;
+			SetEvent(g_hScoringDoneEvent);
 		}
 	}
+}
+
+/****************************************************************************************
+*
+*    ScoreJobCandidates
+*
+*   
+*       pJob -   ,  
+*
+*    
+*       
+*
+*              
+*     ,          
+*   .
+*
+****************************************************************************************/
+
+void MidiFile::ScoreJobCandidates(
+	__inout SCORINGJOB *pJob)
+{
+	//   MidiPart      ; 
+	//   ,    
+	MidiPart Part;
+
+	while (!IsCancelled())
+	{
+		DWORD iCandidate = (DWORD) InterlockedIncrement(&pJob->iNextCandidate) - 1;
+
+		if (iCandidate >= pJob->cCandidates) break;
+
+		CANDIDATEINFO *pCandidate = &pJob->pCandidates[iCandidate];
+
+		pCandidate->DistanceRes = GetPartLyricDistance(&Part, pCandidate->iTrack,
+			pCandidate->Channel, pCandidate->Instrument, pJob->ctMaxPartLyricDistance,
+			&pCandidate->fPassedStages, &pCandidate->PartLyricDistance);
+	}
+}
+
+/****************************************************************************************
+*
+*    SetMaxScoringThreads
+*
+*   
+*       cMaxThreads -    (  ),
+*                             
+*                      ;   "    
+*                     "
+*
+*    
+*       
+*
+*          . 
+*        MidiFile. ,   
+*     ,   ,   
+*    ,   .      :
+*              
+*   ,         ,
+*      .
+*
+****************************************************************************************/
 
-	//      
-	return MIDIFILE_NO_VOCAL_PARTS;
+void MidiFile::SetMaxScoringThreads(
+	__in DWORD cMaxThreads)
+{
+	g_cMaxScoringThreads = cMaxThreads;
 }
 
 /****************************************************************************************
@@ -925,37 +1837,40 @@ MIDIFILERESULT MidiFile::FindVocalParts()
 *    GetPartLyricDistance
 *
 *   
+*       pPart -     MidiPart,     
+*                ;         , 
+*                ,       
 *       iTrack -     m_MidiTracks,    
 *       Channel -  ,    ;    
 *                  ANY_CHANNEL,         
 *       Instrument -  ,    ;   
 *                      ANY_INSTRUMENT,     , 
 *                     
-*       OverlapsThreshold -       
-*                                  
-*       fCriteria -  ,  ,   :
-*                   IDENTICAL_START -  ;
-*                   IDENTICAL_END -  ;
-*                   LIMIT_NOTES_PER_METAEVENT -     
-*                                               
+*       ctMaxPartLyricDistance -    :    
+*                                 ,    
+*       pfPassedStages -   ,      
+*                           ,     
+*                        (  iStage  1 << iStage)
 *       pPartLyricDistance -   ,     
 *                                   MIDI-
 *
 *    
-*       DISTANCE_SUCCESS -    ;
-*       DISTANCE_NOT_VOCAL_PART -    ;
+*       DISTANCE_SUCCESS -    ,      
+*                            ;
+*       DISTANCE_NOT_VOCAL_PART -        ;
 *       DISTANCE_NO_NOTES -      ;
-*		DISTANCE_CANT_ALLOC_MEMORY -    .
+*		DISTANCE_CANT_ALLOC_MEMORY -    ;
+*       DISTANCE_CUTOFF_EXCEEDED -     ctMaxPartLyricDistance.
 *
 *      ,   iTrack, Channel  Instrument, 
-*    ,    m_pLyricTrack  m_LyricEventType, 
-*    MIDI-.
-*
-*         ,    
-*      .        
-*   ,     DISTANCE_NOT_VOCAL_PART. 
-*   ,   :
-*   1)         OverlapsThreshold;
+*    ,    m_pLyric, 
+*    MIDI-,  ,      
+*   (.  g_VocalPartLimitations)   .
+*
+*            ,  
+*         .  ,
+*     :
+*   1)         OverlapsThreshold ;
 *   2)        ,  
 *       ,    MAX_SYMBOLS_PER_NOTE;    
 *          :     IDENTICAL_END, 
@@ -970,32 +1885,77 @@ MIDIFILERESULT MidiFile::FindVocalParts()
 *                 
 *           .
 *
+*        ,     
+*     .      ctMaxPartLyricDistance, 
+*       ,    DISTANCE_CUTOFF_EXCEEDED, 
+*       .
+*
+*   
+*
+*               
+*   :    ,     . 
+*         .   fAliveStages 
+*    ,       ;   ,
+*      ,    ,     ,
+*    .        OverlapsThreshold,
+*         GetNextPartNote.   
+*     ,       
+*     IDENTICAL_END  LIMIT_NOTES_PER_METAEVENT.
+*
 ****************************************************************************************/
 
 MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
+	__inout MidiPart *pPart,
 	__in DWORD iTrack,
 	__in DWORD Channel,
 	__in DWORD Instrument,
-	__in double OverlapsThreshold,
-	__in DWORD fCriteria,
+	__in DWORD ctMaxPartLyricDistance,
+	__out DWORD *pfPassedStages,
 	__out double *pPartLyricDistance)
 {
+	TRACE_ZONE("MidiFile::GetPartLyricDistance");
+
 	//        
 	DWORD PartLyricDistance = 0;
 
-	//   MidiLyric      m_LyricEventType
-	//     
-	MidiLyric Lyric;
+	//    ,     IDENTICAL_START,
+	// IDENTICAL_END  LIMIT_NOTES_PER_METAEVENT 
+	DWORD fStartStages = 0;
+	DWORD fEndStages = 0;
+	DWORD fLimitStages = 0;
 
-	//      m_LyricEventType
-	//     
-	Lyric.InitSearch(m_pLyricTrack, m_LyricEventType, m_DefaultCodePage);
+	//    OverlapsThreshold  
+	double MaxOverlapsThreshold = 0;
 
-	// ,    GetNextValidEvent    ,
+	for (DWORD iStage = 0; iStage < g_cVocalPartStages; iStage++)
+	{
+		DWORD fCriteria = g_VocalPartLimitations[iStage].fCriteria;
+
+		if (fCriteria & IDENTICAL_START) fStartStages |= 1 << iStage;
+		if (fCriteria & IDENTICAL_END) fEndStages |= 1 << iStage;
+		if (fCriteria & LIMIT_NOTES_PER_METAEVENT) fLimitStages |= 1 << iStage;
+
+		if (g_VocalPartLimitations[iStage].OverlapsThreshold > MaxOverlapsThreshold)
+		{
+			MaxOverlapsThreshold = g_VocalPartLimitations[iStage].OverlapsThreshold;
+		}
+	}
+
+	//   ,    ,    
+	//     MAX_NOTES_PER_METAEVENT
+	DWORD fTailStages = fEndStages | fLimitStages;
+
+	//   ,       
+	DWORD fAliveStages = (1 << g_cVocalPartStages) - 1;
+
+	//         m_pLyric
+	DWORD iLyricEvent = 0;
+
+	// ,    GetEvent    ,
 	//          
 	DWORD ctToLyricEvent;
 
-	// ,    GetNextValidEvent    
+	// ,    GetEvent    
 	//     
 	DWORD cchEventText;
 
@@ -1003,11 +1963,8 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 	//    ,    PrevNoteDesc
 	DWORD cchPerNote = 0;
 
-	//   MidiPart      
-	MidiPart Part;
-
 	//      
-	Part.InitSearch(&m_MidiTracks[iTrack], Channel, Instrument, OverlapsThreshold,
+	pPart->InitSearch(&m_MidiTracks[iTrack], Channel, Instrument, MaxOverlapsThreshold,
 		m_ConcordNoteChoice);
 
 	// ,  ,   
@@ -1017,16 +1974,16 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 	NOTEDESC CurNoteDesc;
 
 	//   ,   , .. LyricRes == MIDILYRIC_SUCCESS
-	MIDILYRICRESULT LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, NULL,
-		&cchEventText);
+	MIDILYRICRESULT LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+		NULL, &cchEventText);
 
 	//   
-	MIDIPARTRESULT PartRes = Part.GetNextNote(&CurNoteDesc);
+	MIDIPARTRESULT PartRes = GetNextPartNote(pPart, &CurNoteDesc, &fAliveStages);
 
-	//   GetNextNote
+	//   GetNextPartNote
 	if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
 	{
-		LOG("MidiPart::GetNextNote failed\n");
+		LOG("MidiFile::GetNextPartNote failed\n");
 		return DISTANCE_CANT_ALLOC_MEMORY;
 	}
 	else if (PartRes == MIDIPART_PART_END)
@@ -1035,7 +1992,7 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 	}
 	else if (PartRes != MIDIPART_SUCCESS)
 	{
-		//    MIDIPART_COMPLICATED_NOTE_COMBINATION
+		//    MIDIPART_COMPLICATED_NOTE_COMBINATION
 		//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
 		return DISTANCE_NOT_VOCAL_PART;
 	}
@@ -1048,12 +2005,17 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 		//        ,
 		//        
 		PartLyricDistance = Distance(ctToLyricEvent, CurNoteDesc.ctToNoteOn);
+		if (PartLyricDistance > ctMaxPartLyricDistance)
+		{
+			return DISTANCE_CUTOFF_EXCEEDED;
+		}
 
 		//      
 		cchPerNote = cchEventText;
 
 		//   
-		LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, NULL, &cchEventText);
+		LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+			NULL, &cchEventText);
 
 		if (LyricRes == MIDILYRIC_LYRIC_END)
 		{
@@ -1062,81 +2024,55 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 			//        ,
 			//  
 			if (cchPerNote > MAX_SYMBOLS_PER_NOTE) return DISTANCE_NOT_VOCAL_PART;
-
-			if (fCriteria & LIMIT_NOTES_PER_METAEVENT || fCriteria & IDENTICAL_END)
-			{
-				//  ,      
-				//   MAX_NOTES_PER_METAEVENT
-
-				DWORD cNotesPerMetaEvent = 1;
-
-				//   
-				while (true)
-				{
-					//   
-					PartRes = Part.GetNextNote(&CurNoteDesc);
-
-					//   GetNextNote
-					if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
-					{
-						LOG("MidiPart::GetNextNote failed\n");
-						return DISTANCE_CANT_ALLOC_MEMORY;
-					}
-					else if (PartRes == MIDIPART_PART_END)
-					{
-						break;
-					}
-					else if (PartRes != MIDIPART_SUCCESS)
-					{
-						//    MIDIPART_COMPLICATED_NOTE_COMBINATION
-						//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
-						return DISTANCE_NOT_VOCAL_PART;
-					}
-
-					cNotesPerMetaEvent++;
-
-					if (cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
-					{
-						//       ,
-						//  
-						return DISTANCE_NOT_VOCAL_PART;
-					}
-				}
+
+			//     LIMIT_NOTES_PER_METAEVENT  IDENTICAL_END
+			//  ,      
+			//   MAX_NOTES_PER_METAEVENT
+			if (!CheckLastMetaEventNotes(pPart, 1, fTailStages, &fAliveStages))
+			{
+				LOG("MidiFile::CheckLastMetaEventNotes failed\n");
+				return DISTANCE_CANT_ALLOC_MEMORY;
 			}
 
+			if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
+
 			//          MIDI-
+			*pfPassedStages = fAliveStages;
 			*pPartLyricDistance = (double) PartLyricDistance / m_cTicksPerMidiQuarterNote;
 			return DISTANCE_SUCCESS;
 		}
 
-		if (fCriteria & IDENTICAL_START)
+		//     IDENTICAL_START  ,  
+		//            
+		//     
+		if (PartLyricDistance > Distance(ctToLyricEvent, CurNoteDesc.ctToNoteOn))
 		{
-			//  ,        
-			//          
-			// 
-			if (PartLyricDistance > Distance(ctToLyricEvent, CurNoteDesc.ctToNoteOn))
-			{
-				//  IDENTICAL_START ,  
-				return DISTANCE_NOT_VOCAL_PART;
-			}
+			//  IDENTICAL_START 
+			fAliveStages &= ~fStartStages;
+
+			if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
 		}
 
 		//    
 		PrevNoteDesc = CurNoteDesc;
 
 		//   
-		PartRes = Part.GetNextNote(&CurNoteDesc);
+		PartRes = GetNextPartNote(pPart, &CurNoteDesc, &fAliveStages);
 
-		//   GetNextNote
+		//   GetNextPartNote
 		if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
 		{
-			LOG("MidiPart::GetNextNote failed\n");
+			LOG("MidiFile::GetNextPartNote failed\n");
 			return DISTANCE_CANT_ALLOC_MEMORY;
 		}
 		else if (PartRes == MIDIPART_PART_END)
 		{
 			//     
 
+			//     ,    :
+			//   ,      ( 
+			//   IDENTICAL_END),     (  )
+			DWORD cchAllPerFirstNote = cchPerNote;
 			DWORD cchPerFirstNote = cchPerNote;
 
 			//    
@@ -1145,46 +2081,50 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 			//   
 			while (true)
 			{
-				if (fCriteria & IDENTICAL_END)
+				cchAllPerFirstNote += cchEventText;
+
+				if (ctToLyricEvent <= ctToNoteOff)
 				{
-					//    IDENTICAL_END,
-					//    
 					cchPerFirstNote += cchEventText;
 				}
-				else
+
+				//        ,
+				//   
+				if (cchAllPerFirstNote > MAX_SYMBOLS_PER_NOTE)
 				{
-					//     IDENTICAL_END,  ,
-					//      , 
-					if (ctToLyricEvent <= ctToNoteOff)
-					{
-						cchPerFirstNote += cchEventText;
-					}
+					fAliveStages &= ~fEndStages;
 				}
 
 				if (cchPerFirstNote > MAX_SYMBOLS_PER_NOTE)
 				{
-					//       ,
-					//  
-					return DISTANCE_NOT_VOCAL_PART;
+					fAliveStages &= fEndStages;
 				}
 
+				if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
+
 				//        ,
 				//        
 				PartLyricDistance += Distance(ctToLyricEvent, PrevNoteDesc.ctToNoteOn);
+				if (PartLyricDistance > ctMaxPartLyricDistance)
+				{
+					return DISTANCE_CUTOFF_EXCEEDED;
+				}
 
 				//   
-				LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, NULL, &cchEventText);
+				LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+					NULL, &cchEventText);
 
 				if (LyricRes == MIDILYRIC_LYRIC_END) break;
 			}
 
 			//          MIDI-
+			*pfPassedStages = fAliveStages;
 			*pPartLyricDistance = (double) PartLyricDistance / m_cTicksPerMidiQuarterNote;
 			return DISTANCE_SUCCESS;
 		}
 		else if (PartRes != MIDIPART_SUCCESS)
 		{
-			//    MIDIPART_COMPLICATED_NOTE_COMBINATION
+			//    MIDIPART_COMPLICATED_NOTE_COMBINATION
 			//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
 			return DISTANCE_NOT_VOCAL_PART;
 		}
@@ -1197,18 +2137,22 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 		PrevNoteDesc = CurNoteDesc;
 
 		//   
-		PartRes = Part.GetNextNote(&CurNoteDesc);
+		PartRes = GetNextPartNote(pPart, &CurNoteDesc, &fAliveStages);
 
-		//   GetNextNote
+		//   GetNextPartNote
 		if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
 		{
-			LOG("MidiPart::GetNextNote failed\n");
+			LOG("MidiFile::GetNextPartNote failed\n");
 			return DISTANCE_CANT_ALLOC_MEMORY;
 		}
 		else if (PartRes == MIDIPART_PART_END)
 		{
 			//     
 
+			//     ,    :
+			//   ,      ( 
+			//   IDENTICAL_END),     (  )
+			DWORD cchAllPerFirstNote = 0;
 			DWORD cchPerFirstNote = 0;
 
 			//    
@@ -1217,57 +2161,61 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 			//   
 			while (true)
 			{
-				if (fCriteria & IDENTICAL_END)
+				cchAllPerFirstNote += cchEventText;
+
+				if (ctToLyricEvent <= ctToNoteOff)
 				{
-					//    IDENTICAL_END,
-					//    
 					cchPerFirstNote += cchEventText;
 				}
-				else
+
+				//        ,
+				//   
+				if (cchAllPerFirstNote > MAX_SYMBOLS_PER_NOTE)
 				{
-					//     IDENTICAL_END,  ,
-					//      , 
-					if (ctToLyricEvent <= ctToNoteOff)
-					{
-						cchPerFirstNote += cchEventText;
-					}
+					fAliveStages &= ~fEndStages;
 				}
 
 				if (cchPerFirstNote > MAX_SYMBOLS_PER_NOTE)
 				{
-					//       ,
-					//  
-					return DISTANCE_NOT_VOCAL_PART;
+					fAliveStages &= fEndStages;
 				}
 
+				if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
+
 				//        ,
 				//        
 				PartLyricDistance += Distance(ctToLyricEvent, PrevNoteDesc.ctToNoteOn);
+				if (PartLyricDistance > ctMaxPartLyricDistance)
+				{
+					return DISTANCE_CUTOFF_EXCEEDED;
+				}
 
 				//   
-				LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, NULL, &cchEventText);
+				LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+					NULL, &cchEventText);
 
 				if (LyricRes == MIDILYRIC_LYRIC_END) break;
 			}
 
 			//          MIDI-
+			*pfPassedStages = fAliveStages;
 			*pPartLyricDistance = (double) PartLyricDistance / m_cTicksPerMidiQuarterNote;
 			return DISTANCE_SUCCESS;
 		}
 		else if (PartRes != MIDIPART_SUCCESS)
 		{
-			//    MIDIPART_COMPLICATED_NOTE_COMBINATION
+			//    MIDIPART_COMPLICATED_NOTE_COMBINATION
 			//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
 			return DISTANCE_NOT_VOCAL_PART;
 		}
 
-		if (fCriteria & IDENTICAL_START)
+		if (!IsFirstNoteNearer(ctToLyricEvent, &PrevNoteDesc, &CurNoteDesc))
 		{
-			if (!IsFirstNoteNearer(ctToLyricEvent, &PrevNoteDesc, &CurNoteDesc))
-			{
-				//        
-				return DISTANCE_NOT_VOCAL_PART;
-			}
+			//        ,
+			//  IDENTICAL_START 
+			fAliveStages &= ~fStartStages;
+
+			if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
 		}
 	}
 
@@ -1304,14 +2252,13 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 
 			cNotesPerMetaEvent++;
 
-			if (fCriteria & LIMIT_NOTES_PER_METAEVENT)
+			if (cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
 			{
-				if (cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
-				{
-					//       ,
-					//  
-					return DISTANCE_NOT_VOCAL_PART;
-				}
+				//       ,
+				//     LIMIT_NOTES_PER_METAEVENT
+				fAliveStages &= ~fLimitStages;
+
+				if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
 			}
 
 			//  PrevNoteDesc      
@@ -1320,18 +2267,23 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 			PrevNoteDesc = CurNoteDesc;
 
 			//   
-			PartRes = Part.GetNextNote(&CurNoteDesc);
+			PartRes = GetNextPartNote(pPart, &CurNoteDesc, &fAliveStages);
 
-			//   GetNextNote
+			//   GetNextPartNote
 			if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
 			{
-				LOG("MidiPart::GetNextNote failed\n");
+				LOG("MidiFile::GetNextPartNote failed\n");
 				return DISTANCE_CANT_ALLOC_MEMORY;
 			}
 			else if (PartRes == MIDIPART_PART_END)
 			{
 				//   
 
+				//     ,   
+				// :   ,      (
+				//    IDENTICAL_END),     ( 
+				// )
+				DWORD cchAllPerLastNote = 0;
 				DWORD cchPerLastNote = 0;
 
 				//    
@@ -1340,48 +2292,51 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 				//   
 				while (true)
 				{
-					if (fCriteria & IDENTICAL_END)
+					cchAllPerLastNote += cchEventText;
+
+					if (ctToLyricEvent <= ctToNoteOff)
 					{
-						//    IDENTICAL_END,
-						//    
 						cchPerLastNote += cchEventText;
 					}
-					else
+
+					//        ,
+					//   
+					if (cchAllPerLastNote > MAX_SYMBOLS_PER_NOTE)
 					{
-						//     IDENTICAL_END,  ,
-						//      , 
-						if (ctToLyricEvent <= ctToNoteOff)
-						{
-							cchPerLastNote += cchEventText;
-						}
+						fAliveStages &= ~fEndStages;
 					}
 
 					if (cchPerLastNote > MAX_SYMBOLS_PER_NOTE)
 					{
-						//       ,
-						//  
-						return DISTANCE_NOT_VOCAL_PART;
+						fAliveStages &= fEndStages;
 					}
 
+					if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
+
 					//        ,
 					//        
 					PartLyricDistance += Distance(ctToLyricEvent, PrevNoteDesc.ctToNoteOn);
+					if (PartLyricDistance > ctMaxPartLyricDistance)
+					{
+						return DISTANCE_CUTOFF_EXCEEDED;
+					}
 
 					//   
-					LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, NULL,
-						&cchEventText);
+					LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+						NULL, &cchEventText);
 
 					if (LyricRes == MIDILYRIC_LYRIC_END) break;
 				}
 
 				//          MIDI-
+				*pfPassedStages = fAliveStages;
 				*pPartLyricDistance =
 					(double) PartLyricDistance / m_cTicksPerMidiQuarterNote;
 				return DISTANCE_SUCCESS;
 			}
 			else if (PartRes != MIDIPART_SUCCESS)
 			{
-				//    MIDIPART_COMPLICATED_NOTE_COMBINATION
+				//    MIDIPART_COMPLICATED_NOTE_COMBINATION
 				//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
 				return DISTANCE_NOT_VOCAL_PART;
 			}
@@ -1390,6 +2345,10 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 		//           
 		//  ,        
 		PartLyricDistance += Distance(ctToLyricEvent, PrevNoteDesc.ctToNoteOn);
+		if (PartLyricDistance > ctMaxPartLyricDistance)
+		{
+			return DISTANCE_CUTOFF_EXCEEDED;
+		}
 
 		//   ,    PrevNoteDesc
 		cchPerNote += cchEventText;
@@ -1401,59 +2360,179 @@ MidiFile::DISTANCERESULT MidiFile::GetPartLyricDistance(
 		}
 
 		//   
-		LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, NULL, &cchEventText);
+		LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+			NULL, &cchEventText);
 
 		if (LyricRes == MIDILYRIC_LYRIC_END)
 		{
 			//  
 
-			if (fCriteria & IDENTICAL_END || fCriteria & LIMIT_NOTES_PER_METAEVENT)
+			//     IDENTICAL_END  LIMIT_NOTES_PER_METAEVENT
+			//  ,      
+			//   MAX_NOTES_PER_METAEVENT;   
+			//   PrevNoteDesc  CurNoteDesc
+			if (!CheckLastMetaEventNotes(pPart, 2, fTailStages, &fAliveStages))
 			{
-				//  ,      
-				//   MAX_NOTES_PER_METAEVENT
+				LOG("MidiFile::CheckLastMetaEventNotes failed\n");
+				return DISTANCE_CANT_ALLOC_MEMORY;
+			}
 
-				//      PrevNoteDesc  CurNoteDesc
-				cNotesPerMetaEvent = 2;
+			if (fAliveStages == 0) return DISTANCE_NOT_VOCAL_PART;
 
-				//   
-				while (true)
-				{
-					//   
-					PartRes = Part.GetNextNote(&CurNoteDesc);
+			//          MIDI-
+			*pfPassedStages = fAliveStages;
+			*pPartLyricDistance = (double) PartLyricDistance / m_cTicksPerMidiQuarterNote;
+			return DISTANCE_SUCCESS;
+		}
+	}
+}
 
-					//   GetNextNote
-					if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
-					{
-						LOG("MidiPart::GetNextNote failed\n");
-						return DISTANCE_CANT_ALLOC_MEMORY;
-					}
-					else if (PartRes == MIDIPART_PART_END)
-					{
-						break;
-					}
-					else if (PartRes != MIDIPART_SUCCESS)
-					{
-						//    MIDIPART_COMPLICATED_NOTE_COMBINATION
-						//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
-						return DISTANCE_NOT_VOCAL_PART;
-					}
+/****************************************************************************************
+*
+*    GetNextPartNote
+*
+*   
+*       pPart -     MidiPart,    ; 
+*                        
+*               OverlapsThreshold     
+*       pNoteDesc -     NOTEDESC,    
+*                        ;   
+*                     NULL
+*       pfAliveStages -      ,    
+*                         ;    , 
+*                       OverlapsThreshold  
+*
+*    
+*       ,    MidiPart::GetNextNote, 
+*       MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED,   *pfAliveStages  .
+*
+*           OverlapsThreshold
+*     ,      MidiPart::GetNextNote,    
+*      :       
+*    ,       .
+*
+****************************************************************************************/
 
-					cNotesPerMetaEvent++;
+MIDIPARTRESULT MidiFile::GetNextPartNote(
+	__inout MidiPart *pPart,
+	__out_opt NOTEDESC *pNoteDesc,
+	__inout DWORD *pfAliveStages)
+{
+	//       
+	DWORD cOverlaps = pPart->GetOverlapsCount();
 
-					if (cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
-					{
-						//       ,
-						//  
-						return DISTANCE_NOT_VOCAL_PART;
-					}
+	MIDIPARTRESULT PartRes = pPart->GetNextNote(pNoteDesc);
+
+	if (PartRes == MIDIPART_SUCCESS)
+	{
+		if (pPart->GetOverlapsCount() > cOverlaps)
+		{
+			//   ,     
+			for (DWORD iStage = 0; iStage < g_cVocalPartStages; iStage++)
+			{
+				if (g_VocalPartLimitations[iStage].OverlapsThreshold == 0)
+				{
+					*pfAliveStages &= ~(1 << iStage);
 				}
 			}
+		}
+	}
+	else if (PartRes == MIDIPART_PART_END)
+	{
+		DWORD cSingleNotes = pPart->GetSingleNotesCount();
 
-			//          MIDI-
-			*pPartLyricDistance = (double) PartLyricDistance / m_cTicksPerMidiQuarterNote;
-			return DISTANCE_SUCCESS;
+		if (cSingleNotes > 0)
+		{
+			double OverlapsShare = (double) pPart->GetOverlapsCount() / cSingleNotes;
+
+			for (DWORD iStage = 0; iStage < g_cVocalPartStages; iStage++)
+			{
+				if (OverlapsShare > g_VocalPartLimitations[iStage].OverlapsThreshold)
+				{
+					*pfAliveStages &= ~(1 << iStage);
+				}
+			}
+		}
+	}
+	else
+	{
+		return PartRes;
+	}
+
+	if (*pfAliveStages == 0) return MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED;
+
+	return PartRes;
+}
+
+/****************************************************************************************
+*
+*    CheckLastMetaEventNotes
+*
+*   
+*       pPart -     MidiPart,    
+*       cNotesPerMetaEvent -  ,     
+*       fTailStages -    ,     IDENTICAL_END
+*                      LIMIT_NOTES_PER_METAEVENT
+*       pfAliveStages -      ,    
+*                         
+*
+*    
+*       true   ; false,     .
+*
+*   ,        
+*   MAX_NOTES_PER_METAEVENT,      *pfAliveStages,   
+*    fTailStages,     *pfAliveStages ,   .
+*       .      , 
+*       .
+*
+****************************************************************************************/
+
+bool MidiFile::CheckLastMetaEventNotes(
+	__inout MidiPart *pPart,
+	__in DWORD cNotesPerMetaEvent,
+	__in DWORD fTailStages,
+	__inout DWORD *pfAliveStages)
+{
+	//    
+	DWORD fCheckedStages = *pfAliveStages & fTailStages;
+
+	//   
+	while (fCheckedStages != 0)
+	{
+		//   
+		MIDIPARTRESULT PartRes = GetNextPartNote(pPart, NULL, &fCheckedStages);
+
+		//   GetNextPartNote
+		if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
+		{
+			LOG("MidiFile::GetNextPartNote failed\n");
+			return false;
+		}
+		else if (PartRes == MIDIPART_PART_END)
+		{
+			break;
+		}
+		else if (PartRes != MIDIPART_SUCCESS)
+		{
+			//    MIDIPART_COMPLICATED_NOTE_COMBINATION
+			//  MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED
+			fCheckedStages = 0;
+			break;
+		}
+
+		cNotesPerMetaEvent++;
+
+		if (cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
+		{
+			//       
+			fCheckedStages = 0;
+			break;
 		}
 	}
+
+	*pfAliveStages = (*pfAliveStages & ~fTailStages) | fCheckedStages;
+
+	return true;
 }
 
 /****************************************************************************************
@@ -1503,6 +2582,51 @@ bool MidiFile::IsFirstNoteNearer(
 	return true;
 }
 
+/****************************************************************************************
+*
+*    AddScoredCandidate
+*
+*   
+*       pCandidate -    - ,     
+*                    
+*       iStage -      
+*
+*    
+*       true,         ; false,   
+*        .
+*
+*     -      m_pVocalPartList, 
+*        ,      iStage  
+*      MAX_VOCAL_PART_LYRIC_DISTANCE.
+*
+****************************************************************************************/
+
+bool MidiFile::AddScoredCandidate(
+	__in CANDIDATEINFO *pCandidate,
+	__in DWORD iStage)
+{
+	if (pCandidate->DistanceRes == DISTANCE_CANT_ALLOC_MEMORY)
+	{
+		LOG("MidiFile::GetPartLyricDistance failed\n");
+		return false;
+	}
+
+	if (pCandidate->DistanceRes != DISTANCE_SUCCESS) return true;
+
+	if (!(pCandidate->fPassedStages & (1 << iStage))) return true;
+
+	if (pCandidate->PartLyricDistance > MAX_VOCAL_PART_LYRIC_DISTANCE) return true;
+
+	if (!AddVocalPart(pCandidate->iTrack, pCandidate->Channel, pCandidate->Instrument,
+		pCandidate->PartLyricDistance))
+	{
+		LOG("MidiFile::AddVocalPart failed\n");
+		return false;
+	}
+
+	return true;
+}
+
 /****************************************************************************************
 *
 *    AddVocalPart
@@ -1566,6 +2690,35 @@ bool MidiFile::AddVocalPart(
 	return true;
 }
 
+/****************************************************************************************
+*
+*    FindVocalPart
+*
+*   
+*       iVocalPart -       m_pVocalPartList
+*
+*    
+*             iVocalPart  NULL,    
+*        iVocalPart + 1 .
+*
+*        m_pVocalPartList  .
+*
+****************************************************************************************/
+
+MidiFile::VOCALPARTINFO *MidiFile::FindVocalPart(
+	__in DWORD iVocalPart)
+{
+	VOCALPARTINFO *pCurVocalPart = m_pVocalPartList;
+
+	while (pCurVocalPart != NULL && iVocalPart > 0)
+	{
+		pCurVocalPart = pCurVocalPart->pNext;
+		iVocalPart--;
+	}
+
+	return pCurVocalPart;
+}
+
 /****************************************************************************************
 *
 *    CreateSes
@@ -1577,7 +2730,12 @@ bool MidiFile::AddVocalPart(
 *       Instrument -  ,    ;   
 *                      ANY_INSTRUMENT,     , 
 *                     
+*       ctMaxNoteOn -   ,        (
+*                        )    ; MAXDWORD ,
+*                        
 *       pMidiSong -     MidiSong,     
+*       pbTruncated -   ,     true,  
+*                        ctMaxNoteOn;  false
 *
 *    
 *       true   ; false,   .  , 
@@ -1586,6 +2744,11 @@ bool MidiFile::AddVocalPart(
 *        MidiSong.      
 *   ,   iTrack, Channel  Instrument.
 *
+*          , ..  ,
+*     ,    ,   . 
+*        ,  ,    
+*     .
+*
 *    ,   ,    
 *    .
 *
@@ -1595,28 +2758,27 @@ bool MidiFile::CreateSes(
 	__in DWORD iTrack,
 	__in DWORD Channel,
 	__in DWORD Instrument,
-	__in MidiSong *pMidiSong)
+	__in DWORD ctMaxNoteOn,
+	__in MidiSong *pMidiSong,
+	__out bool *pbTruncated)
 {
-	//   MidiLyric      m_LyricEventType
-	//     
-	MidiLyric Lyric;
+	*pbTruncated = false;
 
-	//      m_LyricEventType
-	//     
-	Lyric.InitSearch(m_pLyricTrack, m_LyricEventType, m_DefaultCodePage);
+	//         m_pLyric
+	DWORD iLyricEvent = 0;
 
-	// ,    GetNextValidEvent    ,
+	// ,    GetEvent    ,
 	//          
 	DWORD ctToLyricEvent;
 
-	// ,    GetNextValidEvent    
-	//  
-	WCHAR pwsEventText[MAX_SYMBOLS_PER_LYRIC_EVENT];
+	// ,    GetEvent     
+	//   
+	LPCWSTR pwsEventText;
 
 	// ,      ,    
 	WCHAR pwsNoteText[MAX_SYMBOLS_PER_NOTE];
 
-	// ,    GetNextValidEvent    
+	// ,    GetEvent    
 	//     
 	DWORD cchEventText;
 
@@ -1633,8 +2795,8 @@ bool MidiFile::CreateSes(
 	NOTEDESC CurNoteDesc;
 
 	//   ,   , .. LyricRes == MIDILYRIC_SUCCESS
-	MIDILYRICRESULT LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, pwsEventText,
-		&cchEventText);
+	MIDILYRICRESULT LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+		&pwsEventText, &cchEventText);
 
 	//   
 	MIDIPARTRESULT PartRes = Part.GetNextNote(&PrevNoteDesc);
@@ -1677,8 +2839,8 @@ bool MidiFile::CreateSes(
 			cchPerNote += cchEventText;
 
 			//   
-			LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, pwsEventText,
-				&cchEventText);
+			LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+				&pwsEventText, &cchEventText);
 
 			if (LyricRes == MIDILYRIC_LYRIC_END) break;
 
@@ -1753,8 +2915,8 @@ bool MidiFile::CreateSes(
 					cchPerNote += cchEventText;
 
 					//   
-					LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, pwsEventText,
-						&cchEventText);
+					LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+						&pwsEventText, &cchEventText);
 
 					if (LyricRes == MIDILYRIC_LYRIC_END) break;
 
@@ -1831,8 +2993,8 @@ bool MidiFile::CreateSes(
 			cchPerNote += cchEventText;
 
 			//   
-			LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, pwsEventText,
-				&cchEventText);
+			LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+				&pwsEventText, &cchEventText);
 
 			if (LyricRes == MIDILYRIC_LYRIC_END)
 			{
@@ -1960,8 +3122,8 @@ bool MidiFile::CreateSes(
 					cchPerNote += cchEventText;
 
 					//   
-					LyricRes = Lyric.GetNextValidEvent(&ctToLyricEvent, pwsEventText,
-						&cchEventText);
+					LyricRes = m_pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent,
+						&pwsEventText, &cchEventText);
 
 					//    ,   
 					if (LyricRes == MIDILYRIC_LYRIC_END) break;
@@ -2031,6 +3193,101 @@ bool MidiFile::CreateSes(
 				cNotesToAdd--;
 			}
 		}
+
+		//  ,    ,    
+		// ctMaxNoteOn,     
+		if (PrevNoteDesc.ctToNoteOn >= ctMaxNoteOn)
+		{
+			*pbTruncated = true;
+			return true;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    GetTicksToMeasure
+*
+*   
+*       iMeasure -  
+*
+*    
+*                 iMeasure 
+*       MAXDWORD,       DWORD.
+*
+*              iMeasure.
+*      ,    CreateMeasureSequence,    :
+*      TIME_SIGNATURE   . 
+*         .
+*
+****************************************************************************************/
+
+DWORD MidiFile::GetTicksToMeasure(
+	__in DWORD iMeasure)
+{
+	//    
+	DWORD Numerator = 4;
+
+	//    
+	DWORD Denominator = 4;
+
+	//      MIDI-
+	DWORD cNotated32ndNotesPerMidiQuarterNote = 8;
+
+	//          
+	double ctToEndOfLastMeasure = 0;
+
+	//   
+	DWORD cMeasuresPassed = 0;
+
+	//        
+	DWORD iEvent = 0;
+
+	//     
+	while (true)
+	{
+		//    ,    
+		DWORD ctCurTime;
+
+		//      
+		BYTE *pEventData;
+
+		//      
+		DWORD Event = m_MidiTracks[0].GetEvent(iEvent++, &ctCurTime, &pEventData);
+
+		//   ,    TIME_SIGNATURE
+		if (Event != TIME_SIGNATURE && Event != REAL_TRACK_END) continue;
+
+		//    
+		double ctMeasure = (double) 32 * Numerator * m_cTicksPerMidiQuarterNote /
+			(Denominator * cNotated32ndNotesPerMidiQuarterNote);
+
+		//       ;   
+		//     
+		DWORD cMeasures = (Event == REAL_TRACK_END) ? MAXDWORD :
+			(DWORD) floor((ctCurTime - ctToEndOfLastMeasure) / ctMeasure);
+
+		if (iMeasure - cMeasuresPassed <= cMeasures)
+		{
+			//  iMeasure    
+			double ctToMeasure = ctToEndOfLastMeasure +
+				(iMeasure - cMeasuresPassed) * ctMeasure;
+
+			if (ctToMeasure >= MAXDWORD) return MAXDWORD;
+
+			return (DWORD) ctToMeasure;
+		}
+
+		cMeasuresPassed += cMeasures;
+
+		//  pEventData  ,    
+		pEventData++;
+
+		Numerator = pEventData[0];
+		Denominator = (DWORD) pow(2.0, pEventData[1]);
+		cNotated32ndNotesPerMidiQuarterNote = pEventData[3];
+
+		ctToEndOfLastMeasure += cMeasures * ctMeasure;
 	}
 }
 
@@ -2040,22 +3297,22 @@ bool MidiFile::CreateSes(
 *
 *   
 *       pMidiSong -     MidiSong,  
+*       ctMaxTime -   ,     TIME_SIGNATURE 
+*                   ; MAXDWORD ,    
 *
 *    
 *       true,     ; false,   
 *        .
 *
-*         MidiSong.
+*         MidiSong.   
+*      .
 *
 ****************************************************************************************/
 
 bool MidiFile::CreateMeasureSequence(
-	__inout MidiSong *pMidiSong)
+	__inout MidiSong *pMidiSong,
+	__in DWORD ctMaxTime)
 {
-	//       ,    
-    //   TIME_SIGNATURE
-	m_MidiTracks[0].ResetCurrentPosition();
-
 	//    
 	DWORD Numerator = 4;
 
@@ -2068,20 +3325,25 @@ bool MidiFile::CreateMeasureSequence(
 	//          
 	double ctToEndOfLastMeasure = 0;
 
-	//    ,    
-	DWORD ctCurTime = 0;
+	//        ,   
+	//    TIME_SIGNATURE
+	DWORD iEvent = 0;
 
 	//     
     while (true)
 	{
-		// -   
-		DWORD ctDeltaTime;
+		//    ,    
+		DWORD ctCurTime;
 
 		//      
 		BYTE *pEventData;
 
 		//      
-		DWORD Event = m_MidiTracks[0].GetNextEvent(&ctDeltaTime, &pEventData);
+		DWORD Event = m_MidiTracks[0].GetEvent(iEvent++, &ctCurTime, &pEventData);
+
+		//  TIME_SIGNATURE,    ctMaxTime,  , ..
+		//    ,    
+		if (Event == TIME_SIGNATURE && ctCurTime >= ctMaxTime) Event = REAL_TRACK_END;
 
 		if (Event == REAL_TRACK_END)
 		{
@@ -2104,9 +3366,13 @@ bool MidiFile::CreateMeasureSequence(
 			double ctMeasure = (double) 32 * Numerator * m_cTicksPerMidiQuarterNote /
 				(Denominator * cNotated32ndNotesPerMidiQuarterNote);
 
+			//         
+			//  ;     ,   
+			// 
+			double ctRest = ctToNoteOn + ctDuration - ctToEndOfLastMeasure;
+
 			//  ,      
-			DWORD cMeasures = (DWORD) ceil((ctToNoteOn + ctDuration -
-				ctToEndOfLastMeasure) / ctMeasure);
+			DWORD cMeasures = (ctRest > 0) ? (DWORD) ceil(ctRest / ctMeasure) : 0;
 
 			//     
 			for (DWORD i = 0; i < cMeasures; i++)
@@ -2122,9 +3388,6 @@ bool MidiFile::CreateMeasureSequence(
 			return true;
 		}
 
-		//    (  ,    )
-		ctCurTime += ctDeltaTime;
-
 		//   ,    TIME_SIGNATURE
 		if (Event != TIME_SIGNATURE) continue;
 
@@ -2181,12 +3444,9 @@ bool MidiFile::CreateMeasureSequence(
 bool MidiFile::CreateTempoMap(
 	__inout MidiSong *pMidiSong)
 {
-	//       ,    
-    //   SET_TEMPO
-	m_MidiTracks[0].ResetCurrentPosition();
-
-	// -   
-	DWORD ctDeltaTime;
+	//        ,   
+	//    SET_TEMPO
+	DWORD iEvent = 0;
 
 	//      
 	BYTE *pEventData;
@@ -2198,14 +3458,11 @@ bool MidiFile::CreateTempoMap(
     while (true)
 	{
 		//      
-		DWORD Event = m_MidiTracks[0].GetNextEvent(&ctDeltaTime, &pEventData);
+		DWORD Event = m_MidiTracks[0].GetEvent(iEvent++, &ctCurTime, &pEventData);
 
 		//   ,  
 		if (Event == REAL_TRACK_END) return true;
 
-		//    (  ,    )
-		ctCurTime += ctDeltaTime;
-
 		//   ,    SET_TEMPO
 		if (Event == SET_TEMPO) break;
 	}
@@ -2227,7 +3484,7 @@ bool MidiFile::CreateTempoMap(
     while (true)
 	{
 		//      
-		DWORD Event = m_MidiTracks[0].GetNextEvent(&ctDeltaTime, &pEventData);
+		DWORD Event = m_MidiTracks[0].GetEvent(iEvent++, &ctCurTime, &pEventData);
 
 		if (Event == REAL_TRACK_END)
 		{
@@ -2243,9 +3500,6 @@ bool MidiFile::CreateTempoMap(
 			return true;
 		}
 
-		//    (  ,    )
-		ctCurTime += ctDeltaTime;
-
 		//   ,    SET_TEMPO
 		if (Event != SET_TEMPO) continue;
 
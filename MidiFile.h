@@ -25,7 +25,30 @@ enum MIDIFILERESULT
 	MIDIFILE_UNSUPPORTED_FORMAT,
 	MIDIFILE_NO_LYRIC,
 	MIDIFILE_NO_VOCAL_PARTS,
-	MIDIFILE_CANT_ALLOC_MEMORY
+	MIDIFILE_CANT_ALLOC_MEMORY,
+	MIDIFILE_CANCELLED
+};
+
+//      (.  MidiFile::AssignFile)
+enum MIDIFILESTAGE
+{
+	MIDIFILE_STAGE_ATTACH_TRACKS, //     
+	MIDIFILE_STAGE_FIND_LYRIC, //   
+	MIDIFILE_STAGE_FIND_VOCAL_PARTS, //   
+	MIDIFILE_STAGE_COUNT
+};
+
+// ,          (. 
+// MidiFile::SetLoadControl)
+typedef void (*MIDIFILESTAGEPROC)(
+	__in MIDIFILESTAGE Stage,
+	__in LPVOID pContext);
+
+//   MIDI-  
+enum FILEBUFFERTYPE
+{
+	FILEBUFFER_HEAP, //    HeapAlloc
+	FILEBUFFER_MAPPED_VIEW //  ,   MapViewOfFile
 };
 
 /****************************************************************************************
@@ -42,7 +65,8 @@ class MidiFile
 		DISTANCE_SUCCESS,
 		DISTANCE_NOT_VOCAL_PART,
 		DISTANCE_NO_NOTES,
-		DISTANCE_CANT_ALLOC_MEMORY
+		DISTANCE_CANT_ALLOC_MEMORY,
+		DISTANCE_CUTOFF_EXCEEDED
 	};
 
 	// ,     
@@ -55,9 +79,39 @@ class MidiFile
 		VOCALPARTINFO *pNext; //     
 	};
 
+	// ,   -    
+	struct CANDIDATEINFO {
+		DWORD iTrack; //     m_MidiTracks
+		DWORD Channel; //    ANY_CHANNEL
+		DWORD Instrument; //    ANY_INSTRUMENT
+		DISTANCERESULT DistanceRes; // ,    GetPartLyricDistance
+		DWORD fPassedStages; //    ,    
+							 // 
+		double PartLyricDistance; //        
+								  // MIDI-
+	};
+
+	// ,          -
+	// ;     
+	struct SCORINGJOB {
+		MidiFile *pMidiFile; //   ,   
+		CANDIDATEINFO *pCandidates; //     - 
+		DWORD cCandidates; //     pCandidates
+		DWORD ctMaxPartLyricDistance; //       
+		volatile LONG iNextCandidate; //    
+		volatile LONG cPendingThreads; //   ,  
+									   // 
+	};
+
 	//      MIDI-
 	BYTE *m_pFile;
 
+	//  MIDI-  
+	DWORD m_cbFile;
+
+	//   MIDI-  
+	FILEBUFFERTYPE m_FileBufferType;
+
 	//  ,    MIDI 
 	DWORD m_cTicksPerMidiQuarterNote;
 
@@ -73,15 +127,30 @@ class MidiFile
 	//     
 	CONCORD_NOTE_CHOICE m_ConcordNoteChoice;
 
-	//      (LYRIC  TEXT_EVENT)
-	DWORD m_LyricEventType;
-
-	//     MidiTrack,      
-	MidiTrack *m_pLyricTrack;
+	//     MidiLyric,    
+	//  ,      
+	MidiLyric *m_pLyric;
 
 	//     
 	VOCALPARTINFO *m_pVocalPartList;
 
+	//   - ,     
+	//  -      
+	DWORD m_cPrunedCandidates;
+
+	//      AssignFile   
+	// ; ,     ,   
+	LONGLONG m_StageTimes[MIDIFILE_STAGE_COUNT];
+
+	// ,        ,  
+	// ;       NULL
+	MIDIFILESTAGEPROC m_pStageProc;
+	LPVOID m_pStageContext;
+
+	//    :     ,    
+	// ;    NULL
+	volatile LONG *m_pCancelFlag;
+
 public:
 
 	MidiFile();
@@ -95,40 +164,136 @@ public:
 	MIDIFILERESULT SetConcordNoteChoice(
 		__in CONCORD_NOTE_CHOICE ConcordNoteChoice);
 
+	//  ,     ,   
+	void SetLoadControl(
+		__in_opt MIDIFILESTAGEPROC pStageProc,
+		__in_opt LPVOID pStageContext,
+		__in_opt volatile LONG *pCancelFlag);
+
 	//      
 	MIDIFILERESULT AssignFile(
 		__in BYTE *pFile,
-		__in DWORD cbFile);
+		__in DWORD cbFile,
+		__in FILEBUFFERTYPE FileBufferType = FILEBUFFER_HEAP);
 
 	//    Song,   
-	Song *CreateSong();
+	Song *CreateSong(
+		__in DWORD iVocalPart = 0,
+		__in DWORD cMaxMeasures = 0,
+		__out_opt bool *pbTruncated = NULL);
+
+	//     
+	DWORD GetVocalPartCount();
+
+	//       
+	bool GetVocalPartInfo(
+		__in DWORD iVocalPart,
+		__out_opt DWORD *piTrack,
+		__out_opt DWORD *pChannel,
+		__out_opt DWORD *pInstrument,
+		__out_opt double *pPartLyricDistance);
+
+	//   ,      
+	DWORD GetPrunedCandidateCount();
+
+	//       
+	DWORD GetEventCount();
+
+	//   ,    
+	DWORD GetMemorySize();
+
+	//       
+	LONGLONG GetStageTime(
+		__in MIDIFILESTAGE Stage);
 
 	//    
 	void Free();
 
+	//        ;
+	//    ,       
+	//    ,      
+	//  
+	static void SetMaxScoringThreads(
+		__in DWORD cMaxThreads);
+
 private:
 
+	//           
+	bool BeginStage(
+		__in MIDIFILESTAGE Stage);
+
+	//  true,     
+	bool IsCancelled();
+
+	//      
+	void EndStage(
+		__in MIDIFILESTAGE Stage,
+		__inout LARGE_INTEGER *pStageStartTime);
+
 	//   
 	MIDIFILERESULT FindLyric();
 
 	//   
 	MIDIFILERESULT FindVocalParts();
 
-	//          MIDI-
+	//    -    
+	MIDIFILERESULT FindCandidates(
+		__out CANDIDATEINFO **ppCandidates,
+		__out DWORD *pcCandidates);
+
+	//       - 
+	void ScoreCandidates(
+		__inout CANDIDATEINFO *pCandidates,
+		__in DWORD cCandidates);
+
+	//   ,   ,     
+	static bool StartScoringPool(
+		__in DWORD cThreads);
+
+	//    ,   
+	static DWORD WINAPI ScoringThreadProc(
+		__in LPVOID lpParameter);
+
+	//        
+	void ScoreJobCandidates(
+		__inout SCORINGJOB *pJob);
+
+	//          MIDI- 
+	// ,         
 	DISTANCERESULT GetPartLyricDistance(
+		__inout MidiPart *pPart,
 		__in DWORD iTrack,
 		__in DWORD Channel,
 		__in DWORD Instrument,
-		__in double OverlapsThreshold,
-		__in DWORD fCriteria,
+		__in DWORD ctMaxPartLyricDistance,
+		__out DWORD *pfPassedStages,
 		__out double *pPartLyricDistance);
 
+	//          
+	MIDIPARTRESULT GetNextPartNote(
+		__inout MidiPart *pPart,
+		__out_opt NOTEDESC *pNoteDesc,
+		__inout DWORD *pfAliveStages);
+
+	//        ,   
+	bool CheckLastMetaEventNotes(
+		__inout MidiPart *pPart,
+		__in DWORD cNotesPerMetaEvent,
+		__in DWORD fTailStages,
+		__inout DWORD *pfAliveStages);
+
 	// ,        
 	bool IsFirstNoteNearer(
 		__in DWORD ctToLyricEvent,
 		__in NOTEDESC *pFirstNote,
 		__in NOTEDESC *pSecondNote);
 
+	//   -     ,    
+	//   
+	bool AddScoredCandidate(
+		__in CANDIDATEINFO *pCandidate,
+		__in DWORD iStage);
+
 	//       m_pVocalPartList
 	bool AddVocalPart(
 		__in DWORD iTrack,
@@ -136,16 +301,27 @@ private:
 		__in DWORD Instrument,
 		__in double PartLyricDistance);
 
+	//      m_pVocalPartList  
+	VOCALPARTINFO *FindVocalPart(
+		__in DWORD iVocalPart);
+
 	//      MidiSong
 	bool CreateSes(
 		__in DWORD iTrack,
 		__in DWORD Channel,
 		__in DWORD Instrument,
-		__in MidiSong *pMidiSong);
+		__in DWORD ctMaxNoteOn,
+		__in MidiSong *pMidiSong,
+		__out bool *pbTruncated);
+
+	//            
+	DWORD GetTicksToMeasure(
+		__in DWORD iMeasure);
 
 	//       MidiSong
 	bool CreateMeasureSequence(
-		__inout MidiSong *pMidiSong);
+		__inout MidiSong *pMidiSong,
+		__in DWORD ctMaxTime);
 
 	//       MidiSong
 	bool CreateTempoMap(
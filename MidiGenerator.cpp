@@ -0,0 +1,1296 @@
+/****************************************************************************************
+*
+*         MIDI-
+*
+*         MIDI-  0  1 
+*       MIDI-     
+*   (SingoscopeBatch, SingoscopeStageBench).       
+*    ,          . 
+*          ,   
+*    :    ,    , 
+*      (      MidiPart::GetNextNote),
+*       (      
+*   MidiFile::FindVocalParts),     .
+*
+*           ,
+*               .
+*
+*    :
+*   SingoscopeGen <> < > [<>=<> ...]
+*
+*    (     ):
+*       format -  MIDI-, 0  1 (1)
+*       tracks -    ,    (4)
+*       notes -        (1000)
+*       polyphony -      (3)
+*       overlap -   ,   ; 
+*                         
+*                   (10)
+*       held -  ,       (0)
+*       instruments -       (1)
+*       tempos -    (4)
+*       timesigs -    (2)
+*       lyric -     : 0 - LYRIC, 1 - TEXT_EVENT, 2 - 
+*                    (2)
+*       codepage -    : 1251, 1252, 20127 (ASCII)  0 -
+*                         (0)
+*       runningstatus - 1,      
+*                         (running status);  0 (1)
+*       division -      (480)
+*       seed -      (1)
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+
+#include "Log.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//      -
+#define MAX_EVENT_DATA_SIZE				24
+
+//        
+#define MAX_PARAMETER_NAME_LENGTH		31
+
+//     
+#define MAX_NOTE_TRACKS					256
+
+//      
+#define INITIAL_EVENT_ARRAY_SIZE		4096
+
+//        ,   
+//   
+#define MAX_EVENT_TIME					0x0FFFFFFF
+
+// ,    ,    
+#define HELD_NOTES_CHANNEL				15
+
+//      
+#define WORDS_PER_LINE					6
+
+//   
+#define EXIT_CODE_SUCCESS				0
+#define EXIT_CODE_WRITE_FAILED			1
+#define EXIT_CODE_INVALID_ARGUMENTS		2
+
+//  ,       ;    
+//  
+enum EVENTORDER
+{
+	ORDER_CONDUCTOR, //    ,  
+	ORDER_NOTE_OFF, //  
+	ORDER_PROGRAM_CHANGE, //  
+	ORDER_LYRIC, //   
+	ORDER_NOTE_ON //  
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,    
+struct EVENT
+{
+	DWORD iTrack; //  ,    
+	DWORD ctTime; //       
+	DWORD Order; //        (  EVENTORDER)
+	DWORD iEvent; //    
+	DWORD cbData; //     Data
+	BYTE Data[MAX_EVENT_DATA_SIZE]; //  ,    
+};
+
+// ,    
+struct PARAMETER
+{
+	LPCTSTR pszName; //  
+	DWORD *pValue; //      
+	DWORD MinValue; //    
+	DWORD MaxValue; //    
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//    
+static DWORD g_Format = 1;
+static DWORD g_cNoteTracks = 4;
+static DWORD g_cNotes = 1000;
+static DWORD g_Polyphony = 3;
+static DWORD g_OverlapPercent = 10;
+static DWORD g_cHeldNotes = 0;
+static DWORD g_cInstruments = 1;
+static DWORD g_cTempoChanges = 4;
+static DWORD g_cTimeSignatureChanges = 2;
+static DWORD g_LyricEventType = 2;
+static DWORD g_LyricCodePage = 0;
+static DWORD g_bUseRunningStatus = 1;
+static DWORD g_Division = 480;
+static DWORD g_Seed = 1;
+
+//    
+static const PARAMETER g_Parameters[] =
+{
+	{TEXT("format"), &g_Format, 0, 1},
+	{TEXT("tracks"), &g_cNoteTracks, 1, MAX_NOTE_TRACKS},
+	{TEXT("notes"), &g_cNotes, 1, 10000000},
+	{TEXT("polyphony"), &g_Polyphony, 1, 1000},
+	{TEXT("overlap"), &g_OverlapPercent, 0, 100},
+	{TEXT("held"), &g_cHeldNotes, 0, 100000},
+	{TEXT("instruments"), &g_cInstruments, 1, MAX_MIDI_INSTRUMENTS},
+	{TEXT("tempos"), &g_cTempoChanges, 0, 100000},
+	{TEXT("timesigs"), &g_cTimeSignatureChanges, 0, 100000},
+	{TEXT("lyric"), &g_LyricEventType, 0, 2},
+	{TEXT("codepage"), &g_LyricCodePage, 0, 20127},
+	{TEXT("runningstatus"), &g_bUseRunningStatus, 0, 1},
+	{TEXT("division"), &g_Division, 24, 0x7FFF},
+	{TEXT("seed"), &g_Seed, 0, 0xFFFFFFFF}
+};
+
+//      ASCII
+static const char *g_pszAsciiSyllables[] =
+{
+	"la", "li", "lo", "na", "ni", "ma", "do", "re", "mi", "so", "ta", "ke", "ru", "ya",
+	"ho", "love", "you", "and", "the", "song"
+};
+
+//      Windows-1251 ( )
+static const char *g_pszCyrillicSyllables[] =
+{
+	"\xEB\xE0", "\xEB\xE8", "\xED\xE0", "\xEC\xE0", "\xED\xFE", "\xF0\xE5", "\xEC\xE8",
+	"\xF1\xEE", "\xEA\xE0", "\xE4\xF3", "\xF8\xE0", "\xE2\xE5", "\xF2\xE5\xF0",
+	"\xEB\xFE", "\xE1\xEE\xE2\xFC", "\xE7\xE8", "\xEC\xEE", "\xF1\xED\xE5",
+	"\xE6\xEE\xEA"
+};
+
+//      Windows-1252 ( )
+static const char *g_pszWesternSyllables[] =
+{
+	"\xE9t\xE9", "o\xF9", "\xE7" "a", "na\xEFve", "d\xE9j\xE0", "se\xF1or", "\xFC" "ber",
+	"fr\xFCh", "ma\xF1" "ana", "c\x9Cur", "gar\xE7on", "f\xEAte"
+};
+
+//    
+static EVENT *g_pEvents = NULL;
+
+//      g_pEvents
+static DWORD g_cEvents = 0;
+
+//  ,       g_pEvents
+static DWORD g_cMaxEvents = 0;
+
+//     
+static DWORD g_RandomState;
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static bool ParseParameter(
+	__in LPCTSTR pszParameter);
+
+static bool GenerateFile(
+	__in LPCTSTR pszFileName,
+	__in DWORD iFile);
+
+static bool GenerateVocalPart(
+	__in DWORD iTrack,
+	__in DWORD Channel,
+	__out DWORD *pctEnd);
+
+static bool GenerateAccompaniment(
+	__in DWORD iTrack,
+	__in DWORD Channel,
+	__out DWORD *pctEnd);
+
+static bool GenerateHeldNotes(
+	__in DWORD iTrack,
+	__in DWORD ctEnd);
+
+static bool GenerateConductorEvents(
+	__in DWORD iTrack,
+	__in DWORD ctEnd);
+
+static bool AddEvent(
+	__in DWORD iTrack,
+	__in DWORD ctTime,
+	__in EVENTORDER Order,
+	__in_bcount(cbData) const BYTE *pData,
+	__in DWORD cbData);
+
+static bool AddChannelEvent(
+	__in DWORD iTrack,
+	__in DWORD ctTime,
+	__in EVENTORDER Order,
+	__in BYTE Status,
+	__in BYTE Data1,
+	__in BYTE Data2);
+
+static bool AddMetaEvent(
+	__in DWORD iTrack,
+	__in DWORD ctTime,
+	__in EVENTORDER Order,
+	__in BYTE Type,
+	__in_bcount(cbData) const BYTE *pData,
+	__in DWORD cbData);
+
+static bool WriteFileImage(
+	__in LPCTSTR pszFileName,
+	__in DWORD cTracks);
+
+static BYTE *PutVLQ(
+	__out BYTE *pCurByte,
+	__in DWORD dwValue);
+
+static BYTE *PutBigEndian(
+	__out BYTE *pCurByte,
+	__in DWORD dwValue,
+	__in DWORD cbValue);
+
+static int __cdecl CompareEvents(
+	const void *pEvent1,
+	const void *pEvent2);
+
+static DWORD Random(
+	__in DWORD Range);
+
+static bool RandomPercent(
+	__in DWORD Percent);
+
+/****************************************************************************************
+*
+*    _tmain
+*
+*   .   main  MSDN.
+*
+****************************************************************************************/
+
+int __cdecl _tmain(
+	int argc,
+	TCHAR *argv[])
+{
+	//   OEM-,      
+	setlocale(LC_ALL, ".OCP");
+
+	if (argc < 3)
+	{
+		_tprintf(TEXT("usage: SingoscopeGen <directory> <files> [name=value ...]\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	DWORD cFiles = _tcstoul(argv[2], NULL, 10);
+
+	if (cFiles == 0)
+	{
+		_tprintf(TEXT("invalid number of files: %s\n"), argv[2]);
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	for (int iArg = 3; iArg < argc; iArg++)
+	{
+		if (!ParseParameter(argv[iArg]))
+		{
+			_tprintf(TEXT("invalid parameter: %s\n"), argv[iArg]);
+			return EXIT_CODE_INVALID_ARGUMENTS;
+		}
+	}
+
+	if (g_LyricCodePage != 0 && g_LyricCodePage != 1251 && g_LyricCodePage != 1252 &&
+		g_LyricCodePage != 20127)
+	{
+		_tprintf(TEXT("unsupported code page: %u\n"), g_LyricCodePage);
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	//          
+	//  ,     
+	if ((ULONGLONG) (g_cNotes + 1) * g_Division * 5 > MAX_EVENT_TIME)
+	{
+		_tprintf(TEXT("too many notes for this division\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	//        \gen00000.mid
+	if (lstrlen(argv[1]) + 14 >= MAX_PATH)
+	{
+		_tprintf(TEXT("directory name is too long\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	if (!CreateDirectory(argv[1], NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		_tprintf(TEXT("cannot create %s (error %u)\n"), argv[1], GetLastError());
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	INITLOG(TEXT("genlog.txt"));
+
+	int ExitCode = EXIT_CODE_SUCCESS;
+
+	for (DWORD iFile = 0; iFile < cFiles; iFile++)
+	{
+		//    
+		TCHAR pszFileName[MAX_PATH];
+
+		wsprintf(pszFileName, TEXT("%s\\gen%05u.mid"), argv[1], iFile);
+
+		if (!GenerateFile(pszFileName, iFile))
+		{
+			_tprintf(TEXT("cannot create %s\n"), pszFileName);
+			ExitCode = EXIT_CODE_WRITE_FAILED;
+			break;
+		}
+	}
+
+	if (g_pEvents != NULL) HeapFree(GetProcessHeap(), 0, g_pEvents);
+
+	UNINITLOG();
+
+	if (ExitCode == EXIT_CODE_SUCCESS) _tprintf(TEXT("%u files created\n"), cFiles);
+
+	return ExitCode;
+}
+
+/****************************************************************************************
+*
+*    ParseParameter
+*
+*   
+*       pszParameter -   ,  ,    
+*                          <>=<>
+*
+*    
+*       true,       ;  false.
+*
+*           
+*   .
+*
+****************************************************************************************/
+
+static bool ParseParameter(
+	__in LPCTSTR pszParameter)
+{
+	LPCTSTR pszValue = _tcschr(pszParameter, TEXT('='));
+
+	if (pszValue == NULL) return false;
+
+	//  
+	TCHAR pszName[MAX_PARAMETER_NAME_LENGTH + 1];
+
+	DWORD cchName = (DWORD) (pszValue - pszParameter);
+
+	if (cchName > MAX_PARAMETER_NAME_LENGTH) return false;
+
+	lstrcpyn(pszName, pszParameter, cchName + 1);
+
+	pszValue++;
+
+	for (DWORD i = 0; i < sizeof(g_Parameters) / sizeof(g_Parameters[0]); i++)
+	{
+		const PARAMETER *pParameter = &g_Parameters[i];
+
+		if (lstrcmpi(pParameter->pszName, pszName) != 0) continue;
+
+		LPTSTR pszEnd;
+
+		DWORD Value = _tcstoul(pszValue, &pszEnd, 10);
+
+		if (*pszValue == 0 || *pszEnd != 0 || Value < pParameter->MinValue ||
+			Value > pParameter->MaxValue)
+		{
+			return false;
+		}
+
+		*pParameter->pValue = Value;
+
+		return true;
+	}
+
+	return false;
+}
+
+/****************************************************************************************
+*
+*    GenerateFile
+*
+*   
+*       pszFileName -   ,  ,    
+*                      
+*       iFile -    
+*
+*    
+*       true,    ;  false.
+*
+*     MIDI-.   1      
+*   ,   -  ,   - , 
+*     (  held   ) - ,  
+*    .   0      .
+*
+****************************************************************************************/
+
+static bool GenerateFile(
+	__in LPCTSTR pszFileName,
+	__in DWORD iFile)
+{
+	//       ,    
+	//       ;  
+	//    
+	g_RandomState = (g_Seed + iFile) * 2654435761u;
+	if (g_RandomState == 0) g_RandomState = 1;
+
+	g_cEvents = 0;
+
+	//   
+	DWORD iNextTrack = (g_Format == 0) ? 0 : 1;
+
+	//        
+	DWORD ctSongEnd;
+
+	if (!GenerateVocalPart(iNextTrack, 0, &ctSongEnd)) return false;
+
+	for (DWORD i = 1; i < g_cNoteTracks; i++)
+	{
+		if (g_Format == 1) iNextTrack++;
+
+		DWORD ctEnd;
+
+		if (!GenerateAccompaniment(iNextTrack, i % MAX_MIDI_CHANNELS, &ctEnd))
+		{
+			return false;
+		}
+
+		if (ctEnd > ctSongEnd) ctSongEnd = ctEnd;
+	}
+
+	if (g_cHeldNotes != 0)
+	{
+		if (g_Format == 1) iNextTrack++;
+
+		if (!GenerateHeldNotes(iNextTrack, ctSongEnd)) return false;
+	}
+
+	if (!GenerateConductorEvents(0, ctSongEnd)) return false;
+
+	return WriteFileImage(pszFileName, iNextTrack + 1);
+}
+
+/****************************************************************************************
+*
+*    GenerateVocalPart
+*
+*   
+*       iTrack -  ,    
+*       Channel -    
+*       pctEnd -   ,       
+*                     
+*
+*    
+*       true,    ; false,     .
+*
+*       g_cNotes    .   
+*    ;    ,   -  .  
+*     ,      .
+*        ,        
+*        MidiFile::FindVocalParts.
+*
+****************************************************************************************/
+
+static bool GenerateVocalPart(
+	__in DWORD iTrack,
+	__in DWORD Channel,
+	__out DWORD *pctEnd)
+{
+	//     
+	BYTE LyricType;
+
+	switch (g_LyricEventType)
+	{
+		case 0: LyricType = LYRIC; break;
+		case 1: LyricType = TEXT_EVENT; break;
+		default: LyricType = Random(2) ? LYRIC : TEXT_EVENT;
+	}
+
+	//    
+	DWORD CodePage = g_LyricCodePage;
+
+	if (CodePage == 0)
+	{
+		static const DWORD CodePages[] = {1251, 1252, 20127};
+
+		CodePage = CodePages[Random(3)];
+	}
+
+	// ,     
+	const char **ppszSyllables;
+	DWORD cSyllables;
+
+	switch (CodePage)
+	{
+		case 1251:
+			ppszSyllables = g_pszCyrillicSyllables;
+			cSyllables = sizeof(g_pszCyrillicSyllables) / sizeof(char *);
+			break;
+		case 1252:
+			ppszSyllables = g_pszWesternSyllables;
+			cSyllables = sizeof(g_pszWesternSyllables) / sizeof(char *);
+			break;
+		default:
+			ppszSyllables = g_pszAsciiSyllables;
+			cSyllables = sizeof(g_pszAsciiSyllables) / sizeof(char *);
+	}
+
+	BYTE ProgramChange = (BYTE) (PROGRAM_CHANGE | Channel);
+	BYTE NoteOn = (BYTE) (NOTE_ON | Channel);
+	BYTE NoteOff = (BYTE) (NOTE_OFF | Channel);
+
+	if (!AddChannelEvent(iTrack, 0, ORDER_PROGRAM_CHANGE, ProgramChange,
+		(BYTE) Random(MAX_MIDI_INSTRUMENTS), 0))
+	{
+		return false;
+	}
+
+	//    
+	DWORD Durations[] = {g_Division / 4, g_Division / 2, g_Division / 2, g_Division,
+		g_Division, g_Division * 3 / 2, g_Division * 2};
+
+	//        
+	DWORD ctTime = Random(g_Division * 4);
+
+	//  ,     ,   ,
+	//     
+	DWORD cSyllablesLeft = 0;
+	DWORD cWordsLeft = WORDS_PER_LINE;
+
+	DWORD ctEnd = 0;
+
+	for (DWORD iNote = 0; iNote < g_cNotes; iNote++)
+	{
+		DWORD ctDuration = Durations[Random(sizeof(Durations) / sizeof(DWORD))];
+		DWORD ctRest = (Random(4) == 0) ? Durations[Random(3)] : 0;
+		DWORD ctNextTime = ctTime + ctDuration + ctRest;
+
+		//   ;     
+		// ;         ,
+		//         ,  
+		// 
+		DWORD ctNoteOff = (Random(1000) < g_OverlapPercent) ?
+			ctNextTime + g_Division / 8 : ctTime + ctDuration;
+
+		BYTE NoteNumber = (BYTE) (55 + Random(24));
+
+		if (!AddChannelEvent(iTrack, ctTime, ORDER_NOTE_ON, NoteOn, NoteNumber, 100))
+		{
+			return false;
+		}
+
+		//     NOTE_OFF,   NOTE_ON  
+		//  
+		bool bAdded = Random(2) ?
+			AddChannelEvent(iTrack, ctNoteOff, ORDER_NOTE_OFF, NoteOff, NoteNumber, 64) :
+			AddChannelEvent(iTrack, ctNoteOff, ORDER_NOTE_OFF, NoteOn, NoteNumber, 0);
+
+		if (!bAdded) return false;
+
+		if (ctNoteOff > ctEnd) ctEnd = ctNoteOff;
+
+		//   
+		if (Random(50) != 0)
+		{
+			if (cSyllablesLeft == 0) cSyllablesLeft = 1 + Random(3);
+
+			BYTE Text[MAX_EVENT_DATA_SIZE];
+			DWORD cbText = 0;
+
+			//   TEXT_EVENT     '/',  
+			//  LYRIC     '\r'
+			if (cWordsLeft == 0 && LyricType == TEXT_EVENT) Text[cbText++] = '/';
+
+			const char *pszSyllable = ppszSyllables[Random(cSyllables)];
+
+			while (*pszSyllable != 0) Text[cbText++] = (BYTE) *pszSyllable++;
+
+			if (--cSyllablesLeft == 0)
+			{
+				Text[cbText++] = ' ';
+
+				if (cWordsLeft == 0) cWordsLeft = WORDS_PER_LINE;
+
+				if (--cWordsLeft == 0 && LyricType == LYRIC) Text[cbText++] = '\r';
+			}
+
+			//      
+			DWORD ctLyric = ctTime;
+			DWORD LyricShift = Random(200);
+
+			if (LyricShift == 0)
+			{
+				ctLyric += g_Division / 16;
+			}
+			else if (LyricShift == 1 && ctLyric >= g_Division / 16)
+			{
+				ctLyric -= g_Division / 16;
+			}
+
+			if (!AddMetaEvent(iTrack, ctLyric, ORDER_LYRIC, LyricType, Text, cbText))
+			{
+				return false;
+			}
+		}
+
+		ctTime = ctNextTime;
+	}
+
+	*pctEnd = ctEnd;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GenerateAccompaniment
+*
+*   
+*       iTrack -  ,    
+*       Channel -   
+*       pctEnd -   ,       
+*                     
+*
+*    
+*       true,    ; false,     .
+*
+*      g_cNotes ,     g_Polyphony
+*   .     ,      , 
+*     .     . 
+*    g_cInstruments - 1    .
+*
+****************************************************************************************/
+
+static bool GenerateAccompaniment(
+	__in DWORD iTrack,
+	__in DWORD Channel,
+	__out DWORD *pctEnd)
+{
+	BYTE ProgramChange = (BYTE) (PROGRAM_CHANGE | Channel);
+	BYTE NoteOn = (BYTE) (NOTE_ON | Channel);
+	BYTE NoteOff = (BYTE) (NOTE_OFF | Channel);
+
+	//        
+	DWORD cConcords = (g_cNotes + g_Polyphony - 1) / g_Polyphony;
+	DWORD cConcordsPerInstrument = (cConcords + g_cInstruments - 1) / g_cInstruments;
+
+	DWORD ctTime = 0;
+	DWORD ctEnd = 0;
+	DWORD cNotesLeft = g_cNotes;
+
+	for (DWORD iConcord = 0; iConcord < cConcords; iConcord++)
+	{
+		if (iConcord % cConcordsPerInstrument == 0)
+		{
+			if (!AddChannelEvent(iTrack, ctTime, ORDER_PROGRAM_CHANGE, ProgramChange,
+				(BYTE) Random(MAX_MIDI_INSTRUMENTS), 0))
+			{
+				return false;
+			}
+		}
+
+		DWORD ctDuration = g_Division << Random(3);
+		DWORD ctNextTime = ctTime + ctDuration;
+
+		DWORD ctNoteOff = RandomPercent(g_OverlapPercent) ?
+			ctNextTime + g_Division / 2 : ctNextTime;
+
+		DWORD cConcordNotes = (cNotesLeft < g_Polyphony) ? cNotesLeft : g_Polyphony;
+		DWORD BaseNoteNumber = 36 + Random(24);
+
+		for (DWORD iNote = 0; iNote < cConcordNotes; iNote++)
+		{
+			BYTE NoteNumber = (BYTE) ((BaseNoteNumber + iNote * 4) % 128);
+
+			if (!AddChannelEvent(iTrack, ctTime, ORDER_NOTE_ON, NoteOn, NoteNumber, 80))
+			{
+				return false;
+			}
+
+			if (!AddChannelEvent(iTrack, ctNoteOff, ORDER_NOTE_OFF, NoteOff, NoteNumber,
+				0))
+			{
+				return false;
+			}
+		}
+
+		cNotesLeft -= cConcordNotes;
+
+		if (ctNoteOff > ctEnd) ctEnd = ctNoteOff;
+
+		ctTime = ctNextTime;
+	}
+
+	*pctEnd = ctEnd;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GenerateHeldNotes
+*
+*   
+*       iTrack -  ,    
+*       ctEnd -        
+*
+*    
+*       true,    ; false,     .
+*
+*    g_cHeldNotes ,       .  
+*     ,   g_cHeldNotes > 128     
+*      ,   .
+*
+****************************************************************************************/
+
+static bool GenerateHeldNotes(
+	__in DWORD iTrack,
+	__in DWORD ctEnd)
+{
+	BYTE NoteOn = (BYTE) (NOTE_ON | HELD_NOTES_CHANNEL);
+	BYTE NoteOff = (BYTE) (NOTE_OFF | HELD_NOTES_CHANNEL);
+
+	for (DWORD iNote = 0; iNote < g_cHeldNotes; iNote++)
+	{
+		BYTE NoteNumber = (BYTE) (iNote % 128);
+
+		if (!AddChannelEvent(iTrack, 0, ORDER_NOTE_ON, NoteOn, NoteNumber, 60) ||
+			!AddChannelEvent(iTrack, ctEnd, ORDER_NOTE_OFF, NoteOff, NoteNumber, 0))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GenerateConductorEvents
+*
+*   
+*       iTrack -  ,    
+*       ctEnd -         
+*
+*    
+*       true,    ; false,     .
+*
+*     ,    , g_cTempoChanges   
+*      g_cTimeSignatureChanges     .
+*
+****************************************************************************************/
+
+static bool GenerateConductorEvents(
+	__in DWORD iTrack,
+	__in DWORD ctEnd)
+{
+	static const BYTE Title[] = "Singoscope test song";
+
+	if (!AddMetaEvent(iTrack, 0, ORDER_CONDUCTOR, SEQUENCE_OR_TRACK_NAME, Title,
+		sizeof(Title) - 1))
+	{
+		return false;
+	}
+
+	//        ( )
+	for (DWORD i = 0; i <= g_cTempoChanges; i++)
+	{
+		DWORD ctTime = (i == 0) ? 0 : Random(ctEnd + 1);
+		DWORD Tempo = 300000 + Random(600000);
+
+		BYTE Data[3] = {(BYTE) (Tempo >> 16), (BYTE) (Tempo >> 8), (BYTE) Tempo};
+
+		if (!AddMetaEvent(iTrack, ctTime, ORDER_CONDUCTOR, SET_TEMPO, Data, 3))
+		{
+			return false;
+		}
+	}
+
+	//   ,   ,  MIDI-
+	//     32-    
+	BYTE Data[4] = {4, 2, 24, 8};
+
+	//         
+	DWORD ctTime = 0;
+
+	//      
+	DWORD ctStep = ctEnd / (g_cTimeSignatureChanges + 1);
+
+	for (DWORD i = 0; i <= g_cTimeSignatureChanges; i++)
+	{
+		if (i != 0)
+		{
+			//      
+			DWORD ctMeasure = g_Division * 4 * Data[0] >> Data[1];
+
+			//    ,     
+			DWORD cMeasures = (ctStep + ctMeasure / 2) / ctMeasure;
+			ctTime += ((cMeasures != 0) ? cMeasures : 1) * ctMeasure;
+
+			if (ctTime > ctEnd) break;
+
+			static const BYTE Numerators[] = {2, 3, 4, 5, 6, 7, 9, 12};
+
+			Data[0] = Numerators[Random(sizeof(Numerators))];
+			Data[1] = (BYTE) (1 + Random(3));
+		}
+
+		if (!AddMetaEvent(iTrack, ctTime, ORDER_CONDUCTOR, TIME_SIGNATURE, Data, 4))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    AddEvent
+*
+*   
+*       iTrack -  ,    
+*       ctTime -       
+*       Order -       
+*       pData -    ,    
+*       cbData -   ;   MAX_EVENT_DATA_SIZE
+*
+*    
+*       true,    ; false,     .
+*
+*         .
+*
+****************************************************************************************/
+
+static bool AddEvent(
+	__in DWORD iTrack,
+	__in DWORD ctTime,
+	__in EVENTORDER Order,
+	__in_bcount(cbData) const BYTE *pData,
+	__in DWORD cbData)
+{
+	//   ,       
+	if (g_cEvents == g_cMaxEvents)
+	{
+		DWORD cNewMaxEvents = (g_cMaxEvents == 0) ? INITIAL_EVENT_ARRAY_SIZE :
+			g_cMaxEvents * 2;
+
+		EVENT *pNewEvents;
+
+		if (g_pEvents == NULL)
+		{
+			pNewEvents = (EVENT *) HeapAlloc(GetProcessHeap(), 0,
+				cNewMaxEvents * sizeof(EVENT));
+		}
+		else
+		{
+			pNewEvents = (EVENT *) HeapReAlloc(GetProcessHeap(), 0, g_pEvents,
+				cNewMaxEvents * sizeof(EVENT));
+		}
+
+		if (pNewEvents == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return false;
+		}
+
+		g_pEvents = pNewEvents;
+		g_cMaxEvents = cNewMaxEvents;
+	}
+
+	EVENT *pEvent = &g_pEvents[g_cEvents];
+
+	pEvent->iTrack = iTrack;
+	pEvent->ctTime = ctTime;
+	pEvent->Order = Order;
+	pEvent->iEvent = g_cEvents;
+	pEvent->cbData = cbData;
+
+	CopyMemory(pEvent->Data, pData, cbData);
+
+	g_cEvents++;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    AddChannelEvent
+*
+*   
+*       iTrack -  ,    
+*       ctTime -       
+*       Order -       
+*       Status -   
+*       Data1 -    
+*       Data2 -    ;  ,     
+*               
+*
+*    
+*       true,    ; false,     .
+*
+*          .
+*
+****************************************************************************************/
+
+static bool AddChannelEvent(
+	__in DWORD iTrack,
+	__in DWORD ctTime,
+	__in EVENTORDER Order,
+	__in BYTE Status,
+	__in BYTE Data1,
+	__in BYTE Data2)
+{
+	BYTE Data[3] = {Status, Data1, Data2};
+
+	DWORD cbData = ((Status & 0xF0) == PROGRAM_CHANGE ||
+		(Status & 0xF0) == CHANNEL_AFTER_TOUCH) ? 2 : 3;
+
+	return AddEvent(iTrack, ctTime, Order, Data, cbData);
+}
+
+/****************************************************************************************
+*
+*    AddMetaEvent
+*
+*   
+*       iTrack -  ,    
+*       ctTime -       
+*       Order -       
+*       Type -  
+*       pData -    
+*       cbData -    ;   MAX_EVENT_DATA_SIZE - 3
+*
+*    
+*       true,    ; false,     .
+*
+*         .
+*
+****************************************************************************************/
+
+static bool AddMetaEvent(
+	__in DWORD iTrack,
+	__in DWORD ctTime,
+	__in EVENTORDER Order,
+	__in BYTE Type,
+	__in_bcount(cbData) const BYTE *pData,
+	__in DWORD cbData)
+{
+	BYTE Data[MAX_EVENT_DATA_SIZE];
+
+	//      128     
+	Data[0] = 0xFF;
+	Data[1] = Type;
+	Data[2] = (BYTE) cbData;
+
+	CopyMemory(Data + 3, pData, cbData);
+
+	return AddEvent(iTrack, ctTime, Order, Data, cbData + 3);
+}
+
+/****************************************************************************************
+*
+*    WriteFileImage
+*
+*   
+*       pszFileName -   ,  ,    
+*                      
+*       cTracks -    
+*
+*    
+*       true,    ;  false.
+*
+*          ,  
+*   MIDI-     .   runningstatus  , 
+*       ,     
+*       ;    .
+*
+****************************************************************************************/
+
+static bool WriteFileImage(
+	__in LPCTSTR pszFileName,
+	__in DWORD cTracks)
+{
+	qsort(g_pEvents, g_cEvents, sizeof(EVENT), CompareEvents);
+
+	//     :  ,    
+	// END_OF_TRACK,     - - (   ) 
+	//  
+	DWORD cbMaxImage = 14 + cTracks * (8 + 4);
+
+	for (DWORD i = 0; i < g_cEvents; i++) cbMaxImage += 5 + g_pEvents[i].cbData;
+
+	BYTE *pImage = (BYTE *) HeapAlloc(GetProcessHeap(), 0, cbMaxImage);
+
+	if (pImage == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		return false;
+	}
+
+	//  
+	BYTE *pCurByte = pImage;
+
+	CopyMemory(pCurByte, "MThd", 4);
+	pCurByte = PutBigEndian(pCurByte + 4, 6, 4);
+	pCurByte = PutBigEndian(pCurByte, g_Format, 2);
+	pCurByte = PutBigEndian(pCurByte, cTracks, 2);
+	pCurByte = PutBigEndian(pCurByte, g_Division, 2);
+
+	DWORD iEvent = 0;
+
+	for (DWORD iTrack = 0; iTrack < cTracks; iTrack++)
+	{
+		//  ;       
+		CopyMemory(pCurByte, "MTrk", 4);
+		BYTE *pTrackSize = pCurByte + 4;
+		BYTE *pFirstTrackByte = pCurByte + 8;
+
+		pCurByte = pFirstTrackByte;
+
+		DWORD ctPrevTime = 0;
+		BYTE RunningStatus = 0;
+
+		for (; iEvent < g_cEvents && g_pEvents[iEvent].iTrack == iTrack; iEvent++)
+		{
+			EVENT *pEvent = &g_pEvents[iEvent];
+
+			pCurByte = PutVLQ(pCurByte, pEvent->ctTime - ctPrevTime);
+			ctPrevTime = pEvent->ctTime;
+
+			BYTE *pData = pEvent->Data;
+			DWORD cbData = pEvent->cbData;
+
+			if (pData[0] == 0xFF)
+			{
+				RunningStatus = 0;
+			}
+			else if (g_bUseRunningStatus)
+			{
+				if (pData[0] == RunningStatus)
+				{
+					pData++;
+					cbData--;
+				}
+				else
+				{
+					RunningStatus = pData[0];
+				}
+			}
+
+			CopyMemory(pCurByte, pData, cbData);
+			pCurByte += cbData;
+		}
+
+		//  END_OF_TRACK
+		static const BYTE EndOfTrack[] = {0x00, 0xFF, END_OF_TRACK, 0x00};
+
+		CopyMemory(pCurByte, EndOfTrack, sizeof(EndOfTrack));
+		pCurByte += sizeof(EndOfTrack);
+
+		PutBigEndian(pTrackSize, (DWORD) (pCurByte - pFirstTrackByte), 4);
+	}
+
+	DWORD cbImage = (DWORD) (pCurByte - pImage);
+
+	HANDLE hFile = CreateFile(pszFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		LOG("CreateFile failed (error %u)\n", GetLastError());
+		HeapFree(GetProcessHeap(), 0, pImage);
+		return false;
+	}
+
+	DWORD cbWritten;
+
+	bool bResult = WriteFile(hFile, pImage, cbImage, &cbWritten, NULL) &&
+		cbWritten == cbImage;
+
+	if (!bResult) LOG("WriteFile failed (error %u)\n", GetLastError());
+
+	CloseHandle(hFile);
+
+	HeapFree(GetProcessHeap(), 0, pImage);
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    PutVLQ
+*
+*   
+*       pCurByte -   ,    
+*       dwValue -  ;  0x10000000
+*
+*    
+*         ,    .
+*
+*          (VLQ).
+*
+****************************************************************************************/
+
+static BYTE *PutVLQ(
+	__out BYTE *pCurByte,
+	__in DWORD dwValue)
+{
+	//     ,  
+	DWORD cGroups = 0;
+
+	while (cGroups < 3 && (dwValue >> (7 * (cGroups + 1))) != 0) cGroups++;
+
+	for (; cGroups > 0; cGroups--)
+	{
+		*pCurByte++ = (BYTE) (0x80 | ((dwValue >> (7 * cGroups)) & 0x7F));
+	}
+
+	*pCurByte++ = (BYTE) (dwValue & 0x7F);
+
+	return pCurByte;
+}
+
+/****************************************************************************************
+*
+*    PutBigEndian
+*
+*   
+*       pCurByte -   ,    
+*       dwValue -  
+*       cbValue -  ,   
+*
+*    
+*         ,    .
+*
+*    ,     (    
+*   MIDI-).
+*
+****************************************************************************************/
+
+static BYTE *PutBigEndian(
+	__out BYTE *pCurByte,
+	__in DWORD dwValue,
+	__in DWORD cbValue)
+{
+	for (DWORD i = cbValue; i > 0; i--)
+	{
+		*pCurByte++ = (BYTE) (dwValue >> (8 * (i - 1)));
+	}
+
+	return pCurByte;
+}
+
+/****************************************************************************************
+*
+*    CompareEvents
+*
+*   .   compare    qsort  MSDN.
+*
+*       ,    ,  
+*        ,     ,  
+*           qsort.
+*
+****************************************************************************************/
+
+static int __cdecl CompareEvents(
+	const void *pEvent1,
+	const void *pEvent2)
+{
+	const EVENT *pFirst = (const EVENT *) pEvent1;
+	const EVENT *pSecond = (const EVENT *) pEvent2;
+
+	if (pFirst->iTrack != pSecond->iTrack)
+	{
+		return (pFirst->iTrack < pSecond->iTrack) ? -1 : 1;
+	}
+
+	if (pFirst->ctTime != pSecond->ctTime)
+	{
+		return (pFirst->ctTime < pSecond->ctTime) ? -1 : 1;
+	}
+
+	if (pFirst->Order != pSecond->Order)
+	{
+		return (pFirst->Order < pSecond->Order) ? -1 : 1;
+	}
+
+	if (pFirst->iEvent != pSecond->iEvent)
+	{
+		return (pFirst->iEvent < pSecond->iEvent) ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    Random
+*
+*   
+*       Range -   ;  
+*
+*    
+*          0  Range - 1.
+*
+*      xorshift.     rand,   
+*           C.
+*
+****************************************************************************************/
+
+static DWORD Random(
+	__in DWORD Range)
+{
+	DWORD x = g_RandomState;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	g_RandomState = x;
+
+	return x % Range;
+}
+
+/****************************************************************************************
+*
+*    RandomPercent
+*
+*   
+*       Percent -   
+*
+*    
+*       true   Percent ;  false.
+*
+****************************************************************************************/
+
+static bool RandomPercent(
+	__in DWORD Percent)
+{
+	return Random(100) < Percent;
+}
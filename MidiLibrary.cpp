@@ -10,6 +10,27 @@
 
 #include <windows.h>
 
+#include "MidiLibrary.h"
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+const BYTE g_cbChannelEventData[16] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0,
+	2,	// NOTE_OFF
+	2,	// NOTE_ON
+	2,	// KEY_AFTER_TOUCH
+	2,	// CONTROL_CHANGE
+	1,	// PROGRAM_CHANGE
+	1,	// CHANNEL_AFTER_TOUCH
+	2,	// PITCH_WHEEL_CHANGE
+	0
+};
+
 /****************************************************************************************
 *
 *    GetNumberFromVLQ
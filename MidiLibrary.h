@@ -20,6 +20,58 @@
 //   MIDI-,     
 #define MAX_MIDI_INSTRUMENTS			128
 
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//     MIDI-     
+//  ;  PROGRAM_CHANGE  CHANNEL_AFTER_TOUCH   
+// ,    - 
+extern const BYTE g_cbChannelEventData[16];
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//    ,     pLastByte;  false,
+//      ; ,    ,
+//    ( ,   GetNumberFromVLQ)
+inline bool ReadVLQ(BYTE **ppCurByte, BYTE *pLastByte, DWORD *pdwValue)
+{
+	BYTE *pCurByte = *ppCurByte;
+
+	if (pCurByte > pLastByte) return false;
+
+	//        (-   
+	// )   
+	if (!(*pCurByte & 0x80))
+	{
+		*pdwValue = *pCurByte;
+		*ppCurByte = pCurByte + 1;
+		return true;
+	}
+
+	DWORD dwValue = 0;
+	BYTE *pFirstByte = pCurByte;
+
+	do
+	{
+		if (pCurByte > pLastByte) return false;
+
+		dwValue = (dwValue << 7) + (*pCurByte & 0x7F);
+	}
+	while (*pCurByte++ & 0x80);
+
+	*pdwValue = (pCurByte - pFirstByte <= 4) ? dwValue : 0;
+	*ppCurByte = pCurByte;
+
+	return true;
+}
+
 /****************************************************************************************
 *
 *    GetNumberFromVLQ
@@ -3,7 +3,9 @@
 *     MidiLyric
 *
 *           MIDI- 
-*      LYRIC  TEXT_EVENT.
+*      LYRIC  TEXT_EVENT.  
+*        ,        
+*     .
 *
 *   :     , 2008-2010
 *
@@ -35,6 +37,12 @@
 MidiLyric::MidiLyric()
 {
 	m_pMidiTrack = NULL;
+
+	m_pctEventTimes = NULL;
+	m_piEventTexts = NULL;
+	m_pwsTexts = NULL;
+	m_cEvents = 0;
+	m_cMaxEvents = 0;
 }
 
 /****************************************************************************************
@@ -47,18 +55,19 @@ MidiLyric::MidiLyric()
 *    
 *       
 *
-*     .  ,     MidiTrack,  
-*     InitSearch.
+*    ,    .   MidiTrack,
+*       Decode,  .
 *
 ****************************************************************************************/
 
 MidiLyric::~MidiLyric()
 {
+	FreeEventTable();
 }
 
 /****************************************************************************************
 *
-*    InitSearch
+*    Decode
 *
 *   
 *       pMidiTrack -     MidiTrack,   
@@ -71,26 +80,222 @@ MidiLyric::~MidiLyric()
 *                          
 *
 *    
-*       
+*       MIDILYRIC_SUCCESS -    ;
+*       MIDILYRIC_CANT_ALLOC_MEMORY -    .
+*
+*     ,   pMidiTrack,    
+*   LyricEventType (.  GetNextValidEvent)      
+*        ,    . ,
+*       ,  .    
+*    :      GetEvent.
+*
+*   
 *
-*          ,  
-*   pMidiTrack.  ,   ,   LyricEventType.
+*      ,    LyricEventType,  
+*        MAX_SYMBOLS_PER_LYRIC_EVENT .  
+*             ,
+*            .  ,  
+*    , ,   .
 *
 ****************************************************************************************/
 
-void MidiLyric::InitSearch(
+MIDILYRICRESULT MidiLyric::Decode(
 	__in MidiTrack *pMidiTrack,
 	__in DWORD LyricEventType,
 	__in UINT DefaultCodePage)
 {
 	m_pMidiTrack = pMidiTrack;
-	m_pMidiTrack->ResetCurrentPosition();
+	m_iCurEvent = 0;
 
 	m_LyricEventType = LyricEventType;
 
 	m_CodePage = DefaultCodePage;
 
 	m_ctCurTime = 0;
+
+	m_cEvents = 0;
+
+	//    LyricEventType
+	DWORD cLyricEvents = 0;
+
+	DWORD cTrackEvents = pMidiTrack->GetEventCount();
+
+	for (DWORD iEvent = 0; iEvent < cTrackEvents; iEvent++)
+	{
+		BYTE *pEventData;
+
+		if (pMidiTrack->GetEvent(iEvent, NULL, &pEventData) == LyricEventType)
+		{
+			cLyricEvents++;
+		}
+	}
+
+	//      ,   
+	if (cLyricEvents == 0) return MIDILYRIC_SUCCESS;
+
+	if (cLyricEvents > m_cMaxEvents)
+	{
+		// ,  ,  ;   
+
+		FreeEventTable();
+
+		m_pctEventTimes = (DWORD *) HeapAlloc(GetProcessHeap(), 0,
+			cLyricEvents * sizeof(DWORD));
+
+		m_piEventTexts = (DWORD *) HeapAlloc(GetProcessHeap(), 0,
+			(cLyricEvents + 1) * sizeof(DWORD));
+
+		m_pwsTexts = (WCHAR *) HeapAlloc(GetProcessHeap(), 0,
+			cLyricEvents * MAX_SYMBOLS_PER_LYRIC_EVENT * sizeof(WCHAR));
+
+		if (m_pctEventTimes == NULL || m_piEventTexts == NULL || m_pwsTexts == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			FreeEventTable();
+			return MIDILYRIC_CANT_ALLOC_MEMORY;
+		}
+
+		m_cMaxEvents = cLyricEvents;
+	}
+
+	//    m_pwsTexts,       
+	// 
+	DWORD iText = 0;
+
+	m_piEventTexts[0] = 0;
+
+	//      
+	while (true)
+	{
+		//       
+		DWORD cchEventText;
+
+		//       
+		MIDILYRICRESULT LyricRes = GetNextValidEvent(&m_pctEventTimes[m_cEvents],
+			m_pwsTexts + iText, &cchEventText);
+
+		if (LyricRes == MIDILYRIC_LYRIC_END) break;
+
+		iText += cchEventText;
+
+		m_cEvents++;
+		m_piEventTexts[m_cEvents] = iText;
+	}
+
+	return MIDILYRIC_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    GetEventCount
+*
+*   
+*       
+*
+*    
+*           .
+*
+*      ,     
+*   Decode.
+*
+****************************************************************************************/
+
+DWORD MidiLyric::GetEventCount()
+{
+	return m_cEvents;
+}
+
+/****************************************************************************************
+*
+*    GetMemorySize
+*
+*   
+*       
+*
+*    
+*            .
+*
+*     ,     . 
+*       ,    
+*    ,    .
+*
+****************************************************************************************/
+
+DWORD MidiLyric::GetMemorySize()
+{
+	if (m_cMaxEvents == 0) return 0;
+
+	return m_cMaxEvents * sizeof(DWORD) + (m_cMaxEvents + 1) * sizeof(DWORD) +
+		m_cMaxEvents * MAX_SYMBOLS_PER_LYRIC_EVENT * sizeof(WCHAR);
+}
+
+/****************************************************************************************
+*
+*    GetSymbolCount
+*
+*   
+*       
+*
+*    
+*              .
+*
+*           ,
+*        Decode.
+*
+****************************************************************************************/
+
+DWORD MidiLyric::GetSymbolCount()
+{
+	if (m_cEvents == 0) return 0;
+
+	return m_piEventTexts[m_cEvents];
+}
+
+/****************************************************************************************
+*
+*    GetEvent
+*
+*   
+*       iEvent -    
+*       pctEventTime -   ,     
+*                      ,        ;
+*                           NULL
+*       ppwsText -   ,       
+*                     ;    
+*                         
+*                  Decode    ;     
+*                  NULL
+*       pcchText -   ,     
+*                     
+*
+*    
+*       MIDILYRIC_SUCCESS -   ;
+*       MIDILYRIC_LYRIC_END -  iEvent      
+*                             ,     ,  
+*                               pctEventTime, ppwsText  pcchText, 
+*                             .
+*
+*        iEvent  , 
+*    Decode.          
+*    MAX_SYMBOLS_PER_LYRIC_EVENT.
+*
+****************************************************************************************/
+
+MIDILYRICRESULT MidiLyric::GetEvent(
+	__in DWORD iEvent,
+	__out_opt DWORD *pctEventTime,
+	__out_opt LPCWSTR *ppwsText,
+	__out DWORD *pcchText)
+{
+	if (iEvent >= m_cEvents) return MIDILYRIC_LYRIC_END;
+
+	if (pctEventTime != NULL) *pctEventTime = m_pctEventTimes[iEvent];
+
+	if (ppwsText != NULL) *ppwsText = m_pwsTexts + m_piEventTexts[iEvent];
+
+	*pcchText = m_piEventTexts[iEvent + 1] - m_piEventTexts[iEvent];
+
+	return MIDILYRIC_SUCCESS;
 }
 
 /****************************************************************************************
@@ -114,8 +319,8 @@ void MidiLyric::InitSearch(
 *                             pctEventTime, pwsBuffer  pcchReturned,  .
 *
 *         ,  
-*    .    InitSearch     
-*       .     
+*    .       Decode  
+*        .     
 *   , ..     ,   
 *    pcchReturned,   .   pwsBuffer  NULL, 
 *      ,       
@@ -225,20 +430,17 @@ MIDILYRICRESULT MidiLyric::GetNextPreprocessedEvent(
 	// 
 	while (true)
 	{
-		// -   
-		DWORD ctDeltaTime;
-
 		//      
 		BYTE *pEventData;
 
 		//    
-		DWORD Event = m_pMidiTrack->GetNextEvent(&ctDeltaTime, &pEventData);
+		DWORD Event = m_pMidiTrack->GetEvent(m_iCurEvent, &m_ctCurTime, &pEventData);
 
 		//       , 
 		if (Event == REAL_TRACK_END) return MIDILYRIC_LYRIC_END;
 
-		//    (  ,    )
-		m_ctCurTime += ctDeltaTime;
+		//    
+		m_iCurEvent++;
 
 		//   ,    m_LyricEventType
 		if (Event != m_LyricEventType) continue;
@@ -272,3 +474,41 @@ MIDILYRICRESULT MidiLyric::GetNextPreprocessedEvent(
 		return MIDILYRIC_SUCCESS;
 	}
 }
+
+/****************************************************************************************
+*
+*    FreeEventTable
+*
+*   
+*       
+*
+*    
+*       
+*
+*    ,    .
+*
+****************************************************************************************/
+
+void MidiLyric::FreeEventTable()
+{
+	if (m_pctEventTimes != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pctEventTimes);
+		m_pctEventTimes = NULL;
+	}
+
+	if (m_piEventTexts != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_piEventTexts);
+		m_piEventTexts = NULL;
+	}
+
+	if (m_pwsTexts != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pwsTexts);
+		m_pwsTexts = NULL;
+	}
+
+	m_cEvents = 0;
+	m_cMaxEvents = 0;
+}
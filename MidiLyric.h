@@ -3,7 +3,9 @@
 *     MidiLyric
 *
 *           MIDI- 
-*      LYRIC  TEXT_EVENT.
+*      LYRIC  TEXT_EVENT.  
+*        ,        
+*     .
 *
 *   :     , 2008-2010
 *
@@ -24,7 +26,8 @@
 enum MIDILYRICRESULT
 {
 	MIDILYRIC_SUCCESS,
-	MIDILYRIC_LYRIC_END
+	MIDILYRIC_LYRIC_END,
+	MIDILYRIC_CANT_ALLOC_MEMORY
 };
 
 /****************************************************************************************
@@ -36,7 +39,7 @@ enum MIDILYRICRESULT
 class MidiLyric
 {
 	//     MidiTrack,    MIDI-,
-	//     
+	//     ;     
 	MidiTrack *m_pMidiTrack;
 
 	//  ,      (LYRIC  TEXT_EVENT)
@@ -45,31 +48,70 @@ class MidiLyric
 	//   
 	UINT m_CodePage;
 
+	//       
+	DWORD m_iCurEvent;
+
 	//   (  ,    )
 	DWORD m_ctCurTime;
 
+	//      (    )
+	DWORD *m_pctEventTimes;
+
+	//         
+	// m_pwsTexts;     ,   ,  
+	//     i    i + 1  i
+	DWORD *m_piEventTexts;
+
+	// ,        
+	WCHAR *m_pwsTexts;
+
+	//     
+	DWORD m_cEvents;
+
+	//  ,       
+	DWORD m_cMaxEvents;
+
 public:
 
 	MidiLyric();
 	~MidiLyric();
 
-	//         
-	void InitSearch(
+	//           
+	MIDILYRICRESULT Decode(
 		__in MidiTrack *pMidiTrack,
 		__in DWORD LyricEventType,
 		__in UINT DefaultCodePage);
 
+	//      
+	DWORD GetEventCount();
+
+	//        
+	DWORD GetSymbolCount();
+
+	//   ,    
+	DWORD GetMemorySize();
+
+	//      
+	MIDILYRICRESULT GetEvent(
+		__in DWORD iEvent,
+		__out_opt DWORD *pctEventTime,
+		__out_opt LPCWSTR *ppwsText,
+		__out DWORD *pcchText);
+
+private:
+
 	//         
 	MIDILYRICRESULT GetNextValidEvent(
 		__out_opt DWORD *pctEventTime,
 		__out_opt WCHAR pwsBuffer[MAX_SYMBOLS_PER_LYRIC_EVENT],
 		__out DWORD	*pcchReturned);
 
-private:
-
 	//        
 	MIDILYRICRESULT GetNextPreprocessedEvent(
 		__out LPWSTR pwsBuffer,
 		__in DWORD cchBuffer,
 		__out DWORD	*pcchReturned);
+
+	//  ,    
+	void FreeEventTable();
 };
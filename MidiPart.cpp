@@ -50,6 +50,8 @@ MidiPart::MidiPart()
 {
 	m_pMidiTrack = NULL;
 	m_pNoteList = NULL;
+	m_pNotePool = NULL;
+	m_pFreeNotes = NULL;
 }
 
 /****************************************************************************************
@@ -62,14 +64,19 @@ MidiPart::MidiPart()
 *    
 *       
 *
-*        .     MidiTrack,
+*       .     MidiTrack,
 *       InitSearch.
 *
 ****************************************************************************************/
 
 MidiPart::~MidiPart()
 {
-	FreeNoteList();
+	while (m_pNotePool != NULL)
+	{
+		NOTEPOOLBLOCK *pBlock = m_pNotePool;
+		m_pNotePool = pBlock->pNext;
+		HeapFree(GetProcessHeap(), 0, pBlock);
+	}
 }
 
 /****************************************************************************************
@@ -110,13 +117,13 @@ void MidiPart::InitSearch(
 	__in double OverlapsThreshold,
 	__in CONCORD_NOTE_CHOICE ConcordNoteChoice)
 {
-	//        ,   
-	//    
+	//        ,   
+	//       
 	FreeNoteList();
 
 	m_pMidiTrack = pMidiTrack;
 
-	m_pMidiTrack->ResetCurrentPosition();
+	m_iCurEvent = 0;
 
 	m_PartChannel = Channel;
 	m_PartInstrument = Instrument;
@@ -153,7 +160,7 @@ void MidiPart::InitSearch(
 *                                                ;
 *		MIDIPART_OVERLAPS_THRESHOLD_EXCEEDED -     
 *                                                    
-*                                                  
+*                                                  .
 *
 *         .   
 *   InitSearch      .     ,
@@ -473,13 +480,13 @@ MIDIPARTRESULT MidiPart::GetNextNote(
 				{
 					//   - ,  
 					m_pNoteList = pSecondNote;
-					delete pFirstNote;
+					FreeNote(pFirstNote);
 				}
 				else
 				{
 					//   - ,  
 					pFirstNote->pNext = pThirdNote;
-					delete pSecondNote;
+					FreeNote(pSecondNote);
 				}
 
 				//      ,  ;
@@ -610,6 +617,48 @@ MIDIPARTRESULT MidiPart::GetNextNote(
 	}
 }
 
+/****************************************************************************************
+*
+*    GetSingleNotesCount
+*
+*   
+*       
+*
+*    
+*         ,    .
+*
+*      ,   GetNextNote   
+*     InitSearch.
+*
+****************************************************************************************/
+
+DWORD MidiPart::GetSingleNotesCount()
+{
+	return m_cSingleNotes;
+}
+
+/****************************************************************************************
+*
+*    GetOverlapsCount
+*
+*   
+*       
+*
+*    
+*              .
+*
+*         (  ), 
+*    GetNextNote     InitSearch.   
+*   GetSingleNotesCount       
+*   ,  ,    InitSearch.
+*
+****************************************************************************************/
+
+DWORD MidiPart::GetOverlapsCount()
+{
+	return m_cOverlaps;
+}
+
 /****************************************************************************************
 *
 *    ReadNextEvent
@@ -633,10 +682,11 @@ MIDIPARTRESULT MidiPart::GetNextNote(
 *       READEVENT_PART_END -  ;       ,
 *                                       
 *                                READEVENT_EMPTY_NOTE;
-*       READEVENT_CANT_ALLOC_MEMORY -       .
+*       READEVENT_CANT_ALLOC_MEMORY -       
+*                                     .
 *
 *          ,  :
-*   1)  m_ctCurTime,
+*   1)  m_iCurEvent  m_ctCurTime,
 *   2)  m_CurInstrument,
 *   3)  m_pNoteList.
 *
@@ -661,8 +711,8 @@ MIDIPARTRESULT MidiPart::GetNextNote(
 
 MidiPart::READEVENTRESULT MidiPart::ReadNextEvent()
 {
-	// -   
-	DWORD ctEventDeltaTime;
+	//    ,    
+	DWORD ctEventTime;
 
 	//      
 	BYTE *pEventData;
@@ -671,7 +721,7 @@ MidiPart::READEVENTRESULT MidiPart::ReadNextEvent()
 	DWORD EventChannel;
 
 	//    
-	DWORD Event = m_pMidiTrack->GetNextEvent(&ctEventDeltaTime, &pEventData,
+	DWORD Event = m_pMidiTrack->GetEvent(m_iCurEvent, &ctEventTime, &pEventData,
 		&EventChannel);
 
 	if (Event == REAL_TRACK_END)
@@ -694,7 +744,7 @@ MidiPart::READEVENTRESULT MidiPart::ReadNextEvent()
 					if (pPrevNote == NULL) m_pNoteList = pCurNote->pNext;
 					else pPrevNote->pNext = pCurNote->pNext;
 
-					delete pCurNote;
+					FreeNote(pCurNote);
 
 					return READEVENT_EMPTY_NOTE;
 				}
@@ -709,8 +759,10 @@ MidiPart::READEVENTRESULT MidiPart::ReadNextEvent()
 		return READEVENT_PART_END;
 	}
 
-	//    (  ,    )
-	m_ctCurTime += ctEventDeltaTime;
+	//         (  ,
+	//    )
+	m_iCurEvent++;
+	m_ctCurTime = ctEventTime;
 
 	//    SysEx-
 	if (Event <= 0x7F || Event >= 0xF0)
@@ -759,10 +811,11 @@ MidiPart::READEVENTRESULT MidiPart::ReadNextEvent()
 		}
 
 		//      m_pNoteList
-		NOTELISTITEM *pNewItem = new NOTELISTITEM;
+		NOTELISTITEM *pNewItem = AllocNote();
+
 		if (pNewItem == NULL)
 		{
-			LOG("operator new failed\n");
+			LOG("MidiPart::AllocNote failed\n");
 			return READEVENT_CANT_ALLOC_MEMORY;
 		}
 
@@ -810,7 +863,7 @@ MidiPart::READEVENTRESULT MidiPart::ReadNextEvent()
 					if (pCurNote == m_pNoteList) m_pNoteList = pCurNote->pNext;
 					else pPrevNote->pNext = pCurNote->pNext;
 
-					delete pCurNote;
+					FreeNote(pCurNote);
 
 					return READEVENT_EMPTY_NOTE;
 				}
@@ -859,7 +912,7 @@ void MidiPart::ReturnFirstNote(
 
 	m_pNoteList = m_pNoteList->pNext;
 
-	delete pDelNote;
+	FreeNote(pDelNote);
 }
 
 /****************************************************************************************
@@ -925,12 +978,83 @@ void MidiPart::ReturnNoteFromConcord(
 
 		pCurNote = pCurNote->pNext;
 
-		delete pDelNote;
+		FreeNote(pDelNote);
 	}
 
 	m_pNoteList = pCurNote;
 }
 
+/****************************************************************************************
+*
+*    AllocNote
+*
+*   
+*       
+*
+*    
+*              NULL,    
+*       .
+*
+*         m_pFreeNotes.   
+*   ,      NOTE_POOL_BLOCK_SIZE ,   
+*     m_pNotePool        .
+*           ,   
+*           .
+*
+****************************************************************************************/
+
+MidiPart::NOTELISTITEM *MidiPart::AllocNote()
+{
+	if (m_pFreeNotes == NULL)
+	{
+		NOTEPOOLBLOCK *pBlock = (NOTEPOOLBLOCK *) HeapAlloc(GetProcessHeap(), 0,
+			sizeof(NOTEPOOLBLOCK));
+
+		if (pBlock == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return NULL;
+		}
+
+		pBlock->pNext = m_pNotePool;
+		m_pNotePool = pBlock;
+
+		for (DWORD i = 0; i < NOTE_POOL_BLOCK_SIZE - 1; i++)
+		{
+			pBlock->Items[i].pNext = &pBlock->Items[i + 1];
+		}
+
+		pBlock->Items[NOTE_POOL_BLOCK_SIZE - 1].pNext = NULL;
+		m_pFreeNotes = pBlock->Items;
+	}
+
+	NOTELISTITEM *pNote = m_pFreeNotes;
+	m_pFreeNotes = pNote->pNext;
+
+	return pNote;
+}
+
+/****************************************************************************************
+*
+*    FreeNote
+*
+*   
+*       pNote -     m_pNotePool,     
+*
+*    
+*       
+*
+*           m_pFreeNotes.
+*
+****************************************************************************************/
+
+void MidiPart::FreeNote(
+	__in NOTELISTITEM *pNote)
+{
+	pNote->pNext = m_pFreeNotes;
+	m_pFreeNotes = pNote;
+}
+
 /****************************************************************************************
 *
 *    FreeNoteList
@@ -941,7 +1065,8 @@ void MidiPart::ReturnNoteFromConcord(
 *    
 *       
 *
-*    ,    ,    m_pNoteList.
+*       ,    m_pNoteList,  
+*     m_pFreeNotes.
 *
 ****************************************************************************************/
 
@@ -953,7 +1078,7 @@ void MidiPart::FreeNoteList()
 	{
 		NOTELISTITEM *pDelNote = pListHead;
 		pListHead = pListHead->pNext;
-		delete pDelNote;
+		FreeNote(pDelNote);
 	}
 
 	m_pNoteList = NULL;
@@ -24,6 +24,9 @@
 //    Instrument  InitSearch
 #define ANY_INSTRUMENT		0xFFFFFFFF
 
+//       ,    MidiPart
+#define NOTE_POOL_BLOCK_SIZE	128
+
 //     
 enum CONCORD_NOTE_CHOICE
 {
@@ -90,6 +93,12 @@ class MidiPart
 		NOTELISTITEM *pNext;     //     
 	};
 
+	// ,     
+	struct NOTEPOOLBLOCK {
+		NOTEPOOLBLOCK *pNext; //    
+		NOTELISTITEM Items[NOTE_POOL_BLOCK_SIZE]; //  
+	};
+
 	//     MidiTrack,    MIDI-,
 	//    
 	MidiTrack *m_pMidiTrack;
@@ -110,12 +119,24 @@ class MidiPart
 	// ,       
 	DWORD m_CurInstrument[MAX_MIDI_CHANNELS];
 
+	//       
+	DWORD m_iCurEvent;
+
 	//   (  ,    )
 	DWORD m_ctCurTime;
 
 	//    
 	NOTELISTITEM *m_pNoteList;
 
+	//   ,     ;   
+	//   ,  -       ,
+	//      ;    
+	//  
+	NOTEPOOLBLOCK *m_pNotePool;
+
+	//       m_pNotePool
+	NOTELISTITEM *m_pFreeNotes;
+
 	//        
 	DWORD m_cSingleNotes;
 
@@ -139,6 +160,12 @@ public:
 	MIDIPARTRESULT GetNextNote(
 		__out_opt NOTEDESC *pNoteDesc);
 
+	//    ,    
+	DWORD GetSingleNotesCount();
+
+	//         
+	DWORD GetOverlapsCount();
+
 private:
 
 	//        
@@ -152,6 +179,13 @@ private:
 	void ReturnNoteFromConcord(
 		__out_opt NOTEDESC *pNoteDesc);
 
-	//  ,    ,    m_pNoteList
+	//      ,     
+	NOTELISTITEM *AllocNote();
+
+	//        
+	void FreeNote(
+		__in NOTELISTITEM *pNote);
+
+	//      m_pNoteList    
 	void FreeNoteList();
 };
@@ -14,8 +14,10 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <windows.h>
+#include <math.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "Song.h"
 #include "MidiLibrary.h"
 #include "MidiTrack.h"
@@ -24,16 +26,46 @@
 #include "MidiSong.h"
 #include "MidiFile.h"
 
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//    ,       
+#define INITIAL_SINGING_EVENT_ARRAY_SIZE	256
+
+//        
+#define INITIAL_TEXT_BUFFER_SIZE			1024
+
+//   ,    
+#define INITIAL_MEASURE_ARRAY_SIZE			64
+
+//   ,    
+#define INITIAL_TEMPO_ARRAY_SIZE			8
+
+//    ,    ;
+//    AlignLyric
+#define UNDEFINED_SINGING_EVENT				0xFFFFFFFF
+
 /****************************************************************************************
 *
 *    ,  
 *
 ****************************************************************************************/
 
+static bool GrowArray(
+	__inout void **ppArray,
+	__in DWORD cItems,
+	__in DWORD cbItem);
+
 static bool IsStartOfGeneralizedSyllable(
 	__in LPCWSTR pwsText,
 	__in DWORD cchText);
 
+static DWORD WholeNotesToUnits(
+	__in double cwn);
+
 /****************************************************************************************
 *
 *   
@@ -50,17 +82,30 @@ static bool IsStartOfGeneralizedSyllable(
 
 MidiSong::MidiSong()
 {
-	m_pFirstSingingEvent = NULL;
-	m_pLastSingingEvent = NULL;
-	m_pCurSingingEvent = NULL;
-
-	m_pFirstMeasure = NULL;
-	m_pLastMeasure = NULL;
-	m_pCurMeasure = NULL;
-
-	m_pFirstTempo = NULL;
-	m_pLastTempo = NULL;
-	m_pCurTempo = NULL;
+	m_pNoteNumbers = NULL;
+	m_pctToNoteOns = NULL;
+	m_pctDurations = NULL;
+	m_piNoteTexts = NULL;
+	m_pcchNoteTexts = NULL;
+	m_cSingingEvents = 0;
+	m_cMaxSingingEvents = 0;
+	m_iCurSingingEvent = 0;
+
+	m_pwsTexts = NULL;
+	m_cchTexts = 0;
+	m_cchMaxTexts = 0;
+
+	m_pMeasures = NULL;
+	m_cMeasures = 0;
+	m_cMaxMeasures = 0;
+	m_iCurMeasure = 0;
+
+	m_pMeasureTimes = NULL;
+
+	m_pTempos = NULL;
+	m_cTempos = 0;
+	m_cMaxTempos = 0;
+	m_iCurTempo = 0;
 }
 
 /****************************************************************************************
@@ -99,9 +144,9 @@ MidiSong::~MidiSong()
 
 void MidiSong::ResetCurrentPosition()
 {
-	m_pCurSingingEvent = m_pFirstSingingEvent;
-	m_pCurMeasure = m_pFirstMeasure;
-	m_pCurTempo = m_pFirstTempo;
+	m_iCurSingingEvent = 0;
+	m_iCurMeasure = 0;
+	m_iCurTempo = 0;
 }
 
 /****************************************************************************************
@@ -133,55 +178,50 @@ bool MidiSong::AddSingingEvent(
 	__in_opt LPCWSTR pwsNoteText,
 	__in DWORD cchNoteText)
 {
-	//        
-	SINGING_EVENT *pNewSingingEvent = new SINGING_EVENT;
-
-	if (pNewSingingEvent == NULL)
-	{
-		LOG("operator new failed\n");
-		return false;
-	}
-
-	//   ,        
-	LPWSTR pwsNewNoteText = NULL;
-
-	if (pwsNoteText != NULL && cchNoteText > 0)
+	//   ,       
+	if (m_cSingingEvents == m_cMaxSingingEvents)
 	{
-		//       
-		pwsNewNoteText = new WCHAR[cchNoteText];
-
-		if (pwsNewNoteText == NULL)
+		DWORD cNewMaxSingingEvents = (m_cMaxSingingEvents == 0) ?
+			INITIAL_SINGING_EVENT_ARRAY_SIZE : m_cMaxSingingEvents * 2;
+
+		//  -    ,    
+		//  ,  m_cMaxSingingEvents - 
+		if (!GrowArray((void **) &m_pNoteNumbers, cNewMaxSingingEvents, sizeof(DWORD)) ||
+			!GrowArray((void **) &m_pctToNoteOns, cNewMaxSingingEvents, sizeof(DWORD)) ||
+			!GrowArray((void **) &m_pctDurations, cNewMaxSingingEvents, sizeof(DWORD)) ||
+			!GrowArray((void **) &m_piNoteTexts, cNewMaxSingingEvents, sizeof(DWORD)) ||
+			!GrowArray((void **) &m_pcchNoteTexts, cNewMaxSingingEvents, sizeof(DWORD)))
 		{
-			LOG("operator new failed\n");
-			delete pNewSingingEvent;
+			LOG("GrowArray failed\n");
 			return false;
 		}
 
-		//          
-		wcsncpy(pwsNewNoteText, pwsNoteText, cchNoteText);
+		m_cMaxSingingEvents = cNewMaxSingingEvents;
 	}
 
-	//      
-	pNewSingingEvent->NoteNumber = NoteNumber;
-	pNewSingingEvent->ctToNoteOn = ctToNoteOn;
-	pNewSingingEvent->ctDuration = ctDuration;
-	pNewSingingEvent->pwsNoteText = pwsNewNoteText;
-	pNewSingingEvent->cchNoteText = cchNoteText;
-	pNewSingingEvent->pNext = NULL;
+	//          m_pwsTexts
+	DWORD iNoteText = 0;
 
-	if (m_pFirstSingingEvent == NULL)
-	{
-		//         
-		m_pFirstSingingEvent = pNewSingingEvent;
-	}
-	else
+	if (pwsNoteText == NULL) cchNoteText = 0;
+
+	if (cchNoteText > 0)
 	{
-		//         
-		m_pLastSingingEvent->pNext = pNewSingingEvent;
+		//        
+		if (!AppendText(pwsNoteText, cchNoteText, &iNoteText))
+		{
+			LOG("MidiSong::AppendText failed\n");
+			return false;
+		}
 	}
 
-	//      
-	m_pLastSingingEvent = pNewSingingEvent;
+	//    
+	m_pNoteNumbers[m_cSingingEvents] = NoteNumber;
+	m_pctToNoteOns[m_cSingingEvents] = ctToNoteOn;
+	m_pctDurations[m_cSingingEvents] = ctDuration;
+	m_piNoteTexts[m_cSingingEvents] = iNoteText;
+	m_pcchNoteTexts[m_cSingingEvents] = cchNoteText;
+
+	m_cSingingEvents++;
 
 	return true;
 }
@@ -222,16 +262,25 @@ bool MidiSong::GetNextSingingEvent(
 	__out_opt DWORD *pcchNoteText)
 {
 	//    ,  false
-	if (m_pCurSingingEvent == NULL) return false;
+	if (m_iCurSingingEvent == m_cSingingEvents) return false;
+
+	if (pNoteNumber != NULL) *pNoteNumber = m_pNoteNumbers[m_iCurSingingEvent];
+	if (pctToNoteOn != NULL) *pctToNoteOn = m_pctToNoteOns[m_iCurSingingEvent];
+	if (pctDuration != NULL) *pctDuration = m_pctDurations[m_iCurSingingEvent];
+
+	if (ppwsNoteText != NULL || pcchNoteText != NULL)
+	{
+		LPCWSTR pwsNoteText;
+		DWORD cchNoteText;
 
-	if (pNoteNumber != NULL) *pNoteNumber = m_pCurSingingEvent->NoteNumber;
-	if (pctToNoteOn != NULL) *pctToNoteOn = m_pCurSingingEvent->ctToNoteOn;
-	if (pctDuration != NULL) *pctDuration = m_pCurSingingEvent->ctDuration;
-	if (ppwsNoteText != NULL) *ppwsNoteText = m_pCurSingingEvent->pwsNoteText;
-	if (pcchNoteText != NULL) *pcchNoteText = m_pCurSingingEvent->cchNoteText;
+		GetSingingEventText(m_iCurSingingEvent, &pwsNoteText, &cchNoteText);
+
+		if (ppwsNoteText != NULL) *ppwsNoteText = pwsNoteText;
+		if (pcchNoteText != NULL) *pcchNoteText = cchNoteText;
+	}
 
 	//     
-	m_pCurSingingEvent = m_pCurSingingEvent->pNext;
+	m_iCurSingingEvent++;
 
 	return true;
 }
@@ -259,34 +308,28 @@ bool MidiSong::AddMeasure(
 	__in DWORD Denominator,
 	__in DWORD cNotated32ndNotesPerMidiQuarterNote)
 {
-	//       
-	MEASURE *pNewMeasure = new MEASURE;
-
-	if (pNewMeasure == NULL)
+	//   ,       
+	if (m_cMeasures == m_cMaxMeasures)
 	{
-		LOG("operator new failed\n");
-		return false;
-	}
+		DWORD cNewMaxMeasures = (m_cMaxMeasures == 0) ?
+			INITIAL_MEASURE_ARRAY_SIZE : m_cMaxMeasures * 2;
 
-	//     
-	pNewMeasure->Numerator = Numerator;
-	pNewMeasure->Denominator = Denominator;
-	pNewMeasure->cNotated32ndNotesPerMidiQuarterNote = cNotated32ndNotesPerMidiQuarterNote;
-	pNewMeasure->pNext = NULL;
+		if (!GrowArray((void **) &m_pMeasures, cNewMaxMeasures, sizeof(MEASURE)))
+		{
+			LOG("GrowArray failed\n");
+			return false;
+		}
 
-	if (m_pFirstMeasure == NULL)
-	{
-		//        
-		m_pFirstMeasure = pNewMeasure;
-	}
-	else
-	{
-		//        
-		m_pLastMeasure->pNext = pNewMeasure;
+		m_cMaxMeasures = cNewMaxMeasures;
 	}
 
-	//      
-	m_pLastMeasure = pNewMeasure;
+	//   
+	m_pMeasures[m_cMeasures].Numerator = Numerator;
+	m_pMeasures[m_cMeasures].Denominator = Denominator;
+	m_pMeasures[m_cMeasures].cNotated32ndNotesPerMidiQuarterNote =
+		cNotated32ndNotesPerMidiQuarterNote;
+
+	m_cMeasures++;
 
 	return true;
 }
@@ -320,15 +363,15 @@ bool MidiSong::GetNextMeasure(
 	__out DWORD *pcNotated32ndNotesPerMidiQuarterNote)
 {
 	//   ,  false
-	if (m_pCurMeasure == NULL) return false;
+	if (m_iCurMeasure == m_cMeasures) return false;
 
-	*pNumerator = m_pCurMeasure->Numerator;
-	*pDenominator = m_pCurMeasure->Denominator;
+	*pNumerator = m_pMeasures[m_iCurMeasure].Numerator;
+	*pDenominator = m_pMeasures[m_iCurMeasure].Denominator;
 	*pcNotated32ndNotesPerMidiQuarterNote =
-		m_pCurMeasure->cNotated32ndNotesPerMidiQuarterNote;
+		m_pMeasures[m_iCurMeasure].cNotated32ndNotesPerMidiQuarterNote;
 
 	//    
-	m_pCurMeasure = m_pCurMeasure->pNext;
+	m_iCurMeasure++;
 
 	return true;
 }
@@ -354,33 +397,27 @@ bool MidiSong::AddTempo(
 	__in DWORD ctToTempoSet,
 	__in DWORD cMicrosecondsPerMidiQuarterNote)
 {
-	//       
-	TEMPO *pNewTempo = new TEMPO;
-
-	if (pNewTempo == NULL)
+	//   ,       
+	if (m_cTempos == m_cMaxTempos)
 	{
-		LOG("operator new failed\n");
-		return false;
-	}
+		DWORD cNewMaxTempos = (m_cMaxTempos == 0) ?
+			INITIAL_TEMPO_ARRAY_SIZE : m_cMaxTempos * 2;
 
-	//     
-	pNewTempo->ctToTempoSet = ctToTempoSet;
-	pNewTempo->cMicrosecondsPerMidiQuarterNote = cMicrosecondsPerMidiQuarterNote;
-	pNewTempo->pNext = NULL;
+		if (!GrowArray((void **) &m_pTempos, cNewMaxTempos, sizeof(TEMPO)))
+		{
+			LOG("GrowArray failed\n");
+			return false;
+		}
 
-	if (m_pFirstTempo == NULL)
-	{
-		//        
-		m_pFirstTempo = pNewTempo;
-	}
-	else
-	{
-		//        
-		m_pLastTempo->pNext = pNewTempo;
+		m_cMaxTempos = cNewMaxTempos;
 	}
 
-	//      
-	m_pLastTempo = pNewTempo;
+	//   
+	m_pTempos[m_cTempos].ctToTempoSet = ctToTempoSet;
+	m_pTempos[m_cTempos].cMicrosecondsPerMidiQuarterNote =
+		cMicrosecondsPerMidiQuarterNote;
+
+	m_cTempos++;
 
 	return true;
 }
@@ -410,13 +447,14 @@ bool MidiSong::GetNextTempo(
 	__out DWORD *pcMicrosecondsPerMidiQuarterNote)
 {
 	//   ,  false
-	if (m_pCurTempo == NULL) return false;
+	if (m_iCurTempo == m_cTempos) return false;
 
-	*pctToTempoSet = m_pCurTempo->ctToTempoSet;
-	*pcMicrosecondsPerMidiQuarterNote = m_pCurTempo->cMicrosecondsPerMidiQuarterNote;
+	*pctToTempoSet = m_pTempos[m_iCurTempo].ctToTempoSet;
+	*pcMicrosecondsPerMidiQuarterNote =
+		m_pTempos[m_iCurTempo].cMicrosecondsPerMidiQuarterNote;
 
 	//    
-	m_pCurTempo = m_pCurTempo->pNext;
+	m_iCurTempo++;
 
 	return true;
 }
@@ -439,6 +477,8 @@ bool MidiSong::GetNextTempo(
 
 bool MidiSong::CorrectLyric()
 {
+	TRACE_ZONE("MidiSong::CorrectLyric");
+
 	//    
 	if (!AlignLyric())
 	{
@@ -482,8 +522,17 @@ Song *MidiSong::CreateSong(
 		return NULL;
 	}
 
+	//      ,      
+	//     
+	if (!CreateMeasureTimes(cTicksPerMidiQuarterNote))
+	{
+		LOG("MidiSong::CreateMeasureTimes failed\n");
+		delete pSong;
+		return NULL;
+	}
+
 	//      Song
-	if (!CreateSes(pSong, cTicksPerMidiQuarterNote))
+	if (!CreateSes(pSong))
 	{
 		LOG("MidiSong::CreateSes failed\n");
 		delete pSong;
@@ -499,7 +548,7 @@ Song *MidiSong::CreateSong(
 	}
 
 	//       Song
-	if (!CreateTempoMap(pSong, cTicksPerMidiQuarterNote))
+	if (!CreateTempoMap(pSong))
 	{
 		LOG("MidiSong::CreateTempoMap failed\n");
 		delete pSong;
@@ -525,53 +574,54 @@ Song *MidiSong::CreateSong(
 
 void MidiSong::Free()
 {
-	//    
+	//   
 
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+	if (m_pNoteNumbers != NULL) HeapFree(GetProcessHeap(), 0, m_pNoteNumbers);
+	if (m_pctToNoteOns != NULL) HeapFree(GetProcessHeap(), 0, m_pctToNoteOns);
+	if (m_pctDurations != NULL) HeapFree(GetProcessHeap(), 0, m_pctDurations);
+	if (m_piNoteTexts != NULL) HeapFree(GetProcessHeap(), 0, m_piNoteTexts);
+	if (m_pcchNoteTexts != NULL) HeapFree(GetProcessHeap(), 0, m_pcchNoteTexts);
 
-	while (pCurSingingEvent != NULL)
-	{
-		SINGING_EVENT *pDelSingingEvent = pCurSingingEvent;
-		pCurSingingEvent = pCurSingingEvent->pNext;
+	m_pNoteNumbers = NULL;
+	m_pctToNoteOns = NULL;
+	m_pctDurations = NULL;
+	m_piNoteTexts = NULL;
+	m_pcchNoteTexts = NULL;
+	m_cSingingEvents = 0;
+	m_cMaxSingingEvents = 0;
+	m_iCurSingingEvent = 0;
 
-		if (pDelSingingEvent->pwsNoteText != NULL) delete pDelSingingEvent->pwsNoteText;
+	//     
 
-		delete pDelSingingEvent;
-	}
+	if (m_pwsTexts != NULL) HeapFree(GetProcessHeap(), 0, m_pwsTexts);
 
-	m_pFirstSingingEvent = NULL;
-	m_pLastSingingEvent = NULL;
-	m_pCurSingingEvent = NULL;
+	m_pwsTexts = NULL;
+	m_cchTexts = 0;
+	m_cchMaxTexts = 0;
 
-	//   
+	//   
 
-	MEASURE *pCurMeasure = m_pFirstMeasure;
+	if (m_pMeasures != NULL) HeapFree(GetProcessHeap(), 0, m_pMeasures);
 
-	while (pCurMeasure != NULL)
-	{
-		MEASURE *pDelMeasure = pCurMeasure;
-		pCurMeasure = pCurMeasure->pNext;
-		delete pDelMeasure;
-	}
+	m_pMeasures = NULL;
+	m_cMeasures = 0;
+	m_cMaxMeasures = 0;
+	m_iCurMeasure = 0;
 
-	m_pFirstMeasure = NULL;
-	m_pLastMeasure = NULL;
-	m_pCurMeasure = NULL;
+	//      
 
-	//   
+	if (m_pMeasureTimes != NULL) HeapFree(GetProcessHeap(), 0, m_pMeasureTimes);
 
-	TEMPO *pCurTempo = m_pFirstTempo;
+	m_pMeasureTimes = NULL;
 
-	while (pCurTempo != NULL)
-	{
-		TEMPO *pDelTempo = pCurTempo;
-		pCurTempo = pCurTempo->pNext;
-		delete pDelTempo;
-	}
+	//   
 
-	m_pFirstTempo = NULL;
-	m_pLastTempo = NULL;
-	m_pCurTempo = NULL;
+	if (m_pTempos != NULL) HeapFree(GetProcessHeap(), 0, m_pTempos);
+
+	m_pTempos = NULL;
+	m_cTempos = 0;
+	m_cMaxTempos = 0;
+	m_iCurTempo = 0;
 }
 
 /****************************************************************************************
@@ -595,14 +645,14 @@ void MidiSong::Free()
 
 bool MidiSong::AlignLyric()
 {
-	//       
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+	//    
+	DWORD iCurSingingEvent = 0;
 
-	//      ,    ;
-	//     NULL,    ;
-	//      NULL,     
-	//    pwsAlignedText
-	SINGING_EVENT *pBookmarkedSingingEvent = NULL;
+	//   ,    ;
+	//     UNDEFINED_SINGING_EVENT,    ;
+	//      UNDEFINED_SINGING_EVENT,    
+	//     pwsAlignedText
+	DWORD iBookmarkedSingingEvent = UNDEFINED_SINGING_EVENT;
 
 	// ,       ,
 	//    
@@ -616,14 +666,14 @@ bool MidiSong::AlignLyric()
 	//     
 	while (true)
 	{
-		if (pCurSingingEvent == NULL)
+		if (iCurSingingEvent == m_cSingingEvents)
 		{
 			//    
 
-			if (pBookmarkedSingingEvent != NULL)
+			if (iBookmarkedSingingEvent != UNDEFINED_SINGING_EVENT)
 			{
 				//    ,    
-				if (!SetText(pBookmarkedSingingEvent, pwsAlignedText, cchAlignedText))
+				if (!SetText(iBookmarkedSingingEvent, pwsAlignedText, cchAlignedText))
 				{
 					LOG("MidiSong::SetText failed\n");
 					return false;
@@ -634,15 +684,17 @@ bool MidiSong::AlignLyric()
 		}
 
 		//     ,   
-		LPCWSTR pwsNoteText = pCurSingingEvent->pwsNoteText;
+		LPCWSTR pwsNoteText;
 
 		//      
-		DWORD cchNoteText = pCurSingingEvent->cchNoteText;
+		DWORD cchNoteText;
+
+		GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 
 		if (pwsNoteText == NULL)
 		{
 			//     
-			pCurSingingEvent = pCurSingingEvent->pNext;
+			iCurSingingEvent++;
 			continue;
 		}
 
@@ -656,16 +708,20 @@ bool MidiSong::AlignLyric()
 			{
 				//     
 
-				if (pBookmarkedSingingEvent != NULL)
+				if (iBookmarkedSingingEvent != UNDEFINED_SINGING_EVENT)
 				{
 					//   ,     
 
 					//    ,    
-					if (!SetText(pBookmarkedSingingEvent, pwsAlignedText, cchAlignedText))
+					if (!SetText(iBookmarkedSingingEvent, pwsAlignedText, cchAlignedText))
 					{
 						LOG("MidiSong::SetText failed\n");
 						return false;
 					}
+
+					// SetText    ,   
+					//      
+					GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 				}
 
 				//   
@@ -674,7 +730,7 @@ bool MidiSong::AlignLyric()
 
 			//   -    ,  
 			//       pwsAlignedText
-			if (pBookmarkedSingingEvent != NULL)
+			if (iBookmarkedSingingEvent != UNDEFINED_SINGING_EVENT)
 			{
 				pwsAlignedText[cchAlignedText] = pwsNoteText[i];
 				cchAlignedText++;
@@ -687,14 +743,18 @@ bool MidiSong::AlignLyric()
 			{
 				//    
 
-				if (pBookmarkedSingingEvent != NULL)
+				if (iBookmarkedSingingEvent != UNDEFINED_SINGING_EVENT)
 				{
 					//    ,    
-					if (!SetText(pBookmarkedSingingEvent, pwsAlignedText, cchAlignedText))
+					if (!SetText(iBookmarkedSingingEvent, pwsAlignedText, cchAlignedText))
 					{
 						LOG("MidiSong::SetText failed\n");
 						return false;
 					}
+
+					// SetText    ,   
+					//      
+					GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 				}
 
 				//        
@@ -718,7 +778,7 @@ bool MidiSong::AlignLyric()
 		if (i == cchNoteText)
 		{
 			//         ,   
-			SetText(pCurSingingEvent, NULL, 0);
+			SetText(iCurSingingEvent, NULL, 0);
 
 			if (cchAlignedText == MAX_SYMBOLS_PER_NOTE)
 			{
@@ -726,7 +786,7 @@ bool MidiSong::AlignLyric()
 				//    ,    , ;
 				//         ,
 				//     
-				pBookmarkedSingingEvent = NULL;
+				iBookmarkedSingingEvent = UNDEFINED_SINGING_EVENT;
 			}
 		}
 		else
@@ -737,11 +797,11 @@ bool MidiSong::AlignLyric()
 			wcsncpy(pwsAlignedText, pwsNoteText + i, cchAlignedText);
 
 			//      
-			pBookmarkedSingingEvent = pCurSingingEvent;
+			iBookmarkedSingingEvent = iCurSingingEvent;
 		}
 
 		//     
-		pCurSingingEvent = pCurSingingEvent->pNext;
+		iCurSingingEvent++;
 	}
 }
 
@@ -765,26 +825,28 @@ bool MidiSong::AlignLyric()
 
 bool MidiSong::RemoveNonPrintableSymbols()
 {
-	//       
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+	//    
+	DWORD iCurSingingEvent = 0;
 
 	//    ;
 	//    
 	while (true)
 	{
 		//    ,  
-		if (pCurSingingEvent == NULL) return true;
+		if (iCurSingingEvent == m_cSingingEvents) return true;
 
 		//     ,   
-		LPCWSTR pwsNoteText = pCurSingingEvent->pwsNoteText;
+		LPCWSTR pwsNoteText;
 
 		//      
-		DWORD cchNoteText = pCurSingingEvent->cchNoteText;
+		DWORD cchNoteText;
+
+		GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 
 		if (pwsNoteText == NULL)
 		{
 			//     
-			pCurSingingEvent = pCurSingingEvent->pNext;
+			iCurSingingEvent++;
 			continue;
 		}
 
@@ -825,208 +887,345 @@ bool MidiSong::RemoveNonPrintableSymbols()
 		cchNewNoteText = i;
 
 		//       
-		if (!SetText(pCurSingingEvent, pwsNewNoteText, cchNewNoteText))
+		if (!SetText(iCurSingingEvent, pwsNewNoteText, cchNewNoteText))
 		{
 			LOG("MidiSong::SetText failed\n");
 			return false;
 		}
 
 		//     
-		pCurSingingEvent = pCurSingingEvent->pNext;
+		iCurSingingEvent++;
 	}
 }
 
+/****************************************************************************************
+*
+*    GetSingingEventText
+*
+*   
+*       iSingingEvent -     
+*       ppwsNoteText -   ,      
+*                      ,   ,    
+*                      ,   ,  NULL,    
+*                       
+*       pcchNoteText -   ,     
+*                          ,   
+*
+*    
+*       
+*
+*         iSingingEvent.
+*
+****************************************************************************************/
+
+void MidiSong::GetSingingEventText(
+	__in DWORD iSingingEvent,
+	__out LPCWSTR *ppwsNoteText,
+	__out DWORD *pcchNoteText)
+{
+	*pcchNoteText = m_pcchNoteTexts[iSingingEvent];
+
+	*ppwsNoteText = (*pcchNoteText == 0) ? NULL :
+		m_pwsTexts + m_piNoteTexts[iSingingEvent];
+}
+
 /****************************************************************************************
 *
 *    SetText
 *
 *   
-*       pSingingEvent -      
+*       iSingingEvent -     
 *		pwsNoteText -  ,   ,  
 *                       ,   ;    
-*                      NULL
+*                      NULL;       m_pwsTexts
 *       cchNoteText -     pwsNoteText
 *
 *    
 *       true,       ; false,  
 *         .
 *
-*       ,   pSingingEvent.
+*          iSingingEvent.  
+*      ,      ,   
+*      m_pwsTexts,        
+*    Free.           ,
+*           
+*   .
 *
 ****************************************************************************************/
 
 bool MidiSong::SetText(
-	__inout SINGING_EVENT *pSingingEvent,
+	__in DWORD iSingingEvent,
 	__in_opt LPCWSTR pwsNoteText,
 	__in DWORD cchNoteText)
 {
-	//   ,        
-	LPWSTR pwsNewNoteText = NULL;
+	if (pwsNoteText == NULL) cchNoteText = 0;
 
-	if (pwsNoteText != NULL && cchNoteText > 0)
+	if (cchNoteText > m_pcchNoteTexts[iSingingEvent])
+	{
+		//       
+		if (!AppendText(pwsNoteText, cchNoteText, &m_piNoteTexts[iSingingEvent]))
+		{
+			LOG("MidiSong::AppendText failed\n");
+			return false;
+		}
+	}
+	else if (cchNoteText > 0)
 	{
-		//       
-		pwsNewNoteText = new WCHAR[cchNoteText];
+		//      
+		wcsncpy(m_pwsTexts + m_piNoteTexts[iSingingEvent], pwsNoteText, cchNoteText);
+	}
+
+	m_pcchNoteTexts[iSingingEvent] = cchNoteText;
 
-		if (pwsNewNoteText == NULL)
+	return true;
+}
+
+/****************************************************************************************
+*
+*    AppendText
+*
+*   
+*       pwsText -  ,   ;    
+*                   m_pwsTexts
+*       cchText -     pwsText
+*       piText -   ,       
+*                    m_pwsTexts
+*
+*    
+*       true,    ; false,     .
+*
+*        m_pwsTexts,    .
+*
+****************************************************************************************/
+
+bool MidiSong::AppendText(
+	__in LPCWSTR pwsText,
+	__in DWORD cchText,
+	__out DWORD *piText)
+{
+	//  ,        
+	if (m_cchTexts + cchText > m_cchMaxTexts)
+	{
+		DWORD cchNewMaxTexts = (m_cchMaxTexts == 0) ?
+			INITIAL_TEXT_BUFFER_SIZE : m_cchMaxTexts * 2;
+
+		while (m_cchTexts + cchText > cchNewMaxTexts) cchNewMaxTexts *= 2;
+
+		if (!GrowArray((void **) &m_pwsTexts, cchNewMaxTexts, sizeof(WCHAR)))
 		{
-			LOG("operator new failed\n");
+			LOG("GrowArray failed\n");
 			return false;
 		}
 
-		//          
-		wcsncpy(pwsNewNoteText, pwsNoteText, cchNoteText);
+		m_cchMaxTexts = cchNewMaxTexts;
 	}
 
-	//     
-	if (pSingingEvent->pwsNoteText != NULL) delete pSingingEvent->pwsNoteText;
+	wcsncpy(m_pwsTexts + m_cchTexts, pwsText, cchText);
 
-	//      
-	pSingingEvent->pwsNoteText = pwsNewNoteText;
-	pSingingEvent->cchNoteText = cchNoteText;
+	*piText = m_cchTexts;
+	m_cchTexts += cchText;
 
 	return true;
 }
 
 /****************************************************************************************
 *
-*    CreateSes
+*    CreateMeasureTimes
 *
 *   
-*       pSong -     Song,     
 *       cTicksPerMidiQuarterNote -  ,    MIDI 
 *
 *    
 *       true   ; false,     .
 *
-*   C     Song.
+*        :     
+*               
+*    .
 *
 ****************************************************************************************/
 
-bool MidiSong::CreateSes(
-	__inout Song *pSong,
+bool MidiSong::CreateMeasureTimes(
 	__in DWORD cTicksPerMidiQuarterNote)
 {
-	//       
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+	//  ,    
+	if (m_pMeasureTimes != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pMeasureTimes);
+		m_pMeasureTimes = NULL;
+	}
+
+	if (m_cMeasures == 0) return true;
 
-	//      
-	MEASURE *pCurMeasure = m_pFirstMeasure;
+	m_pMeasureTimes = (MEASURETIME *) HeapAlloc(GetProcessHeap(), 0,
+		m_cMeasures * sizeof(MEASURETIME));
+
+	if (m_pMeasureTimes == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		return false;
+	}
 
 	// ,   ;
 	//        
 	double ctTotal = 0;
 
 	// ,    ;
-    //         
+	//         
 	double cwnTotal = 0;
 
-	//           
-    // 
-	double cwnToPrevNoteOff = 0;
-
-	//    ;
-	//      Song
-	while (true)
+	for (DWORD i = 0; i < m_cMeasures; i++)
 	{
-		//     ,    
-		if (pCurSingingEvent == NULL) return true;
+		MEASURE *pMeasure = &m_pMeasures[i];
+		MEASURETIME *pMeasureTime = &m_pMeasureTimes[i];
 
-		//     
-		double ctPerCurMeasure;
+		pMeasureTime->ctToMeasure = ctTotal;
+		pMeasureTime->cwnToMeasure = cwnTotal;
 
-		//      
-		double cwnPerCurMeasure;
+		//     
+		pMeasureTime->ctPerMeasure = (double) 32 * pMeasure->Numerator *
+			cTicksPerMidiQuarterNote / (pMeasure->Denominator *
+			pMeasure->cNotated32ndNotesPerMidiQuarterNote);
 
-		//   ,    ,     
-        //   
-		while (true)
-		{
-			//      
-			ctPerCurMeasure = (double) 32 * pCurMeasure->Numerator *
-				cTicksPerMidiQuarterNote / (pCurMeasure->Denominator *
-				pCurMeasure->cNotated32ndNotesPerMidiQuarterNote);
+		//      
+		pMeasureTime->cwnPerMeasure = (double) pMeasure->Numerator /
+			pMeasure->Denominator;
 
-			//       
-			cwnPerCurMeasure = (double) pCurMeasure->Numerator / pCurMeasure->Denominator;
+		ctTotal += pMeasureTime->ctPerMeasure;
+		cwnTotal += pMeasureTime->cwnPerMeasure;
+	}
 
-			if (ctTotal + ctPerCurMeasure >= pCurSingingEvent->ctToNoteOn)
-			{
-				// ,        ,
-                // ,    
-				break;
-			}
+	return true;
+}
+
+/****************************************************************************************
+*
+*    TicksToWholeNotes
+*
+*   
+*       ctTime -     
+*       piMeasure -   ,     ,  
+*                    ;      ,  
+*                     ctTime
+*
+*    
+*               ctTime.
+*
+*             .   
+*    ,    *piMeasure,     
+*        .    
+*     ,      .
+*
+*   
+*
+*         ,     ,   
+*    .         
+*     ,    .
+*
+****************************************************************************************/
 
-			ctTotal += ctPerCurMeasure;
-			cwnTotal += cwnPerCurMeasure;
+double MidiSong::TicksToWholeNotes(
+	__in DWORD ctTime,
+	__inout DWORD *piMeasure)
+{
+	if (m_cMeasures == 0) return 0;
 
-			//    
-			pCurMeasure = pCurMeasure->pNext;
-		}
+	DWORD iMeasure = *piMeasure;
 
-		//           
-		//  
-		double cwnToNoteOn = cwnTotal + (pCurSingingEvent->ctToNoteOn - ctTotal) *
-			cwnPerCurMeasure / ctPerCurMeasure;
+	MEASURETIME *pMeasureTime = &m_pMeasureTimes[iMeasure];
 
-		// ,         
-        //   
-        DWORD ctToNoteOff = pCurSingingEvent->ctToNoteOn + pCurSingingEvent->ctDuration;
+	//       ,    , 
+	//     ctTime
+	if (pMeasureTime->ctToMeasure + pMeasureTime->ctPerMeasure < ctTime)
+	{
+		DWORD iLow = iMeasure + 1;
+		DWORD iHigh = m_cMeasures - 1;
 
-		//   ,    ,     
-        //   
-		while (true)
+		while (iLow < iHigh)
 		{
-			//      
-			ctPerCurMeasure = (double) 32 * pCurMeasure->Numerator *
-				cTicksPerMidiQuarterNote / (pCurMeasure->Denominator *
-				pCurMeasure->cNotated32ndNotesPerMidiQuarterNote);
+			DWORD iMiddle = iLow + (iHigh - iLow) / 2;
 
-			//       
-			cwnPerCurMeasure = (double) pCurMeasure->Numerator / pCurMeasure->Denominator;
-
-			if (ctTotal + ctPerCurMeasure >= ctToNoteOff)
+			if (m_pMeasureTimes[iMiddle].ctToMeasure +
+				m_pMeasureTimes[iMiddle].ctPerMeasure >= ctTime)
 			{
-				// ,        ,
-                // ,    
-				break;
+				iHigh = iMiddle;
 			}
+			else
+			{
+				iLow = iMiddle + 1;
+			}
+		}
 
-			ctTotal += ctPerCurMeasure;
-			cwnTotal += cwnPerCurMeasure;
-
-			//    
-			pCurMeasure = pCurMeasure->pNext;
+		if (iLow < m_cMeasures)
+		{
+			iMeasure = iLow;
+			pMeasureTime = &m_pMeasureTimes[iMeasure];
 		}
 
-		//           
+		*piMeasure = iMeasure;
+	}
+
+	return pMeasureTime->cwnToMeasure + (ctTime - pMeasureTime->ctToMeasure) *
+		pMeasureTime->cwnPerMeasure / pMeasureTime->ctPerMeasure;
+}
+
+/****************************************************************************************
+*
+*    CreateSes
+*
+*   
+*       pSong -     Song,     
+*
+*    
+*       true   ; false,     .
+*
+*   C     Song.       
+*      CreateMeasureTimes.
+*
+****************************************************************************************/
+
+bool MidiSong::CreateSes(
+	__inout Song *pSong)
+{
+	//  ,        ;
+	//         
+	DWORD iCurMeasure = 0;
+
+	//    ;
+	//      Song
+	for (DWORD iCurSingingEvent = 0; iCurSingingEvent < m_cSingingEvents;
+		iCurSingingEvent++)
+	{
+		//           
 		//  
-		double cwnToNoteOff = cwnTotal + (ctToNoteOff - ctTotal) *
-			cwnPerCurMeasure / ctPerCurMeasure;
+		double cwnToNoteOn = TicksToWholeNotes(m_pctToNoteOns[iCurSingingEvent],
+			&iCurMeasure);
 
-		//         
-		double cwnPerNote = cwnToNoteOff - cwnToNoteOn;
+		//           
+		//  
+		double cwnToNoteOff = TicksToWholeNotes(m_pctToNoteOns[iCurSingingEvent] +
+			m_pctDurations[iCurSingingEvent], &iCurMeasure);
 
-		//          
-		//   
-		double cwnPerPause = cwnToNoteOn - cwnToPrevNoteOff;
+		//          
+		DWORD cuToNoteOn = WholeNotesToUnits(cwnToNoteOn);
+		DWORD cuToNoteOff = WholeNotesToUnits(cwnToNoteOff);
 
 		//      
-		bool bEventAdded = pSong->AddSingingEvent(pCurSingingEvent->NoteNumber,
-			cwnPerPause, cwnPerNote, pCurSingingEvent->pwsNoteText,
-			pCurSingingEvent->cchNoteText);
+		LPCWSTR pwsNoteText;
+		DWORD cchNoteText;
+
+		GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
+
+		bool bEventAdded = pSong->AddSingingEvent(m_pNoteNumbers[iCurSingingEvent],
+			cuToNoteOn, cuToNoteOff - cuToNoteOn, pwsNoteText, cchNoteText);
 
 		if (!bEventAdded)
 		{
 			LOG("Song::AddSingingEvent failed\n");
 			return false;
 		}
-
-		cwnToPrevNoteOff = cwnToNoteOff;
-
-		//     
-		pCurSingingEvent = pCurSingingEvent->pNext;
 	}
+
+	return true;
 }
 
 /****************************************************************************************
@@ -1047,15 +1246,15 @@ bool MidiSong::CreateSes(
 bool MidiSong::CreateMeasureSequence(
 	__inout Song *pSong)
 {
-	//      
-	MEASURE *pCurMeasure = m_pFirstMeasure;
+	//      
+	MEASURE *pCurMeasure = m_pMeasures;
 
 	//   ;
 	//       Song
 	while (true)
 	{
 		//    ,  
-		if (pCurMeasure == NULL) return true;
+		if (pCurMeasure == m_pMeasures + m_cMeasures) return true;
 
 		if (!pSong->AddMeasure(pCurMeasure->Numerator, pCurMeasure->Denominator))
 		{
@@ -1064,7 +1263,7 @@ bool MidiSong::CreateMeasureSequence(
 		}
 
 		//    
-		pCurMeasure = pCurMeasure->pNext;
+		pCurMeasure++;
 	}
 }
 
@@ -1074,78 +1273,43 @@ bool MidiSong::CreateMeasureSequence(
 *
 *   
 *       pSong -     Song
-*       cTicksPerMidiQuarterNote -  ,    MIDI 
 *
 *    
 *       true,     ; false,     .
 *
-*         Song.
+*         Song. ,   
+*    ,     .     
+*        CreateMeasureTimes.
 *
 ****************************************************************************************/
 
 bool MidiSong::CreateTempoMap(
-	__inout Song *pSong,
-	__in DWORD cTicksPerMidiQuarterNote)
+	__inout Song *pSong)
 {
-	//      
-	TEMPO *pCurTempo = m_pFirstTempo;
+	if (m_cMeasures == 0) return true;
 
-	//      
-	MEASURE *pCurMeasure = m_pFirstMeasure;
+	//      
+	MEASURETIME *pLastMeasureTime = &m_pMeasureTimes[m_cMeasures - 1];
+	double ctToEndOfLastMeasure = pLastMeasureTime->ctToMeasure +
+		pLastMeasureTime->ctPerMeasure;
 
-	// ,   ;
-	//        
-	double ctTotal = 0;
-
-	// ,    ;
-    //         
-	double cwnTotal = 0;
+	//  ,      
+	DWORD iCurMeasure = 0;
 
 	//   ;
 	//       Song
-	while (true)
+	for (DWORD iCurTempo = 0; iCurTempo < m_cTempos; iCurTempo++)
 	{
-		//    ,     
-		if (pCurTempo == NULL) return true;
-
-		//     
-		double ctPerCurMeasure;
-
-		//      
-		double cwnPerCurMeasure;
-
-		//   ,    ,     
-		// 
-		while (true)
-		{
-			//      
-			ctPerCurMeasure = (double) 32 * pCurMeasure->Numerator *
-				cTicksPerMidiQuarterNote / (pCurMeasure->Denominator *
-				pCurMeasure->cNotated32ndNotesPerMidiQuarterNote);
-
-			//       
-			cwnPerCurMeasure = (double) pCurMeasure->Numerator / pCurMeasure->Denominator;
+		TEMPO *pCurTempo = &m_pTempos[iCurTempo];
 
-			if (ctTotal + ctPerCurMeasure >= pCurTempo->ctToTempoSet)
-			{
-				// ,      ,
-                // ,    
-				break;
-			}
-
-			ctTotal += ctPerCurMeasure;
-			cwnTotal += cwnPerCurMeasure;
-
-			//    
-			pCurMeasure = pCurMeasure->pNext;
-
-			//   ,  
-			if (pCurMeasure == NULL) return true;
-		}
+		//       ,    
+		// 
+		if (ctToEndOfLastMeasure < pCurTempo->ctToTempoSet) return true;
 
 		//           
-		double cwnToTempoSet = cwnTotal + (pCurTempo->ctToTempoSet - ctTotal) *
-			cwnPerCurMeasure / ctPerCurMeasure;
+		double cwnToTempoSet = TicksToWholeNotes(pCurTempo->ctToTempoSet, &iCurMeasure);
+
+		MEASURE *pCurMeasure = &m_pMeasures[iCurMeasure];
 
 		double BPM = ((double) pCurMeasure->cNotated32ndNotesPerMidiQuarterNote / 8) *
 			((double) 60000000 / pCurTempo->cMicrosecondsPerMidiQuarterNote);
@@ -1156,10 +1320,55 @@ bool MidiSong::CreateTempoMap(
 			LOG("Song::AddTempo failed\n");
 			return false;
 		}
+	}
 
-		//    
-		pCurTempo = pCurTempo->pNext;
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GrowArray
+*
+*   
+*       ppArray -   ,      ; 
+*                    ,      NULL
+*       cItems -     
+*       cbItem -     
+*
+*    
+*       true,    ; false,     .
+*
+*      cItems        cItems
+*   ,   .     ,  
+*    .
+*
+****************************************************************************************/
+
+static bool GrowArray(
+	__inout void **ppArray,
+	__in DWORD cItems,
+	__in DWORD cbItem)
+{
+	void *pNewArray;
+
+	if (*ppArray == NULL)
+	{
+		pNewArray = HeapAlloc(GetProcessHeap(), 0, cItems * cbItem);
 	}
+	else
+	{
+		pNewArray = HeapReAlloc(GetProcessHeap(), 0, *ppArray, cItems * cbItem);
+	}
+
+	if (pNewArray == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		return false;
+	}
+
+	*ppArray = pNewArray;
+
+	return true;
 }
 
 /****************************************************************************************
@@ -1196,3 +1405,29 @@ static bool IsStartOfGeneralizedSyllable(
 
 	return false;
 }
+
+/****************************************************************************************
+*
+*    WholeNotesToUnits
+*
+*   
+*       cwn -      
+*
+*    
+*           (. WHOLE_NOTE_UNITS)   .
+*
+*                
+*    . ,    DWORD,  .
+*
+****************************************************************************************/
+
+static DWORD WholeNotesToUnits(
+	__in double cwn)
+{
+	double cu = floor(cwn * WHOLE_NOTE_UNITS + 0.5);
+
+	if (cu <= 0) return 0;
+	if (cu >= MAXDWORD) return MAXDWORD;
+
+	return (DWORD) cu;
+}
@@ -13,60 +13,94 @@
 
 class MidiSong
 {
-	// ,     
-	struct SINGING_EVENT {
-		DWORD NoteNumber; //  
-		DWORD ctToNoteOn; //        
-		DWORD ctDuration; //    
-		LPWSTR pwsNoteText; //     ,   
-		DWORD cchNoteText; //     pwsNoteText
-		SINGING_EVENT *pNext; //     
-	};
-
-	// ,    
+	// ,  
 	struct MEASURE {
 		DWORD Numerator; //   
 		DWORD Denominator; //   
 		DWORD cNotated32ndNotesPerMidiQuarterNote; //   
 												   //   MIDI-
-		MEASURE *pNext; //     
 	};
 
-	// ,    
+	// ,     
+	struct MEASURETIME {
+		double ctToMeasure; //        
+		double cwnToMeasure; //         
+		double ctPerMeasure; //    
+		double cwnPerMeasure; //     
+	};
+
+	// ,  
 	struct TEMPO {
 		DWORD ctToTempoSet;	//        
 							//  
 		DWORD cMicrosecondsPerMidiQuarterNote; //   MIDI-
 											   //  
-		TEMPO *pNext; //     
 	};
 
-	//       
-	SINGING_EVENT *m_pFirstSingingEvent;
+	//     ,       
+	// ;         
+
+	//   
+	DWORD *m_pNoteNumbers;
+
+	//        
+	DWORD *m_pctToNoteOns;
+
+	//     
+	DWORD *m_pctDurations;
+
+	//          m_pwsTexts
+	DWORD *m_piNoteTexts;
+
+	//       ;  ,  
+	//    
+	DWORD *m_pcchNoteTexts;
+
+	//     
+	DWORD m_cSingingEvents;
+
+	//   ,       
+	DWORD m_cMaxSingingEvents;
+
+	//    
+	DWORD m_iCurSingingEvent;
+
+	// ,          
+	WCHAR *m_pwsTexts;
 
-	//       
-	SINGING_EVENT *m_pLastSingingEvent;
+	//      m_pwsTexts
+	DWORD m_cchTexts;
 
-	//       
-	SINGING_EVENT *m_pCurSingingEvent;
+	//   m_pwsTexts  
+	DWORD m_cchMaxTexts;
 
-	//      
-	MEASURE *m_pFirstMeasure;
+	//  
+	MEASURE *m_pMeasures;
 
-	//      
-	MEASURE *m_pLastMeasure;
+	//     m_pMeasures
+	DWORD m_cMeasures;
 
-	//      
-	MEASURE *m_pCurMeasure;
+	//  ,       m_pMeasures
+	DWORD m_cMaxMeasures;
 
-	//      
-	TEMPO *m_pFirstTempo;
+	//   
+	DWORD m_iCurMeasure;
 
-	//      
-	TEMPO *m_pLastTempo;
+	//     ;    
+	//  m_pMeasures;    CreateMeasureTimes
+	MEASURETIME *m_pMeasureTimes;
 
-	//      
-	TEMPO *m_pCurTempo;
+	//  
+	TEMPO *m_pTempos;
+
+	//     m_pTempos
+	DWORD m_cTempos;
+
+	//  ,       m_pTempos
+	DWORD m_cMaxTempos;
+
+	//   
+	DWORD m_iCurTempo;
 
 public:
 
@@ -133,16 +167,36 @@ private:
 	//     AlignLyric
 	bool RemoveNonPrintableSymbols();
 
+	//       
+	void GetSingingEventText(
+		__in DWORD iSingingEvent,
+		__out LPCWSTR *ppwsNoteText,
+		__out DWORD *pcchNoteText);
+
 	//     
 	bool SetText(
-		__inout SINGING_EVENT *pSingingEvent,
+		__in DWORD iSingingEvent,
 		__in_opt LPCWSTR pwsNoteText,
 		__in DWORD cchNoteText);
 
+	//      m_pwsTexts
+	bool AppendText(
+		__in LPCWSTR pwsText,
+		__in DWORD cchText,
+		__out DWORD *piText);
+
+	//      
+	bool CreateMeasureTimes(
+		__in DWORD cTicksPerMidiQuarterNote);
+
+	//           
+	double TicksToWholeNotes(
+		__in DWORD ctTime,
+		__inout DWORD *piMeasure);
+
 	//      Song
 	bool CreateSes(
-		__inout Song *pSong,
-		__in DWORD cTicksPerMidiQuarterNote);
+		__inout Song *pSong);
 
 	//       Song
 	bool CreateMeasureSequence(
@@ -150,6 +204,5 @@ private:
 
 	//       Song
 	bool CreateTempoMap(
-		__inout Song *pSong,
-		__in DWORD cTicksPerMidiQuarterNote);
+		__inout Song *pSong);
 };
@@ -0,0 +1,824 @@
+/****************************************************************************************
+*
+*     MidiStreamParser
+*
+*       MIDI-,     ( ,
+*   ,   ..),       ,  
+*    ,     .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+
+#include "Log.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiStreamParser.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//   
+#define EMPTY_RUNNING_STATUS		0x00
+
+//   MIDI-  
+#define FILE_HEADER_SIZE			14
+
+//    MIDI- (    )  
+#define CHUNK_HEADER_SIZE			8
+
+//  
+#define STREAM_STATE_FILE_HEADER	0	//   
+#define STREAM_STATE_CHUNK_HEADER	1	//    
+#define STREAM_STATE_TRACK			2	//   
+#define STREAM_STATE_SKIP_CHUNK		3	//  ,   
+#define STREAM_STATE_END			4	//  
+#define STREAM_STATE_ERROR			5	//    
+
+//   ParseEvent
+#define PARSE_COMPLETE				0	//     
+#define PARSE_INCOMPLETE			1	//      
+#define PARSE_INVALID				2	//     ,  
+										//   
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,  ,   ParseEvent
+struct PARSEDEVENT
+{
+	DWORD ctDeltaTime; // -   
+	DWORD Event; //  
+	DWORD Channel; //   
+	DWORD DataOffset; //        
+	DWORD cbData; //     
+	DWORD cbEvent; //       -;   
+				   //   ,    , 
+				   //    
+	bool bSizeKnown; // true,    cbEvent  
+	BYTE RunningStatus; //    
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+inline DWORD GetBigEndianDword(PBYTE pBytes)
+{
+	return pBytes[0] << 24 | pBytes[1] << 16 | pBytes[2] << 8 | pBytes[3];
+}
+
+inline DWORD GetBigEndianWord(PBYTE pBytes)
+{
+	return pBytes[0] << 8 | pBytes[1];
+}
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static DWORD ParseEvent(
+	__in BYTE *pBytes,
+	__in DWORD cbBytes,
+	__in BYTE RunningStatus,
+	__out PARSEDEVENT *pEvent);
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+MidiStreamParser::MidiStreamParser()
+{
+	m_pBuffer = NULL;
+
+	Reset();
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .
+*
+****************************************************************************************/
+
+MidiStreamParser::~MidiStreamParser()
+{
+	if (m_pBuffer != NULL) HeapFree(GetProcessHeap(), 0, m_pBuffer);
+}
+
+/****************************************************************************************
+*
+*    Reset
+*
+*   
+*       
+*
+*    
+*       
+*
+*        .     
+*    .
+*
+****************************************************************************************/
+
+void MidiStreamParser::Reset()
+{
+	m_State = STREAM_STATE_FILE_HEADER;
+	m_Error = MIDISTREAM_INVALID_FORMAT;
+
+	m_pInput = NULL;
+	m_cbInput = 0;
+	m_bEndOfInput = false;
+
+	m_cbBuffered = 0;
+	m_cbChunkLeft = 0;
+	m_cbSkip = 0;
+
+	m_iTrack = 0;
+	m_ctCurTime = 0;
+	m_RunningStatus = EMPTY_RUNNING_STATUS;
+
+	m_Format = 0;
+	m_cTicksPerMidiQuarterNote = 0;
+}
+
+/****************************************************************************************
+*
+*    Feed
+*
+*   
+*       pBytes -      ;    
+*                 NULL,   cbBytes  
+*       cbBytes -     
+*
+*    
+*       true,    ; false,      
+*       .
+*
+*        .     
+*   ,      ,   GetNextEvent  
+*    MIDISTREAM_NEED_MORE_DATA.       
+*   .
+*
+****************************************************************************************/
+
+bool MidiStreamParser::Feed(
+	__in_opt BYTE *pBytes,
+	__in DWORD cbBytes)
+{
+	if (m_cbInput != 0)
+	{
+		LOG("previous input is not parsed yet\n");
+		return false;
+	}
+
+	m_pInput = pBytes;
+	m_cbInput = cbBytes;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    SetEndOfInput
+*
+*   
+*       
+*
+*    
+*       
+*
+*    ,      .   , 
+*      ,   ,     
+*   MidiFile,    GetNextEvent   MIDISTREAM_END.
+*
+****************************************************************************************/
+
+void MidiStreamParser::SetEndOfInput()
+{
+	m_bEndOfInput = true;
+}
+
+/****************************************************************************************
+*
+*    GetNextEvent
+*
+*   
+*       pEvent -   ,      
+*
+*    
+*       MIDISTREAM_HEADER -   ,     
+*                            GetFormat  GetTicksPerMidiQuarterNote;
+*       MIDISTREAM_EVENT -   pEvent    ;
+*       MIDISTREAM_TRACK_END -  ,   pEvent  
+*                               iTrack  ctEventTime;
+*       MIDISTREAM_NEED_MORE_DATA -    ,  
+*                                     Feed     
+*                                    SetEndOfInput;
+*       MIDISTREAM_END -    ;
+*       MIDISTREAM_INVALID_FORMAT -    MIDI-;
+*       MIDISTREAM_UNSUPPORTED_FORMAT -  MIDI-  ;
+*       MIDISTREAM_INVALID_TRACK -  MIDI-    , 
+*                                     ;   
+*                                  MidiFile ,   
+*                                      , 
+*                                   ,    
+*                                   ;
+*       MIDISTREAM_CANT_ALLOC_MEMORY -      .
+*
+*       ,      
+*   .     ,    
+*   MidiFile::AssignFile,      ,    
+*   MidiTrack::AttachToTrack ( END_OF_TRACK  ).   
+*              ,
+*        Reset.
+*
+*   
+*
+*   ,     ,    . 
+*   ,    ,    m_pBuffer,   
+*         ,   
+*   .      MAX_STREAM_EVENT_SIZE  
+*      .    MAX_STREAM_EVENT_SIZE
+*   ( SysEx-) ,   - .
+*
+****************************************************************************************/
+
+MIDISTREAMRESULT MidiStreamParser::GetNextEvent(
+	__out MIDISTREAMEVENT *pEvent)
+{
+	if (m_pBuffer == NULL && m_State != STREAM_STATE_ERROR)
+	{
+		m_pBuffer = (BYTE *) HeapAlloc(GetProcessHeap(), 0, MAX_STREAM_EVENT_SIZE);
+
+		if (m_pBuffer == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return Fail(MIDISTREAM_CANT_ALLOC_MEMORY);
+		}
+	}
+
+	while (true)
+	{
+		switch (m_State)
+		{
+		case STREAM_STATE_FILE_HEADER:
+		{
+			if (!Gather(FILE_HEADER_SIZE))
+			{
+				if (!m_bEndOfInput) return MIDISTREAM_NEED_MORE_DATA;
+
+				LOG("file is too small\n");
+				return Fail(MIDISTREAM_INVALID_FORMAT);
+			}
+
+			m_cbBuffered = 0;
+
+			//   MIDI-    " "
+			if (GetBigEndianDword(m_pBuffer) != 'MThd' ||
+				GetBigEndianDword(m_pBuffer + 4) != 6)
+			{
+				LOG("invalid MIDI file header\n");
+				return Fail(MIDISTREAM_INVALID_FORMAT);
+			}
+
+			//   MIDI-; MIDI-  2  
+			m_Format = GetBigEndianWord(m_pBuffer + 8);
+
+			if (m_Format == 2)
+			{
+				LOG("unsupported MIDI file format\n");
+				return Fail(MIDISTREAM_UNSUPPORTED_FORMAT);
+			}
+			else if (m_Format > 2)
+			{
+				LOG("invalid MIDI file format\n");
+				return Fail(MIDISTREAM_INVALID_FORMAT);
+			}
+
+			// -  SMPTE-  
+			if (m_pBuffer[12] & 0x80)
+			{
+				LOG("SMPTE format for delta times is not supported\n");
+				return Fail(MIDISTREAM_UNSUPPORTED_FORMAT);
+			}
+
+			m_cTicksPerMidiQuarterNote = GetBigEndianWord(m_pBuffer + 12);
+
+			m_State = STREAM_STATE_CHUNK_HEADER;
+
+			return MIDISTREAM_HEADER;
+		}
+
+		case STREAM_STATE_CHUNK_HEADER:
+		{
+			if (!Gather(CHUNK_HEADER_SIZE))
+			{
+				if (!m_bEndOfInput) return MIDISTREAM_NEED_MORE_DATA;
+
+				//       
+				m_cbBuffered = 0;
+				m_State = STREAM_STATE_END;
+				continue;
+			}
+
+			m_cbBuffered = 0;
+
+			DWORD CurChunkSignature = GetBigEndianDword(m_pBuffer);
+			m_cbChunkLeft = GetBigEndianDword(m_pBuffer + 4);
+
+			//   ,   "MTrk",    
+			if (CurChunkSignature == 'MTrk' && m_cbChunkLeft > 0)
+			{
+				m_State = STREAM_STATE_TRACK;
+				m_cbSkip = 0;
+				m_ctCurTime = 0;
+				m_RunningStatus = EMPTY_RUNNING_STATUS;
+			}
+			else
+			{
+				m_State = STREAM_STATE_SKIP_CHUNK;
+			}
+
+			continue;
+		}
+
+		case STREAM_STATE_SKIP_CHUNK:
+		{
+			DWORD cbSkip = m_cbChunkLeft;
+			if (cbSkip > m_cbInput) cbSkip = m_cbInput;
+
+			Consume(cbSkip);
+			m_cbChunkLeft -= cbSkip;
+
+			if (m_cbChunkLeft == 0)
+			{
+				m_State = STREAM_STATE_CHUNK_HEADER;
+			}
+			else if (m_bEndOfInput)
+			{
+				m_State = STREAM_STATE_END;
+			}
+			else
+			{
+				return MIDISTREAM_NEED_MORE_DATA;
+			}
+
+			continue;
+		}
+
+		case STREAM_STATE_TRACK:
+			return ReadTrackEvent(pEvent);
+
+		case STREAM_STATE_END:
+			return MIDISTREAM_END;
+
+		default:
+			return m_Error;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    GetFormat  GetTicksPerMidiQuarterNote
+*
+*   
+*       
+*
+*    
+*        MIDI-      MIDI- .
+*
+*       .     ,
+*     GetNextEvent   MIDISTREAM_HEADER.
+*
+****************************************************************************************/
+
+DWORD MidiStreamParser::GetFormat()
+{
+	return m_Format;
+}
+
+DWORD MidiStreamParser::GetTicksPerMidiQuarterNote()
+{
+	return m_cTicksPerMidiQuarterNote;
+}
+
+/****************************************************************************************
+*
+*    Gather
+*
+*   
+*       cbNeeded -      m_pBuffer
+*
+*    
+*       true,    m_pBuffer  cbNeeded ; false,  
+*          .
+*
+*      m_pBuffer     ,     
+*   cbNeeded.
+*
+****************************************************************************************/
+
+bool MidiStreamParser::Gather(
+	__in DWORD cbNeeded)
+{
+	DWORD cbCopy = cbNeeded - m_cbBuffered;
+	if (cbCopy > m_cbInput) cbCopy = m_cbInput;
+
+	if (cbCopy > 0)
+	{
+		CopyMemory(m_pBuffer + m_cbBuffered, m_pInput, cbCopy);
+		m_cbBuffered += cbCopy;
+		Consume(cbCopy);
+	}
+
+	return m_cbBuffered == cbNeeded;
+}
+
+/****************************************************************************************
+*
+*    Consume
+*
+*   
+*       cbBytes -  
+*
+*    
+*       
+*
+*    cbBytes     .
+*
+****************************************************************************************/
+
+void MidiStreamParser::Consume(
+	__in DWORD cbBytes)
+{
+	m_pInput += cbBytes;
+	m_cbInput -= cbBytes;
+}
+
+/****************************************************************************************
+*
+*    ReadTrackEvent
+*
+*   
+*       pEvent -   ,      
+*
+*    
+*       MIDISTREAM_EVENT, MIDISTREAM_TRACK_END, MIDISTREAM_NEED_MORE_DATA 
+*       MIDISTREAM_INVALID_TRACK (.   GetNextEvent).
+*
+*         ,    
+*     .       , 
+*    ( ,     MidiTrack::AttachToTrack).
+*
+****************************************************************************************/
+
+MIDISTREAMRESULT MidiStreamParser::ReadTrackEvent(
+	__out MIDISTREAMEVENT *pEvent)
+{
+	while (true)
+	{
+		//   ,    
+		if (m_cbSkip > 0)
+		{
+			DWORD cbSkip = m_cbSkip;
+			if (cbSkip > m_cbInput) cbSkip = m_cbInput;
+
+			Consume(cbSkip);
+			m_cbChunkLeft -= cbSkip;
+			m_cbSkip -= cbSkip;
+
+			if (m_cbSkip > 0)
+			{
+				if (!m_bEndOfInput) return MIDISTREAM_NEED_MORE_DATA;
+
+				return EndTrack(pEvent);
+			}
+		}
+
+		if (m_cbBuffered == 0)
+		{
+			if (m_cbChunkLeft == 0) return EndTrack(pEvent);
+
+			//     
+			if (m_cbInput == 0)
+			{
+				if (!m_bEndOfInput) return MIDISTREAM_NEED_MORE_DATA;
+
+				return EndTrack(pEvent);
+			}
+		}
+
+		//         :  
+		//     ,     
+		//   
+		BYTE *pEventBytes;
+		DWORD cbAvailable;
+
+		//   ,        
+		DWORD cbTrackLeft;
+
+		if (m_cbBuffered == 0)
+		{
+			pEventBytes = m_pInput;
+			cbAvailable = m_cbChunkLeft;
+			if (cbAvailable > m_cbInput) cbAvailable = m_cbInput;
+			cbTrackLeft = m_cbChunkLeft - cbAvailable;
+		}
+		else
+		{
+			pEventBytes = m_pBuffer;
+			cbAvailable = m_cbBuffered;
+			cbTrackLeft = m_cbChunkLeft;
+		}
+
+		PARSEDEVENT ParsedEvent;
+
+		DWORD ParseResult = ParseEvent(pEventBytes, cbAvailable, m_RunningStatus,
+			&ParsedEvent);
+
+		if (ParseResult == PARSE_INVALID)
+		{
+			//    MidiFile  ,   
+			// ,      
+			LOG("running status is not set\n");
+			m_cbBuffered = 0;
+			m_State = STREAM_STATE_SKIP_CHUNK;
+			return MIDISTREAM_INVALID_TRACK;
+		}
+
+		if (ParseResult == PARSE_COMPLETE)
+		{
+			if (m_cbBuffered == 0)
+			{
+				Consume(ParsedEvent.cbEvent);
+				m_cbChunkLeft -= ParsedEvent.cbEvent;
+			}
+			else
+			{
+				//  ,      
+				//    GetNextEvent
+				m_cbBuffered = 0;
+			}
+
+			m_RunningStatus = ParsedEvent.RunningStatus;
+			m_ctCurTime += ParsedEvent.ctDeltaTime;
+
+			//         
+			if (ParsedEvent.Event == END_OF_TRACK) continue;
+
+			pEvent->iTrack = m_iTrack;
+			pEvent->ctEventTime = m_ctCurTime;
+			pEvent->Event = ParsedEvent.Event;
+			pEvent->pDataBytes = pEventBytes + ParsedEvent.DataOffset;
+			pEvent->Channel = ParsedEvent.Channel;
+			pEvent->cbData = ParsedEvent.cbData;
+
+			return MIDISTREAM_EVENT;
+		}
+
+		//      
+
+		if (ParsedEvent.cbEvent - cbAvailable > cbTrackLeft)
+		{
+			//     ;     
+			// 
+			m_cbSkip = m_cbChunkLeft;
+			m_cbBuffered = 0;
+
+			if (m_cbSkip == 0) return EndTrack(pEvent);
+
+			continue;
+		}
+
+		if (ParsedEvent.cbEvent > MAX_STREAM_EVENT_SIZE)
+		{
+			if (!ParsedEvent.bSizeKnown)
+			{
+				//      -  ;
+				//   
+				LOG("variable-length quantity is too long\n");
+				m_cbSkip = m_cbChunkLeft;
+				m_cbBuffered = 0;
+
+				if (m_cbSkip == 0) return EndTrack(pEvent);
+
+				continue;
+			}
+
+			//     ;  ,  
+			// - (     )
+			LOG("event of %u bytes is skipped\n", ParsedEvent.cbEvent);
+			m_ctCurTime += ParsedEvent.ctDeltaTime;
+			m_cbSkip = ParsedEvent.cbEvent - m_cbBuffered;
+			m_cbBuffered = 0;
+
+			continue;
+		}
+
+		//            
+		//  ,   ,     
+		if (m_cbBuffered == 0)
+		{
+			CopyMemory(m_pBuffer, m_pInput, cbAvailable);
+			m_cbBuffered = cbAvailable;
+			Consume(cbAvailable);
+			m_cbChunkLeft -= cbAvailable;
+		}
+
+		DWORD cbCopy = ParsedEvent.cbEvent - m_cbBuffered;
+		if (cbCopy > m_cbInput) cbCopy = m_cbInput;
+		if (cbCopy > m_cbChunkLeft) cbCopy = m_cbChunkLeft;
+
+		if (cbCopy == 0)
+		{
+			if (!m_bEndOfInput) return MIDISTREAM_NEED_MORE_DATA;
+
+			//     
+			m_cbBuffered = 0;
+			return EndTrack(pEvent);
+		}
+
+		CopyMemory(m_pBuffer + m_cbBuffered, m_pInput, cbCopy);
+		m_cbBuffered += cbCopy;
+		Consume(cbCopy);
+		m_cbChunkLeft -= cbCopy;
+	}
+}
+
+/****************************************************************************************
+*
+*    EndTrack
+*
+*   
+*       pEvent -   ,       
+*                 
+*
+*    
+*       MIDISTREAM_TRACK_END.
+*
+*           .   
+*     ,        .
+*
+****************************************************************************************/
+
+MIDISTREAMRESULT MidiStreamParser::EndTrack(
+	__out MIDISTREAMEVENT *pEvent)
+{
+	pEvent->iTrack = m_iTrack;
+	pEvent->ctEventTime = m_ctCurTime;
+
+	m_iTrack++;
+	m_State = (m_cbChunkLeft == 0) ? STREAM_STATE_CHUNK_HEADER : STREAM_STATE_END;
+
+	return MIDISTREAM_TRACK_END;
+}
+
+/****************************************************************************************
+*
+*    Fail
+*
+*   
+*       Error -  
+*
+*    
+*         Error.
+*
+*     ;    GetNextEvent    
+*   .
+*
+****************************************************************************************/
+
+MIDISTREAMRESULT MidiStreamParser::Fail(
+	__in MIDISTREAMRESULT Error)
+{
+	m_State = STREAM_STATE_ERROR;
+	m_Error = Error;
+
+	return Error;
+}
+
+/****************************************************************************************
+*
+*    ParseEvent
+*
+*   
+*       pBytes -      (   -)
+*       cbBytes -    
+*       RunningStatus -    
+*       pEvent -   ,      
+*
+*    
+*       PARSE_COMPLETE -  ,    pEvent ;
+*       PARSE_INCOMPLETE -      , 
+*                           cbEvent  bSizeKnown,   bSizeKnown  true, 
+*                            ctDeltaTime;
+*       PARSE_INVALID -     ,     .
+*
+*        ,    
+*   MidiTrack::AttachToTrack.
+*
+****************************************************************************************/
+
+static DWORD ParseEvent(
+	__in BYTE *pBytes,
+	__in DWORD cbBytes,
+	__in BYTE RunningStatus,
+	__out PARSEDEVENT *pEvent)
+{
+	//      
+	BYTE *pLastByte = pBytes + cbBytes - 1;
+
+	//    
+	BYTE *pCurByte = pBytes;
+
+	//    ,         
+	pEvent->cbEvent = cbBytes + 1;
+	pEvent->bSizeKnown = false;
+
+	if (!ReadVLQ(&pCurByte, pLastByte, &pEvent->ctDeltaTime)) return PARSE_INCOMPLETE;
+	if (pCurByte > pLastByte) return PARSE_INCOMPLETE;
+
+	//      
+	BYTE *pEventData;
+
+	if (*pCurByte < 0xF0)
+	{
+		//   MIDI-
+
+		if (*pCurByte & 0x80)
+		{
+			//     
+			RunningStatus = *pCurByte;
+			pCurByte++;
+		}
+		else if (RunningStatus == EMPTY_RUNNING_STATUS)
+		{
+			return PARSE_INVALID;
+		}
+
+		pEventData = pCurByte;
+		pEvent->Event = RunningStatus & 0xF0;
+		pEvent->Channel = RunningStatus & 0x0F;
+		pEvent->cbData = g_cbChannelEventData[pEvent->Event >> 4];
+	}
+	else
+	{
+		//   SysEx-,  
+
+		//     
+		BYTE *pStatusByte = pCurByte;
+
+		pEventData = pStatusByte + ((*pStatusByte == 0xFF) ? 2 : 1);
+		pCurByte = pEventData;
+
+		if (!ReadVLQ(&pCurByte, pLastByte, &pEvent->cbData)) return PARSE_INCOMPLETE;
+
+		pEvent->Event = (*pStatusByte == 0xFF) ? pStatusByte[1] : *pStatusByte;
+		pEvent->Channel = 0;
+	}
+
+	pEvent->DataOffset = (DWORD) (pEventData - pBytes);
+	pEvent->cbEvent = (DWORD) (pCurByte - pBytes) + pEvent->cbData;
+	pEvent->bSizeKnown = true;
+
+	if (pEvent->cbEvent > cbBytes) return PARSE_INCOMPLETE;
+
+	//      NOTE_ON  ,
+	//       NOTE_OFF
+	if (pEvent->Event == NOTE_ON && pEventData[1] == 0) pEvent->Event = NOTE_OFF;
+
+	pEvent->RunningStatus = RunningStatus;
+
+	return PARSE_COMPLETE;
+}
@@ -0,0 +1,151 @@
+/****************************************************************************************
+*
+*     MidiStreamParser
+*
+*       MIDI-,     ( ,
+*   ,   ..),       ,  
+*    ,     .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//    (  -),    
+//    ;     
+#define MAX_STREAM_EVENT_SIZE		65536
+
+//     GetNextEvent
+enum MIDISTREAMRESULT
+{
+	MIDISTREAM_HEADER,
+	MIDISTREAM_EVENT,
+	MIDISTREAM_TRACK_END,
+	MIDISTREAM_NEED_MORE_DATA,
+	MIDISTREAM_END,
+	MIDISTREAM_INVALID_FORMAT,
+	MIDISTREAM_UNSUPPORTED_FORMAT,
+	MIDISTREAM_INVALID_TRACK,
+	MIDISTREAM_CANT_ALLOC_MEMORY
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,  ,    GetNextEvent
+struct MIDISTREAMEVENT
+{
+	DWORD iTrack; //   ( ,     MidiFile)
+	DWORD ctEventTime; //       ; 
+					   // MIDISTREAM_TRACK_END -    
+	DWORD Event; //   ( ,    MidiTrack::GetEvent)
+	BYTE *pDataBytes; //       ( ,   
+					  // MidiTrack::GetEvent);    
+					  //  GetNextEvent  Feed
+	DWORD Channel; //    MIDI-,    - 0
+	DWORD cbData; //     
+};
+
+/****************************************************************************************
+*
+*    MidiStreamParser
+*
+****************************************************************************************/
+
+class MidiStreamParser
+{
+	//    (   STREAM_STATE_*)
+	DWORD m_State;
+
+	//  ,    GetNextEvent   
+	MIDISTREAMRESULT m_Error;
+
+	//        
+	BYTE *m_pInput;
+
+	//      
+	DWORD m_cbInput;
+
+	// true,     
+	bool m_bEndOfInput;
+
+	// ,      ,   
+	// ;       GetNextEvent
+	BYTE *m_pBuffer;
+
+	//     m_pBuffer
+	DWORD m_cbBuffered;
+
+	//    ,      
+	DWORD m_cbChunkLeft;
+
+	//    ,      
+	DWORD m_cbSkip;
+
+	//   
+	DWORD m_iTrack;
+
+	//          
+	DWORD m_ctCurTime;
+
+	//    MIDI-  
+	BYTE m_RunningStatus;
+
+	//  MIDI-      MIDI-   
+	DWORD m_Format;
+	DWORD m_cTicksPerMidiQuarterNote;
+
+public:
+
+	MidiStreamParser();
+	~MidiStreamParser();
+
+	//      
+	void Reset();
+
+	//      
+	bool Feed(
+		__in_opt BYTE *pBytes,
+		__in DWORD cbBytes);
+
+	//  ,      
+	void SetEndOfInput();
+
+	//     ,      
+	MIDISTREAMRESULT GetNextEvent(
+		__out MIDISTREAMEVENT *pEvent);
+
+	//     
+	DWORD GetFormat();
+	DWORD GetTicksPerMidiQuarterNote();
+
+private:
+
+	//        ,      cbNeeded
+	bool Gather(
+		__in DWORD cbNeeded);
+
+	//  cbBytes     
+	void Consume(
+		__in DWORD cbBytes);
+
+	//    
+	MIDISTREAMRESULT ReadTrackEvent(
+		__out MIDISTREAMEVENT *pEvent);
+
+	//   
+	MIDISTREAMRESULT EndTrack(
+		__out MIDISTREAMEVENT *pEvent);
+
+	//   
+	MIDISTREAMRESULT Fail(
+		__in MIDISTREAMRESULT Error);
+};
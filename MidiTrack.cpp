@@ -23,6 +23,10 @@
 //   
 #define EMPTY_RUNNING_STATUS	0x00
 
+//     :    DWORD    
+// BYTE
+#define EVENT_TABLE_ENTRY_SIZE	(3 * sizeof(DWORD) + 2 * sizeof(BYTE))
+
 /****************************************************************************************
 *
 *   
@@ -41,8 +45,13 @@ MidiTrack::MidiTrack()
 {
 	m_pFirstTrackEvent = NULL;
 	m_pLastByteOfTrack = NULL;
-	m_pCurByte = NULL;
-	m_RunningStatus = EMPTY_RUNNING_STATUS;
+
+	m_pctEventTime = NULL;
+	m_pDataOffset = NULL;
+	m_pcbData = NULL;
+	m_pEvent = NULL;
+	m_pChannel = NULL;
+	m_cEvents = 0;
 }
 
 /****************************************************************************************
@@ -55,12 +64,13 @@ MidiTrack::MidiTrack()
 *    
 *       
 *
-*     .
+*       .
 *
 ****************************************************************************************/
 
 MidiTrack::~MidiTrack()
 {
+	FreeEventTable();
 }
 
 /****************************************************************************************
@@ -72,19 +82,29 @@ MidiTrack::~MidiTrack()
 *       cbTrack -  ,    
 *
 *    
-*       true -     ;
-*       false -   MIDI-   .
+*       MIDITRACK_SUCCESS -     ;
+*       MIDITRACK_INVALID_TRACK -   MIDI-   ;
+*       MIDITRACK_CANT_ALLOC_MEMORY -       .
 *
-*        MIDI-.
+*        MIDI-      
+*   ,       GetEvent.  ,  
+*      ,        .
 *
 *   
 *
 *         ,    
 *   (    m_pLastByteOfTrack).
 *
+*        ,     .  
+*         (-       
+*    ),         
+*      ,       
+*           .   
+*        g_cbChannelEventData  MidiLibrary.
+*
 ****************************************************************************************/
 
-bool MidiTrack::AttachToTrack(
+MIDITRACKRESULT MidiTrack::AttachToTrack(
 	__in BYTE *pFirstByteOfTrack,
 	__in DWORD cbTrack)
 {
@@ -100,17 +120,58 @@ bool MidiTrack::AttachToTrack(
 	//  
 	BYTE RunningStatus = EMPTY_RUNNING_STATUS;
 
+	//    ,    
+	DWORD ctCurTime = 0;
+
+	//       - ,   
+	// 
+	FreeEventTable();
+
+	//       
+	DWORD cMaxEvents = cbTrack / 2;
+
+	if (cMaxEvents != 0)
+	{
+		//     :     DWORD  
+		//    BYTE
+		m_pctEventTime = (DWORD *) HeapAlloc(GetProcessHeap(), 0,
+			cMaxEvents * EVENT_TABLE_ENTRY_SIZE);
+
+		if (m_pctEventTime == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return MIDITRACK_CANT_ALLOC_MEMORY;
+		}
+
+		m_pDataOffset = m_pctEventTime + cMaxEvents;
+		m_pcbData = m_pDataOffset + cMaxEvents;
+		m_pEvent = (BYTE *) (m_pcbData + cMaxEvents);
+		m_pChannel = m_pEvent + cMaxEvents;
+	}
+
 	//   
 	while (pCurByte <= pLastByteOfTrack)
 	{
-		//   -
-		while (pCurByte <= pLastByteOfTrack && *pCurByte & 0x80) pCurByte++;
+		// -   
+		DWORD ctDeltaTime;
+
+		//  -           ,
+		//  
+		if (!ReadVLQ(&pCurByte, pLastByteOfTrack, &ctDeltaTime)) break;
+		if (pCurByte > pLastByteOfTrack) break;
+
+		//  :   MIDI-,    
+		// SysEx-
+		DWORD Event;
 
-		//    ,     -
-		pCurByte++;
+		//      
+		BYTE *pEventData;
 
-		//     ,  
-		if (pCurByte > pLastByteOfTrack) goto exit;
+		//     
+		DWORD cbEventData;
+
+		//   
+		BYTE EventChannel = 0;
 
 		if (*pCurByte < 0xF0)
 		{
@@ -122,311 +183,231 @@ bool MidiTrack::AttachToTrack(
 				RunningStatus = *pCurByte;
 				pCurByte++;
 			}
-			else
+			else if (RunningStatus == EMPTY_RUNNING_STATUS)
 			{
-				//     ;
-				// ,    
-				if (RunningStatus == EMPTY_RUNNING_STATUS) return false;
+				//     ,     
+				FreeEventTable();
+				return MIDITRACK_INVALID_TRACK;
 			}
 
-			//    MIDI-
-			BYTE Event = RunningStatus & 0xF0;
+			pEventData = pCurByte;
+			Event = RunningStatus & 0xF0;
+			EventChannel = RunningStatus & 0x0F;
+			cbEventData = g_cbChannelEventData[Event >> 4];
 
-			//      ,  
-			pCurByte += 2;
+			//      ,  
+			if (cbEventData > (DWORD) (pLastByteOfTrack + 1 - pCurByte)) break;
 
-			if (Event == PROGRAM_CHANGE || Event == CHANNEL_AFTER_TOUCH)
-			{
-				//  PROGRAM_CHANGE  CHANNEL_AFTER_TOUCH    
-				pCurByte--;
-			}
+			pCurByte += cbEventData;
+
+			//      NOTE_ON  ,
+			//       NOTE_OFF
+			if (Event == NOTE_ON && pEventData[1] == 0) Event = NOTE_OFF;
 		}
 		else
 		{
 			//   SysEx-,  
 
-			if (*pCurByte == 0xFF)
-			{
-				//  ;       
-				pCurByte += 2;
-			}
-			else
-			{
-				//  SysEx-;    
-				pCurByte++;
-			}
+			//     
+			BYTE *pStatusByte = pCurByte;
 
-			DWORD dwValue = 0;
-			BYTE CurByte;
-			DWORD cbVLQ = 0;
+			//    ,    -   
+			// 
+			pCurByte += (*pStatusByte == 0xFF) ? 2 : 1;
 
-			//      SysEx-  
-			do
-			{
-				//     ,  
-				if (pCurByte > pLastByteOfTrack) goto exit;
+			//      ;     
+			// ,  
+			if (!ReadVLQ(&pCurByte, pLastByteOfTrack, &cbEventData)) break;
 
-				CurByte = *pCurByte;
+			//      ,   
+			//   
+			Event = (*pStatusByte == 0xFF) ? pStatusByte[1] : *pStatusByte;
 
-				dwValue = (dwValue << 7) + (CurByte & 0x7F);
+			//      ;   
+			// SysEx-      ,  
+			// 
+			pEventData = pStatusByte + ((*pStatusByte == 0xFF) ? 2 : 1);
 
-				pCurByte++;
-				cbVLQ++;
-			}
-			while (CurByte & 0x80);
+			//      ,  
+			if (cbEventData > (DWORD) (pLastByteOfTrack + 1 - pCurByte)) break;
 
-			//        ,
-			//    
-			if (cbVLQ <= 4) pCurByte += dwValue;
+			pCurByte += cbEventData;
 		}
 
-		if (pCurByte <= pLastByteOfTrack + 1)
-		{
-			//       
-			pLastByteOfCurEvent = pCurByte - 1;
-		}
-	}
+		//       
+		pLastByteOfCurEvent = pCurByte - 1;
+
+		//    (  ,    )
+		ctCurTime += ctDeltaTime;
 
-exit:
+		//           
+		if (Event == END_OF_TRACK) continue;
+
+		m_pctEventTime[m_cEvents] = ctCurTime;
+		m_pDataOffset[m_cEvents] = (DWORD) (pEventData - pFirstByteOfTrack);
+		m_pcbData[m_cEvents] = cbEventData;
+		m_pEvent[m_cEvents] = (BYTE) Event;
+		m_pChannel[m_cEvents] = EventChannel;
+		m_cEvents++;
+	}
 
 	m_pFirstTrackEvent = pFirstByteOfTrack;
 	m_pLastByteOfTrack = pLastByteOfCurEvent;
-	m_RunningStatus = EMPTY_RUNNING_STATUS;
 
-	return true;
+	if (m_cEvents == 0)
+	{
+		//       ,    
+		FreeEventTable();
+	}
+	else if (m_cEvents < cMaxEvents)
+	{
+		//       ;   
+		//   ,       
+		DWORD *pDataOffset = m_pctEventTime + m_cEvents;
+		DWORD *pcbData = pDataOffset + m_cEvents;
+		BYTE *pEvent = (BYTE *) (pcbData + m_cEvents);
+		BYTE *pChannel = pEvent + m_cEvents;
+
+		MoveMemory(pDataOffset, m_pDataOffset, m_cEvents * sizeof(DWORD));
+		MoveMemory(pcbData, m_pcbData, m_cEvents * sizeof(DWORD));
+		MoveMemory(pEvent, m_pEvent, m_cEvents * sizeof(BYTE));
+		MoveMemory(pChannel, m_pChannel, m_cEvents * sizeof(BYTE));
+
+		m_pDataOffset = pDataOffset;
+		m_pcbData = pcbData;
+		m_pEvent = pEvent;
+		m_pChannel = pChannel;
+
+		//     ,     
+		// ;    ,     
+		HeapReAlloc(GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY, m_pctEventTime,
+			m_cEvents * EVENT_TABLE_ENTRY_SIZE);
+	}
+
+	return MIDITRACK_SUCCESS;
 }
 
 /****************************************************************************************
 *
-*    ResetCurrentPosition
+*    GetEventCount
 *
 *   
-*       
+*       
 *
 *    
-*       
+*            .
 *
-*        .
+*      ,    END_OF_TRACK.
 *
 ****************************************************************************************/
 
-void MidiTrack::ResetCurrentPosition()
+DWORD MidiTrack::GetEventCount()
 {
-	m_pCurByte = m_pFirstTrackEvent;
-	m_RunningStatus = EMPTY_RUNNING_STATUS;
+	return m_cEvents;
 }
 
 /****************************************************************************************
 *
-*    GetNextEvent
+*    GetMemorySize
 *
 *   
-*       pctDeltaTime -   ,     -
-*                       ;      NULL
-*       ppDataBytes -   ,      
-*                         ;  MIDI- - 
-*                       ,     , 
-*                      -    ,    
-*       pChannel -   ,      
-*                   ,     MIDI-; 
-*                      MIDI-,    
-*                   ;      NULL;  
-*                      NULL
+*       
 *
 *    
-*        :   MIDI-,   ( END_OF_TRACK),
-*        SysEx-   REAL_TRACK_END.
+*            .
 *
-*      .    AttachToTrack 
-*   ResetCurrentPosition      .  
-*     REAL_TRACK_END        
-*     END_OF_TRACK.     REAL_TRACK_END, 
-*   ,     pcTicks, ppDataBytes  pChannel, 
-*   .
-*
-*   
-*
-*         GetNextRawEvent.   
-*          .
+*     ,     . 
+*          (.  AttachToTrack),
+*        .
 *
 ****************************************************************************************/
 
-DWORD MidiTrack::GetNextEvent(
-	__out_opt DWORD *pctDeltaTime,
-	__out BYTE **ppDataBytes,
-	__out_opt DWORD *pChannel)
+DWORD MidiTrack::GetMemorySize()
 {
-	if (m_pCurByte == NULL)	return REAL_TRACK_END;
-
-	DWORD Event;
-	DWORD ctDeltaTime, ctTotalDeltaTime = 0;
-
-	do
-	{
-    	Event = GetNextRawEvent(&ctDeltaTime, ppDataBytes, pChannel);
-    	ctTotalDeltaTime += ctDeltaTime;
-    }
-	while (Event == END_OF_TRACK);
-
-	if (pctDeltaTime != NULL) *pctDeltaTime = ctTotalDeltaTime;
-
-	return Event;
+	return m_cEvents * EVENT_TABLE_ENTRY_SIZE;
 }
 
 /****************************************************************************************
 *
-*    GetNextRawEvent
+*    GetEvent
 *
 *   
-*       pctDeltaTime -   ,     -
-*                       
+*       iEvent -      
+*       pctEventTime -   ,     
+*                      ,        ;
+*                           NULL
 *       ppDataBytes -   ,      
-*                         ;  MIDI- - 
-*                       ,     , 
-*                      -    ,    
+*                        ;  MIDI- -   
+*                     ,     ,   -
+*                        ,    
 *       pChannel -   ,      
-*                   ,     MIDI-; 
-*                      MIDI-,    
-*                   ;      NULL;  
+*                  ,     MIDI-;   
+*                    MIDI-,     
+*                  ;      NULL;  
 *                      NULL
+*       pcbData -   ,       
+*                   (   SysEx- -   
+*                  ,   );    
+*                  NULL;       NULL
 *
 *    
-*        :   MIDI-,   ( END_OF_TRACK),
-*        SysEx-   REAL_TRACK_END.
+*        :   MIDI-,   ( END_OF_TRACK),
+*        SysEx-   REAL_TRACK_END,   iEvent   
+*          .
 *
-*      .    AttachToTrack 
-*   ResetCurrentPosition      .  
-*     REAL_TRACK_END    .    
-*   REAL_TRACK_END,  ,     pcTicks, ppDataBytes 
-*   pChannel,  .
+*           .  
+*     REAL_TRACK_END,  ,    
+*   pctEventTime, ppDataBytes, pChannel  pcbData,  .   
+*    ,      
+*        ,    .
 *
 ****************************************************************************************/
 
-DWORD MidiTrack::GetNextRawEvent(
-	__out DWORD *pctDeltaTime,
+DWORD MidiTrack::GetEvent(
+	__in DWORD iEvent,
+	__out_opt DWORD *pctEventTime,
 	__out BYTE **ppDataBytes,
-	__out_opt DWORD *pChannel)
+	__out_opt DWORD *pChannel,
+	__out_opt DWORD *pcbData)
 {
-	if (m_pCurByte > m_pLastByteOfTrack) return REAL_TRACK_END;
-
-	//   -
-	*pctDeltaTime = GetNumberFromVLQ(&m_pCurByte);
-
-	//   MIDI- (  SysEx),   
-	BYTE Event;
-
-	if (*m_pCurByte < 0xF0)
-	{
-		//   MIDI-
-
-		if (*m_pCurByte & 0x80)
-		{
-			//     
-			m_RunningStatus = *m_pCurByte;
-			m_pCurByte ++;
-		}
-
-		//       
-		*ppDataBytes = m_pCurByte;
-
-		//    MIDI-
-		Event = m_RunningStatus & 0xF0;
-
-		//    
-		if (pChannel != NULL) *pChannel = m_RunningStatus & 0x0F;
-
-		if (Event == NOTE_ON)
-		{
-			//      NOTE_ON  ,
-			//       NOTE_OFF
-			if (m_pCurByte[1] == 0) Event = NOTE_OFF;
-		}
-
-		//   m_pCurByte    
+	if (iEvent >= m_cEvents) return REAL_TRACK_END;
 
-		m_pCurByte += 2;
+	if (pctEventTime != NULL) *pctEventTime = m_pctEventTime[iEvent];
 
-		if (Event == PROGRAM_CHANGE || Event == CHANNEL_AFTER_TOUCH)
-		{
-			m_pCurByte --;
-		}
-	}
-	else
-	{
-		//   SysEx-,  
-
-		if (*m_pCurByte == 0xFF)
-		{
-			//  
+	*ppDataBytes = m_pFirstTrackEvent + m_pDataOffset[iEvent];
 
-			//    
-			m_pCurByte ++;
+	if (pChannel != NULL) *pChannel = m_pChannel[iEvent];
 
-			//   
-			Event = *m_pCurByte;
+	if (pcbData != NULL) *pcbData = m_pcbData[iEvent];
 
-			//   
-			m_pCurByte ++;
-
-			//       
-			*ppDataBytes = m_pCurByte;
-
-			//      
-			DWORD cbData = GetNumberFromVLQ(&m_pCurByte);
-
-			//   m_pCurByte    
-			m_pCurByte += cbData;
-		}
-		else
-		{
-			//  SysEx-
-
-			//   SysEx-
-			Event = *m_pCurByte;
-
-			//    
-			m_pCurByte ++;
-
-			//       
-			*ppDataBytes = m_pCurByte;
-
-			//      
-			DWORD cbData = GetNumberFromVLQ(&m_pCurByte);
-
-			//   m_pCurByte    
-			m_pCurByte += cbData;
-		}
-	}
-
-	return Event;
+	return m_pEvent[iEvent];
 }
 
 /****************************************************************************************
 *
-*    Duplicate
+*    FreeEventTable
 *
 *   
 *       
 *
 *    
-*            MidiTrack  NULL   .
+*       
 *
-*      .
+*       .
 *
 ****************************************************************************************/
 
-MidiTrack *MidiTrack::Duplicate()
+void MidiTrack::FreeEventTable()
 {
-	MidiTrack *pNewMidiTrack = new MidiTrack;
-
-	if (pNewMidiTrack == NULL)
+	if (m_pctEventTime != NULL)
 	{
-		LOG("operator new failed\n");
-		return NULL;
+		HeapFree(GetProcessHeap(), 0, m_pctEventTime);
+		m_pctEventTime = NULL;
 	}
 
-	pNewMidiTrack->AttachToTrack(m_pFirstTrackEvent,
-		m_pLastByteOfTrack - m_pFirstTrackEvent + 1);
-
-	return pNewMidiTrack;
+	m_pDataOffset = NULL;
+	m_pcbData = NULL;
+	m_pEvent = NULL;
+	m_pChannel = NULL;
+	m_cEvents = 0;
 }
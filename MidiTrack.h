@@ -44,10 +44,17 @@
 #define MULTIPACK					0xF0
 #define PACKET 						0xF7
 
-// ,   GetNextEvent  GetNextRawEvent,
-//    
+// ,   GetEvent    
 #define REAL_TRACK_END				0xFFFFFFFF
 
+//     AttachToTrack
+enum MIDITRACKRESULT
+{
+	MIDITRACK_SUCCESS,
+	MIDITRACK_INVALID_TRACK,
+	MIDITRACK_CANT_ALLOC_MEMORY
+};
+
 /****************************************************************************************
 *
 *    MidiTrack
@@ -62,39 +69,55 @@ class MidiTrack
 	//     
 	BYTE *m_pLastByteOfTrack;
 
-	//     
-	BYTE *m_pCurByte;
+	//     (  END_OF_TRACK); 
+	//      ,    
+	// ,      m_pctEventTime:
+
+	// ,         
+	DWORD *m_pctEventTime;
+
+	// ,        
+	//   
+	DWORD *m_pDataOffset;
+
+	// ,       
+	DWORD *m_pcbData;
 
-	//    MIDI-
-	BYTE m_RunningStatus;
+	// ,    
+	BYTE *m_pEvent;
+
+	// ,      MIDI-
+	BYTE *m_pChannel;
+
+	//    
+	DWORD m_cEvents;
 
 public:
 
 	MidiTrack();
 	~MidiTrack();
 
-	//      MIDI-
-	bool AttachToTrack(
+	//      MIDI-    
+	MIDITRACKRESULT AttachToTrack(
 		__in BYTE *pFirstByteOfTrack,
 		__in DWORD cbTrack);
 
-	//      
-	void ResetCurrentPosition();
+	//    ,    END_OF_TRACK
+	DWORD GetEventCount();
 
-	//   ,   END_OF_TRACK
-	DWORD GetNextEvent(
-		__out_opt DWORD *pctDeltaTime,
-		__out BYTE **ppDataBytes,
-		__out_opt DWORD *pChannel = NULL);
+	//   ,    
+	DWORD GetMemorySize();
 
-	//    
-	MidiTrack *Duplicate();
+	//      
+	DWORD GetEvent(
+		__in DWORD iEvent,
+		__out_opt DWORD *pctEventTime,
+		__out BYTE **ppDataBytes,
+		__out_opt DWORD *pChannel = NULL,
+		__out_opt DWORD *pcbData = NULL);
 
 private:
 
-	//   ,   END_OF_TRACK
-	DWORD GetNextRawEvent(
-		__out DWORD *pctDeltaTime,
-		__out BYTE **ppDataBytes,
-		__out_opt DWORD *pChannel);
-};
+	//     
+	void FreeEventTable();
+};
\ No newline at end of file
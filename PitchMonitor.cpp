@@ -0,0 +1,378 @@
+/****************************************************************************************
+*
+*          
+*
+*      WAV-,        
+*     ( PitchSource    )     
+*      ,  ,     
+*          .   
+*   :  ,     . 
+*        ,     
+*   ,   ( 20 ),     
+*         .
+*
+*    :
+*   SingoscopePitch <WAV- | stdin | mic> [<>=<> ...]
+*
+*   stdin   PCM 16 ,  ,     ;
+*   mic -       .    
+*       Ctrl+C.
+*
+*    (     ):
+*       block -     (256)
+*       blocks -      (32)
+*       rate -    stdin  mic (44100)
+*       realtime - 1,  WAV-       
+*                   (    ); 0,  
+*                    (1)
+*       quiet - 1,    ;  0 (0)
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <locale.h>
+
+#include "Log.h"
+#include "Trace.h"
+#include "AudioRing.h"
+#include "PitchSource.h"
+#include "FilePitchSource.h"
+#include "WaveInPitchSource.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//        
+#define MAX_PARAMETER_NAME_LENGTH		31
+
+//   ,     Ctrl+C,   
+#define PITCH_WAIT_TIMEOUT				100
+
+//          
+#define A4_NOTE_NUMBER					69
+#define A4_FREQUENCY					440.0
+
+//   
+#define EXIT_CODE_SUCCESS				0
+#define EXIT_CODE_START_FAILED			1
+#define EXIT_CODE_INVALID_ARGUMENTS		2
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,    
+struct PARAMETER
+{
+	LPCTSTR pszName; //  
+	DWORD *pValue; //      
+	DWORD MinValue; //    
+	DWORD MaxValue; //    
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//    
+static DWORD g_cSamplesPerBlock = 256;
+static DWORD g_cRingBlocks = 32;
+static DWORD g_SampleRate = 44100;
+static DWORD g_bIsRealTime = 1;
+static DWORD g_bIsQuiet = 0;
+
+//    
+static const PARAMETER g_Parameters[] =
+{
+	{TEXT("block"), &g_cSamplesPerBlock, 16, 65536},
+	{TEXT("blocks"), &g_cRingBlocks, 2, 4096},
+	{TEXT("rate"), &g_SampleRate, 8000, 192000},
+	{TEXT("realtime"), &g_bIsRealTime, 0, 1},
+	{TEXT("quiet"), &g_bIsQuiet, 0, 1}
+};
+
+//    
+static const LPCTSTR g_pszNoteNames[12] =
+{
+	TEXT("C"), TEXT("C#"), TEXT("D"), TEXT("D#"), TEXT("E"), TEXT("F"), TEXT("F#"),
+	TEXT("G"), TEXT("G#"), TEXT("A"), TEXT("A#"), TEXT("B")
+};
+
+//   Ctrl+C
+static volatile LONG g_bIsInterrupted = 0;
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static bool ParseParameter(
+	__in LPCTSTR pszParameter);
+
+static void PrintPitch(
+	__in const PITCHDESC *pPitch,
+	__in DWORD cRingBlocks);
+
+static void PrintStatistics(
+	__in const PITCHSOURCESTATS *pStats);
+
+static BOOL WINAPI ConsoleCtrlHandler(
+	__in DWORD CtrlType);
+
+/****************************************************************************************
+*
+*    _tmain
+*
+*   .   main  MSDN.
+*
+****************************************************************************************/
+
+int __cdecl _tmain(
+	int argc,
+	TCHAR *argv[])
+{
+	//   OEM-,      
+	setlocale(LC_ALL, ".OCP");
+
+	if (argc < 2)
+	{
+		_tprintf(TEXT("usage: SingoscopePitch <file.wav | stdin | mic> ")
+			TEXT("[name=value ...]\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	for (int iArg = 2; iArg < argc; iArg++)
+	{
+		if (!ParseParameter(argv[iArg]))
+		{
+			_tprintf(TEXT("invalid parameter: %s\n"), argv[iArg]);
+			return EXIT_CODE_INVALID_ARGUMENTS;
+		}
+	}
+
+	INITLOG(TEXT("pitchlog.txt"));
+	INITTRACE(TEXT("pitchtrace.json"));
+
+	PitchSource *pSource;
+
+	if (lstrcmpi(argv[1], TEXT("mic")) == 0)
+	{
+		pSource = new WaveInPitchSource(g_SampleRate, g_cSamplesPerBlock);
+	}
+	else if (lstrcmpi(argv[1], TEXT("stdin")) == 0)
+	{
+		pSource = new FilePitchSource(NULL, g_SampleRate, g_bIsRealTime != 0);
+	}
+	else
+	{
+		pSource = new FilePitchSource(argv[1], 0, g_bIsRealTime != 0);
+	}
+
+	int ExitCode = EXIT_CODE_SUCCESS;
+
+	if (pSource == NULL)
+	{
+		_tprintf(TEXT("out of memory\n"));
+		ExitCode = EXIT_CODE_START_FAILED;
+	}
+	else if (!pSource->Start(g_cSamplesPerBlock, g_cRingBlocks))
+	{
+		_tprintf(TEXT("cannot open %s\n"), argv[1]);
+		ExitCode = EXIT_CODE_START_FAILED;
+	}
+	else
+	{
+		SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+
+		while (!g_bIsInterrupted)
+		{
+			PITCHDESC Pitch;
+
+			PITCHSOURCERESULT Result = pSource->GetNextPitch(&Pitch,
+				PITCH_WAIT_TIMEOUT);
+
+			if (Result == PITCHSOURCE_END_OF_INPUT) break;
+
+			if (Result == PITCHSOURCE_SUCCESS && !g_bIsQuiet)
+			{
+				PrintPitch(&Pitch, g_cRingBlocks);
+			}
+		}
+
+		pSource->Stop();
+
+		SetConsoleCtrlHandler(ConsoleCtrlHandler, FALSE);
+
+		PITCHSOURCESTATS Stats;
+
+		pSource->GetStatistics(&Stats);
+
+		PrintStatistics(&Stats);
+	}
+
+	delete pSource;
+
+	UNINITTRACE();
+	UNINITLOG();
+
+	return ExitCode;
+}
+
+/****************************************************************************************
+*
+*    ParseParameter
+*
+*   
+*       pszParameter -   ,  ,    
+*                          <>=<>
+*
+*    
+*       true,       ;  false.
+*
+*           
+*   .
+*
+****************************************************************************************/
+
+static bool ParseParameter(
+	__in LPCTSTR pszParameter)
+{
+	LPCTSTR pszValue = _tcschr(pszParameter, TEXT('='));
+
+	if (pszValue == NULL) return false;
+
+	//  
+	TCHAR pszName[MAX_PARAMETER_NAME_LENGTH + 1];
+
+	DWORD cchName = (DWORD) (pszValue - pszParameter);
+
+	if (cchName > MAX_PARAMETER_NAME_LENGTH) return false;
+
+	lstrcpyn(pszName, pszParameter, cchName + 1);
+
+	pszValue++;
+
+	for (DWORD i = 0; i < sizeof(g_Parameters) / sizeof(g_Parameters[0]); i++)
+	{
+		const PARAMETER *pParameter = &g_Parameters[i];
+
+		if (lstrcmpi(pParameter->pszName, pszName) != 0) continue;
+
+		LPTSTR pszEnd;
+
+		DWORD Value = _tcstoul(pszValue, &pszEnd, 10);
+
+		if (*pszValue == 0 || *pszEnd != 0 || Value < pParameter->MinValue ||
+			Value > pParameter->MaxValue)
+		{
+			return false;
+		}
+
+		*pParameter->pValue = Value;
+
+		return true;
+	}
+
+	return false;
+}
+
+/****************************************************************************************
+*
+*    PrintPitch
+*
+*   
+*       pPitch -   ,     
+*       cRingBlocks -     
+*
+*    
+*       
+*
+*        ,   ,   
+*       ,     .
+*
+****************************************************************************************/
+
+static void PrintPitch(
+	__in const PITCHDESC *pPitch,
+	__in DWORD cRingBlocks)
+{
+	if (pPitch->Frequency <= 0.0)
+	{
+		_tprintf(TEXT("%9.3f          -          %7.3f ms  %u/%u\n"), pPitch->Time,
+			pPitch->Latency, pPitch->FillLevel, cRingBlocks);
+		return;
+	}
+
+	//     MIDI   
+	double Note = A4_NOTE_NUMBER + 12.0 * log(pPitch->Frequency / A4_FREQUENCY) /
+		log(2.0);
+
+	int NearestNote = (int) floor(Note + 0.5);
+
+	int Cents = (int) floor((Note - NearestNote) * 100.0 + 0.5);
+
+	_tprintf(TEXT("%9.3f %8.2f Hz %2s%-2d %+3d  %7.3f ms  %u/%u\n"), pPitch->Time,
+		pPitch->Frequency, g_pszNoteNames[NearestNote % 12], NearestNote / 12 - 1, Cents,
+		pPitch->Latency, pPitch->FillLevel, cRingBlocks);
+}
+
+/****************************************************************************************
+*
+*    PrintStatistics
+*
+*   
+*       pStats -       
+*
+*    
+*       
+*
+*        .
+*
+****************************************************************************************/
+
+static void PrintStatistics(
+	__in const PITCHSOURCESTATS *pStats)
+{
+	_tprintf(TEXT("block:     %.3f ms\n"), pStats->BlockDuration);
+	_tprintf(TEXT("captured:  %u blocks\n"), pStats->cCapturedBlocks);
+	_tprintf(TEXT("dropped:   %u blocks\n"), pStats->cDroppedBlocks);
+	_tprintf(TEXT("processed: %u blocks\n"), pStats->cProcessedBlocks);
+	_tprintf(TEXT("ring fill: %u max of %u blocks\n"), pStats->MaxFillLevel,
+		pStats->cRingBlocks);
+	_tprintf(TEXT("latency:   %.3f min, %.3f avg, %.3f max ms\n"), pStats->MinLatency,
+		pStats->AvgLatency, pStats->MaxLatency);
+}
+
+/****************************************************************************************
+*
+*    ConsoleCtrlHandler
+*
+*   .   HandlerRoutine  MSDN.
+*
+****************************************************************************************/
+
+static BOOL WINAPI ConsoleCtrlHandler(
+	__in DWORD CtrlType)
+{
+	if (CtrlType != CTRL_C_EVENT && CtrlType != CTRL_BREAK_EVENT) return FALSE;
+
+	InterlockedExchange(&g_bIsInterrupted, 1);
+
+	return TRUE;
+}
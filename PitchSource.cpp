@@ -0,0 +1,768 @@
+/****************************************************************************************
+*
+*     PitchSource
+*
+*            ,
+*        .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+
+#include "Log.h"
+#include "Trace.h"
+#include "AudioRing.h"
+#include "PitchSource.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//        ,    
+#define MIN_PITCH_FREQUENCY		70.0
+#define MAX_PITCH_FREQUENCY		1100.0
+
+//    YIN:      
+//  
+#define YIN_THRESHOLD			0.15
+
+//   ,     
+#define SILENCE_LEVEL			100.0
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       bIsRealTime - true,         (
+*                      )    ; false,  
+*                      ,      
+*                     (, ,    )
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+PitchSource::PitchSource(
+	__in bool bIsRealTime)
+{
+	m_hThread = NULL;
+	m_hDataEvent = NULL;
+	m_hSpaceEvent = NULL;
+
+	m_bStopping = 0;
+	m_bInputEnded = 0;
+	m_bIsRealTime = bIsRealTime;
+	m_SampleRate = 0;
+
+	m_pDropSamples = NULL;
+
+	m_cCapturedBlocks = 0;
+	m_cDroppedBlocks = 0;
+
+	m_pDetectProc = DetectPitch;
+	m_pDetectContext = NULL;
+
+	m_pWindow = NULL;
+	m_cWindowSamples = 0;
+	m_cFilledWindowSamples = 0;
+
+	LARGE_INTEGER Frequency;
+	QueryPerformanceFrequency(&Frequency);
+	m_PerformanceFrequency = Frequency.QuadPart;
+
+	m_cProcessedBlocks = 0;
+	m_MinLatency = 0;
+	m_MaxLatency = 0;
+	m_TotalLatency = 0;
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .     
+*    ,       
+*    Stop.
+*
+****************************************************************************************/
+
+PitchSource::~PitchSource()
+{
+	Stop();
+	Free();
+}
+
+/****************************************************************************************
+*
+*    SetPitchDetector
+*
+*   
+*       pDetectProc -      
+*       pDetectContext - ,    pDetectProc
+*
+*    
+*       
+*
+*    ,     (  - 
+*   DetectPitch).    ,   GetNextPitch, 
+*      ,     . 
+*    ,     .
+*
+****************************************************************************************/
+
+void PitchSource::SetPitchDetector(
+	__in PITCHDETECTPROC pDetectProc,
+	__in_opt LPVOID pDetectContext)
+{
+	m_pDetectProc = pDetectProc;
+	m_pDetectContext = pDetectContext;
+}
+
+/****************************************************************************************
+*
+*    Start
+*
+*   
+*       cSamplesPerBlock -    ;   ,  
+*                          ,      
+*       cRingBlocks -     
+*
+*    
+*       true,        ;  false.
+*
+*         .    ,  
+*    .    .
+*
+****************************************************************************************/
+
+bool PitchSource::Start(
+	__in DWORD cSamplesPerBlock,
+	__in DWORD cRingBlocks)
+{
+	Stop();
+	Free();
+
+	if (!OpenInput(&m_SampleRate))
+	{
+		LOG("PitchSource::OpenInput failed\n");
+		return false;
+	}
+
+	//        ,     
+	// 
+	m_cWindowSamples = 2 * (DWORD) (m_SampleRate / MIN_PITCH_FREQUENCY + 1);
+	if (m_cWindowSamples < cSamplesPerBlock) m_cWindowSamples = cSamplesPerBlock;
+
+	m_pWindow = (SHORT *) HeapAlloc(GetProcessHeap(), 0,
+		m_cWindowSamples * sizeof(SHORT));
+
+	m_pDropSamples = (SHORT *) HeapAlloc(GetProcessHeap(), 0,
+		cSamplesPerBlock * sizeof(SHORT));
+
+	if (m_pWindow == NULL || m_pDropSamples == NULL ||
+		!m_Ring.Create(cRingBlocks, cSamplesPerBlock))
+	{
+		LOG("HeapAlloc failed\n");
+		Free();
+		CloseInput();
+		return false;
+	}
+
+	m_hDataEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_hSpaceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	if (m_hDataEvent == NULL || m_hSpaceEvent == NULL)
+	{
+		LOG("CreateEvent failed (error %u)\n", GetLastError());
+		Free();
+		CloseInput();
+		return false;
+	}
+
+	m_bStopping = 0;
+	m_bInputEnded = 0;
+	m_cCapturedBlocks = 0;
+	m_cDroppedBlocks = 0;
+	m_cFilledWindowSamples = 0;
+
+	m_cProcessedBlocks = 0;
+	m_MinLatency = 0;
+	m_MaxLatency = 0;
+	m_TotalLatency = 0;
+
+	m_hThread = CreateThread(NULL, 0, CaptureThreadProc, this, 0, NULL);
+
+	if (m_hThread == NULL)
+	{
+		LOG("CreateThread failed (error %u)\n", GetLastError());
+		Free();
+		CloseInput();
+		return false;
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    Stop
+*
+*   
+*       
+*
+*    
+*       
+*
+*         .   
+*       ,      ,
+*        . ,    , 
+*         Start.
+*
+****************************************************************************************/
+
+void PitchSource::Stop()
+{
+	if (m_hThread == NULL) return;
+
+	InterlockedExchange(&m_bStopping, 1);
+
+	//    ,      
+	SetEvent(m_hSpaceEvent);
+
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
+
+	CloseInput();
+}
+
+/****************************************************************************************
+*
+*    GetSampleRate
+*
+*   
+*       
+*
+*    
+*            ,      .
+*
+*       .
+*
+****************************************************************************************/
+
+DWORD PitchSource::GetSampleRate()
+{
+	return m_SampleRate;
+}
+
+/****************************************************************************************
+*
+*    GetNextPitch
+*
+*   
+*       pPitch -   ,      
+*       Timeout -        
+*                 INFINITE
+*
+*    
+*       PITCHSOURCE_SUCCESS -   ;
+*       PITCHSOURCE_TIMEOUT -   Timeout     ;
+*       PITCHSOURCE_END_OF_INPUT -      
+*                                  ,     .
+*
+*         ,      
+*       .      (  
+*   ),    .       
+*   .
+*
+*   
+*
+*         ,    
+*     ,    .   
+*      (.  Capture):     - 
+*      , ..   ,   
+*         ;    - 
+*      , ..   .
+*
+****************************************************************************************/
+
+PITCHSOURCERESULT PitchSource::GetNextPitch(
+	__out PITCHDESC *pPitch,
+	__in DWORD Timeout)
+{
+	if (m_hDataEvent == NULL) return PITCHSOURCE_END_OF_INPUT;
+
+	AUDIOBLOCK *pBlock;
+
+	for (;;)
+	{
+		//      :   ,   
+		//      
+		LONG bInputEnded = m_bInputEnded;
+
+		pBlock = m_Ring.GetReadBlock();
+
+		if (pBlock != NULL) break;
+
+		if (bInputEnded) return PITCHSOURCE_END_OF_INPUT;
+
+		if (WaitForSingleObject(m_hDataEvent, Timeout) == WAIT_TIMEOUT)
+		{
+			return PITCHSOURCE_TIMEOUT;
+		}
+	}
+
+	pPitch->iBlock = pBlock->iBlock;
+	pPitch->Time = ((double) pBlock->iBlock * m_Ring.GetSamplesPerBlock() +
+		pBlock->cSamples) / m_SampleRate;
+	pPitch->FillLevel = m_Ring.GetFillLevel();
+
+	LONGLONG CaptureTime = pBlock->CaptureTime;
+
+	AppendToWindow(pBlock);
+
+	m_Ring.ReleaseReadBlock();
+
+	// ,       ,   
+	if (!m_bIsRealTime) SetEvent(m_hSpaceEvent);
+
+	//   
+	if (m_cFilledWindowSamples == m_cWindowSamples)
+	{
+		TRACE_ZONE("PitchSource::DetectPitch");
+
+		pPitch->Frequency = m_pDetectProc(m_pWindow, m_cWindowSamples, m_SampleRate,
+			m_pDetectContext);
+	}
+	else
+	{
+		pPitch->Frequency = 0.0;
+	}
+
+	//   
+	LARGE_INTEGER CurrentTime;
+	QueryPerformanceCounter(&CurrentTime);
+
+	LONGLONG Latency = CurrentTime.QuadPart - CaptureTime;
+
+	if (m_cProcessedBlocks == 0 || Latency < m_MinLatency) m_MinLatency = Latency;
+	if (m_cProcessedBlocks == 0 || Latency > m_MaxLatency) m_MaxLatency = Latency;
+
+	m_TotalLatency += Latency;
+	m_cProcessedBlocks++;
+
+	pPitch->Latency = Latency * 1000.0 / m_PerformanceFrequency;
+
+	TRACE_COUNTER("PitchSource latency, us",
+		Latency * 1000000 / m_PerformanceFrequency);
+
+	return PITCHSOURCE_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    GetStatistics
+*
+*   
+*       pStats -   ,     
+*
+*    
+*       
+*
+*            Start.
+*      ,    GetNextPitch.   
+*           
+*   ,         .
+*
+****************************************************************************************/
+
+void PitchSource::GetStatistics(
+	__out PITCHSOURCESTATS *pStats)
+{
+	pStats->cCapturedBlocks = (DWORD) m_cCapturedBlocks;
+	pStats->cDroppedBlocks = (DWORD) m_cDroppedBlocks;
+	pStats->cProcessedBlocks = m_cProcessedBlocks;
+	pStats->cRingBlocks = m_Ring.GetBlockCount();
+	pStats->FillLevel = m_Ring.GetFillLevel();
+	pStats->MaxFillLevel = m_Ring.GetMaxFillLevel();
+
+	pStats->BlockDuration = (m_SampleRate != 0) ?
+		m_Ring.GetSamplesPerBlock() * 1000.0 / m_SampleRate : 0.0;
+
+	if (m_cProcessedBlocks != 0)
+	{
+		pStats->MinLatency = m_MinLatency * 1000.0 / m_PerformanceFrequency;
+		pStats->AvgLatency = m_TotalLatency * 1000.0 / m_PerformanceFrequency /
+			m_cProcessedBlocks;
+		pStats->MaxLatency = m_MaxLatency * 1000.0 / m_PerformanceFrequency;
+	}
+	else
+	{
+		pStats->MinLatency = 0.0;
+		pStats->AvgLatency = 0.0;
+		pStats->MaxLatency = 0.0;
+	}
+}
+
+/****************************************************************************************
+*
+*    DetectPitch
+*
+*   
+*       pSamples -    
+*       cSamples -    
+*       SampleRate -    
+*       pContext -  
+*
+*    
+*             ,    .
+*
+*        YIN (A. de Cheveigne, H. Kawahara, 2002).
+*           , 
+*            .
+*
+*   
+*
+*              
+*      ,       
+*   .        
+*   ,     YIN_THRESHOLD     
+*    ;    .   
+*   ,    ,     
+*   .
+*
+****************************************************************************************/
+
+double PitchSource::DetectPitch(
+	__in const SHORT *pSamples,
+	__in DWORD cSamples,
+	__in DWORD SampleRate,
+	__in LPVOID pContext)
+{
+	//        
+	DWORD MaxLag = (DWORD) (SampleRate / MIN_PITCH_FREQUENCY);
+	DWORD MinLag = (DWORD) (SampleRate / MAX_PITCH_FREQUENCY);
+
+	if (MaxLag > cSamples / 2) MaxLag = cSamples / 2;
+	if (MinLag < 2) MinLag = 2;
+
+	if (MaxLag <= MinLag) return 0.0;
+
+	//  ,    
+	DWORD cSumSamples = cSamples - MaxLag;
+
+	//   
+	double Energy = 0.0;
+
+	for (DWORD i = 0; i < cSumSamples; i++) Energy += (double) pSamples[i] * pSamples[i];
+
+	if (Energy < SILENCE_LEVEL * SILENCE_LEVEL * cSumSamples) return 0.0;
+
+	//      1  
+	double DifferenceSum = 0.0;
+
+	//      
+	double PrevPrevNorm = 1.0;
+	double PrevNorm = 1.0;
+
+	// true,      
+	bool bIsBelowThreshold = false;
+
+	for (DWORD Lag = 1; Lag <= MaxLag; Lag++)
+	{
+		double Difference = GetSquaredDifference(pSamples, cSumSamples, Lag);
+
+		DifferenceSum += Difference;
+
+		double Norm = (DifferenceSum > 0.0) ? Difference * Lag / DifferenceSum : 1.0;
+
+		if (bIsBelowThreshold && Norm >= PrevNorm)
+		{
+			//   -  ;    ,
+			//     
+			double Denominator = PrevPrevNorm - 2.0 * PrevNorm + Norm;
+
+			double Shift = (Denominator > 0.0) ?
+				0.5 * (PrevPrevNorm - Norm) / Denominator : 0.0;
+
+			return SampleRate / ((Lag - 1) + Shift);
+		}
+
+		if (Lag >= MinLag && Norm < YIN_THRESHOLD) bIsBelowThreshold = true;
+
+		PrevPrevNorm = PrevNorm;
+		PrevNorm = Norm;
+	}
+
+	return 0.0;
+}
+
+/****************************************************************************************
+*
+*    CaptureThreadProc
+*
+*   
+*       lpParameter -     PitchSource
+*
+*    
+*       .
+*
+*     .
+*
+****************************************************************************************/
+
+DWORD WINAPI PitchSource::CaptureThreadProc(
+	__in LPVOID lpParameter)
+{
+	PitchSource *pSource = (PitchSource *) lpParameter;
+
+	pSource->Capture();
+
+	TRACE_THREAD_END();
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    Capture
+*
+*   
+*       
+*
+*    
+*       
+*
+*             ,  
+*         .   ,  
+*        (    
+*   ),   ;   ,   
+*    .
+*
+*            
+*    :  ReadInput    , 
+*     ,      
+*   .         
+*    ReadInput.
+*
+****************************************************************************************/
+
+void PitchSource::Capture()
+{
+	DWORD cSamplesPerBlock = m_Ring.GetSamplesPerBlock();
+
+	//   ,  
+	DWORD iBlock = 0;
+
+	while (!IsStopping())
+	{
+		AUDIOBLOCK *pBlock = m_Ring.GetWriteBlock();
+
+		SHORT *pSamples;
+
+		if (pBlock != NULL)
+		{
+			pSamples = pBlock->pSamples;
+		}
+		else if (m_bIsRealTime)
+		{
+			pSamples = m_pDropSamples;
+		}
+		else
+		{
+			WaitForSingleObject(m_hSpaceEvent, INFINITE);
+			continue;
+		}
+
+		DWORD cSamples = ReadInput(pSamples, cSamplesPerBlock);
+
+		if (cSamples == 0) break;
+
+		if (pBlock == NULL)
+		{
+			InterlockedIncrement(&m_cDroppedBlocks);
+			iBlock++;
+			continue;
+		}
+
+		LARGE_INTEGER CaptureTime;
+		QueryPerformanceCounter(&CaptureTime);
+
+		if (m_bIsRealTime)
+		{
+			CaptureTime.QuadPart -= (LONGLONG) cSamples * m_PerformanceFrequency /
+				m_SampleRate;
+		}
+
+		pBlock->CaptureTime = CaptureTime.QuadPart;
+		pBlock->iBlock = iBlock++;
+		pBlock->cSamples = cSamples;
+
+		m_Ring.CommitWriteBlock();
+
+		InterlockedIncrement(&m_cCapturedBlocks);
+
+		SetEvent(m_hDataEvent);
+
+		TRACE_COUNTER("PitchSource ring fill", m_Ring.GetFillLevel());
+	}
+
+	InterlockedExchange(&m_bInputEnded, 1);
+
+	SetEvent(m_hDataEvent);
+}
+
+/****************************************************************************************
+*
+*    AppendToWindow
+*
+*   
+*       pBlock -   
+*
+*    
+*       
+*
+*              .
+*
+****************************************************************************************/
+
+void PitchSource::AppendToWindow(
+	__in const AUDIOBLOCK *pBlock)
+{
+	DWORD cSamples = pBlock->cSamples;
+
+	if (cSamples >= m_cWindowSamples)
+	{
+		CopyMemory(m_pWindow, pBlock->pSamples + cSamples - m_cWindowSamples,
+			m_cWindowSamples * sizeof(SHORT));
+	}
+	else
+	{
+		MoveMemory(m_pWindow, m_pWindow + cSamples,
+			(m_cWindowSamples - cSamples) * sizeof(SHORT));
+
+		CopyMemory(m_pWindow + m_cWindowSamples - cSamples, pBlock->pSamples,
+			cSamples * sizeof(SHORT));
+	}
+
+	m_cFilledWindowSamples += cSamples;
+
+	if (m_cFilledWindowSamples > m_cWindowSamples)
+	{
+		m_cFilledWindowSamples = m_cWindowSamples;
+	}
+}
+
+/****************************************************************************************
+*
+*    GetSquaredDifference
+*
+*   
+*       pSamples -   
+*       cSamples -  ;   pSamples    
+*                  cSamples + Lag 
+*       Lag -   
+*
+*    
+*         .
+*
+*          cSamples   ,
+*       Lag .
+*
+****************************************************************************************/
+
+double PitchSource::GetSquaredDifference(
+	__in const SHORT *pSamples,
+	__in DWORD cSamples,
+	__in DWORD Lag)
+{
+	double Sum = 0.0;
+
+	for (DWORD i = 0; i < cSamples; i++)
+	{
+		//   16-     
+		int Difference = pSamples[i] - pSamples[i + Lag];
+
+		Sum += (double) Difference * Difference;
+	}
+
+	return Sum;
+}
+
+/****************************************************************************************
+*
+*    IsStopping
+*
+*   
+*       
+*
+*    
+*       true,     ;  false.
+*
+*       ,   ReadInput   
+*    ,       .
+*
+****************************************************************************************/
+
+bool PitchSource::IsStopping()
+{
+	return m_bStopping != 0;
+}
+
+/****************************************************************************************
+*
+*    Free
+*
+*   
+*       
+*
+*    
+*       
+*
+*     ,   . ,    
+*   .
+*
+****************************************************************************************/
+
+void PitchSource::Free()
+{
+	m_Ring.Free();
+
+	if (m_pWindow != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pWindow);
+		m_pWindow = NULL;
+	}
+
+	if (m_pDropSamples != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pDropSamples);
+		m_pDropSamples = NULL;
+	}
+
+	if (m_hDataEvent != NULL)
+	{
+		CloseHandle(m_hDataEvent);
+		m_hDataEvent = NULL;
+	}
+
+	if (m_hSpaceEvent != NULL)
+	{
+		CloseHandle(m_hSpaceEvent);
+		m_hSpaceEvent = NULL;
+	}
+}
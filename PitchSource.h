@@ -0,0 +1,206 @@
+/****************************************************************************************
+*
+*     PitchSource
+*
+*            .
+*              
+*     (.  AudioRing) ,     
+*    .    ( , WAV-  ..) 
+*    ,       .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//     GetNextPitch
+enum PITCHSOURCERESULT
+{
+	PITCHSOURCE_SUCCESS,
+	PITCHSOURCE_TIMEOUT,
+	PITCHSOURCE_END_OF_INPUT
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,        ; 
+//  GetNextPitch
+struct PITCHDESC {
+	DWORD iBlock; //     
+	double Time; //        
+	double Frequency; //       ,    
+	double Latency; //        
+					//   ;     
+					//  -     ,  
+					//  -     
+	DWORD FillLevel; //     ,  
+					 // ,    
+};
+
+// ,    ;  
+// GetStatistics
+struct PITCHSOURCESTATS {
+	DWORD cCapturedBlocks; //  ,    
+	DWORD cDroppedBlocks; //  ,  -  
+	DWORD cProcessedBlocks; //  ,     
+	DWORD cRingBlocks; //     
+	DWORD FillLevel; //    
+	DWORD MaxFillLevel; //    
+	double BlockDuration; //    
+	double MinLatency; //     (. PITCHDESC)
+	double AvgLatency; //    
+	double MaxLatency; //    
+};
+
+//     ;      
+//       ,    
+typedef double (*PITCHDETECTPROC)(
+	__in const SHORT *pSamples,
+	__in DWORD cSamples,
+	__in DWORD SampleRate,
+	__in LPVOID pContext);
+
+/****************************************************************************************
+*
+*    PitchSource
+*
+****************************************************************************************/
+
+class PitchSource
+{
+	//    
+	AudioRing m_Ring;
+
+	//     NULL,    
+	HANDLE m_hThread;
+
+	// ,       ,  
+	//  -   
+	HANDLE m_hDataEvent;
+	HANDLE m_hSpaceEvent;
+
+	//    
+	volatile LONG m_bStopping;
+
+	//    :        
+	volatile LONG m_bInputEnded;
+
+	// true,        ;    
+	//    ,    
+	bool m_bIsRealTime;
+
+	//    
+	DWORD m_SampleRate;
+
+	// ,       
+	SHORT *m_pDropSamples;
+
+	//     ;   
+	volatile LONG m_cCapturedBlocks;
+	volatile LONG m_cDroppedBlocks;
+
+	//       
+	PITCHDETECTPROC m_pDetectProc;
+	LPVOID m_pDetectContext;
+
+	//   ,     ,   
+	//    
+	SHORT *m_pWindow;
+	DWORD m_cWindowSamples;
+	DWORD m_cFilledWindowSamples;
+
+	//   
+	LONGLONG m_PerformanceFrequency;
+
+	//   :       
+	//  
+	DWORD m_cProcessedBlocks;
+	LONGLONG m_MinLatency;
+	LONGLONG m_MaxLatency;
+	LONGLONG m_TotalLatency;
+
+	//   
+	static DWORD WINAPI CaptureThreadProc(
+		__in LPVOID lpParameter);
+
+	//           
+	void Capture();
+
+	//      
+	void AppendToWindow(
+		__in const AUDIOBLOCK *pBlock);
+
+	//    
+	void Free();
+
+	//     ,    
+	static double GetSquaredDifference(
+		__in const SHORT *pSamples,
+		__in DWORD cSamples,
+		__in DWORD Lag);
+
+protected:
+
+	//   
+	virtual bool OpenInput(
+		__out DWORD *pSampleRate) = 0;
+
+	//     ;    
+	// ,      
+	virtual DWORD ReadInput(
+		__out SHORT *pSamples,
+		__in DWORD cSamples) = 0;
+
+	//   
+	virtual void CloseInput() = 0;
+
+	//  true,     
+	bool IsStopping();
+
+public:
+
+	PitchSource(
+		__in bool bIsRealTime);
+	virtual ~PitchSource();
+
+	//     
+	void SetPitchDetector(
+		__in PITCHDETECTPROC pDetectProc,
+		__in_opt LPVOID pDetectContext);
+
+	//       
+	bool Start(
+		__in DWORD cSamplesPerBlock,
+		__in DWORD cRingBlocks);
+
+	//       
+	void Stop();
+
+	//   
+	DWORD GetSampleRate();
+
+	//      
+	PITCHSOURCERESULT GetNextPitch(
+		__out PITCHDESC *pPitch,
+		__in DWORD Timeout);
+
+	//    
+	void GetStatistics(
+		__out PITCHSOURCESTATS *pStats);
+
+	//     YIN;    
+	static double DetectPitch(
+		__in const SHORT *pSamples,
+		__in DWORD cSamples,
+		__in DWORD SampleRate,
+		__in LPVOID pContext);
+};
@@ -0,0 +1,463 @@
+/****************************************************************************************
+*
+*     RecentSongCache
+*
+*           ,  
+*             .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+#include <tchar.h>
+
+#include "Log.h"
+#include "Song.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiPart.h"
+#include "MidiLyric.h"
+#include "MidiSong.h"
+#include "MidiFile.h"
+#include "SongFile.h"
+#include "RecentSongCache.h"
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       cbMaxMemory -    ,    
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+RecentSongCache::RecentSongCache(
+	__in DWORD cbMaxMemory)
+{
+	m_pFirstEntry = NULL;
+	m_pLastEntry = NULL;
+	m_cEntries = 0;
+
+	m_cbMemory = 0;
+	m_cbMaxMemory = cbMaxMemory;
+
+	m_cHits = 0;
+	m_cMisses = 0;
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*       .
+*
+****************************************************************************************/
+
+RecentSongCache::~RecentSongCache()
+{
+	Clear();
+}
+
+/****************************************************************************************
+*
+*    GetSongKey
+*
+*   
+*       pszFileName -   ,  ,    
+*                       
+*       DefaultCodePage -       
+*       ConcordNoteChoice -     
+*       QuantizeStepDenominator -     
+*       pKey -   ,      
+*
+*    
+*       true,    ; false,     
+*       .
+*
+*       :  ,      , 
+*     ,       .   
+*        ,  ,      
+*   ,      .       ,
+*           .
+*
+****************************************************************************************/
+
+bool RecentSongCache::GetSongKey(
+	__in LPCTSTR pszFileName,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator,
+	__out RECENTSONGKEY *pKey)
+{
+	WIN32_FILE_ATTRIBUTE_DATA FileData;
+
+	if (!GetFileAttributesEx(pszFileName, GetFileExInfoStandard, &FileData))
+	{
+		LOG("GetFileAttributesEx failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	lstrcpyn(pKey->pszFileName, pszFileName, MAX_PATH);
+	pKey->cbFile = ((ULONGLONG) FileData.nFileSizeHigh << 32) | FileData.nFileSizeLow;
+	pKey->LastWriteTime = FileData.ftLastWriteTime;
+	pKey->DefaultCodePage = DefaultCodePage;
+	pKey->ConcordNoteChoice = ConcordNoteChoice;
+	pKey->QuantizeStepDenominator = QuantizeStepDenominator;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    SetMaxMemorySize
+*
+*   
+*       cbMaxMemory -    ,    
+*
+*    
+*       
+*
+*       ,    , 
+*      ,     .  ,  
+*     .
+*
+****************************************************************************************/
+
+void RecentSongCache::SetMaxMemorySize(
+	__in DWORD cbMaxMemory)
+{
+	m_cbMaxMemory = cbMaxMemory;
+
+	Trim(cbMaxMemory);
+}
+
+/****************************************************************************************
+*
+*    PutSong
+*
+*   
+*       pKey -    ,   GetSongKey  
+*              
+*       iVocalPart -   ,    
+*       pSongFile -     SongFile,    
+*       pSong -     Song,    
+*
+*    
+*       true,     ; false,     
+*             (    ).
+*
+*      .  pSongFile  pSong      
+*   .              ,  
+*   .      ,   
+*    .
+*
+****************************************************************************************/
+
+bool RecentSongCache::PutSong(
+	__in const RECENTSONGKEY *pKey,
+	__in DWORD iVocalPart,
+	__in SongFile *pSongFile,
+	__in Song *pSong)
+{
+	//           
+	ENTRY *pOldEntry = FindEntry(pKey);
+
+	if (pOldEntry != NULL) DeleteEntry(pOldEntry);
+
+	//  ,  
+	DWORD cbMemory = sizeof(ENTRY) + pSongFile->GetMemorySize() + pSong->GetMemorySize();
+
+	if (cbMemory > m_cbMaxMemory)
+	{
+		delete pSongFile;
+		delete pSong;
+		return false;
+	}
+
+	ENTRY *pEntry = new ENTRY;
+
+	if (pEntry == NULL)
+	{
+		LOG("operator new failed\n");
+		delete pSongFile;
+		delete pSong;
+		return false;
+	}
+
+	//    
+	Trim(m_cbMaxMemory - cbMemory);
+
+	pEntry->Key = *pKey;
+	pEntry->iVocalPart = iVocalPart;
+	pEntry->pSongFile = pSongFile;
+	pEntry->pSong = pSong;
+	pEntry->cbMemory = cbMemory;
+
+	//     
+	pEntry->pPrev = NULL;
+	pEntry->pNext = m_pFirstEntry;
+
+	if (m_pFirstEntry != NULL)
+	{
+		m_pFirstEntry->pPrev = pEntry;
+	}
+	else
+	{
+		m_pLastEntry = pEntry;
+	}
+
+	m_pFirstEntry = pEntry;
+
+	m_cEntries++;
+	m_cbMemory += cbMemory;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    TakeSong
+*
+*   
+*       pKey -    ,   GetSongKey
+*       ppSongFile -   ,      
+*                      SongFile
+*       ppSong -   ,       
+*                 Song
+*       piVocalPart -   ,     
+*                      ,    
+*
+*    
+*       true,     ;  false.
+*
+*      :       
+*     ,          .
+*       ,        PutSong.
+*         ,      ,  
+*     .
+*
+****************************************************************************************/
+
+bool RecentSongCache::TakeSong(
+	__in const RECENTSONGKEY *pKey,
+	__out SongFile **ppSongFile,
+	__out Song **ppSong,
+	__out DWORD *piVocalPart)
+{
+	ENTRY *pEntry = FindEntry(pKey);
+
+	if (pEntry != NULL && (pEntry->Key.cbFile != pKey->cbFile ||
+		CompareFileTime(&pEntry->Key.LastWriteTime, &pKey->LastWriteTime) != 0))
+	{
+		//  ,  
+		DeleteEntry(pEntry);
+		pEntry = NULL;
+	}
+
+	if (pEntry == NULL)
+	{
+		m_cMisses++;
+		return false;
+	}
+
+	UnlinkEntry(pEntry);
+
+	*ppSongFile = pEntry->pSongFile;
+	*ppSong = pEntry->pSong;
+	*piVocalPart = pEntry->iVocalPart;
+
+	delete pEntry;
+
+	m_cHits++;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GetStatistics
+*
+*   
+*       pcHits -   ,      ,
+*                  ;      NULL
+*       pcMisses -   ,      ,
+*                      ;      NULL
+*       pcSongs -   ,      
+*                  ;      NULL
+*       pcbMemory -   ,      
+*                   ,    ;     
+*                   NULL
+*
+*    
+*       
+*
+*          .
+*
+****************************************************************************************/
+
+void RecentSongCache::GetStatistics(
+	__out_opt DWORD *pcHits,
+	__out_opt DWORD *pcMisses,
+	__out_opt DWORD *pcSongs,
+	__out_opt DWORD *pcbMemory)
+{
+	if (pcHits != NULL) *pcHits = m_cHits;
+	if (pcMisses != NULL) *pcMisses = m_cMisses;
+	if (pcSongs != NULL) *pcSongs = m_cEntries;
+	if (pcbMemory != NULL) *pcbMemory = m_cbMemory;
+}
+
+/****************************************************************************************
+*
+*    Clear
+*
+*   
+*       
+*
+*    
+*       
+*
+*       .    .
+*
+****************************************************************************************/
+
+void RecentSongCache::Clear()
+{
+	Trim(0);
+}
+
+/****************************************************************************************
+*
+*    FindEntry
+*
+*   
+*       pKey -    
+*
+*    
+*             NULL,     .
+*
+*            ,     .
+*         ,        
+*            .
+*
+*   
+*
+*        ,    .
+*
+****************************************************************************************/
+
+RecentSongCache::ENTRY *RecentSongCache::FindEntry(
+	__in const RECENTSONGKEY *pKey)
+{
+	for (ENTRY *pEntry = m_pFirstEntry; pEntry != NULL; pEntry = pEntry->pNext)
+	{
+		if (pEntry->Key.DefaultCodePage == pKey->DefaultCodePage &&
+			pEntry->Key.ConcordNoteChoice == pKey->ConcordNoteChoice &&
+			pEntry->Key.QuantizeStepDenominator == pKey->QuantizeStepDenominator &&
+			lstrcmpi(pEntry->Key.pszFileName, pKey->pszFileName) == 0)
+		{
+			return pEntry;
+		}
+	}
+
+	return NULL;
+}
+
+/****************************************************************************************
+*
+*    UnlinkEntry
+*
+*   
+*       pEntry -     
+*
+*    
+*       
+*
+*       ,   .
+*
+****************************************************************************************/
+
+void RecentSongCache::UnlinkEntry(
+	__in ENTRY *pEntry)
+{
+	if (pEntry->pPrev != NULL)
+	{
+		pEntry->pPrev->pNext = pEntry->pNext;
+	}
+	else
+	{
+		m_pFirstEntry = pEntry->pNext;
+	}
+
+	if (pEntry->pNext != NULL)
+	{
+		pEntry->pNext->pPrev = pEntry->pPrev;
+	}
+	else
+	{
+		m_pLastEntry = pEntry->pPrev;
+	}
+
+	m_cEntries--;
+	m_cbMemory -= pEntry->cbMemory;
+}
+
+/****************************************************************************************
+*
+*    DeleteEntry
+*
+*   
+*       pEntry -     
+*
+*    
+*       
+*
+*              .
+*
+****************************************************************************************/
+
+void RecentSongCache::DeleteEntry(
+	__in ENTRY *pEntry)
+{
+	UnlinkEntry(pEntry);
+
+	delete pEntry->pSongFile;
+	delete pEntry->pSong;
+	delete pEntry;
+}
+
+/****************************************************************************************
+*
+*    Trim
+*
+*   
+*       cbMaxMemory -   ,      
+*
+*    
+*       
+*
+*       , .. ,     ,  
+*      cbMaxMemory.
+*
+****************************************************************************************/
+
+void RecentSongCache::Trim(
+	__in DWORD cbMaxMemory)
+{
+	while (m_pLastEntry != NULL && m_cbMemory > cbMaxMemory)
+	{
+		DeleteEntry(m_pLastEntry);
+	}
+}
@@ -0,0 +1,126 @@
+/****************************************************************************************
+*
+*     RecentSongCache
+*
+*            ( 
+*   SongFile  Song),           
+*    .    ;    ,
+*    ,     .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,     ;  
+// RecentSongCache::GetSongKey
+struct RECENTSONGKEY {
+	TCHAR pszFileName[MAX_PATH]; //    
+	ULONGLONG cbFile; //      
+	FILETIME LastWriteTime; //      
+	UINT DefaultCodePage; //       
+	CONCORD_NOTE_CHOICE ConcordNoteChoice; //     
+	DWORD QuantizeStepDenominator; //    
+};
+
+/****************************************************************************************
+*
+*    RecentSongCache
+*
+****************************************************************************************/
+
+class RecentSongCache
+{
+	// ,    ;    ,
+	//          
+	struct ENTRY {
+		RECENTSONGKEY Key; //  
+		DWORD iVocalPart; //   ,    
+		SongFile *pSongFile; //     SongFile
+		Song *pSong; //     Song
+		DWORD cbMemory; //  ,   pSongFile  pSong
+		ENTRY *pPrev; //     
+		ENTRY *pNext; //     
+	};
+
+	//    (    )   (
+	//  )   
+	ENTRY *m_pFirstEntry;
+	ENTRY *m_pLastEntry;
+
+	//    
+	DWORD m_cEntries;
+
+	//   ,    
+	DWORD m_cbMemory;
+
+	//    ,    
+	DWORD m_cbMaxMemory;
+
+	//        
+	DWORD m_cHits;
+	DWORD m_cMisses;
+
+	//          
+	ENTRY *FindEntry(
+		__in const RECENTSONGKEY *pKey);
+
+	//     
+	void UnlinkEntry(
+		__in ENTRY *pEntry);
+
+	//        
+	void DeleteEntry(
+		__in ENTRY *pEntry);
+
+	//    ,      
+	void Trim(
+		__in DWORD cbMaxMemory);
+
+public:
+
+	RecentSongCache(
+		__in DWORD cbMaxMemory);
+	~RecentSongCache();
+
+	//     
+	static bool GetSongKey(
+		__in LPCTSTR pszFileName,
+		__in UINT DefaultCodePage,
+		__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+		__in DWORD QuantizeStepDenominator,
+		__out RECENTSONGKEY *pKey);
+
+	//       
+	void SetMaxMemorySize(
+		__in DWORD cbMaxMemory);
+
+	//    
+	bool PutSong(
+		__in const RECENTSONGKEY *pKey,
+		__in DWORD iVocalPart,
+		__in SongFile *pSongFile,
+		__in Song *pSong);
+
+	//    
+	bool TakeSong(
+		__in const RECENTSONGKEY *pKey,
+		__out SongFile **ppSongFile,
+		__out Song **ppSong,
+		__out DWORD *piVocalPart);
+
+	//    
+	void GetStatistics(
+		__out_opt DWORD *pcHits,
+		__out_opt DWORD *pcMisses,
+		__out_opt DWORD *pcSongs,
+		__out_opt DWORD *pcbMemory);
+
+	//     
+	void Clear();
+};
@@ -15,3 +15,7 @@
 //    
 
 #define IDC_OPENFILE				1500
+
+//  ,      
+
+#define IDC_NEXTVOCALPART			1600
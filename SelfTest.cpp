@@ -0,0 +1,4684 @@
+/****************************************************************************************
+*
+*       
+*
+*           ,   
+*          :
+*       -    ( Log):    
+*          ;    , 
+*                ,   
+*               .  ,
+*              DEBUGLOG; makefile    ;
+*       -      ( SongLoader): ,  
+*               ,    
+*          ,       , 
+*              ,     
+*          ,   ,    ,  
+*          .       MIDI- 
+*         ;
+*       -     ( RecentSongCache): ,  
+*               ,  ,
+*              ,   ,  
+*            ,      
+*          ;
+*       -     ( AudioRing):     
+*          ,    ; ,   
+*         ,      ,    
+*            ,   -  ,     
+*            ;
+*       -    ( Song):       
+*           ,     
+*             GetNextTempo,   ,  
+*          (       ),    
+*          ;    ,   
+*         ,     ,    
+*         ;
+*       -      ( MidiSong  Song):   
+*                 
+*                   ,  
+*                    ;
+*         ,      ,   
+*         ,      ,      
+*         ,         
+*            ;
+*       -    ( MidiFile):  ,   
+*           ,    , 
+*          ,       ; 
+*            MIDI-,      
+*           ,          
+*          ,          
+*           ,      ;
+*       -   ( MidiTrack): ,    
+*            ,   ,   
+*             ,     ,   
+*           ,        
+*               ;
+*       -  MIDI-   ( MidiStreamParser): ,  
+*              (     ),
+*            ,    MidiTrack, 
+*                   ,  
+*         MidiFile ;    ,   ,
+*               ,   
+*         ;
+*       -    ( MidiPart):      ,
+*                ; ,  
+*            ,    NOTE_OFF   
+*               ,    ,
+*            .
+*
+*    :
+*   SingoscopeSelfTest
+*
+*           
+*   .    ,    .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#include "Log.h"
+#include "TextMessages.h"
+#include "ShowError.h"
+#include "Song.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiPart.h"
+#include "MidiLyric.h"
+#include "MidiSong.h"
+#include "MidiFile.h"
+#include "MidiStreamParser.h"
+#include "SongFile.h"
+#include "SongLoader.h"
+#include "RecentSongCache.h"
+#include "AudioRing.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//    
+#define SELFTEST_LOG_FILE_NAME			TEXT("selftestlog.txt")
+
+//  ,     ,   
+//   ;   ,     
+#define LOG_CHECK_THREAD_COUNT			4
+#define LOG_CHECK_MESSAGE_COUNT			20000
+
+//  ,    ,     
+// ;       ,   
+// ,   
+#define LOG_CHECK_BURST_SIZE			200
+#define LOG_CHECK_BURST_PAUSE			5
+
+//   ,    
+#define LOG_CHECK_PREFIX				"selftest "
+
+//  ,      
+#define LOG_DROPPED_PREFIX				"*** "
+
+//  MIDI-  ,     
+#define LOADER_CHECK_MIDI_FILE_NAME		TEXT("selftest.mid")
+
+//    4/4         ;
+//    ,     
+#define TEST_MIDI_MEASURES				32
+#define TEST_MIDI_DIVISION				480
+
+//    :   (14 ),   (8 ),
+//  (7 ),  (8 ),   (3 ),  16   
+//    (4 )
+#define TEST_MIDI_IMAGE_SIZE			(44 + TEST_MIDI_MEASURES * 4 * 16)
+
+//   ,     
+#define LOADER_CHECK_MISSING_FILE_NAME	TEXT("selftest_missing.mid")
+
+//     ,       
+#define LOADER_CHECK_PREVIEW_MEASURES	2
+
+//   ,    
+#define LOADER_CHECK_QUANTIZE_STEP		32
+
+//   ,    LoadProc    
+//  ;        
+#define LOADER_CHECK_PAUSE				100
+
+//     
+#define LOADER_CHECK_MAX_EVENTS			64
+
+//   ,        
+#define LOADER_CHECK_TIMEOUT			10000
+
+//  ,        
+// ,   ,     
+#define CACHE_CHECK_CAPACITY			3
+#define CACHE_CHECK_SONG_COUNT			5
+
+//     ,      
+//  ,    ;     
+//   ,      
+#define RING_CHECK_BLOCK_COUNT			5
+#define RING_CHECK_SAMPLES_PER_BLOCK	64
+#define RING_CHECK_TOTAL_BLOCKS			100000
+
+//   ,      ,    
+//         
+#define TEMPO_CHECK_DEFAULT_BPM			120.0
+#define TEMPO_CHECK_SECONDS_PER_WHOLE	240.0
+
+//       ,     , 
+//  ,      (   
+// );       
+#define TEMPO_CHECK_POSITION_STEP		0.125
+#define TEMPO_CHECK_POSITION_COUNT		137
+#define TEMPO_CHECK_POSITION_STRIDE		37
+
+//       
+#define TEMPO_ORDER_ASCENDING			0
+#define TEMPO_ORDER_DESCENDING			1
+#define TEMPO_ORDER_SCATTERED			2
+
+//     
+#define TEMPO_CHECK_TOLERANCE			1e-9
+
+//    (  2520   )  
+// ,        (1260 )
+#define TIMELINE_CHECK_QUANTIZE_STEP	32
+#define TIMELINE_CHECK_EMPTY_NOTE_LENGTH	64
+
+//      MIDI-,     
+// ,      (    4/4) 
+//  ;      
+#define VOCAL_CHECK_DIVISION			480
+#define VOCAL_CHECK_LYRIC_START			1920
+#define VOCAL_CHECK_LYRIC_EVENTS		16
+
+//  ,      ,   
+// ,     (.  GetFixtureNotes);   
+//          
+#define VOCAL_CHECK_SHORT_END_EVENTS	8
+#define VOCAL_CHECK_DENSE_NOTES			10
+
+//      ;    0, 1  2  ,
+//          
+#define VOCAL_CHECK_NOTE_SHIFT			10
+
+//      ,    ,   
+// ,       ,     
+//  ;       2 
+#define VOCAL_CHECK_MAX_PARTS			4
+#define VOCAL_CHECK_MAX_NOTES			32
+#define VOCAL_CHECK_MAX_TRACK_EVENTS	256
+#define VOCAL_CHECK_MAX_TRACKS			8
+#define VOCAL_CHECK_MAX_VOCAL_PARTS		16
+#define VOCAL_CHECK_IMAGE_SIZE			8192
+
+//      (.  g_RefVocalPartLimitations)
+#define VOCAL_CHECK_STAGE_COUNT			6
+
+//    ,       
+//        ;   
+//   MidiFile.cpp
+#define IDENTICAL_START					0x00000001
+#define IDENTICAL_END					0x00000002
+#define LIMIT_NOTES_PER_METAEVENT		0x00000004
+#define MAX_NOTES_PER_METAEVENT			10
+#define MAX_VOCAL_PART_LYRIC_DISTANCE	500
+
+//         ,  
+//       ,    
+//      
+#define TRACK_CHECK_RANDOM_TRACKS		200
+#define TRACK_CHECK_TRUNCATED_TRACKS	20
+#define TRACK_CHECK_MAX_EVENTS			140
+#define TRACK_CHECK_TRACK_SIZE			4096
+
+//  MIDI-      ,  
+//  ,         
+#define STREAM_CHECK_FILES				3
+#define STREAM_CHECK_PASSES				8
+#define STREAM_CHECK_CHUNKS				7
+#define STREAM_CHECK_FILE_SIZE			98304
+
+//     MIDI-      , 
+//        ,    
+#define STREAM_CHECK_DIVISION			480
+#define STREAM_CHECK_MISSING_BYTES		100
+
+//      ,   
+//  
+#define STREAM_CHECK_GUARD_SIZE			16
+
+//          (,   
+//   ),      ,    
+//     NOTE_OFF;      
+#define POOL_CHECK_CONCORD_NOTES		(2 * NOTE_POOL_BLOCK_SIZE + 44)
+#define POOL_CHECK_CONCORD_LENGTH		480
+#define POOL_CHECK_OFF_STRIDE			7
+
+//       ,   
+// ,          
+#define POOL_CHECK_ROUNDS				2
+#define POOL_CHECK_ROUND_LENGTH			1920
+#define POOL_CHECK_MELODY_NOTES			3
+#define POOL_CHECK_MELODY_NOTE_LENGTH	120
+
+//  ,   ,     
+#define POOL_CHECK_EXPECTED_NOTES	(POOL_CHECK_ROUNDS * (1 + POOL_CHECK_MELODY_NOTES))
+#define POOL_CHECK_TRACK_SIZE			8192
+
+//   
+#define EXIT_CODE_SUCCESS				0
+#define EXIT_CODE_CHECK_FAILED			1
+#define EXIT_CODE_INVALID_ARGUMENTS		2
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,   ,   LoadProc
+struct LOADEVENT
+{
+	DWORD iLoad; //  
+	SONGLOADEVENT Event; // 
+	DWORD Param; //  
+};
+
+// ,         
+struct TIMELINENOTE
+{
+	DWORD ToNoteOn; //        (   
+					//   )
+	DWORD Length; //   (      )
+	DWORD cuToExpectedNoteOn; //       
+							  //    
+	DWORD cuExpectedLength; //       
+};
+
+//    MIDI-,       (.
+//  GetFixtureNotes)
+enum PARTSHAPE
+{
+	PART_SHAPE_ALIGNED,
+	PART_SHAPE_OVERLAPPED,
+	PART_SHAPE_EARLY_START,
+	PART_SHAPE_SHORT_END,
+	PART_SHAPE_LOOSE_ENDS,
+	PART_SHAPE_DENSE,
+	PART_SHAPE_LONG_END,
+	PART_SHAPE_SPARSE,
+	PART_SHAPE_EMPTY
+};
+
+// ,   MIDI-     
+struct FIXTUREPART
+{
+	DWORD iTrack; //  
+	DWORD Channel; //  
+	DWORD Instrument; //  
+	PARTSHAPE Shape; //  
+};
+
+// ,  MIDI-     
+struct VOCALFIXTURE
+{
+	LPCTSTR pszName; //       
+	DWORD cParts; //  
+	FIXTUREPART Parts[VOCAL_CHECK_MAX_PARTS]; // 
+	DWORD iExpectedStage; //  ,     
+};
+
+// ,      MIDI-
+struct FIXTUREEVENT
+{
+	DWORD ctTime; //       
+	DWORD Order; //       
+	BYTE Status; //  
+	BYTE Data[2]; //  
+	DWORD cbData; //   
+};
+
+// ,      
+struct REFVOCALPARTLIMITATIONS
+{
+	double OverlapsThreshold; //     
+	DWORD fCriteria; //  
+};
+
+// ,   ,   
+struct REFVOCALPART
+{
+	DWORD iTrack; //  
+	DWORD Channel; //    ANY_CHANNEL
+	DWORD Instrument; //    ANY_INSTRUMENT
+	double PartLyricDistance; //      
+};
+
+//     GetReferenceDistance
+enum REFDISTANCERESULT
+{
+	REF_DISTANCE_SUCCESS,
+	REF_DISTANCE_NOT_VOCAL_PART,
+	REF_DISTANCE_NO_NOTES,
+	REF_DISTANCE_CANT_ALLOC_MEMORY
+};
+
+// ,  ,    
+struct REFTRACKEVENT
+{
+	DWORD ctTime; //       
+	DWORD DataOffset; //        
+	DWORD cbData; //     
+	DWORD Event; //  
+	DWORD Channel; //  
+};
+
+// ,   MIDI-      
+struct STREAMTRACK
+{
+	MidiTrack Track; // ,   ,     MidiFile
+	bool bIsValid; // false,   MidiFile  
+	DWORD iTrack; //     MidiFile
+	DWORD ctLength; //       
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//      
+static DWORD g_cFailedChecks = 0;
+
+//        ;  
+// LoadProc   ,       
+static LOADEVENT g_LoadEvents[LOADER_CHECK_MAX_EVENTS];
+static volatile LONG g_cLoadEvents = 0;
+
+//  ,    LoadProc   ,  
+// ;  ,   g_bIsPauseEnabled   
+static SONGLOADEVENT g_PauseEvent = SONGLOAD_EVENT_STAGE;
+static DWORD g_PauseParam = 0;
+static volatile LONG g_bIsPauseEnabled = 0;
+
+// ,    LoadProc    
+//    
+static HANDLE g_hPausedEvent = NULL;
+static HANDLE g_hFinishedEvent = NULL;
+
+// ,    ,     
+static volatile LONG g_bIsRingReaderStopped = 0;
+
+//     ;   
+// g_VocalPartLimitations  MidiFile.cpp
+static const REFVOCALPARTLIMITATIONS g_RefVocalPartLimitations[VOCAL_CHECK_STAGE_COUNT] =
+{
+	{ 0.0, IDENTICAL_START | IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, IDENTICAL_START | IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, IDENTICAL_START | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, LIMIT_NOTES_PER_METAEVENT },
+	{ 0.5, 0 }
+};
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static void Check(
+	__in bool bCondition,
+	__in LPCTSTR pszDescription);
+
+#ifdef DEBUGLOG
+
+static bool WriteLogMessages();
+
+static DWORD WINAPI LogThreadProc(
+	__in LPVOID lpParameter);
+
+static void CheckLogFile();
+
+#endif
+
+static void CheckLoader();
+
+static bool WriteTestMidiFile(
+	__in LPCTSTR pszFileName);
+
+static void CheckMissingFile(
+	__in SongLoader *pLoader);
+
+static void CheckPreview(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszMidiFileName);
+
+static void CheckCancel(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszMidiFileName,
+	__in SONGLOADEVENT PauseEvent,
+	__in DWORD PauseParam,
+	__in LPCTSTR pszEventName);
+
+static void CheckRestart(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszMidiFileName);
+
+static void StartLoad(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszFileName,
+	__in bool bIsPaused,
+	__in SONGLOADEVENT PauseEvent,
+	__in DWORD PauseParam);
+
+static bool CheckLoadEvents(
+	__in DWORD iLoad,
+	__in bool bIsLoaded);
+
+static void LoadProc(
+	__in DWORD iLoad,
+	__in SONGLOADEVENT Event,
+	__in DWORD Param,
+	__in LPVOID pContext);
+
+static void CheckRecentSongCache();
+
+static void GetTestSongKey(
+	__in DWORD iSong,
+	__out RECENTSONGKEY *pKey);
+
+static bool PutTestSong(
+	__in RecentSongCache *pCache,
+	__in DWORD iSong);
+
+static bool TakeTestSong(
+	__in RecentSongCache *pCache,
+	__in DWORD iSong);
+
+static void CheckAudioRing();
+
+static DWORD WINAPI RingWriterThreadProc(
+	__in LPVOID lpParameter);
+
+static void FillTestBlock(
+	__out AUDIOBLOCK *pBlock,
+	__in DWORD iBlock);
+
+static bool IsTestBlockValid(
+	__in const AUDIOBLOCK *pBlock,
+	__in DWORD iBlock);
+
+static void CheckTempoMap();
+
+static bool CheckTempoPositions(
+	__in Song *pSong,
+	__in DWORD Order);
+
+static double GetLinearSeconds(
+	__in Song *pSong,
+	__in double WholeNotes);
+
+static bool IsNear(
+	__in double Value,
+	__in double Expected);
+
+static void CheckSongTimeline();
+
+static bool CheckTickConversion(
+	__in DWORD cTicksPerMidiQuarterNote,
+	__in const DWORD (*pMeasures)[3],
+	__in DWORD cMeasures,
+	__in const TIMELINENOTE *pNotes,
+	__in DWORD cNotes);
+
+static bool CreateTimelineSong(
+	__out Song *pSong,
+	__in const TIMELINENOTE *pNotes,
+	__in DWORD cNotes);
+
+static bool IsSongTimelineValid(
+	__in Song *pSong,
+	__in const TIMELINENOTE *pNotes,
+	__in DWORD cNotes);
+
+static void CheckVocalPartSearch();
+
+static DWORD BuildVocalFixture(
+	__in const VOCALFIXTURE *pFixture,
+	__out BYTE *pImage);
+
+static DWORD GetFixtureNotes(
+	__in PARTSHAPE Shape,
+	__out NOTEDESC *pNotes);
+
+static void WriteVarLen(
+	__inout BYTE **ppCurByte,
+	__in DWORD Value);
+
+static int __cdecl CompareFixtureEvents(
+	__in const void *pElement1,
+	__in const void *pElement2);
+
+static bool FindReferenceVocalParts(
+	__in BYTE *pImage,
+	__in DWORD cbImage,
+	__out REFVOCALPART *pVocalParts,
+	__out DWORD *pcVocalParts,
+	__out DWORD *piStage);
+
+static REFDISTANCERESULT GetReferenceDistance(
+	__in MidiTrack *pTrack,
+	__in MidiLyric *pLyric,
+	__in DWORD cTicksPerMidiQuarterNote,
+	__in DWORD Channel,
+	__in DWORD Instrument,
+	__in double OverlapsThreshold,
+	__in DWORD fCriteria,
+	__out double *pPartLyricDistance);
+
+static REFDISTANCERESULT CheckReferenceTailNotes(
+	__inout MidiPart *pPart,
+	__in DWORD cNotesPerMetaEvent);
+
+static REFDISTANCERESULT AddReferenceTailEvents(
+	__in MidiLyric *pLyric,
+	__in DWORD iLyricEvent,
+	__in DWORD ctToLyricEvent,
+	__in DWORD cchEventText,
+	__in const NOTEDESC *pLastNote,
+	__in DWORD cchPerLastNote,
+	__in DWORD fCriteria,
+	__in DWORD cTicksPerMidiQuarterNote,
+	__in DWORD PartLyricDistance,
+	__out double *pPartLyricDistance);
+
+static bool IsReferenceFirstNoteNearer(
+	__in DWORD ctToLyricEvent,
+	__in const NOTEDESC *pFirstNote,
+	__in const NOTEDESC *pSecondNote);
+
+static bool AddReferenceVocalPart(
+	__inout REFVOCALPART *pVocalParts,
+	__inout DWORD *pcVocalParts,
+	__in DWORD iTrack,
+	__in DWORD Channel,
+	__in DWORD Instrument,
+	__in double PartLyricDistance);
+
+static DWORD TickDistance(
+	__in DWORD ctTime1,
+	__in DWORD ctTime2);
+
+static void CheckTrackDecoding();
+
+static bool IsTrackDecodedAsBefore(
+	__in BYTE *pTrack,
+	__in DWORD cbTrack,
+	__out REFTRACKEVENT *pRefEvents);
+
+static MIDITRACKRESULT DecodeReferenceTrack(
+	__in BYTE *pTrack,
+	__in DWORD cbTrack,
+	__out REFTRACKEVENT *pEvents,
+	__out DWORD *pcEvents,
+	__out_opt DWORD *pctTrackLength);
+
+static DWORD BuildRandomTrack(
+	__inout DWORD *pSeed,
+	__out BYTE *pTrack);
+
+static void WriteRandomVarLen(
+	__inout DWORD *pSeed,
+	__inout BYTE **ppCurByte,
+	__in DWORD cBytes);
+
+static DWORD GetRandom(
+	__inout DWORD *pSeed,
+	__in DWORD Range);
+
+static void CheckStreamParser();
+
+static DWORD BuildStreamFile(
+	__inout DWORD *pSeed,
+	__out BYTE *pFile);
+
+static DWORD AttachStreamTracks(
+	__in BYTE *pFile,
+	__in DWORD cbFile,
+	__out STREAMTRACK *pTracks,
+	__out REFTRACKEVENT *pRefEvents);
+
+static bool IsStreamParsedAsTracks(
+	__inout MidiStreamParser *pParser,
+	__in BYTE *pFile,
+	__in DWORD cbFile,
+	__in STREAMTRACK *pTracks,
+	__in DWORD cTracks,
+	__in DWORD cbMaxPortion,
+	__inout DWORD *pSeed,
+	__out BYTE *pPortion,
+	__out DWORD *pcSkippedEvents,
+	__out DWORD *pcStraddlingEvents);
+
+static void CheckNotePool();
+
+static DWORD BuildPoolTrack(
+	__out BYTE *pTrack,
+	__out NOTEDESC *pExpectedNotes);
+
+/****************************************************************************************
+*
+*    _tmain
+*
+*   .   main  MSDN.
+*
+****************************************************************************************/
+
+int __cdecl _tmain(
+	int argc,
+	TCHAR *argv[])
+{
+	//   OEM-,      
+	setlocale(LC_ALL, ".OCP");
+
+	if (argc != 1)
+	{
+		_tprintf(TEXT("usage: SingoscopeSelfTest\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	INITLOG(SELFTEST_LOG_FILE_NAME);
+
+#ifdef DEBUGLOG
+	bool bAreLogMessagesWritten = WriteLogMessages();
+#endif
+
+	CheckLoader();
+
+	CheckRecentSongCache();
+
+	CheckAudioRing();
+
+	CheckTempoMap();
+
+	CheckSongTimeline();
+
+	CheckVocalPartSearch();
+
+	CheckTrackDecoding();
+
+	CheckStreamParser();
+
+	CheckNotePool();
+
+	//     ,     
+	//     
+	UNINITLOG();
+
+#ifdef DEBUGLOG
+	_tprintf(TEXT("log queue\n"));
+	Check(bAreLogMessagesWritten, TEXT("all log threads start"));
+
+	if (bAreLogMessagesWritten) CheckLogFile();
+#else
+	_tprintf(TEXT("log queue: skipped (built without DEBUGLOG)\n"));
+#endif
+
+	if (g_cFailedChecks != 0)
+	{
+		_tprintf(TEXT("%u checks failed\n"), g_cFailedChecks);
+		return EXIT_CODE_CHECK_FAILED;
+	}
+
+	_tprintf(TEXT("all checks passed\n"));
+
+	return EXIT_CODE_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    Check
+*
+*   
+*       bCondition -  
+*       pszDescription -  
+*
+*    
+*       
+*
+*      ,       
+*   .
+*
+****************************************************************************************/
+
+static void Check(
+	__in bool bCondition,
+	__in LPCTSTR pszDescription)
+{
+	if (bCondition) return;
+
+	_tprintf(TEXT("    FAILED: %s\n"), pszDescription);
+	g_cFailedChecks++;
+}
+
+#ifdef DEBUGLOG
+
+/****************************************************************************************
+*
+*    WriteLogMessages
+*
+*   
+*       
+*
+*    
+*       true,      ;  false.
+*
+*     ,      
+*    ,    .
+*
+****************************************************************************************/
+
+static bool WriteLogMessages()
+{
+	HANDLE hThreads[LOG_CHECK_THREAD_COUNT];
+	DWORD cThreads = 0;
+
+	for (DWORD iThread = 0; iThread < LOG_CHECK_THREAD_COUNT; iThread++)
+	{
+		hThreads[cThreads] = CreateThread(NULL, 0, LogThreadProc,
+			(LPVOID) (DWORD_PTR) iThread, 0, NULL);
+
+		if (hThreads[cThreads] == NULL)
+		{
+			LOG("CreateThread failed (error %u)\n", GetLastError());
+			break;
+		}
+
+		cThreads++;
+	}
+
+	if (cThreads != 0)
+	{
+		WaitForMultipleObjects(cThreads, hThreads, TRUE, INFINITE);
+	}
+
+	for (DWORD iThread = 0; iThread < cThreads; iThread++)
+	{
+		CloseHandle(hThreads[iThread]);
+	}
+
+	return cThreads == LOG_CHECK_THREAD_COUNT;
+}
+
+/****************************************************************************************
+*
+*    LogThreadProc
+*
+*   
+*       lpParameter -  
+*
+*    
+*       .
+*
+*              ,
+*        .
+*
+****************************************************************************************/
+
+static DWORD WINAPI LogThreadProc(
+	__in LPVOID lpParameter)
+{
+	DWORD iThread = (DWORD) (DWORD_PTR) lpParameter;
+
+	for (DWORD iMessage = 0; iMessage < LOG_CHECK_MESSAGE_COUNT; iMessage++)
+	{
+		LOG(LOG_CHECK_PREFIX "%u %u\n", iThread, iMessage);
+
+		if ((iMessage + 1) % LOG_CHECK_BURST_SIZE == 0) Sleep(LOG_CHECK_BURST_PAUSE);
+	}
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    CheckLogFile
+*
+*   
+*       
+*
+*    
+*       
+*
+*        ,    
+*      ,      
+*     ,  ,   ,  , 
+*   .
+*
+****************************************************************************************/
+
+static void CheckLogFile()
+{
+	HANDLE hFile = CreateFile(SELFTEST_LOG_FILE_NAME, GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, 0, NULL);
+
+	Check(hFile != INVALID_HANDLE_VALUE, TEXT("log file can be opened"));
+
+	if (hFile == INVALID_HANDLE_VALUE) return;
+
+	DWORD cbFile = GetFileSize(hFile, NULL);
+	char *pText = NULL;
+	DWORD cbRead = 0;
+
+	if (cbFile != INVALID_FILE_SIZE)
+	{
+		pText = (char *) HeapAlloc(GetProcessHeap(), 0, cbFile + 1);
+	}
+
+	if (pText != NULL && !ReadFile(hFile, pText, cbFile, &cbRead, NULL))
+	{
+		cbRead = 0;
+	}
+
+	CloseHandle(hFile);
+
+	Check(pText != NULL && cbRead == cbFile, TEXT("log file can be read"));
+
+	if (pText == NULL) return;
+
+	pText[cbRead] = '\0';
+
+	//        
+	//  
+	DWORD iNextMessage[LOG_CHECK_THREAD_COUNT] = {0};
+	DWORD cWrittenMessages[LOG_CHECK_THREAD_COUNT] = {0};
+
+	DWORD cDroppedMessages = 0;
+	bool bIsFormatValid = true;
+	bool bIsOrderValid = true;
+
+	for (char *pLine = pText; *pLine != '\0'; )
+	{
+		char *pLineEnd = strchr(pLine, '\n');
+		char *pNextLine = pLine + strlen(pLine);
+
+		if (pLineEnd != NULL)
+		{
+			pNextLine = pLineEnd + 1;
+			*pLineEnd = '\0';
+		}
+
+		char *pMessage = strstr(pLine, LOG_CHECK_PREFIX);
+		char *pDropped = strstr(pLine, LOG_DROPPED_PREFIX);
+
+		if (pMessage != NULL)
+		{
+			//        
+			DWORD iThread, iMessage;
+			int cchParsed = 0;
+
+			if (sscanf(pMessage + strlen(LOG_CHECK_PREFIX), "%u %u%n", &iThread,
+				&iMessage, &cchParsed) != 2 || iThread >= LOG_CHECK_THREAD_COUNT ||
+				strspn(pMessage + strlen(LOG_CHECK_PREFIX) + cchParsed, "\r") !=
+				strlen(pMessage + strlen(LOG_CHECK_PREFIX) + cchParsed))
+			{
+				bIsFormatValid = false;
+			}
+			else if (iMessage < iNextMessage[iThread])
+			{
+				bIsOrderValid = false;
+			}
+			else
+			{
+				iNextMessage[iThread] = iMessage + 1;
+				cWrittenMessages[iThread]++;
+			}
+		}
+		else if (pDropped != NULL)
+		{
+			int cDropped;
+
+			if (sscanf(pDropped, LOG_DROPPED_PREFIX "%d", &cDropped) == 1 &&
+				cDropped > 0)
+			{
+				cDroppedMessages += cDropped;
+			}
+			else
+			{
+				bIsFormatValid = false;
+			}
+		}
+
+		pLine = pNextLine;
+	}
+
+	HeapFree(GetProcessHeap(), 0, pText);
+
+	DWORD cTotalWritten = 0;
+	bool bAreCountsValid = true;
+
+	for (DWORD iThread = 0; iThread < LOG_CHECK_THREAD_COUNT; iThread++)
+	{
+		cTotalWritten += cWrittenMessages[iThread];
+
+		if (cWrittenMessages[iThread] > LOG_CHECK_MESSAGE_COUNT)
+		{
+			bAreCountsValid = false;
+		}
+	}
+
+	_tprintf(TEXT("    %u messages written, %u dropped\n"), cTotalWritten,
+		cDroppedMessages);
+
+	Check(cTotalWritten != 0, TEXT("some log messages are written"));
+	Check(bIsFormatValid, TEXT("each log message is written whole on its own line"));
+	Check(bIsOrderValid, TEXT("log messages of each thread keep their order"));
+	Check(bAreCountsValid, TEXT("no log message is written twice"));
+	Check(cTotalWritten + cDroppedMessages >=
+		LOG_CHECK_THREAD_COUNT * LOG_CHECK_MESSAGE_COUNT,
+		TEXT("each lost log message is counted as dropped"));
+}
+
+#endif
+
+/****************************************************************************************
+*
+*    CheckLoader
+*
+*   
+*       
+*
+*    
+*       
+*
+*             
+*      MIDI-,    .
+*
+****************************************************************************************/
+
+static void CheckLoader()
+{
+	LPCTSTR pszMidiFileName = LOADER_CHECK_MIDI_FILE_NAME;
+
+	g_hPausedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	g_hFinishedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	SongLoader *pLoader = new SongLoader;
+
+	if (g_hPausedEvent != NULL && g_hFinishedEvent != NULL && pLoader != NULL)
+	{
+		pLoader->SetLoadProc(LoadProc, NULL);
+
+		CheckMissingFile(pLoader);
+
+		if (WriteTestMidiFile(pszMidiFileName))
+		{
+			CheckPreview(pLoader, pszMidiFileName);
+
+			CheckCancel(pLoader, pszMidiFileName, SONGLOAD_EVENT_STAGE,
+				SONGLOAD_STAGE_READ_FILE, TEXT("file reading"));
+			CheckCancel(pLoader, pszMidiFileName, SONGLOAD_EVENT_STAGE,
+				SONGLOAD_STAGE_FIND_VOCAL_PARTS, TEXT("vocal part search"));
+			CheckCancel(pLoader, pszMidiFileName, SONGLOAD_EVENT_PREVIEW, 0,
+				TEXT("preview"));
+			CheckCancel(pLoader, pszMidiFileName, SONGLOAD_EVENT_STAGE,
+				SONGLOAD_STAGE_COMPLETE_SONG, TEXT("song completion"));
+
+			CheckRestart(pLoader, pszMidiFileName);
+
+			DeleteFile(pszMidiFileName);
+		}
+		else
+		{
+			Check(false, TEXT("test MIDI file can be written"));
+		}
+	}
+	else
+	{
+		_tprintf(TEXT("song loader\n"));
+		Check(false, TEXT("song loader check can be prepared"));
+	}
+
+	delete pLoader;
+
+	if (g_hPausedEvent != NULL) CloseHandle(g_hPausedEvent);
+	if (g_hFinishedEvent != NULL) CloseHandle(g_hFinishedEvent);
+}
+
+/****************************************************************************************
+*
+*    WriteTestMidiFile
+*
+*   
+*       pszFileName -   
+*
+*    
+*       true,   ;  false.
+*
+*    MIDI-  0    TEST_MIDI_MEASURES   4/4 
+*    120   .   -     , 
+*         ,    ,
+*         .
+*
+****************************************************************************************/
+
+static bool WriteTestMidiFile(
+	__in LPCTSTR pszFileName)
+{
+	BYTE Image[TEST_MIDI_IMAGE_SIZE];
+	BYTE *pCurByte = Image;
+
+	//  :  0,  
+	static const BYTE FileHeader[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1,
+		HIBYTE(TEST_MIDI_DIVISION), LOBYTE(TEST_MIDI_DIVISION)};
+
+	CopyMemory(pCurByte, FileHeader, sizeof(FileHeader));
+	pCurByte += sizeof(FileHeader);
+
+	//  ;       
+	CopyMemory(pCurByte, "MTrk", 4);
+	BYTE *pTrackSize = pCurByte + 4;
+	pCurByte += 8;
+
+	//  (500000   ),  4/4   , 
+	//      
+	static const BYTE TrackStart[] = {
+		0x00, 0xFF, SET_TEMPO, 3, 0x07, 0xA1, 0x20,
+		0x00, 0xFF, TIME_SIGNATURE, 4, 4, 2, 24, 8,
+		0x00, PROGRAM_CHANGE, 52};
+
+	CopyMemory(pCurByte, TrackStart, sizeof(TrackStart));
+	pCurByte += sizeof(TrackStart);
+
+	for (DWORD iNote = 0; iNote < TEST_MIDI_MEASURES * 4; iNote++)
+	{
+		BYTE NoteNumber = (BYTE) (60 + iNote % 8);
+
+		// ,       
+		static const BYTE Lyric[] = {0x00, 0xFF, LYRIC, 3, 'l', 'a', ' '};
+
+		CopyMemory(pCurByte, Lyric, sizeof(Lyric));
+		pCurByte += sizeof(Lyric);
+
+		*pCurByte++ = 0x00;
+		*pCurByte++ = NOTE_ON;
+		*pCurByte++ = NoteNumber;
+		*pCurByte++ = 100;
+
+		*pCurByte++ = (BYTE) (0x80 | (TEST_MIDI_DIVISION >> 7));
+		*pCurByte++ = (BYTE) (TEST_MIDI_DIVISION & 0x7F);
+		*pCurByte++ = NOTE_ON;
+		*pCurByte++ = NoteNumber;
+		*pCurByte++ = 0;
+	}
+
+	static const BYTE EndOfTrack[] = {0x00, 0xFF, END_OF_TRACK, 0};
+
+	CopyMemory(pCurByte, EndOfTrack, sizeof(EndOfTrack));
+	pCurByte += sizeof(EndOfTrack);
+
+	DWORD cbTrack = (DWORD) (pCurByte - pTrackSize - 4);
+
+	pTrackSize[0] = HIBYTE(HIWORD(cbTrack));
+	pTrackSize[1] = LOBYTE(HIWORD(cbTrack));
+	pTrackSize[2] = HIBYTE(LOWORD(cbTrack));
+	pTrackSize[3] = LOBYTE(LOWORD(cbTrack));
+
+	HANDLE hFile = CreateFile(pszFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		LOG("CreateFile failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	DWORD cbImage = (DWORD) (pCurByte - Image);
+	DWORD cbWritten;
+
+	bool bResult = WriteFile(hFile, Image, cbImage, &cbWritten, NULL) &&
+		cbWritten == cbImage;
+
+	if (!bResult) LOG("WriteFile failed (error %u)\n", GetLastError());
+
+	CloseHandle(hFile);
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    CheckMissingFile
+*
+*   
+*       pLoader -    
+*
+*    
+*       
+*
+*       ,    CreateFile
+*     ,    .
+*
+****************************************************************************************/
+
+static void CheckMissingFile(
+	__in SongLoader *pLoader)
+{
+	_tprintf(TEXT("song loader: missing file\n"));
+
+	DeleteFile(LOADER_CHECK_MISSING_FILE_NAME);
+
+	StartLoad(pLoader, LOADER_CHECK_MISSING_FILE_NAME, false, SONGLOAD_EVENT_STAGE, 0);
+
+	SongFile *pSongFile;
+	Song *pSong;
+
+	Check(!pLoader->TakeResult(&pSongFile, &pSong), TEXT("missing file is not loaded"));
+	Check(pSongFile == NULL && pSong == NULL, TEXT("failed load returns no objects"));
+
+	DWORD SystemError, FunctionId;
+
+	Check(pLoader->GetLastResult(&SystemError, &FunctionId) == MIDIFILE_SUCCESS &&
+		SystemError != ERROR_SUCCESS && FunctionId == FUNCID_CREATE_FILE,
+		TEXT("CreateFile error is returned to the caller"));
+
+	CheckLoadEvents(pLoader->GetCurrentLoad(), false);
+}
+
+/****************************************************************************************
+*
+*    CheckPreview
+*
+*   
+*       pLoader -    
+*       pszMidiFileName -  MIDI-  
+*
+*    
+*       
+*
+*          ,    
+*      ,     ,  
+*     .
+*
+****************************************************************************************/
+
+static void CheckPreview(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszMidiFileName)
+{
+	_tprintf(TEXT("song loader: preview and result\n"));
+
+	StartLoad(pLoader, pszMidiFileName, false, SONGLOAD_EVENT_STAGE, 0);
+
+	Check(WaitForSingleObject(g_hFinishedEvent, LOADER_CHECK_TIMEOUT) == WAIT_OBJECT_0,
+		TEXT("load finishes"));
+
+	Song *pPreviewSong = pLoader->TakePreviewSong();
+
+	SongFile *pSongFile;
+	Song *pSong;
+
+	Check(pLoader->TakeResult(&pSongFile, &pSong), TEXT("song is loaded"));
+	Check(!pLoader->IsLoading(), TEXT("result is taken"));
+
+	bool bIsPreviewSent = CheckLoadEvents(pLoader->GetCurrentLoad(), true);
+
+	Check(bIsPreviewSent == (pPreviewSong != NULL),
+		TEXT("preview song is kept until it is taken"));
+
+	if (!bIsPreviewSent)
+	{
+		_tprintf(TEXT("    song is too short for a preview\n"));
+	}
+
+	delete pPreviewSong;
+	delete pSong;
+	delete pSongFile;
+}
+
+/****************************************************************************************
+*
+*    CheckCancel
+*
+*   
+*       pLoader -    
+*       pszMidiFileName -  MIDI-  
+*       PauseEvent -  ,     
+*       PauseParam -   
+*       pszEventName -    
+*
+*    
+*       
+*
+*          ,   ,
+*         .
+*
+****************************************************************************************/
+
+static void CheckCancel(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszMidiFileName,
+	__in SONGLOADEVENT PauseEvent,
+	__in DWORD PauseParam,
+	__in LPCTSTR pszEventName)
+{
+	_tprintf(TEXT("song loader: cancel at %s\n"), pszEventName);
+
+	StartLoad(pLoader, pszMidiFileName, true, PauseEvent, PauseParam);
+
+	HANDLE hEvents[2] = {g_hPausedEvent, g_hFinishedEvent};
+
+	DWORD WaitResult = WaitForMultipleObjects(2, hEvents, FALSE, LOADER_CHECK_TIMEOUT);
+
+	Check(WaitResult == WAIT_OBJECT_0 || WaitResult == WAIT_OBJECT_0 + 1,
+		TEXT("load reaches the event or finishes"));
+
+	pLoader->Cancel();
+
+	Check(!pLoader->IsLoading(), TEXT("cancelled load is not running"));
+
+	SongFile *pSongFile;
+	Song *pSong;
+
+	Check(!pLoader->TakeResult(&pSongFile, &pSong),
+		TEXT("cancelled load has no result"));
+
+	if (WaitResult != WAIT_OBJECT_0)
+	{
+		//   ,   ;   
+		//  SONGLOAD_EVENT_PREVIEW 
+		_tprintf(TEXT("    load has no such event\n"));
+		return;
+	}
+
+	Check(pLoader->GetLastResult() == MIDIFILE_CANCELLED,
+		TEXT("cancelled load reports MIDIFILE_CANCELLED"));
+
+	CheckLoadEvents(pLoader->GetCurrentLoad(), false);
+
+	// ,     ,     
+	if (PauseEvent == SONGLOAD_EVENT_STAGE && PauseParam == SONGLOAD_STAGE_COMPLETE_SONG)
+	{
+		return;
+	}
+
+	for (LONG iEvent = 0; iEvent < g_cLoadEvents; iEvent++)
+	{
+		if (g_LoadEvents[iEvent].Event == SONGLOAD_EVENT_STAGE &&
+			g_LoadEvents[iEvent].Param == SONGLOAD_STAGE_COMPLETE_SONG)
+		{
+			Check(false, TEXT("cancelled load does not complete the song"));
+			break;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    CheckRestart
+*
+*   
+*       pLoader -    
+*       pszMidiFileName -  MIDI-  
+*
+*    
+*       
+*
+*     ,    ,  ,  
+*            ,   
+*        .
+*
+****************************************************************************************/
+
+static void CheckRestart(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszMidiFileName)
+{
+	_tprintf(TEXT("song loader: restart\n"));
+
+	StartLoad(pLoader, pszMidiFileName, true, SONGLOAD_EVENT_STAGE,
+		SONGLOAD_STAGE_READ_FILE);
+
+	DWORD iOldLoad = pLoader->GetCurrentLoad();
+
+	Check(WaitForSingleObject(g_hPausedEvent, LOADER_CHECK_TIMEOUT) == WAIT_OBJECT_0,
+		TEXT("first load reaches the event"));
+
+	//   ,    
+	InterlockedExchange(&g_bIsPauseEnabled, 0);
+	pLoader->Start(pszMidiFileName, CP_ACP, CHOOSE_MIN_NOTE_NUMBER,
+		LOADER_CHECK_QUANTIZE_STEP, LOADER_CHECK_PREVIEW_MEASURES);
+
+	DWORD iNewLoad = pLoader->GetCurrentLoad();
+
+	Check(iNewLoad != iOldLoad, TEXT("new load gets a new number"));
+
+	SongFile *pSongFile;
+	Song *pSong;
+
+	Check(pLoader->TakeResult(&pSongFile, &pSong), TEXT("new load is loaded"));
+
+	delete pSong;
+	delete pSongFile;
+
+	CheckLoadEvents(iOldLoad, false);
+	CheckLoadEvents(iNewLoad, true);
+
+	bool bIsNewLoadStarted = false;
+
+	for (LONG iEvent = 0; iEvent < g_cLoadEvents; iEvent++)
+	{
+		if (g_LoadEvents[iEvent].iLoad == iNewLoad)
+		{
+			bIsNewLoadStarted = true;
+		}
+		else if (bIsNewLoadStarted)
+		{
+			Check(false, TEXT("old load sends no events after the new one starts"));
+			break;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    StartLoad
+*
+*   
+*       pLoader -    
+*       pszFileName -    
+*       bIsPaused - true,        
+*       PauseEvent -  ,     
+*       PauseParam -   
+*
+*    
+*       
+*
+*          .
+*
+****************************************************************************************/
+
+static void StartLoad(
+	__in SongLoader *pLoader,
+	__in LPCTSTR pszFileName,
+	__in bool bIsPaused,
+	__in SONGLOADEVENT PauseEvent,
+	__in DWORD PauseParam)
+{
+	//    ,       
+	g_cLoadEvents = 0;
+
+	g_PauseEvent = PauseEvent;
+	g_PauseParam = PauseParam;
+	g_bIsPauseEnabled = bIsPaused ? 1 : 0;
+
+	ResetEvent(g_hPausedEvent);
+	ResetEvent(g_hFinishedEvent);
+
+	pLoader->Start(pszFileName, CP_ACP, CHOOSE_MIN_NOTE_NUMBER,
+		LOADER_CHECK_QUANTIZE_STEP, LOADER_CHECK_PREVIEW_MEASURES);
+}
+
+/****************************************************************************************
+*
+*    CheckLoadEvents
+*
+*   
+*       iLoad -  
+*       bIsLoaded - true,     
+*
+*    
+*       true,       SONGLOAD_EVENT_PREVIEW; 
+*       false.
+*
+*      :     ,  
+*    ,          
+*    .
+*
+****************************************************************************************/
+
+static bool CheckLoadEvents(
+	__in DWORD iLoad,
+	__in bool bIsLoaded)
+{
+	Check(g_cLoadEvents < LOADER_CHECK_MAX_EVENTS, TEXT("load events fit the list"));
+
+	DWORD cEvents = 0;
+	DWORD cFinishedEvents = 0;
+	DWORD LastStage = 0;
+	bool bIsOrderValid = true;
+	bool bIsPreviewSent = false;
+	bool bIsResultValid = false;
+
+	for (LONG iEvent = 0; iEvent < g_cLoadEvents; iEvent++)
+	{
+		const LOADEVENT *pEvent = &g_LoadEvents[iEvent];
+
+		if (pEvent->iLoad != iLoad) continue;
+
+		if (cEvents == 0)
+		{
+			if (pEvent->Event != SONGLOAD_EVENT_STAGE ||
+				pEvent->Param != SONGLOAD_STAGE_READ_FILE)
+			{
+				bIsOrderValid = false;
+			}
+		}
+		else if (cFinishedEvents != 0)
+		{
+			bIsOrderValid = false;
+		}
+		else if (pEvent->Event == SONGLOAD_EVENT_STAGE)
+		{
+			if (pEvent->Param <= LastStage) bIsOrderValid = false;
+		}
+
+		if (pEvent->Event == SONGLOAD_EVENT_STAGE) LastStage = pEvent->Param;
+
+		if (pEvent->Event == SONGLOAD_EVENT_PREVIEW) bIsPreviewSent = true;
+
+		if (pEvent->Event == SONGLOAD_EVENT_FINISHED)
+		{
+			cFinishedEvents++;
+			bIsResultValid = pEvent->Param == (bIsLoaded ? 1 : 0);
+		}
+
+		cEvents++;
+	}
+
+	Check(bIsOrderValid, TEXT("load stages come in order"));
+	Check(cFinishedEvents == 1, TEXT("load finishes exactly once"));
+	Check(bIsResultValid, TEXT("finish event reports the load result"));
+
+	return bIsPreviewSent;
+}
+
+/****************************************************************************************
+*
+*    LoadProc
+*
+*   
+*       iLoad -  
+*       Event - 
+*       Param -  
+*       pContext -  
+*
+*    
+*       
+*
+*     .     
+*   g_hPausedEvent    ,     
+*      .    .
+*
+****************************************************************************************/
+
+static void LoadProc(
+	__in DWORD iLoad,
+	__in SONGLOADEVENT Event,
+	__in DWORD Param,
+	__in LPVOID pContext)
+{
+	if (g_cLoadEvents < LOADER_CHECK_MAX_EVENTS)
+	{
+		LOADEVENT *pEvent = &g_LoadEvents[g_cLoadEvents];
+
+		pEvent->iLoad = iLoad;
+		pEvent->Event = Event;
+		pEvent->Param = Param;
+
+		InterlockedIncrement(&g_cLoadEvents);
+	}
+
+	if (Event == SONGLOAD_EVENT_FINISHED)
+	{
+		SetEvent(g_hFinishedEvent);
+	}
+	else if (g_bIsPauseEnabled && Event == g_PauseEvent && Param == g_PauseParam)
+	{
+		InterlockedExchange(&g_bIsPauseEnabled, 0);
+		SetEvent(g_hPausedEvent);
+		Sleep(LOADER_CHECK_PAUSE);
+	}
+}
+
+/****************************************************************************************
+*
+*    CheckRecentSongCache
+*
+*   
+*       
+*
+*    
+*       
+*
+*          . 
+*           SongFile  Song 
+*     ,      
+*   .
+*
+****************************************************************************************/
+
+static void CheckRecentSongCache()
+{
+	_tprintf(TEXT("recent song cache\n"));
+
+	//   ,      
+	RecentSongCache *pCache = new RecentSongCache(MAXDWORD);
+
+	if (pCache == NULL)
+	{
+		Check(false, TEXT("recent song cache can be created"));
+		return;
+	}
+
+	DWORD cbSong;
+
+	Check(PutTestSong(pCache, 0), TEXT("song is put into the cache"));
+
+	pCache->GetStatistics(NULL, NULL, NULL, &cbSong);
+	pCache->SetMaxMemorySize(CACHE_CHECK_CAPACITY * cbSong);
+	pCache->Clear();
+
+	DWORD cHits, cMisses, cSongs, cbMemory;
+
+	//     
+	for (DWORD iSong = 0; iSong < CACHE_CHECK_SONG_COUNT; iSong++)
+	{
+		PutTestSong(pCache, iSong);
+	}
+
+	pCache->GetStatistics(NULL, NULL, &cSongs, &cbMemory);
+
+	Check(cSongs == CACHE_CHECK_CAPACITY && cbMemory == CACHE_CHECK_CAPACITY * cbSong,
+		TEXT("cache keeps songs within its memory limit"));
+
+	Check(!TakeTestSong(pCache, 0) && !TakeTestSong(pCache, 1),
+		TEXT("oldest songs are evicted"));
+
+	// ,      ,   , 
+	//    
+	DWORD iOldestSong = CACHE_CHECK_SONG_COUNT - CACHE_CHECK_CAPACITY;
+
+	Check(TakeTestSong(pCache, iOldestSong), TEXT("cached song is taken"));
+
+	PutTestSong(pCache, iOldestSong);
+	PutTestSong(pCache, CACHE_CHECK_SONG_COUNT);
+
+	Check(TakeTestSong(pCache, iOldestSong) && !TakeTestSong(pCache, iOldestSong + 1),
+		TEXT("song put back becomes the newest"));
+
+	//         
+	RECENTSONGKEY Key;
+	SongFile *pSongFile;
+	Song *pSong;
+	DWORD iVocalPart;
+
+	GetTestSongKey(CACHE_CHECK_SONG_COUNT, &Key);
+	Key.LastWriteTime.dwLowDateTime++;
+
+	Check(!pCache->TakeSong(&Key, &pSongFile, &pSong, &iVocalPart),
+		TEXT("song of a changed file is not returned"));
+
+	GetTestSongKey(CACHE_CHECK_SONG_COUNT, &Key);
+
+	Check(!pCache->TakeSong(&Key, &pSongFile, &pSong, &iVocalPart),
+		TEXT("song of a changed file is removed"));
+
+	//      -  
+	GetTestSongKey(CACHE_CHECK_SONG_COUNT - 1, &Key);
+	Key.QuantizeStepDenominator *= 2;
+
+	Check(!pCache->TakeSong(&Key, &pSongFile, &pSong, &iVocalPart),
+		TEXT("song with other load settings is not returned"));
+
+	Check(TakeTestSong(pCache, CACHE_CHECK_SONG_COUNT - 1),
+		TEXT("song with the original settings is kept"));
+
+	pCache->GetStatistics(&cHits, &cMisses, &cSongs, &cbMemory);
+
+	Check(cHits == 3 && cMisses == 6, TEXT("cache counts hits and misses"));
+	Check(cSongs == 0 && cbMemory == 0,
+		TEXT("cache is empty after all songs are taken"));
+
+	//     
+	PutTestSong(pCache, 0);
+	PutTestSong(pCache, 0);
+
+	pCache->GetStatistics(NULL, NULL, &cSongs, NULL);
+
+	Check(cSongs == 1, TEXT("song put twice replaces the old copy"));
+
+	//    ,      
+	pCache->SetMaxMemorySize(cbSong - 1);
+	pCache->GetStatistics(NULL, NULL, &cSongs, &cbMemory);
+
+	Check(cSongs == 0 && cbMemory == 0, TEXT("lower memory limit evicts songs"));
+	Check(!PutTestSong(pCache, 0), TEXT("song larger than the limit is not cached"));
+
+	delete pCache;
+}
+
+/****************************************************************************************
+*
+*    GetTestSongKey
+*
+*   
+*       iSong -  
+*       pKey -   ,      
+*
+*    
+*       
+*
+*           .
+*
+****************************************************************************************/
+
+static void GetTestSongKey(
+	__in DWORD iSong,
+	__out RECENTSONGKEY *pKey)
+{
+	ZeroMemory(pKey, sizeof(RECENTSONGKEY));
+
+	wsprintf(pKey->pszFileName, TEXT("selftest_song%u.mid"), iSong);
+
+	pKey->cbFile = 1000 + iSong;
+	pKey->LastWriteTime.dwLowDateTime = iSong;
+	pKey->DefaultCodePage = CP_ACP;
+	pKey->ConcordNoteChoice = CHOOSE_MIN_NOTE_NUMBER;
+	pKey->QuantizeStepDenominator = LOADER_CHECK_QUANTIZE_STEP;
+}
+
+/****************************************************************************************
+*
+*    PutTestSong
+*
+*   
+*       pCache -      
+*       iSong -  
+*
+*    
+*       true,     ;  false.
+*
+*          .      
+*    .
+*
+****************************************************************************************/
+
+static bool PutTestSong(
+	__in RecentSongCache *pCache,
+	__in DWORD iSong)
+{
+	RECENTSONGKEY Key;
+
+	GetTestSongKey(iSong, &Key);
+
+	SongFile *pSongFile = new SongFile;
+	Song *pSong = new Song;
+
+	if (pSongFile == NULL || pSong == NULL)
+	{
+		delete pSongFile;
+		delete pSong;
+		return false;
+	}
+
+	return pCache->PutSong(&Key, iSong, pSongFile, pSong);
+}
+
+/****************************************************************************************
+*
+*    TakeTestSong
+*
+*   
+*       pCache -      
+*       iSong -  
+*
+*    
+*       true,     ;  false.
+*
+*         ,      
+*    .
+*
+****************************************************************************************/
+
+static bool TakeTestSong(
+	__in RecentSongCache *pCache,
+	__in DWORD iSong)
+{
+	RECENTSONGKEY Key;
+	SongFile *pSongFile;
+	Song *pSong;
+	DWORD iVocalPart;
+
+	GetTestSongKey(iSong, &Key);
+
+	if (!pCache->TakeSong(&Key, &pSongFile, &pSong, &iVocalPart)) return false;
+
+	Check(iVocalPart == iSong, TEXT("cached song keeps its vocal part"));
+
+	delete pSong;
+	delete pSongFile;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    CheckAudioRing
+*
+*   
+*       
+*
+*    
+*       
+*
+*       :      
+*    ,          .
+*
+****************************************************************************************/
+
+static void CheckAudioRing()
+{
+	_tprintf(TEXT("audio ring\n"));
+
+	AudioRing Ring;
+
+	if (!Ring.Create(RING_CHECK_BLOCK_COUNT, RING_CHECK_SAMPLES_PER_BLOCK))
+	{
+		Check(false, TEXT("audio ring can be created"));
+		return;
+	}
+
+	//         
+	Check(Ring.GetReadBlock() == NULL, TEXT("empty ring has no block to read"));
+
+	for (DWORD iBlock = 0; iBlock < RING_CHECK_BLOCK_COUNT; iBlock++)
+	{
+		AUDIOBLOCK *pBlock = Ring.GetWriteBlock();
+
+		if (pBlock == NULL) break;
+
+		FillTestBlock(pBlock, iBlock);
+		Ring.CommitWriteBlock();
+	}
+
+	Check(Ring.GetFillLevel() == RING_CHECK_BLOCK_COUNT &&
+		Ring.GetMaxFillLevel() == RING_CHECK_BLOCK_COUNT,
+		TEXT("ring holds as many blocks as it was created with"));
+	Check(Ring.GetWriteBlock() == NULL, TEXT("full ring has no block to write"));
+
+	bool bAreBlocksValid = true;
+
+	for (DWORD iBlock = 0; iBlock < RING_CHECK_BLOCK_COUNT; iBlock++)
+	{
+		AUDIOBLOCK *pBlock = Ring.GetReadBlock();
+
+		if (pBlock == NULL || !IsTestBlockValid(pBlock, iBlock))
+		{
+			bAreBlocksValid = false;
+			break;
+		}
+
+		Ring.ReleaseReadBlock();
+	}
+
+	Check(bAreBlocksValid, TEXT("blocks are read in the order they are written"));
+	Check(Ring.GetFillLevel() == 0 && Ring.GetReadBlock() == NULL,
+		TEXT("ring is empty after all blocks are read"));
+
+	//       
+	if (!Ring.Create(RING_CHECK_BLOCK_COUNT, RING_CHECK_SAMPLES_PER_BLOCK))
+	{
+		Check(false, TEXT("audio ring can be created"));
+		return;
+	}
+
+	HANDLE hThread = CreateThread(NULL, 0, RingWriterThreadProc, &Ring, 0, NULL);
+
+	if (hThread == NULL)
+	{
+		LOG("CreateThread failed (error %u)\n", GetLastError());
+		Check(false, TEXT("ring writer thread starts"));
+		return;
+	}
+
+	bool bIsFillLevelValid = true;
+	DWORD iBlock;
+
+	for (iBlock = 0; iBlock < RING_CHECK_TOTAL_BLOCKS; iBlock++)
+	{
+		AUDIOBLOCK *pBlock;
+
+		while ((pBlock = Ring.GetReadBlock()) == NULL) Sleep(0);
+
+		DWORD FillLevel = Ring.GetFillLevel();
+
+		if (FillLevel == 0 || FillLevel > RING_CHECK_BLOCK_COUNT)
+		{
+			bIsFillLevelValid = false;
+		}
+
+		if (!IsTestBlockValid(pBlock, iBlock))
+		{
+			InterlockedExchange(&g_bIsRingReaderStopped, 1);
+			break;
+		}
+
+		Ring.ReleaseReadBlock();
+	}
+
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+
+	_tprintf(TEXT("    %u blocks passed, max fill level %u of %u\n"), iBlock,
+		Ring.GetMaxFillLevel(), RING_CHECK_BLOCK_COUNT);
+
+	Check(iBlock == RING_CHECK_TOTAL_BLOCKS,
+		TEXT("all blocks pass between threads whole and in order"));
+	Check(bIsFillLevelValid, TEXT("reader sees a fill level within the ring size"));
+	Check(Ring.GetMaxFillLevel() != 0 &&
+		Ring.GetMaxFillLevel() <= RING_CHECK_BLOCK_COUNT,
+		TEXT("max fill level stays within the ring size"));
+}
+
+/****************************************************************************************
+*
+*    RingWriterThreadProc
+*
+*   
+*       lpParameter -    
+*
+*    
+*       .
+*
+*        ,   , 
+*    .      ,   ,
+*      .
+*
+****************************************************************************************/
+
+static DWORD WINAPI RingWriterThreadProc(
+	__in LPVOID lpParameter)
+{
+	AudioRing *pRing = (AudioRing *) lpParameter;
+
+	for (DWORD iBlock = 0; iBlock < RING_CHECK_TOTAL_BLOCKS; iBlock++)
+	{
+		AUDIOBLOCK *pBlock;
+
+		while ((pBlock = pRing->GetWriteBlock()) == NULL)
+		{
+			if (g_bIsRingReaderStopped) return 0;
+
+			Sleep(0);
+		}
+
+		FillTestBlock(pBlock, iBlock);
+		pRing->CommitWriteBlock();
+	}
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    FillTestBlock
+*
+*   
+*       pBlock -   
+*       iBlock -  
+*
+*    
+*       
+*
+*     ,     ;  
+*       .
+*
+****************************************************************************************/
+
+static void FillTestBlock(
+	__out AUDIOBLOCK *pBlock,
+	__in DWORD iBlock)
+{
+	pBlock->CaptureTime = iBlock;
+	pBlock->iBlock = iBlock;
+	pBlock->cSamples = 1 + iBlock % RING_CHECK_SAMPLES_PER_BLOCK;
+
+	for (DWORD iSample = 0; iSample < pBlock->cSamples; iSample++)
+	{
+		pBlock->pSamples[iSample] = (SHORT) (iBlock + iSample);
+	}
+}
+
+/****************************************************************************************
+*
+*    IsTestBlockValid
+*
+*   
+*       pBlock -   
+*       iBlock -   
+*
+*    
+*       true,     ,   FillTestBlock; 
+*       false.
+*
+*    ,     .
+*
+****************************************************************************************/
+
+static bool IsTestBlockValid(
+	__in const AUDIOBLOCK *pBlock,
+	__in DWORD iBlock)
+{
+	if (pBlock->iBlock != iBlock || pBlock->CaptureTime != (LONGLONG) iBlock ||
+		pBlock->cSamples != 1 + iBlock % RING_CHECK_SAMPLES_PER_BLOCK)
+	{
+		return false;
+	}
+
+	for (DWORD iSample = 0; iSample < pBlock->cSamples; iSample++)
+	{
+		if (pBlock->pSamples[iSample] != (SHORT) (iBlock + iSample)) return false;
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    CheckTempoMap
+*
+*   
+*       
+*
+*    
+*       
+*
+*                  
+*    ,         ,  
+*          .
+*
+****************************************************************************************/
+
+static void CheckTempoMap()
+{
+	_tprintf(TEXT("tempo map\n"));
+
+	//  :         
+	static const double Tempos[][2] = {
+		{1.0, 60.0}, {1.5, 200.0}, {1.5, 90.0}, {2.75, 140.0}, {4.0, 72.0},
+		{4.0, 180.0}, {4.0, 100.0}, {6.25, 45.0}, {7.0, 240.0}, {9.5, 128.0},
+		{12.0, 66.0}, {12.125, 300.0}, {15.0, 110.0}};
+
+	//        
+	Song EmptySong;
+
+	Check(IsNear(EmptySong.SecondsToWholeNotes(
+		3.0 * TEMPO_CHECK_SECONDS_PER_WHOLE / TEMPO_CHECK_DEFAULT_BPM), 3.0),
+		TEXT("song without tempos uses the default tempo"));
+
+	Song TempoSong;
+
+	for (DWORD iTempo = 0; iTempo < sizeof(Tempos) / sizeof(Tempos[0]); iTempo++)
+	{
+		if (!TempoSong.AddTempo(Tempos[iTempo][0], Tempos[iTempo][1]))
+		{
+			Check(false, TEXT("tempo map can be built"));
+			return;
+		}
+	}
+
+	Check(CheckTempoPositions(&TempoSong, TEMPO_ORDER_ASCENDING),
+		TEXT("positions in ascending order match the linear walk"));
+	Check(CheckTempoPositions(&TempoSong, TEMPO_ORDER_DESCENDING),
+		TEXT("positions in descending order match the linear walk"));
+	Check(CheckTempoPositions(&TempoSong, TEMPO_ORDER_SCATTERED),
+		TEXT("positions in scattered order match the linear walk"));
+}
+
+/****************************************************************************************
+*
+*    CheckTempoPositions
+*
+*   
+*       pSong -      
+*       Order -   : TEMPO_ORDER_ASCENDING,
+*               TEMPO_ORDER_DESCENDING  TEMPO_ORDER_SCATTERED
+*
+*    
+*       true,     ;  false.
+*
+*              
+*       ,   SecondsToWholeNotes  
+*       .     , 
+*         ,    .
+*
+****************************************************************************************/
+
+static bool CheckTempoPositions(
+	__in Song *pSong,
+	__in DWORD Order)
+{
+	bool bResult = true;
+
+	for (DWORD i = 0; i < TEMPO_CHECK_POSITION_COUNT; i++)
+	{
+		DWORD iPosition = i;
+
+		if (Order == TEMPO_ORDER_DESCENDING)
+		{
+			iPosition = TEMPO_CHECK_POSITION_COUNT - 1 - i;
+		}
+		else if (Order == TEMPO_ORDER_SCATTERED)
+		{
+			iPosition = i * TEMPO_CHECK_POSITION_STRIDE % TEMPO_CHECK_POSITION_COUNT;
+		}
+
+		double WholeNotes = iPosition * TEMPO_CHECK_POSITION_STEP;
+		double Seconds = GetLinearSeconds(pSong, WholeNotes);
+
+		double ConvertedWholeNotes = pSong->SecondsToWholeNotes(Seconds);
+
+		if (!IsNear(ConvertedWholeNotes, WholeNotes))
+		{
+			_tprintf(TEXT("    position %.3f s: %.9f whole notes (expected %.9f)\n"),
+				Seconds, ConvertedWholeNotes, WholeNotes);
+
+			bResult = false;
+		}
+	}
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    GetLinearSeconds
+*
+*   
+*       pSong -      
+*       WholeNotes -   :      
+*
+*    
+*              .
+*
+*         ,     
+*    GetNextTempo     .   
+*      .
+*
+****************************************************************************************/
+
+static double GetLinearSeconds(
+	__in Song *pSong,
+	__in double WholeNotes)
+{
+	double Offset = 0.0;
+	double BPM = TEMPO_CHECK_DEFAULT_BPM;
+	double Seconds = 0.0;
+
+	double NextOffset;
+	double NextBPM;
+
+	pSong->ResetCurrentPosition();
+
+	while (pSong->GetNextTempo(&NextOffset, &NextBPM) && NextOffset <= WholeNotes)
+	{
+		Seconds += (NextOffset - Offset) * TEMPO_CHECK_SECONDS_PER_WHOLE / BPM;
+		Offset = NextOffset;
+		BPM = NextBPM;
+	}
+
+	return Seconds + (WholeNotes - Offset) * TEMPO_CHECK_SECONDS_PER_WHOLE / BPM;
+}
+
+/****************************************************************************************
+*
+*    IsNear
+*
+*   
+*       Value -  
+*       Expected -  
+*
+*    
+*       true,      TEMPO_CHECK_TOLERANCE;  false.
+*
+*        ,  ,  ,
+*   -  .
+*
+****************************************************************************************/
+
+static bool IsNear(
+	__in double Value,
+	__in double Expected)
+{
+	double Scale = (Expected > 1.0) ? Expected : 1.0;
+	double Difference = (Value > Expected) ? Value - Expected : Expected - Value;
+
+	return Difference <= TEMPO_CHECK_TOLERANCE * Scale;
+}
+
+/****************************************************************************************
+*
+*    CheckSongTimeline
+*
+*   
+*       
+*
+*    
+*       
+*
+*        :      
+*   (. WHOLE_NOTE_UNITS)     MIDI,     
+*     .        
+*       ;          
+*   ,         .
+*
+****************************************************************************************/
+
+static void CheckSongTimeline()
+{
+	_tprintf(TEXT("song timeline\n"));
+
+	//    11   :     
+	//  32-    MIDI;      44, 16.5, 22, 55
+	//  19.25
+	static const DWORD OddMeasures[][3] = {
+		{4, 4, 8}, {3, 8, 8}, {6, 8, 12}, {5, 4, 8}, {7, 16, 8}};
+
+	//   :       ;   
+	//  ,        
+	static const TIMELINENOTE OddNotes[] = {
+		{0, 11, 0, 20160}, {13, 20, 23825, 36655}, {44, 5, 80640, 9164},
+		{50, 11, 91636, 20619}, {61, 21, 112255, 57730}, {82, 1, 169985, 2291},
+		{90, 47, 185105, 86139}, {140, 17, 276742, 31156}, {160, 3, 313396, 5499}};
+
+	//    96   ;     6/8  12 32- 
+	//   MIDI  315 ,     - 210 ,  
+	//       
+	static const DWORD EvenMeasures[][3] = {
+		{4, 4, 8}, {3, 4, 8}, {6, 8, 12}, {2, 2, 8}, {6, 8, 12}};
+
+	static const TIMELINENOTE EvenNotes[] = {
+		{1, 95, 210, 19950}, {383, 2, 80430, 420}, {671, 1, 140910, 210},
+		{673, 190, 141435, 59850}, {863, 97, 201285, 20475}, {1247, 1, 282030, 210},
+		{1249, 190, 282555, 59850}, {1500, 7, 361620, 2205}};
+
+	Check(CheckTickConversion(11, OddMeasures,
+		sizeof(OddMeasures) / sizeof(OddMeasures[0]), OddNotes,
+		sizeof(OddNotes) / sizeof(OddNotes[0])),
+		TEXT("ticks convert to units with 11 ticks per quarter"));
+
+	Check(CheckTickConversion(96, EvenMeasures,
+		sizeof(EvenMeasures) / sizeof(EvenMeasures[0]), EvenNotes,
+		sizeof(EvenNotes) / sizeof(EvenNotes[0])),
+		TEXT("ticks convert to units with 96 ticks per quarter"));
+
+	//        1/32 (2520 ):  
+	//          
+	static const TIMELINENOTE QuantizedNotes[] = {
+		{0, 2520, 0, 2520}, {5039, 2522, 2520, 5040}, {10080, 2521, 10080, 2520},
+		{15119, 1, 12600, 2520}, {20159, 2521, 17640, 5040}};
+
+	// ,       
+	static const TIMELINENOTE EmptiedNotes[] = {
+		{20160, 2519, 20160, 0}, {22679, 2, 20160, 2520}};
+
+	Song QuantizedSong;
+	Song EmptiedSong;
+
+	if (CreateTimelineSong(&QuantizedSong, QuantizedNotes,
+		sizeof(QuantizedNotes) / sizeof(QuantizedNotes[0])))
+	{
+		Check(QuantizedSong.Quantize(TIMELINE_CHECK_QUANTIZE_STEP),
+			TEXT("quantization without empty notes succeeds"));
+		Check(IsSongTimelineValid(&QuantizedSong, QuantizedNotes,
+			sizeof(QuantizedNotes) / sizeof(QuantizedNotes[0])),
+			TEXT("notes on the grid stay, notes below the grid move down"));
+	}
+
+	if (CreateTimelineSong(&EmptiedSong, EmptiedNotes,
+		sizeof(EmptiedNotes) / sizeof(EmptiedNotes[0])))
+	{
+		Check(!EmptiedSong.Quantize(TIMELINE_CHECK_QUANTIZE_STEP),
+			TEXT("quantization reports an emptied note"));
+		Check(IsSongTimelineValid(&EmptiedSong, EmptiedNotes,
+			sizeof(EmptiedNotes) / sizeof(EmptiedNotes[0])),
+			TEXT("notes are quantized despite an emptied note"));
+	}
+
+	//         1/64 (1260 ):   
+	//   ,      ,   , 
+	//   
+	static const TIMELINENOTE ExtendedNotes[] = {
+		{0, 0, 0, 1260}, {1260, 0, 1260, 0}, {2519, 100, 2519, 100},
+		{5000, 0, 5000, 1260}};
+
+	Song ExtendedSong;
+
+	if (CreateTimelineSong(&ExtendedSong, ExtendedNotes,
+		sizeof(ExtendedNotes) / sizeof(ExtendedNotes[0])))
+	{
+		Check(!ExtendedSong.ExtendEmptyNotes(TIMELINE_CHECK_EMPTY_NOTE_LENGTH),
+			TEXT("extension reports an empty note without room"));
+		Check(IsSongTimelineValid(&ExtendedSong, ExtendedNotes,
+			sizeof(ExtendedNotes) / sizeof(ExtendedNotes[0])),
+			TEXT("empty notes are extended only where there is room"));
+	}
+
+	//           ,
+	//     ,    
+	static const DWORD LengthDenominators[] = {3, 7, 12, 256};
+
+	for (DWORD i = 0; i < sizeof(LengthDenominators) / sizeof(LengthDenominators[0]);
+		i++)
+	{
+		DWORD LengthDenominator = LengthDenominators[i];
+
+		TIMELINENOTE LastNote = {0, 0, 0, WHOLE_NOTE_UNITS / LengthDenominator};
+
+		Song LastNoteSong;
+
+		if (!CreateTimelineSong(&LastNoteSong, &LastNote, 1)) continue;
+
+		LastNoteSong.ExtendEmptyNotes(LengthDenominator);
+
+		Check(IsSongTimelineValid(&LastNoteSong, &LastNote, 1) &&
+			LastNote.cuExpectedLength * LengthDenominator == WHOLE_NOTE_UNITS,
+			TEXT("extended notes are an exact part of a whole note"));
+	}
+}
+
+/****************************************************************************************
+*
+*    CheckTickConversion
+*
+*   
+*       cTicksPerMidiQuarterNote -  ,    MIDI 
+*       pMeasures -    :     
+*                    32-    MIDI
+*       cMeasures -  
+*       pNotes -     :       
+*       cNotes -  
+*
+*    
+*       true,         ;  false.
+*
+*      MIDI       MidiSong::CreateSong 
+*         .
+*
+****************************************************************************************/
+
+static bool CheckTickConversion(
+	__in DWORD cTicksPerMidiQuarterNote,
+	__in const DWORD (*pMeasures)[3],
+	__in DWORD cMeasures,
+	__in const TIMELINENOTE *pNotes,
+	__in DWORD cNotes)
+{
+	MidiSong TimelineMidiSong;
+
+	for (DWORD iMeasure = 0; iMeasure < cMeasures; iMeasure++)
+	{
+		if (!TimelineMidiSong.AddMeasure(pMeasures[iMeasure][0],
+			pMeasures[iMeasure][1], pMeasures[iMeasure][2]))
+		{
+			return false;
+		}
+	}
+
+	for (DWORD iNote = 0; iNote < cNotes; iNote++)
+	{
+		if (!TimelineMidiSong.AddSingingEvent(60, pNotes[iNote].ToNoteOn,
+			pNotes[iNote].Length, NULL, 0))
+		{
+			return false;
+		}
+	}
+
+	Song *pSong = TimelineMidiSong.CreateSong(cTicksPerMidiQuarterNote);
+
+	if (pSong == NULL) return false;
+
+	bool bResult = IsSongTimelineValid(pSong, pNotes, cNotes);
+
+	delete pSong;
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    CreateTimelineSong
+*
+*   
+*       pSong -    
+*       pNotes -     :    
+*       cNotes -  
+*
+*    
+*       true,     ; false,     .
+*
+*             .
+*
+****************************************************************************************/
+
+static bool CreateTimelineSong(
+	__out Song *pSong,
+	__in const TIMELINENOTE *pNotes,
+	__in DWORD cNotes)
+{
+	for (DWORD iNote = 0; iNote < cNotes; iNote++)
+	{
+		if (!pSong->AddSingingEvent(60, pNotes[iNote].ToNoteOn, pNotes[iNote].Length,
+			NULL, 0))
+		{
+			Check(false, TEXT("timeline song can be built"));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    IsSongTimelineValid
+*
+*   
+*       pSong -   
+*       pNotes -         
+*       cNotes -  
+*
+*    
+*       true,        ;  false.
+*
+*             .
+*
+****************************************************************************************/
+
+static bool IsSongTimelineValid(
+	__in Song *pSong,
+	__in const TIMELINENOTE *pNotes,
+	__in DWORD cNotes)
+{
+	const DWORD *pcuToNoteOns;
+	const DWORD *pcuNoteLengths;
+
+	if (pSong->GetSingingEvents(NULL, &pcuToNoteOns, &pcuNoteLengths) != cNotes)
+	{
+		return false;
+	}
+
+	bool bResult = true;
+
+	for (DWORD iNote = 0; iNote < cNotes; iNote++)
+	{
+		if (pcuToNoteOns[iNote] != pNotes[iNote].cuToExpectedNoteOn ||
+			pcuNoteLengths[iNote] != pNotes[iNote].cuExpectedLength)
+		{
+			_tprintf(TEXT("    note %u: %u+%u units (expected %u+%u)\n"), iNote,
+				pcuToNoteOns[iNote], pcuNoteLengths[iNote],
+				pNotes[iNote].cuToExpectedNoteOn, pNotes[iNote].cuExpectedLength);
+
+			bResult = false;
+		}
+	}
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    CheckVocalPartSearch
+*
+*   
+*       
+*
+*    
+*       
+*
+*     ,     MidiFile, 
+*          ,   , 
+*      (.  FindReferenceVocalParts),  MIDI-,
+*      VocalFixtures.     , 
+*       ,    ,  
+*      .
+*
+****************************************************************************************/
+
+static void CheckVocalPartSearch()
+{
+	_tprintf(TEXT("vocal part search\n"));
+
+	//   :      ,   
+	//   (VOCAL_CHECK_STAGE_COUNT -   );  0
+	//   .   ,     ,
+	//    ,   ,   ,
+	//   
+	static const VOCALFIXTURE VocalFixtures[] = {
+		{TEXT("aligned part"), 2, {
+			{1, 0, 52, PART_SHAPE_ALIGNED}, {2, 1, 53, PART_SHAPE_OVERLAPPED}}, 0},
+		{TEXT("overlapped part"), 3, {
+			{1, 0, 52, PART_SHAPE_OVERLAPPED}, {2, 1, 53, PART_SHAPE_SHORT_END},
+			{3, 2, 54, PART_SHAPE_DENSE}}, 1},
+		{TEXT("part without identical end"), 3, {
+			{1, 0, 52, PART_SHAPE_SHORT_END}, {2, 1, 53, PART_SHAPE_EARLY_START},
+			{3, 2, 54, PART_SHAPE_DENSE}}, 2},
+		{TEXT("part without identical start"), 2, {
+			{1, 0, 52, PART_SHAPE_EARLY_START}, {2, 1, 53, PART_SHAPE_LOOSE_ENDS}}, 3},
+		{TEXT("part without identical start and end"), 2, {
+			{1, 0, 52, PART_SHAPE_LOOSE_ENDS}, {1, 1, 53, PART_SHAPE_DENSE}}, 4},
+		{TEXT("part with too many notes per lyric event"), 3, {
+			{1, 0, 52, PART_SHAPE_DENSE}, {2, 1, 53, PART_SHAPE_LONG_END},
+			{3, 2, 54, PART_SHAPE_SPARSE}}, 5},
+		{TEXT("several parts in one track"), 4, {
+			{1, 0, 52, PART_SHAPE_ALIGNED}, {1, 1, 53, PART_SHAPE_ALIGNED},
+			{1, 2, 54, PART_SHAPE_EMPTY}, {2, 3, 52, PART_SHAPE_ALIGNED}}, 0},
+		{TEXT("no vocal parts"), 1, {
+			{1, 0, 52, PART_SHAPE_SPARSE}}, VOCAL_CHECK_STAGE_COUNT}};
+
+	for (DWORD iFixture = 0; iFixture < sizeof(VocalFixtures) / sizeof(VocalFixtures[0]);
+		iFixture++)
+	{
+		const VOCALFIXTURE *pFixture = &VocalFixtures[iFixture];
+
+		BYTE *pImage = (BYTE *) HeapAlloc(GetProcessHeap(), 0, VOCAL_CHECK_IMAGE_SIZE);
+
+		if (pImage == NULL)
+		{
+			Check(false, TEXT("vocal part fixture can be built"));
+			return;
+		}
+
+		DWORD cbImage = BuildVocalFixture(pFixture, pImage);
+
+		REFVOCALPART RefVocalParts[VOCAL_CHECK_MAX_VOCAL_PARTS];
+		DWORD cRefVocalParts;
+		DWORD iRefStage;
+
+		if (!FindReferenceVocalParts(pImage, cbImage, RefVocalParts, &cRefVocalParts,
+			&iRefStage))
+		{
+			HeapFree(GetProcessHeap(), 0, pImage);
+			Check(false, TEXT("per-stage search completes"));
+			continue;
+		}
+
+		if (iRefStage != pFixture->iExpectedStage)
+		{
+			_tprintf(TEXT("    %s: per-stage search ends at stage %u (expected %u)\n"),
+				pFixture->pszName, iRefStage, pFixture->iExpectedStage);
+
+			Check(false, TEXT("fixtures reach their stages"));
+		}
+
+		//     MidiFile,     ,
+		//    
+		MidiFile File;
+
+		MIDIFILERESULT Result = File.AssignFile(pImage, cbImage);
+
+		if (Result != MIDIFILE_SUCCESS) HeapFree(GetProcessHeap(), 0, pImage);
+
+		MIDIFILERESULT RefResult = (cRefVocalParts != 0) ? MIDIFILE_SUCCESS :
+			MIDIFILE_NO_VOCAL_PARTS;
+
+		bool bIsMatch = (Result == RefResult);
+
+		if (Result == MIDIFILE_SUCCESS)
+		{
+			bIsMatch = bIsMatch && (File.GetVocalPartCount() == cRefVocalParts);
+
+			for (DWORD i = 0; bIsMatch && i < cRefVocalParts; i++)
+			{
+				DWORD iTrack;
+				DWORD Channel;
+				DWORD Instrument;
+				double PartLyricDistance;
+
+				File.GetVocalPartInfo(i, &iTrack, &Channel, &Instrument,
+					&PartLyricDistance);
+
+				bIsMatch = (iTrack == RefVocalParts[i].iTrack &&
+					Channel == RefVocalParts[i].Channel &&
+					Instrument == RefVocalParts[i].Instrument &&
+					PartLyricDistance == RefVocalParts[i].PartLyricDistance);
+			}
+		}
+
+		if (!bIsMatch)
+		{
+			_tprintf(TEXT("    %s: single pass differs from the per-stage search\n"),
+				pFixture->pszName);
+
+			Check(false, TEXT("single pass finds the same vocal parts"));
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    BuildVocalFixture
+*
+*   
+*       pFixture -    
+*       pImage -     VOCAL_CHECK_IMAGE_SIZE ,  
+*                   
+*
+*    
+*           .
+*
+*    MIDI-  1.  0   4/4  VOCAL_CHECK_LYRIC_EVENTS
+*           ,    - 
+*   .     ,     
+*    (.  GetFixtureNotes).
+*
+****************************************************************************************/
+
+static DWORD BuildVocalFixture(
+	__in const VOCALFIXTURE *pFixture,
+	__out BYTE *pImage)
+{
+	//  :       
+	DWORD cTracks = 1;
+
+	for (DWORD iPart = 0; iPart < pFixture->cParts; iPart++)
+	{
+		if (pFixture->Parts[iPart].iTrack + 1 > cTracks)
+		{
+			cTracks = pFixture->Parts[iPart].iTrack + 1;
+		}
+	}
+
+	BYTE *pCurByte = pImage;
+
+	//  :  1
+	BYTE FileHeader[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, (BYTE) cTracks,
+		HIBYTE(VOCAL_CHECK_DIVISION), LOBYTE(VOCAL_CHECK_DIVISION)};
+
+	CopyMemory(pCurByte, FileHeader, sizeof(FileHeader));
+	pCurByte += sizeof(FileHeader);
+
+	for (DWORD iTrack = 0; iTrack < cTracks; iTrack++)
+	{
+		//  ;       
+		CopyMemory(pCurByte, "MTrk", 4);
+		BYTE *pTrackSize = pCurByte + 4;
+		pCurByte += 8;
+
+		//     
+		FIXTUREEVENT Events[VOCAL_CHECK_MAX_TRACK_EVENTS];
+		DWORD cEvents = 0;
+
+		if (iTrack == 0)
+		{
+			static const BYTE TimeSignature[] = {
+				0x00, 0xFF, TIME_SIGNATURE, 4, 4, 2, 24, 8};
+
+			CopyMemory(pCurByte, TimeSignature, sizeof(TimeSignature));
+			pCurByte += sizeof(TimeSignature);
+
+			for (DWORD iLyricEvent = 0; iLyricEvent < VOCAL_CHECK_LYRIC_EVENTS;
+				iLyricEvent++)
+			{
+				static const BYTE Lyric[] = {0xFF, LYRIC, 3, 'l', 'a', ' '};
+
+				WriteVarLen(&pCurByte, (iLyricEvent == 0) ? VOCAL_CHECK_LYRIC_START :
+					VOCAL_CHECK_DIVISION);
+
+				CopyMemory(pCurByte, Lyric, sizeof(Lyric));
+				pCurByte += sizeof(Lyric);
+			}
+		}
+
+		//     
+		for (DWORD iPart = 0; iPart < pFixture->cParts; iPart++)
+		{
+			const FIXTUREPART *pPart = &pFixture->Parts[iPart];
+
+			if (pPart->iTrack != iTrack) continue;
+
+			FIXTUREEVENT *pEvent = &Events[cEvents++];
+
+			pEvent->ctTime = 0;
+			pEvent->Order = 0;
+			pEvent->Status = (BYTE) (PROGRAM_CHANGE | pPart->Channel);
+			pEvent->Data[0] = (BYTE) pPart->Instrument;
+			pEvent->cbData = 1;
+
+			NOTEDESC Notes[VOCAL_CHECK_MAX_NOTES];
+			DWORD cNotes = GetFixtureNotes(pPart->Shape, Notes);
+
+			for (DWORD iNote = 0; iNote < cNotes; iNote++)
+			{
+				//     NOTE_ON    
+				//        
+				for (DWORD iEdge = 0; iEdge < 2; iEdge++)
+				{
+					pEvent = &Events[cEvents++];
+
+					pEvent->ctTime = Notes[iNote].ctToNoteOn +
+						iEdge * Notes[iNote].ctDuration;
+					pEvent->Order = 2 - iEdge;
+					pEvent->Status = (BYTE) (NOTE_ON | pPart->Channel);
+					pEvent->Data[0] = (BYTE) Notes[iNote].NoteNumber;
+					pEvent->Data[1] = (BYTE) ((iEdge == 0) ? 100 : 0);
+					pEvent->cbData = 2;
+				}
+			}
+		}
+
+		//          
+		for (DWORD iEvent = 0; iEvent < cEvents; iEvent++)
+		{
+			Events[iEvent].Order = Events[iEvent].Order * VOCAL_CHECK_MAX_TRACK_EVENTS +
+				iEvent;
+		}
+
+		qsort(Events, cEvents, sizeof(FIXTUREEVENT), CompareFixtureEvents);
+
+		DWORD ctPrevEvent = 0;
+
+		for (DWORD iEvent = 0; iEvent < cEvents; iEvent++)
+		{
+			WriteVarLen(&pCurByte, Events[iEvent].ctTime - ctPrevEvent);
+			ctPrevEvent = Events[iEvent].ctTime;
+
+			*pCurByte++ = Events[iEvent].Status;
+
+			CopyMemory(pCurByte, Events[iEvent].Data, Events[iEvent].cbData);
+			pCurByte += Events[iEvent].cbData;
+		}
+
+		static const BYTE EndOfTrack[] = {0x00, 0xFF, END_OF_TRACK, 0};
+
+		CopyMemory(pCurByte, EndOfTrack, sizeof(EndOfTrack));
+		pCurByte += sizeof(EndOfTrack);
+
+		DWORD cbTrack = (DWORD) (pCurByte - pTrackSize - 4);
+
+		pTrackSize[0] = HIBYTE(HIWORD(cbTrack));
+		pTrackSize[1] = LOBYTE(HIWORD(cbTrack));
+		pTrackSize[2] = HIBYTE(LOWORD(cbTrack));
+		pTrackSize[3] = LOBYTE(LOWORD(cbTrack));
+	}
+
+	return (DWORD) (pCurByte - pImage);
+}
+
+/****************************************************************************************
+*
+*    GetFixtureNotes
+*
+*   
+*       Shape -  
+*       pNotes -     VOCAL_CHECK_MAX_NOTES ,   
+*                  
+*
+*    
+*         .
+*
+*          .  
+*       ,     (
+*     2 * VOCAL_CHECK_NOTE_SHIFT ):
+*   PART_SHAPE_ALIGNED -  ;
+*   PART_SHAPE_OVERLAPPED -       , 
+*                               ,    ;
+*   PART_SHAPE_EARLY_START -       ,   ,
+*                               ,   
+*                            (  IDENTICAL_START);
+*   PART_SHAPE_SHORT_END -    VOCAL_CHECK_SHORT_END_EVENTS  
+*                           ,      
+*                          MAX_SYMBOLS_PER_NOTE ,    
+*                             (  IDENTICAL_END);
+*   PART_SHAPE_LOOSE_ENDS -    ;
+*   PART_SHAPE_DENSE -      VOCAL_CHECK_DENSE_NOTES 
+*                       (  LIMIT_NOTES_PER_METAEVENT);
+*   PART_SHAPE_LONG_END -        
+*                         (  IDENTICAL_END 
+*                         LIMIT_NOTES_PER_METAEVENT);
+*   PART_SHAPE_SPARSE -     ,     
+*                         MAX_SYMBOLS_PER_NOTE    ;
+*   PART_SHAPE_EMPTY -  .
+*
+****************************************************************************************/
+
+static DWORD GetFixtureNotes(
+	__in PARTSHAPE Shape,
+	__out NOTEDESC *pNotes)
+{
+	if (Shape == PART_SHAPE_EMPTY) return 0;
+
+	DWORD cNotes = 0;
+
+	if (Shape == PART_SHAPE_EARLY_START || Shape == PART_SHAPE_LOOSE_ENDS)
+	{
+		pNotes[cNotes].NoteNumber = 48;
+		pNotes[cNotes].ctToNoteOn = VOCAL_CHECK_LYRIC_START - 3 * VOCAL_CHECK_DIVISION;
+		pNotes[cNotes].ctDuration = VOCAL_CHECK_DIVISION / 2;
+		cNotes++;
+	}
+
+	DWORD cLyricNotes = VOCAL_CHECK_LYRIC_EVENTS;
+
+	if (Shape == PART_SHAPE_SHORT_END || Shape == PART_SHAPE_LOOSE_ENDS)
+	{
+		cLyricNotes -= VOCAL_CHECK_SHORT_END_EVENTS;
+	}
+
+	for (DWORD iLyricEvent = 0; iLyricEvent < cLyricNotes; iLyricEvent++)
+	{
+		if (Shape == PART_SHAPE_SPARSE && iLyricEvent != 0 &&
+			iLyricEvent != cLyricNotes - 1)
+		{
+			continue;
+		}
+
+		DWORD ctToLyricEvent = VOCAL_CHECK_LYRIC_START +
+			iLyricEvent * VOCAL_CHECK_DIVISION;
+
+		pNotes[cNotes].NoteNumber = 60 + iLyricEvent % 12;
+		pNotes[cNotes].ctToNoteOn = ctToLyricEvent +
+			iLyricEvent % 3 * VOCAL_CHECK_NOTE_SHIFT;
+		pNotes[cNotes].ctDuration = VOCAL_CHECK_DIVISION / 2;
+
+		if (Shape == PART_SHAPE_OVERLAPPED && iLyricEvent % 4 == 0)
+		{
+			pNotes[cNotes].ctDuration = VOCAL_CHECK_DIVISION + VOCAL_CHECK_DIVISION / 4;
+		}
+
+		cNotes++;
+
+		//          
+		//  
+		if ((Shape == PART_SHAPE_DENSE && iLyricEvent == VOCAL_CHECK_LYRIC_EVENTS / 2) ||
+			(Shape == PART_SHAPE_LONG_END && iLyricEvent == cLyricNotes - 1))
+		{
+			DWORD ctDenseNote = VOCAL_CHECK_DIVISION * 3 / 8 / VOCAL_CHECK_DENSE_NOTES;
+
+			for (DWORD iDenseNote = 0; iDenseNote < VOCAL_CHECK_DENSE_NOTES;
+				iDenseNote++)
+			{
+				pNotes[cNotes].NoteNumber = 72 + iDenseNote % 12;
+				pNotes[cNotes].ctToNoteOn = ctToLyricEvent +
+					VOCAL_CHECK_DIVISION * 5 / 8 + iDenseNote * ctDenseNote;
+				pNotes[cNotes].ctDuration = ctDenseNote;
+				cNotes++;
+			}
+		}
+	}
+
+	return cNotes;
+}
+
+/****************************************************************************************
+*
+*    WriteVarLen
+*
+*   
+*       ppCurByte -   ,    ,  
+*                    ;      
+*       Value - 
+*
+*    
+*       
+*
+*        ,    MIDI- 
+*   - .
+*
+****************************************************************************************/
+
+static void WriteVarLen(
+	__inout BYTE **ppCurByte,
+	__in DWORD Value)
+{
+	BYTE Bytes[5];
+	DWORD cBytes = 0;
+
+	do
+	{
+		Bytes[cBytes++] = (BYTE) (Value & 0x7F);
+		Value >>= 7;
+	}
+	while (Value != 0);
+
+	while (cBytes > 1) *(*ppCurByte)++ = (BYTE) (Bytes[--cBytes] | 0x80);
+
+	*(*ppCurByte)++ = Bytes[0];
+}
+
+/****************************************************************************************
+*
+*    CompareFixtureEvents
+*
+*   .   compare    qsort  MSDN.
+*
+*       ,     Order,  
+*    BuildVocalFixture       .
+*
+****************************************************************************************/
+
+static int __cdecl CompareFixtureEvents(
+	__in const void *pElement1,
+	__in const void *pElement2)
+{
+	const FIXTUREEVENT *pEvent1 = (const FIXTUREEVENT *) pElement1;
+	const FIXTUREEVENT *pEvent2 = (const FIXTUREEVENT *) pElement2;
+
+	if (pEvent1->ctTime != pEvent2->ctTime)
+	{
+		return (pEvent1->ctTime < pEvent2->ctTime) ? -1 : 1;
+	}
+
+	if (pEvent1->Order != pEvent2->Order)
+	{
+		return (pEvent1->Order < pEvent2->Order) ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    FindReferenceVocalParts
+*
+*   
+*       pImage -    MIDI-,   BuildVocalFixture
+*       cbImage -    
+*       pVocalParts -     VOCAL_CHECK_MAX_VOCAL_PARTS , 
+*                            
+*                       
+*       pcVocalParts -   ,     
+*                        
+*       piStage -   ,      , 
+*                    ,  VOCAL_CHECK_STAGE_COUNT, 
+*                   
+*
+*    
+*       true,   ; false,      
+*         VOCAL_CHECK_MAX_VOCAL_PARTS  .
+*
+*      ,     MidiFile  ,   
+*        :   ,   
+*              
+*   OverlapsThreshold   (.  GetReferenceDistance).  
+*      0,      BuildVocalFixture.
+*
+****************************************************************************************/
+
+static bool FindReferenceVocalParts(
+	__in BYTE *pImage,
+	__in DWORD cbImage,
+	__out REFVOCALPART *pVocalParts,
+	__out DWORD *pcVocalParts,
+	__out DWORD *piStage)
+{
+	*pcVocalParts = 0;
+	*piStage = VOCAL_CHECK_STAGE_COUNT;
+
+	DWORD cTicksPerMidiQuarterNote = (pImage[12] << 8) | pImage[13];
+
+	//    MidiTrack   
+	MidiTrack Tracks[VOCAL_CHECK_MAX_TRACKS];
+	DWORD cTracks = 0;
+
+	for (DWORD iCurByte = 14;
+		iCurByte + 8 <= cbImage && cTracks < VOCAL_CHECK_MAX_TRACKS; cTracks++)
+	{
+		DWORD cbTrack = (pImage[iCurByte + 4] << 24) | (pImage[iCurByte + 5] << 16) |
+			(pImage[iCurByte + 6] << 8) | pImage[iCurByte + 7];
+
+		if (Tracks[cTracks].AttachToTrack(pImage + iCurByte + 8, cbTrack) !=
+			MIDITRACK_SUCCESS)
+		{
+			return false;
+		}
+
+		iCurByte += 8 + cbTrack;
+	}
+
+	MidiLyric Lyric;
+
+	if (Lyric.Decode(&Tracks[0], LYRIC, CP_ACP) != MIDILYRIC_SUCCESS) return false;
+
+	//      
+	for (DWORD iStage = 0; iStage < VOCAL_CHECK_STAGE_COUNT; iStage++)
+	{
+		double OverlapsThreshold = g_RefVocalPartLimitations[iStage].OverlapsThreshold;
+		DWORD fCriteria = g_RefVocalPartLimitations[iStage].fCriteria;
+
+		//    
+		for (DWORD iCurTrack = 0; iCurTrack < cTracks; iCurTrack++)
+		{
+			// ,    ,    
+			bool DoesPartExist[MAX_MIDI_CHANNELS][MAX_MIDI_INSTRUMENTS];
+
+			ZeroMemory(DoesPartExist, sizeof(DoesPartExist));
+
+			DWORD cPartsInTrack = 0;
+
+			for (DWORD iEvent = 0; iEvent < Tracks[iCurTrack].GetEventCount(); iEvent++)
+			{
+				PBYTE pEventData;
+				DWORD EventChannel;
+
+				DWORD EventType = Tracks[iCurTrack].GetEvent(iEvent, NULL, &pEventData,
+					&EventChannel);
+
+				if (EventType != PROGRAM_CHANGE) continue;
+
+				if (!DoesPartExist[EventChannel][*pEventData])
+				{
+					DoesPartExist[EventChannel][*pEventData] = true;
+					cPartsInTrack++;
+				}
+			}
+
+			if (cPartsInTrack == 0) continue;
+
+			//      
+			DWORD cEmptyParts = 0;
+
+			for (DWORD CurChannel = 0; CurChannel < MAX_MIDI_CHANNELS; CurChannel++)
+			{
+				for (DWORD CurInstr = 0; CurInstr < MAX_MIDI_INSTRUMENTS; CurInstr++)
+				{
+					if (!DoesPartExist[CurChannel][CurInstr]) continue;
+
+					double PartLyricDistance;
+
+					REFDISTANCERESULT DistanceRes = GetReferenceDistance(
+						&Tracks[iCurTrack], &Lyric, cTicksPerMidiQuarterNote, CurChannel,
+						CurInstr, OverlapsThreshold, fCriteria, &PartLyricDistance);
+
+					if (DistanceRes == REF_DISTANCE_CANT_ALLOC_MEMORY) return false;
+
+					if (DistanceRes == REF_DISTANCE_NO_NOTES) cEmptyParts++;
+
+					if (DistanceRes == REF_DISTANCE_SUCCESS &&
+						PartLyricDistance <= MAX_VOCAL_PART_LYRIC_DISTANCE &&
+						!AddReferenceVocalPart(pVocalParts, pcVocalParts, iCurTrack,
+						CurChannel, CurInstr, PartLyricDistance))
+					{
+						return false;
+					}
+				}
+			}
+
+			//      2  ,  , 
+			//      
+			if (cPartsInTrack - cEmptyParts > 1)
+			{
+				double PartLyricDistance;
+
+				REFDISTANCERESULT DistanceRes = GetReferenceDistance(&Tracks[iCurTrack],
+					&Lyric, cTicksPerMidiQuarterNote, ANY_CHANNEL, ANY_INSTRUMENT,
+					OverlapsThreshold, fCriteria, &PartLyricDistance);
+
+				if (DistanceRes == REF_DISTANCE_CANT_ALLOC_MEMORY) return false;
+
+				if (DistanceRes == REF_DISTANCE_SUCCESS &&
+					PartLyricDistance <= MAX_VOCAL_PART_LYRIC_DISTANCE &&
+					!AddReferenceVocalPart(pVocalParts, pcVocalParts, iCurTrack,
+					ANY_CHANNEL, ANY_INSTRUMENT, PartLyricDistance))
+				{
+					return false;
+				}
+			}
+		}
+
+		if (*pcVocalParts != 0)
+		{
+			//      ,   
+			*piStage = iStage;
+			return true;
+		}
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GetReferenceDistance
+*
+*   
+*       pTrack -   ,    
+*       pLyric -    
+*       cTicksPerMidiQuarterNote -     MIDI-
+*       Channel -     ANY_CHANNEL
+*       Instrument -     ANY_INSTRUMENT
+*       OverlapsThreshold -       
+*                                  
+*       fCriteria -   IDENTICAL_START, IDENTICAL_END 
+*                   LIMIT_NOTES_PER_METAEVENT,   
+*       pPartLyricDistance -   ,     
+*                                   MIDI-
+*
+*    
+*       REF_DISTANCE_SUCCESS -   ;
+*       REF_DISTANCE_NOT_VOCAL_PART -       ;
+*       REF_DISTANCE_NO_NOTES -      ;
+*       REF_DISTANCE_CANT_ALLOC_MEMORY -    .
+*
+*              
+*   .   MidiFile::GetPartLyricDistance   ,    
+*    ,         ; ,
+*     ,    .
+*
+****************************************************************************************/
+
+static REFDISTANCERESULT GetReferenceDistance(
+	__in MidiTrack *pTrack,
+	__in MidiLyric *pLyric,
+	__in DWORD cTicksPerMidiQuarterNote,
+	__in DWORD Channel,
+	__in DWORD Instrument,
+	__in double OverlapsThreshold,
+	__in DWORD fCriteria,
+	__out double *pPartLyricDistance)
+{
+	//        
+	DWORD PartLyricDistance = 0;
+
+	//      ,     
+	DWORD iLyricEvent = 0;
+	DWORD ctToLyricEvent;
+	DWORD cchEventText;
+
+	//     ,    PrevNoteDesc
+	DWORD cchPerNote = 0;
+
+	MidiPart Part;
+
+	Part.InitSearch(pTrack, Channel, Instrument, OverlapsThreshold,
+		CHOOSE_MIN_NOTE_NUMBER);
+
+	// ,   ,   
+	NOTEDESC PrevNoteDesc;
+	NOTEDESC CurNoteDesc;
+
+	//   ,   
+	pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent, NULL, &cchEventText);
+
+	//   
+	MIDIPARTRESULT PartRes = Part.GetNextNote(&CurNoteDesc);
+
+	if (PartRes == MIDIPART_CANT_ALLOC_MEMORY) return REF_DISTANCE_CANT_ALLOC_MEMORY;
+	if (PartRes == MIDIPART_PART_END) return REF_DISTANCE_NO_NOTES;
+	if (PartRes != MIDIPART_SUCCESS) return REF_DISTANCE_NOT_VOCAL_PART;
+
+	if (ctToLyricEvent <= CurNoteDesc.ctToNoteOn)
+	{
+		//          
+		PartLyricDistance = TickDistance(ctToLyricEvent, CurNoteDesc.ctToNoteOn);
+
+		cchPerNote = cchEventText;
+
+		//   
+		MIDILYRICRESULT LyricRes = pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent, NULL,
+			&cchEventText);
+
+		if (LyricRes == MIDILYRIC_LYRIC_END)
+		{
+			//     
+			if (cchPerNote > MAX_SYMBOLS_PER_NOTE) return REF_DISTANCE_NOT_VOCAL_PART;
+
+			if (fCriteria & (LIMIT_NOTES_PER_METAEVENT | IDENTICAL_END))
+			{
+				REFDISTANCERESULT TailRes = CheckReferenceTailNotes(&Part, 1);
+
+				if (TailRes != REF_DISTANCE_SUCCESS) return TailRes;
+			}
+
+			*pPartLyricDistance = (double) PartLyricDistance / cTicksPerMidiQuarterNote;
+			return REF_DISTANCE_SUCCESS;
+		}
+
+		if (fCriteria & IDENTICAL_START)
+		{
+			//           
+			//         
+			if (PartLyricDistance > TickDistance(ctToLyricEvent, CurNoteDesc.ctToNoteOn))
+			{
+				return REF_DISTANCE_NOT_VOCAL_PART;
+			}
+		}
+
+		PrevNoteDesc = CurNoteDesc;
+
+		//   
+		PartRes = Part.GetNextNote(&CurNoteDesc);
+
+		if (PartRes == MIDIPART_CANT_ALLOC_MEMORY) return REF_DISTANCE_CANT_ALLOC_MEMORY;
+
+		if (PartRes == MIDIPART_PART_END)
+		{
+			//     
+			return AddReferenceTailEvents(pLyric, iLyricEvent, ctToLyricEvent,
+				cchEventText, &PrevNoteDesc, cchPerNote, fCriteria,
+				cTicksPerMidiQuarterNote, PartLyricDistance, pPartLyricDistance);
+		}
+
+		if (PartRes != MIDIPART_SUCCESS) return REF_DISTANCE_NOT_VOCAL_PART;
+	}
+	else
+	{
+		//      
+		PrevNoteDesc = CurNoteDesc;
+
+		//   
+		PartRes = Part.GetNextNote(&CurNoteDesc);
+
+		if (PartRes == MIDIPART_CANT_ALLOC_MEMORY) return REF_DISTANCE_CANT_ALLOC_MEMORY;
+
+		if (PartRes == MIDIPART_PART_END)
+		{
+			//     
+			return AddReferenceTailEvents(pLyric, iLyricEvent, ctToLyricEvent,
+				cchEventText, &PrevNoteDesc, 0, fCriteria, cTicksPerMidiQuarterNote,
+				PartLyricDistance, pPartLyricDistance);
+		}
+
+		if (PartRes != MIDIPART_SUCCESS) return REF_DISTANCE_NOT_VOCAL_PART;
+
+		if (fCriteria & IDENTICAL_START)
+		{
+			//        
+			if (!IsReferenceFirstNoteNearer(ctToLyricEvent, &PrevNoteDesc, &CurNoteDesc))
+			{
+				return REF_DISTANCE_NOT_VOCAL_PART;
+			}
+		}
+	}
+
+	//   ;     ,  
+	// PrevNoteDesc,       
+	while (true)
+	{
+		//     
+		DWORD cNotesPerMetaEvent = 0;
+
+		//   ,      
+		while (!IsReferenceFirstNoteNearer(ctToLyricEvent, &PrevNoteDesc, &CurNoteDesc))
+		{
+			cchPerNote = 0;
+
+			cNotesPerMetaEvent++;
+
+			if ((fCriteria & LIMIT_NOTES_PER_METAEVENT) &&
+				cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
+			{
+				return REF_DISTANCE_NOT_VOCAL_PART;
+			}
+
+			PrevNoteDesc = CurNoteDesc;
+
+			PartRes = Part.GetNextNote(&CurNoteDesc);
+
+			if (PartRes == MIDIPART_CANT_ALLOC_MEMORY)
+			{
+				return REF_DISTANCE_CANT_ALLOC_MEMORY;
+			}
+
+			if (PartRes == MIDIPART_PART_END)
+			{
+				//   
+				return AddReferenceTailEvents(pLyric, iLyricEvent, ctToLyricEvent,
+					cchEventText, &PrevNoteDesc, 0, fCriteria, cTicksPerMidiQuarterNote,
+					PartLyricDistance, pPartLyricDistance);
+			}
+
+			if (PartRes != MIDIPART_SUCCESS) return REF_DISTANCE_NOT_VOCAL_PART;
+		}
+
+		//           
+		PartLyricDistance += TickDistance(ctToLyricEvent, PrevNoteDesc.ctToNoteOn);
+
+		cchPerNote += cchEventText;
+
+		if (cchPerNote > MAX_SYMBOLS_PER_NOTE) return REF_DISTANCE_NOT_VOCAL_PART;
+
+		//   
+		MIDILYRICRESULT LyricRes = pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent, NULL,
+			&cchEventText);
+
+		if (LyricRes == MIDILYRIC_LYRIC_END)
+		{
+			//  ;     
+			// PrevNoteDesc  CurNoteDesc
+			if (fCriteria & (IDENTICAL_END | LIMIT_NOTES_PER_METAEVENT))
+			{
+				REFDISTANCERESULT TailRes = CheckReferenceTailNotes(&Part, 2);
+
+				if (TailRes != REF_DISTANCE_SUCCESS) return TailRes;
+			}
+
+			*pPartLyricDistance = (double) PartLyricDistance / cTicksPerMidiQuarterNote;
+			return REF_DISTANCE_SUCCESS;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    CheckReferenceTailNotes
+*
+*   
+*       pPart -   ,       
+*       cNotesPerMetaEvent -    ,   
+*                            
+*
+*    
+*       REF_DISTANCE_SUCCESS -      
+*                              MAX_NOTES_PER_METAEVENT ;
+*       REF_DISTANCE_NOT_VOCAL_PART -       ;
+*       REF_DISTANCE_CANT_ALLOC_MEMORY -    .
+*
+*            
+*   .
+*
+****************************************************************************************/
+
+static REFDISTANCERESULT CheckReferenceTailNotes(
+	__inout MidiPart *pPart,
+	__in DWORD cNotesPerMetaEvent)
+{
+	while (true)
+	{
+		MIDIPARTRESULT PartRes = pPart->GetNextNote(NULL);
+
+		if (PartRes == MIDIPART_CANT_ALLOC_MEMORY) return REF_DISTANCE_CANT_ALLOC_MEMORY;
+		if (PartRes == MIDIPART_PART_END) return REF_DISTANCE_SUCCESS;
+		if (PartRes != MIDIPART_SUCCESS) return REF_DISTANCE_NOT_VOCAL_PART;
+
+		cNotesPerMetaEvent++;
+
+		if (cNotesPerMetaEvent > MAX_NOTES_PER_METAEVENT)
+		{
+			return REF_DISTANCE_NOT_VOCAL_PART;
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    AddReferenceTailEvents
+*
+*   
+*       pLyric -    
+*       iLyricEvent -  ,   
+*       ctToLyricEvent -     
+*       cchEventText -     
+*       pLastNote -      
+*       cchPerLastNote -    ,   
+*                         
+*       fCriteria -  ,   
+*       cTicksPerMidiQuarterNote -     MIDI-
+*       PartLyricDistance -    ,    
+*       pPartLyricDistance -   ,     
+*                                   MIDI-
+*
+*    
+*       REF_DISTANCE_SUCCESS  REF_DISTANCE_NOT_VOCAL_PART.
+*
+*            .   
+*    IDENTICAL_END,   ,    
+*    ,  .
+*
+****************************************************************************************/
+
+static REFDISTANCERESULT AddReferenceTailEvents(
+	__in MidiLyric *pLyric,
+	__in DWORD iLyricEvent,
+	__in DWORD ctToLyricEvent,
+	__in DWORD cchEventText,
+	__in const NOTEDESC *pLastNote,
+	__in DWORD cchPerLastNote,
+	__in DWORD fCriteria,
+	__in DWORD cTicksPerMidiQuarterNote,
+	__in DWORD PartLyricDistance,
+	__out double *pPartLyricDistance)
+{
+	//    
+	DWORD ctToNoteOff = pLastNote->ctToNoteOn + pLastNote->ctDuration;
+
+	while (true)
+	{
+		if ((fCriteria & IDENTICAL_END) || ctToLyricEvent <= ctToNoteOff)
+		{
+			cchPerLastNote += cchEventText;
+		}
+
+		if (cchPerLastNote > MAX_SYMBOLS_PER_NOTE) return REF_DISTANCE_NOT_VOCAL_PART;
+
+		PartLyricDistance += TickDistance(ctToLyricEvent, pLastNote->ctToNoteOn);
+
+		if (pLyric->GetEvent(iLyricEvent++, &ctToLyricEvent, NULL, &cchEventText) ==
+			MIDILYRIC_LYRIC_END)
+		{
+			break;
+		}
+	}
+
+	*pPartLyricDistance = (double) PartLyricDistance / cTicksPerMidiQuarterNote;
+	return REF_DISTANCE_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    IsReferenceFirstNoteNearer
+*
+*   
+*       ctToLyricEvent -    
+*       pFirstNote -     
+*       pSecondNote -     
+*
+*    
+*       true,          ;  false.
+*
+*     MidiFile::IsFirstNoteNearer.
+*
+****************************************************************************************/
+
+static bool IsReferenceFirstNoteNearer(
+	__in DWORD ctToLyricEvent,
+	__in const NOTEDESC *pFirstNote,
+	__in const NOTEDESC *pSecondNote)
+{
+	//    
+	DWORD ctToFirstNoteOff = pFirstNote->ctToNoteOn + pFirstNote->ctDuration;
+
+	if (ctToLyricEvent >= ctToFirstNoteOff)
+	{
+		//         
+
+		if (ctToLyricEvent >= pSecondNote->ctToNoteOn) return false;
+
+		//       
+
+		if (ctToLyricEvent - ctToFirstNoteOff > pSecondNote->ctToNoteOn - ctToLyricEvent)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    AddReferenceVocalPart
+*
+*   
+*       pVocalParts -     ,  
+*                       
+*       pcVocalParts -       
+*       iTrack, Channel, Instrument -    
+*       PartLyricDistance -        
+*
+*    
+*       true,   ; false,   .
+*
+*           ,  
+*     PartLyricDistance,   MidiFile::AddVocalPart.
+*
+****************************************************************************************/
+
+static bool AddReferenceVocalPart(
+	__inout REFVOCALPART *pVocalParts,
+	__inout DWORD *pcVocalParts,
+	__in DWORD iTrack,
+	__in DWORD Channel,
+	__in DWORD Instrument,
+	__in double PartLyricDistance)
+{
+	if (*pcVocalParts == VOCAL_CHECK_MAX_VOCAL_PARTS) return false;
+
+	DWORD iNewVocalPart = *pcVocalParts;
+
+	while (iNewVocalPart > 0 &&
+		pVocalParts[iNewVocalPart - 1].PartLyricDistance > PartLyricDistance)
+	{
+		pVocalParts[iNewVocalPart] = pVocalParts[iNewVocalPart - 1];
+		iNewVocalPart--;
+	}
+
+	pVocalParts[iNewVocalPart].iTrack = iTrack;
+	pVocalParts[iNewVocalPart].Channel = Channel;
+	pVocalParts[iNewVocalPart].Instrument = Instrument;
+	pVocalParts[iNewVocalPart].PartLyricDistance = PartLyricDistance;
+
+	(*pcVocalParts)++;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    TickDistance
+*
+*          .
+*
+****************************************************************************************/
+
+static DWORD TickDistance(
+	__in DWORD ctTime1,
+	__in DWORD ctTime2)
+{
+	return (ctTime1 > ctTime2) ? ctTime1 - ctTime2 : ctTime2 - ctTime1;
+}
+
+/****************************************************************************************
+*
+*    CheckTrackDecoding
+*
+*   
+*       
+*
+*    
+*       
+*
+*    ,     MidiTrack,  , 
+*          (.  DecodeReferenceTrack).
+*         BuildRandomTrack;  
+*   TRACK_CHECK_TRUNCATED_TRACKS       ,  
+*        .  , ,  , 
+*         ,  , 
+*          ,  .
+*
+****************************************************************************************/
+
+static void CheckTrackDecoding()
+{
+	_tprintf(TEXT("track decoding\n"));
+
+	BYTE *pTrack = (BYTE *) HeapAlloc(GetProcessHeap(), 0, TRACK_CHECK_TRACK_SIZE);
+
+	//     ,      
+	REFTRACKEVENT *pRefEvents = (REFTRACKEVENT *) HeapAlloc(GetProcessHeap(), 0,
+		TRACK_CHECK_TRACK_SIZE / 2 * sizeof(REFTRACKEVENT));
+
+	if (pTrack == NULL || pRefEvents == NULL)
+	{
+		Check(false, TEXT("track decoding buffers can be allocated"));
+		if (pTrack != NULL) HeapFree(GetProcessHeap(), 0, pTrack);
+		if (pRefEvents != NULL) HeapFree(GetProcessHeap(), 0, pRefEvents);
+		return;
+	}
+
+	//     ;  ,  
+	//    
+	DWORD Seed = 1;
+
+	bool bRandomTracksMatch = true;
+	bool bTruncatedTracksMatch = true;
+	bool bInvalidTracksMatch = true;
+	bool bRandomBytesMatch = true;
+
+	for (DWORD iTrack = 0; iTrack < TRACK_CHECK_RANDOM_TRACKS; iTrack++)
+	{
+		//    
+		DWORD cbTrack = BuildRandomTrack(&Seed, pTrack);
+
+		if (!IsTrackDecodedAsBefore(pTrack, cbTrack, pRefEvents))
+		{
+			_tprintf(TEXT("    random track %u differs\n"), iTrack);
+			bRandomTracksMatch = false;
+		}
+
+		//     
+		if (iTrack < TRACK_CHECK_TRUNCATED_TRACKS)
+		{
+			for (DWORD cbPart = 0; cbPart < cbTrack; cbPart++)
+			{
+				if (!IsTrackDecodedAsBefore(pTrack, cbPart, pRefEvents))
+				{
+					_tprintf(TEXT("    random track %u truncated to %u bytes differs\n"),
+						iTrack, cbPart);
+					bTruncatedTracksMatch = false;
+					break;
+				}
+			}
+		}
+
+		// ,        ;  
+		//      ,    
+		// 
+		BYTE *pCurByte = pTrack;
+
+		if (iTrack % 2 != 0)
+		{
+			*pCurByte++ = 0;
+			*pCurByte++ = 0xFF;
+			*pCurByte++ = TEXT_EVENT;
+			*pCurByte++ = 0;
+		}
+
+		*pCurByte++ = 0;
+		*pCurByte++ = 60;
+		*pCurByte++ = 64;
+
+		cbTrack = (DWORD) (pCurByte - pTrack) + BuildRandomTrack(&Seed, pCurByte);
+
+		DWORD cRefEvents;
+
+		MidiTrack Track;
+
+		if (DecodeReferenceTrack(pTrack, cbTrack, pRefEvents, &cRefEvents, NULL) !=
+			MIDITRACK_INVALID_TRACK ||
+			Track.AttachToTrack(pTrack, cbTrack) != MIDITRACK_INVALID_TRACK)
+		{
+			_tprintf(TEXT("    track %u without running status differs\n"), iTrack);
+			bInvalidTracksMatch = false;
+		}
+
+		//    ,     NOTE_ON, 
+		//    
+		cbTrack = 2 + GetRandom(&Seed, TRACK_CHECK_TRACK_SIZE - 2);
+
+		pTrack[0] = 0;
+		pTrack[1] = NOTE_ON;
+
+		for (DWORD iByte = 2; iByte < cbTrack; iByte++)
+		{
+			pTrack[iByte] = (BYTE) GetRandom(&Seed, 256);
+		}
+
+		if (!IsTrackDecodedAsBefore(pTrack, cbTrack, pRefEvents))
+		{
+			_tprintf(TEXT("    track %u of random bytes differs\n"), iTrack);
+			bRandomBytesMatch = false;
+		}
+	}
+
+	Check(bRandomTracksMatch, TEXT("random tracks are decoded as before"));
+	Check(bTruncatedTracksMatch, TEXT("truncated tracks are decoded as before"));
+	Check(bInvalidTracksMatch,
+		TEXT("a channel event without running status is invalid"));
+	Check(bRandomBytesMatch, TEXT("tracks of random bytes are decoded as before"));
+
+	HeapFree(GetProcessHeap(), 0, pRefEvents);
+	HeapFree(GetProcessHeap(), 0, pTrack);
+}
+
+/****************************************************************************************
+*
+*    IsTrackDecodedAsBefore
+*
+*   
+*       pTrack -     
+*       cbTrack -  ,    
+*       pRefEvents -     cbTrack / 2 ,   
+*                     ,    
+*
+*    
+*       true,    MidiTrack    ,   
+*       ,  false.
+*
+*      MidiTrack       
+*   AttachToTrack,     ,   GetEvent
+*   (, ,  ,      ),   
+*   DecodeReferenceTrack.  ,     
+*   GetEvent   REAL_TRACK_END.
+*
+****************************************************************************************/
+
+static bool IsTrackDecodedAsBefore(
+	__in BYTE *pTrack,
+	__in DWORD cbTrack,
+	__out REFTRACKEVENT *pRefEvents)
+{
+	DWORD cRefEvents;
+
+	MIDITRACKRESULT RefResult = DecodeReferenceTrack(pTrack, cbTrack, pRefEvents,
+		&cRefEvents, NULL);
+
+	MidiTrack Track;
+
+	MIDITRACKRESULT Result = Track.AttachToTrack(pTrack, cbTrack);
+
+	if (Result != RefResult) return false;
+	if (Result != MIDITRACK_SUCCESS) return true;
+
+	if (Track.GetEventCount() != cRefEvents) return false;
+
+	DWORD ctTime;
+	BYTE *pData;
+	DWORD Channel;
+	DWORD cbData;
+
+	for (DWORD iEvent = 0; iEvent < cRefEvents; iEvent++)
+	{
+		DWORD Event = Track.GetEvent(iEvent, &ctTime, &pData, &Channel, &cbData);
+
+		if (Event != pRefEvents[iEvent].Event ||
+			ctTime != pRefEvents[iEvent].ctTime ||
+			pData != pTrack + pRefEvents[iEvent].DataOffset ||
+			Channel != pRefEvents[iEvent].Channel ||
+			cbData != pRefEvents[iEvent].cbData)
+		{
+			return false;
+		}
+	}
+
+	return Track.GetEvent(cRefEvents, &ctTime, &pData) == REAL_TRACK_END;
+}
+
+/****************************************************************************************
+*
+*    DecodeReferenceTrack
+*
+*   
+*       pTrack -     
+*       cbTrack -  ,    
+*       pEvents -     cbTrack / 2 ,   
+*                    (  END_OF_TRACK)
+*       pcEvents -   ,     
+*                     pEvents
+*       pctTrackLength -   ,     
+*                            (   END_OF_TRACK) 
+*                        ;      NULL
+*
+*    
+*       MIDITRACK_SUCCESS -  ;
+*       MIDITRACK_INVALID_TRACK -      ,  
+*                                    .
+*
+*     ,     MidiTrack::AttachToTrack  ,
+*       :      
+*      ,      ,  
+*     GetNextRawEvent.   ,  
+*    4 ,   .
+*
+****************************************************************************************/
+
+static MIDITRACKRESULT DecodeReferenceTrack(
+	__in BYTE *pTrack,
+	__in DWORD cbTrack,
+	__out REFTRACKEVENT *pEvents,
+	__out DWORD *pcEvents,
+	__out_opt DWORD *pctTrackLength)
+{
+	*pcEvents = 0;
+
+	//  :  ,    
+	DWORD cbValidTrack = 0;
+
+	DWORD iCurByte = 0;
+	BYTE RunningStatus = 0;
+
+	while (iCurByte < cbTrack)
+	{
+		//  -
+		while (iCurByte < cbTrack && (pTrack[iCurByte] & 0x80)) iCurByte++;
+		iCurByte++;
+
+		if (iCurByte >= cbTrack) break;
+
+		if (pTrack[iCurByte] < 0xF0)
+		{
+			if (pTrack[iCurByte] & 0x80)
+			{
+				RunningStatus = pTrack[iCurByte];
+				iCurByte++;
+			}
+			else if (RunningStatus == 0)
+			{
+				return MIDITRACK_INVALID_TRACK;
+			}
+
+			BYTE Event = RunningStatus & 0xF0;
+
+			iCurByte += (Event == PROGRAM_CHANGE || Event == CHANNEL_AFTER_TOUCH) ?
+				1 : 2;
+		}
+		else
+		{
+			iCurByte += (pTrack[iCurByte] == 0xFF) ? 2 : 1;
+
+			//   ;      ,  
+			DWORD cbData = 0;
+			DWORD cbVarLen = 0;
+			BYTE CurByte;
+
+			do
+			{
+				if (iCurByte >= cbTrack) goto decode;
+
+				CurByte = pTrack[iCurByte++];
+				cbData = (cbData << 7) + (CurByte & 0x7F);
+				cbVarLen++;
+			}
+			while (CurByte & 0x80);
+
+			if (cbVarLen <= 4) iCurByte += cbData;
+		}
+
+		if (iCurByte <= cbTrack) cbValidTrack = iCurByte;
+	}
+
+decode:
+
+	//  :  
+	BYTE *pCurByte = pTrack;
+	BYTE *pEndOfTrack = pTrack + cbValidTrack;
+	DWORD ctCurTime = 0;
+
+	RunningStatus = 0;
+
+	while (pCurByte < pEndOfTrack)
+	{
+		ctCurTime += GetNumberFromVLQ(&pCurByte);
+
+		REFTRACKEVENT *pEvent = pEvents + *pcEvents;
+
+		pEvent->ctTime = ctCurTime;
+		pEvent->Channel = 0;
+
+		if (*pCurByte < 0xF0)
+		{
+			if (*pCurByte & 0x80) RunningStatus = *pCurByte++;
+
+			pEvent->DataOffset = (DWORD) (pCurByte - pTrack);
+			pEvent->Event = RunningStatus & 0xF0;
+			pEvent->Channel = RunningStatus & 0x0F;
+
+			if (pEvent->Event == NOTE_ON && pCurByte[1] == 0) pEvent->Event = NOTE_OFF;
+
+			pEvent->cbData = (pEvent->Event == PROGRAM_CHANGE ||
+				pEvent->Event == CHANNEL_AFTER_TOUCH) ? 1 : 2;
+		}
+		else
+		{
+			if (*pCurByte == 0xFF)
+			{
+				pCurByte++;
+				pEvent->Event = *pCurByte++;
+			}
+			else
+			{
+				pEvent->Event = *pCurByte++;
+			}
+
+			pEvent->DataOffset = (DWORD) (pCurByte - pTrack);
+			pEvent->cbData = GetNumberFromVLQ(&pCurByte);
+		}
+
+		pCurByte += pEvent->cbData;
+
+		if (pEvent->Event != END_OF_TRACK) (*pcEvents)++;
+	}
+
+	if (pctTrackLength != NULL) *pctTrackLength = ctCurTime;
+
+	return MIDITRACK_SUCCESS;
+}
+
+/****************************************************************************************
+*
+*    BuildRandomTrack
+*
+*   
+*       pSeed -   ,    
+*                (.  GetRandom)
+*       pTrack -   ,      ; 
+*                   TRACK_CHECK_TRACK_SIZE - 8 
+*
+*    
+*          .
+*
+*     (  MTrk)   :   
+*       ,  NOTE_ON    ,
+*    (   END_OF_TRACK)  SysEx-. - 
+*        1-5 .    
+*   SysEx-      5  (  
+*    )     2 ,     .
+*
+****************************************************************************************/
+
+static DWORD BuildRandomTrack(
+	__inout DWORD *pSeed,
+	__out BYTE *pTrack)
+{
+	BYTE *pCurByte = pTrack;
+
+	//  ;  -    
+	BYTE RunningStatus = 0;
+
+	DWORD cEvents = 1 + GetRandom(pSeed, TRACK_CHECK_MAX_EVENTS);
+
+	for (DWORD iEvent = 0; iEvent < cEvents; iEvent++)
+	{
+		//  -   
+		DWORD Choice = GetRandom(pSeed, 20);
+
+		WriteRandomVarLen(pSeed, &pCurByte, (Choice < 12) ? 1 : (Choice < 16) ? 2 :
+			(Choice < 18) ? 3 : Choice - 14);
+
+		Choice = GetRandom(pSeed, 10);
+
+		if (Choice < 6)
+		{
+			//  ;    ,    
+			//   
+			if (RunningStatus == 0 || GetRandom(pSeed, 2) == 0)
+			{
+				RunningStatus = (BYTE) (0x80 + GetRandom(pSeed, 0x70));
+				*pCurByte++ = RunningStatus;
+			}
+
+			BYTE Event = RunningStatus & 0xF0;
+
+			*pCurByte++ = (BYTE) GetRandom(pSeed, 0x80);
+
+			if (Event != PROGRAM_CHANGE && Event != CHANNEL_AFTER_TOUCH)
+			{
+				//        
+				*pCurByte++ = (BYTE) ((GetRandom(pSeed, 4) == 0) ? 0 :
+					GetRandom(pSeed, 0x80));
+			}
+		}
+		else
+		{
+			//  (    - END_OF_TRACK)  SysEx-
+			if (Choice < 9)
+			{
+				*pCurByte++ = 0xFF;
+				*pCurByte++ = (BYTE) ((Choice == 8) ? END_OF_TRACK :
+					GetRandom(pSeed, 0x80));
+			}
+			else
+			{
+				*pCurByte++ = (GetRandom(pSeed, 2) == 0) ? MULTIPACK : PACKET;
+			}
+
+			DWORD cbData = GetRandom(pSeed, 8);
+
+			Choice = GetRandom(pSeed, 20);
+
+			if (Choice < 18)
+			{
+				WriteVarLen(&pCurByte, cbData);
+			}
+			else
+			{
+				WriteRandomVarLen(pSeed, &pCurByte, (Choice == 18) ? 5 : 2);
+			}
+
+			for (DWORD iByte = 0; iByte < cbData; iByte++)
+			{
+				*pCurByte++ = (BYTE) GetRandom(pSeed, 256);
+			}
+		}
+	}
+
+	return (DWORD) (pCurByte - pTrack);
+}
+
+/****************************************************************************************
+*
+*    WriteRandomVarLen
+*
+*   
+*       pSeed -   ,    
+*                (.  GetRandom)
+*       ppCurByte -   ,    ,  
+*                    ;      
+*       cBytes -   
+*
+*    
+*       
+*
+*         ,  
+*     (    4 ,    MIDI- 
+*   ).
+*
+****************************************************************************************/
+
+static void WriteRandomVarLen(
+	__inout DWORD *pSeed,
+	__inout BYTE **ppCurByte,
+	__in DWORD cBytes)
+{
+	while (cBytes > 1)
+	{
+		*(*ppCurByte)++ = (BYTE) (0x80 | GetRandom(pSeed, 0x80));
+		cBytes--;
+	}
+
+	*(*ppCurByte)++ = (BYTE) GetRandom(pSeed, 0x80);
+}
+
+/****************************************************************************************
+*
+*    GetRandom
+*
+*   
+*       pSeed -   ,    
+*               
+*       Range -      (  65536)
+*
+*    
+*          0  Range - 1.
+*
+*        .  
+*    ,    rand,    
+*       .
+*
+****************************************************************************************/
+
+static DWORD GetRandom(
+	__inout DWORD *pSeed,
+	__in DWORD Range)
+{
+	*pSeed = *pSeed * 1664525 + 1013904223;
+
+	return (*pSeed >> 16) % Range;
+}
+
+/****************************************************************************************
+*
+*    CheckStreamParser
+*
+*   
+*       
+*
+*    
+*       
+*
+*    MIDI-,   BuildStreamFile,  
+*   MidiStreamParser         (.
+*    IsStreamParsedAsTracks).    STREAM_CHECK_PASSES 
+*       :   ,     
+*   (     ),    
+*   .  ,        
+*           , 
+*    .
+*
+****************************************************************************************/
+
+static void CheckStreamParser()
+{
+	_tprintf(TEXT("stream parser\n"));
+
+	BYTE *pFile = (BYTE *) HeapAlloc(GetProcessHeap(), 0, STREAM_CHECK_FILE_SIZE);
+
+	BYTE *pPortion = (BYTE *) HeapAlloc(GetProcessHeap(), 0,
+		STREAM_CHECK_FILE_SIZE + STREAM_CHECK_GUARD_SIZE);
+
+	//     ,      
+	REFTRACKEVENT *pRefEvents = (REFTRACKEVENT *) HeapAlloc(GetProcessHeap(), 0,
+		STREAM_CHECK_FILE_SIZE / 2 * sizeof(REFTRACKEVENT));
+
+	if (pFile == NULL || pPortion == NULL || pRefEvents == NULL)
+	{
+		Check(false, TEXT("stream parser buffers can be allocated"));
+		if (pFile != NULL) HeapFree(GetProcessHeap(), 0, pFile);
+		if (pPortion != NULL) HeapFree(GetProcessHeap(), 0, pPortion);
+		if (pRefEvents != NULL) HeapFree(GetProcessHeap(), 0, pRefEvents);
+		return;
+	}
+
+	//   MidiTrack  MidiStreamParser    , 
+	//      
+	{
+		STREAMTRACK Tracks[STREAM_CHECK_CHUNKS];
+
+		MidiStreamParser Parser;
+
+		//     
+		DWORD Seed = 1;
+
+		bool bFilesMatch = true;
+		bool bWholeEventsReturned = true;
+
+		DWORD cSkippedEvents = 0;
+		DWORD cStraddlingEvents = 0;
+
+		for (DWORD iFile = 0; iFile < STREAM_CHECK_FILES; iFile++)
+		{
+			DWORD cbFile = BuildStreamFile(&Seed, pFile);
+
+			DWORD cTracks = AttachStreamTracks(pFile, cbFile, Tracks, pRefEvents);
+
+			for (DWORD iPass = 0; iPass < STREAM_CHECK_PASSES; iPass++)
+			{
+				//    :  ,  ,   
+				//  16 , 4   64 
+				DWORD cbMaxPortion = (iPass == 0) ? cbFile : (iPass == 1) ? 1 :
+					(iPass % 3 == 2) ? 16 : (iPass % 3 == 0) ? 4096 : 65536;
+
+				DWORD cPassSkippedEvents;
+				DWORD cPassStraddlingEvents;
+
+				if (!IsStreamParsedAsTracks(&Parser, pFile, cbFile, Tracks, cTracks,
+					cbMaxPortion, &Seed, pPortion, &cPassSkippedEvents,
+					&cPassStraddlingEvents))
+				{
+					_tprintf(TEXT("    file %u, pass %u differs\n"), iFile, iPass);
+					bFilesMatch = false;
+				}
+
+				// ,   ,    
+				if (iPass == 0 && cPassSkippedEvents != 0)
+				{
+					_tprintf(TEXT("    file %u: an unbroken event is skipped\n"), iFile);
+					bWholeEventsReturned = false;
+				}
+
+				cSkippedEvents += cPassSkippedEvents;
+				cStraddlingEvents += cPassStraddlingEvents;
+			}
+		}
+
+		Check(bFilesMatch, TEXT("events of a file fed in portions match its tracks"));
+		Check(bWholeEventsReturned,
+			TEXT("a long event within one portion is returned"));
+		Check(cStraddlingEvents != 0, TEXT("some events straddle two portions"));
+		Check(cSkippedEvents != 0,
+			TEXT("a straddling event longer than the buffer is skipped"));
+	}
+
+	HeapFree(GetProcessHeap(), 0, pRefEvents);
+	HeapFree(GetProcessHeap(), 0, pPortion);
+	HeapFree(GetProcessHeap(), 0, pFile);
+}
+
+/****************************************************************************************
+*
+*    BuildStreamFile
+*
+*   
+*       pSeed -   ,    
+*                (.  GetRandom)
+*       pFile -     STREAM_CHECK_FILE_SIZE ,  
+*                 
+*
+*    
+*          .
+*
+*    MIDI-  1  STREAM_CHECK_CHUNKS :   
+*    (.  BuildRandomTrack),   ,   "MTrk",
+*          , ,  
+*    SysEx-  MAX_STREAM_EVENT_SIZE ,     
+*      .       
+*   STREAM_CHECK_MISSING_BYTES  ,    .
+*
+****************************************************************************************/
+
+static DWORD BuildStreamFile(
+	__inout DWORD *pSeed,
+	__out BYTE *pFile)
+{
+	//  :  , ,     
+	//   MIDI-
+	CopyMemory(pFile, "MThd\0\0\0\6\0\1\0", 11);
+	pFile[11] = STREAM_CHECK_CHUNKS;
+	pFile[12] = STREAM_CHECK_DIVISION >> 8;
+	pFile[13] = STREAM_CHECK_DIVISION & 0xFF;
+
+	BYTE *pCurByte = pFile + 14;
+
+	for (DWORD iChunk = 0; iChunk < STREAM_CHECK_CHUNKS; iChunk++)
+	{
+		BYTE *pChunkHeader = pCurByte;
+		pCurByte += 8;
+
+		BYTE *pChunkData = pCurByte;
+
+		const char *pSignature = "MTrk";
+
+		switch (iChunk)
+		{
+		case 1:
+			// ,    
+			pSignature = "XFIH";
+
+			for (DWORD cBytes = GetRandom(pSeed, 64); cBytes > 0; cBytes--)
+			{
+				*pCurByte++ = (BYTE) GetRandom(pSeed, 256);
+			}
+
+			break;
+
+		case 2:
+			// ,   MidiFile 
+			*pCurByte++ = 0;
+			*pCurByte++ = 60;
+			*pCurByte++ = 64;
+			pCurByte += BuildRandomTrack(pSeed, pCurByte);
+			break;
+
+		case 3:
+		{
+			//   SysEx-,      
+			// 
+			WriteVarLen(&pCurByte, 1 + GetRandom(pSeed, 1000));
+			*pCurByte++ = MULTIPACK;
+			WriteVarLen(&pCurByte, MAX_STREAM_EVENT_SIZE);
+
+			for (DWORD iByte = 0; iByte < MAX_STREAM_EVENT_SIZE; iByte++)
+			{
+				*pCurByte++ = (BYTE) GetRandom(pSeed, 256);
+			}
+
+			pCurByte += BuildRandomTrack(pSeed, pCurByte);
+			break;
+		}
+
+		case 4:
+			//  
+			break;
+
+		default:
+			pCurByte += BuildRandomTrack(pSeed, pCurByte);
+			break;
+		}
+
+		DWORD cbChunk = (DWORD) (pCurByte - pChunkData);
+
+		if (iChunk == STREAM_CHECK_CHUNKS - 1) cbChunk += STREAM_CHECK_MISSING_BYTES;
+
+		CopyMemory(pChunkHeader, pSignature, 4);
+		pChunkHeader[4] = (BYTE) (cbChunk >> 24);
+		pChunkHeader[5] = (BYTE) (cbChunk >> 16);
+		pChunkHeader[6] = (BYTE) (cbChunk >> 8);
+		pChunkHeader[7] = (BYTE) cbChunk;
+	}
+
+	return (DWORD) (pCurByte - pFile);
+}
+
+/****************************************************************************************
+*
+*    AttachStreamTracks
+*
+*   
+*       pFile -   MIDI-
+*       cbFile -    
+*       pTracks -     STREAM_CHECK_CHUNKS ,   
+*                    
+*       pRefEvents -     cbFile / 2 ,   
+*                    DecodeReferenceTrack   
+*
+*    
+*          .
+*
+*      MidiTrack      ,   
+*    MidiFile::AssignFile,        MidiFile 
+*      .
+*
+****************************************************************************************/
+
+static DWORD AttachStreamTracks(
+	__in BYTE *pFile,
+	__in DWORD cbFile,
+	__out STREAMTRACK *pTracks,
+	__out REFTRACKEVENT *pRefEvents)
+{
+	DWORD cTracks = 0;
+	DWORD cValidTracks = 0;
+
+	DWORD iCurByte = 14;
+
+	while (iCurByte + 7 < cbFile)
+	{
+		bool bIsTrack = (memcmp(pFile + iCurByte, "MTrk", 4) == 0);
+
+		DWORD cbChunk = pFile[iCurByte + 4] << 24 | pFile[iCurByte + 5] << 16 |
+			pFile[iCurByte + 6] << 8 | pFile[iCurByte + 7];
+
+		iCurByte += 8;
+
+		if (iCurByte + cbChunk > cbFile) cbChunk = cbFile - iCurByte;
+
+		if (bIsTrack && cbChunk > 0)
+		{
+			STREAMTRACK *pTrack = pTracks + cTracks;
+
+			pTrack->bIsValid = (pTrack->Track.AttachToTrack(pFile + iCurByte, cbChunk) ==
+				MIDITRACK_SUCCESS);
+
+			// ,   MidiFile ,    ,  
+			//  
+			pTrack->iTrack = cValidTracks;
+
+			if (pTrack->bIsValid)
+			{
+				DWORD cRefEvents;
+
+				DecodeReferenceTrack(pFile + iCurByte, cbChunk, pRefEvents, &cRefEvents,
+					&pTrack->ctLength);
+
+				cValidTracks++;
+			}
+
+			cTracks++;
+		}
+
+		iCurByte += cbChunk;
+	}
+
+	return cTracks;
+}
+
+/****************************************************************************************
+*
+*    IsStreamParsedAsTracks
+*
+*   
+*       pParser -   ,   
+*       pFile -   MIDI-
+*       cbFile -    
+*       pTracks -       (. 
+*                 AttachStreamTracks)
+*       cTracks -     pTracks
+*       cbMaxPortion -       (  65536  
+*                        )
+*       pSeed -   ,    
+*                (.  GetRandom)
+*       pPortion -     cbFile + STREAM_CHECK_GUARD_SIZE 
+*                    
+*       pcSkippedEvents -   ,     
+*                             , 
+*                         
+*       pcStraddlingEvents -   ,    
+*                             ,    
+*
+*    
+*       true,      ,    ,  false.
+*
+*       MidiStreamParser,    
+*       cbMaxPortion .      pPortion,
+*           ,  
+*              ,
+*     .      , 
+*     MidiTrack::GetEvent (, ,  ,   
+*     ,     SysEx- -     ).
+*    ,          , 
+*   ,   MidiFile ,   ,   
+*     .   MAX_STREAM_EVENT_SIZE  
+*    .
+*
+****************************************************************************************/
+
+static bool IsStreamParsedAsTracks(
+	__inout MidiStreamParser *pParser,
+	__in BYTE *pFile,
+	__in DWORD cbFile,
+	__in STREAMTRACK *pTracks,
+	__in DWORD cTracks,
+	__in DWORD cbMaxPortion,
+	__inout DWORD *pSeed,
+	__out BYTE *pPortion,
+	__out DWORD *pcSkippedEvents,
+	__out DWORD *pcStraddlingEvents)
+{
+	*pcSkippedEvents = 0;
+	*pcStraddlingEvents = 0;
+
+	pParser->Reset();
+
+	//    ,     ,   
+	//   
+	DWORD iFileByte = 0;
+	DWORD cbPortion = 0;
+
+	bool bHeaderParsed = false;
+	bool bEndOfInput = false;
+
+	//      pTracks     
+	DWORD iStreamTrack = 0;
+	DWORD iEvent = 0;
+
+	while (true)
+	{
+		MIDISTREAMEVENT Event;
+
+		MIDISTREAMRESULT Result = pParser->GetNextEvent(&Event);
+
+		if (Result == MIDISTREAM_NEED_MORE_DATA)
+		{
+			if (bEndOfInput) return false;
+
+			if (iFileByte == cbFile)
+			{
+				pParser->SetEndOfInput();
+				bEndOfInput = true;
+				continue;
+			}
+
+			cbPortion = cbFile - iFileByte;
+
+			if (cbPortion > cbMaxPortion) cbPortion = 1 + GetRandom(pSeed, cbMaxPortion);
+
+			CopyMemory(pPortion, pFile + iFileByte, cbPortion);
+
+			for (DWORD iByte = 0; iByte < STREAM_CHECK_GUARD_SIZE; iByte++)
+			{
+				DWORD iGuardByte = iFileByte + cbPortion + iByte;
+
+				pPortion[cbPortion + iByte] = (BYTE) ((iGuardByte < cbFile) ?
+					~pFile[iGuardByte] : 0);
+			}
+
+			iFileByte += cbPortion;
+
+			if (!pParser->Feed(pPortion, cbPortion)) return false;
+
+			continue;
+		}
+
+		if (Result == MIDISTREAM_HEADER)
+		{
+			if (bHeaderParsed || pParser->GetFormat() != 1 ||
+				pParser->GetTicksPerMidiQuarterNote() != STREAM_CHECK_DIVISION)
+			{
+				return false;
+			}
+
+			bHeaderParsed = true;
+			continue;
+		}
+
+		if (Result == MIDISTREAM_END)
+		{
+			return bHeaderParsed && bEndOfInput && iStreamTrack == cTracks;
+		}
+
+		if (iStreamTrack == cTracks) return false;
+
+		STREAMTRACK *pTrack = pTracks + iStreamTrack;
+
+		if (Result == MIDISTREAM_INVALID_TRACK)
+		{
+			if (pTrack->bIsValid) return false;
+
+			iStreamTrack++;
+			iEvent = 0;
+			continue;
+		}
+
+		if (Result != MIDISTREAM_EVENT && Result != MIDISTREAM_TRACK_END) return false;
+
+		if (Event.iTrack != pTrack->iTrack) return false;
+
+		//  ,   MidiFile ,  : 
+		//  ,   ,   
+		if (Result == MIDISTREAM_EVENT && !pTrack->bIsValid) continue;
+
+		if (!pTrack->bIsValid) return false;
+
+		DWORD ctTime;
+		BYTE *pData;
+		DWORD Channel;
+		DWORD cbData;
+
+		if (Result == MIDISTREAM_TRACK_END)
+		{
+			if (Event.ctEventTime != pTrack->ctLength) return false;
+
+			//       
+			while (pTrack->Track.GetEvent(iEvent, &ctTime, &pData, &Channel, &cbData) !=
+				REAL_TRACK_END)
+			{
+				if (cbData < MAX_STREAM_EVENT_SIZE) return false;
+
+				(*pcSkippedEvents)++;
+				iEvent++;
+			}
+
+			iStreamTrack++;
+			iEvent = 0;
+			continue;
+		}
+
+		while (true)
+		{
+			DWORD TrackEvent = pTrack->Track.GetEvent(iEvent, &ctTime, &pData, &Channel,
+				&cbData);
+
+			if (TrackEvent == REAL_TRACK_END) return false;
+
+			if (TrackEvent == Event.Event && ctTime == Event.ctEventTime &&
+				Channel == Event.Channel && cbData == Event.cbData)
+			{
+				//    SysEx-     
+				DWORD cbCompared = cbData;
+
+				if (TrackEvent < 0x80 || TrackEvent >= 0xF0)
+				{
+					BYTE *pCurByte = pData;
+
+					do
+					{
+						cbCompared++;
+					}
+					while (*pCurByte++ & 0x80);
+				}
+
+				if (memcmp(pData, Event.pDataBytes, cbCompared) != 0) return false;
+
+				break;
+			}
+
+			//        
+			if (cbData < MAX_STREAM_EVENT_SIZE) return false;
+
+			(*pcSkippedEvents)++;
+			iEvent++;
+		}
+
+		// ,    ,    
+		// 
+		if (Event.pDataBytes < pPortion || Event.pDataBytes >= pPortion + cbPortion)
+		{
+			(*pcStraddlingEvents)++;
+		}
+
+		iEvent++;
+	}
+}
+
+/****************************************************************************************
+*
+*    CheckNotePool
+*
+*   
+*       
+*
+*    
+*       
+*
+*     ,   BuildPoolTrack,  
+*   MidiPart      .    
+*     ,        ,  
+*     .        : 
+*         .
+*
+****************************************************************************************/
+
+static void CheckNotePool()
+{
+	_tprintf(TEXT("note pool\n"));
+
+	BYTE *pTrack = (BYTE *) HeapAlloc(GetProcessHeap(), 0, POOL_CHECK_TRACK_SIZE);
+
+	if (pTrack == NULL)
+	{
+		Check(false, TEXT("note pool track can be built"));
+		return;
+	}
+
+	NOTEDESC ExpectedNotes[POOL_CHECK_EXPECTED_NOTES];
+
+	DWORD cbTrack = BuildPoolTrack(pTrack, ExpectedNotes);
+
+	//   MidiTrack  MidiPart    ,  
+	//     
+	{
+		MidiTrack Track;
+
+		if (Track.AttachToTrack(pTrack, cbTrack) != MIDITRACK_SUCCESS)
+		{
+			Check(false, TEXT("note pool track can be attached"));
+		}
+		else
+		{
+			MidiPart Part;
+
+			for (DWORD iSearch = 0; iSearch < 2; iSearch++)
+			{
+				Part.InitSearch(&Track, ANY_CHANNEL, ANY_INSTRUMENT, 1.0,
+					CHOOSE_MIN_NOTE_NUMBER);
+
+				//   ,     
+				DWORD iNote = 0;
+
+				while (iNote < POOL_CHECK_EXPECTED_NOTES)
+				{
+					NOTEDESC NoteDesc;
+
+					if (Part.GetNextNote(&NoteDesc) != MIDIPART_SUCCESS ||
+						NoteDesc.NoteNumber != ExpectedNotes[iNote].NoteNumber ||
+						NoteDesc.ctToNoteOn != ExpectedNotes[iNote].ctToNoteOn ||
+						NoteDesc.ctDuration != ExpectedNotes[iNote].ctDuration)
+					{
+						break;
+					}
+
+					iNote++;
+				}
+
+				if (iNote < POOL_CHECK_EXPECTED_NOTES)
+				{
+					_tprintf(TEXT("    search %u: note %u differs\n"), iSearch, iNote);
+				}
+
+				Check(iNote == POOL_CHECK_EXPECTED_NOTES &&
+					Part.GetNextNote(NULL) == MIDIPART_PART_END, (iSearch == 0) ?
+					TEXT("notes of a part wider than a pool block are paired") :
+					TEXT("a reused part returns the same notes"));
+			}
+		}
+	}
+
+	HeapFree(GetProcessHeap(), 0, pTrack);
+}
+
+/****************************************************************************************
+*
+*    BuildPoolTrack
+*
+*   
+*       pTrack -     POOL_CHECK_TRACK_SIZE ,  
+*                   
+*       pExpectedNotes -     POOL_CHECK_EXPECTED_NOTES , 
+*                           ,    
+*
+*    
+*          .
+*
+*     (  MTrk),   POOL_CHECK_ROUNDS  
+*     POOL_CHECK_CONCORD_NOTES ,     
+*   POOL_CHECK_MELODY_NOTES .     0, 1  2  128 
+*    ;  NOTE_OFF      ,  
+*     NOTE_ON.       
+*   .
+*
+****************************************************************************************/
+
+static DWORD BuildPoolTrack(
+	__out BYTE *pTrack,
+	__out NOTEDESC *pExpectedNotes)
+{
+	BYTE *pCurByte = pTrack;
+
+	//    
+	DWORD ctLastEvent = 0;
+
+	//     0
+	for (DWORD Channel = 0; Channel <= POOL_CHECK_CONCORD_NOTES / 128; Channel++)
+	{
+		WriteVarLen(&pCurByte, 0);
+		*pCurByte++ = (BYTE) (PROGRAM_CHANGE | Channel);
+		*pCurByte++ = 0;
+	}
+
+	DWORD cExpectedNotes = 0;
+
+	for (DWORD iRound = 0; iRound < POOL_CHECK_ROUNDS; iRound++)
+	{
+		DWORD ctRound = iRound * POOL_CHECK_ROUND_LENGTH;
+
+		for (DWORD iEvent = 0; iEvent < 2 * POOL_CHECK_CONCORD_NOTES; iEvent++)
+		{
+			//    - NOTE_ON,  - NOTE_OFF
+			bool bIsNoteOn = (iEvent < POOL_CHECK_CONCORD_NOTES);
+
+			DWORD iNote = bIsNoteOn ? iEvent : (iEvent - POOL_CHECK_CONCORD_NOTES) *
+				POOL_CHECK_OFF_STRIDE % POOL_CHECK_CONCORD_NOTES;
+
+			DWORD ctEvent = bIsNoteOn ? ctRound : ctRound + POOL_CHECK_CONCORD_LENGTH;
+
+			WriteVarLen(&pCurByte, ctEvent - ctLastEvent);
+			ctLastEvent = ctEvent;
+
+			*pCurByte++ = (BYTE) ((bIsNoteOn ? NOTE_ON : NOTE_OFF) | (iNote / 128));
+			*pCurByte++ = (BYTE) (iNote % 128);
+			*pCurByte++ = 64;
+		}
+
+		pExpectedNotes[cExpectedNotes].NoteNumber = 0;
+		pExpectedNotes[cExpectedNotes].ctToNoteOn = ctRound;
+		pExpectedNotes[cExpectedNotes].ctDuration = POOL_CHECK_CONCORD_LENGTH;
+		cExpectedNotes++;
+
+		//       
+		for (DWORD iNote = 0; iNote < POOL_CHECK_MELODY_NOTES; iNote++)
+		{
+			DWORD ctNoteOn = ctRound + 2 * POOL_CHECK_CONCORD_LENGTH +
+				iNote * POOL_CHECK_MELODY_NOTE_LENGTH;
+
+			WriteVarLen(&pCurByte, ctNoteOn - ctLastEvent);
+			*pCurByte++ = NOTE_ON;
+			*pCurByte++ = (BYTE) (60 + 2 * iNote);
+			*pCurByte++ = 64;
+
+			WriteVarLen(&pCurByte, POOL_CHECK_MELODY_NOTE_LENGTH);
+			*pCurByte++ = NOTE_OFF;
+			*pCurByte++ = (BYTE) (60 + 2 * iNote);
+			*pCurByte++ = 64;
+
+			ctLastEvent = ctNoteOn + POOL_CHECK_MELODY_NOTE_LENGTH;
+
+			pExpectedNotes[cExpectedNotes].NoteNumber = 60 + 2 * iNote;
+			pExpectedNotes[cExpectedNotes].ctToNoteOn = ctNoteOn;
+			pExpectedNotes[cExpectedNotes].ctDuration = POOL_CHECK_MELODY_NOTE_LENGTH;
+			cExpectedNotes++;
+		}
+	}
+
+	//  END_OF_TRACK
+	WriteVarLen(&pCurByte, 0);
+	*pCurByte++ = 0xFF;
+	*pCurByte++ = END_OF_TRACK;
+	*pCurByte++ = 0;
+
+	return (DWORD) (pCurByte - pTrack);
+}
@@ -4,6 +4,9 @@
 *
 *       .
 *
+*      HEADLESS (  ),   
+*     ,       .
+*
 *   :     , 2008-2010
 *
 ****************************************************************************************/
@@ -17,7 +20,10 @@
 #include "Log.h"
 #include "TextMessages.h"
 #include "ShowError.h"
+
+#ifndef HEADLESS
 #include "FrameWnd.h"
+#endif
 
 /****************************************************************************************
 *
@@ -36,9 +42,6 @@
 *
 ****************************************************************************************/
 
-//     ,  
-static DWORD g_LastMsgId = MSGID_UNDEFINED;
-
 //       ShowFatalError,   
 //       (  GetTickCount)
 static DWORD g_LastFatalErrorTime;
@@ -102,13 +105,13 @@ void ShowError_Uninit()
 void ShowError(
 	__in TEXTMESSAGEID0 MsgId)
 {
+#ifndef HEADLESS
 	LPCTSTR pszMsg = TextMessages_GetMessage(MsgId);
 
 	if (pszMsg == NULL) return;
 
-	g_LastMsgId = MsgId;
-
 	MessageBox(g_hwndFrame, pszMsg, NULL, MB_OK | MB_HELP | MB_ICONEXCLAMATION);
+#endif
 }
 
 /****************************************************************************************
@@ -131,6 +134,7 @@ void ShowError(
 	__in TEXTMESSAGEID1 MsgId,
 	__in DWORD ErrorCode)
 {
+#ifndef HEADLESS
 	LPCTSTR pszMsg = TextMessages_GetMessage(MsgId);
 
 	if (pszMsg == NULL) return;
@@ -155,6 +159,7 @@ void ShowError(
 		MessageBox(g_hwndFrame, lpBuffer, NULL, MB_OK | MB_HELP | MB_ICONEXCLAMATION);
 		LocalFree(lpBuffer);
 	}
+#endif
 }
 
 /****************************************************************************************
@@ -180,6 +185,7 @@ void ShowError(
 	__in FUNCTIONID FunctionId,
 	__in DWORD ErrorCode)
 {
+#ifndef HEADLESS
 	LPCTSTR pszMsg = TextMessages_GetMessage(MsgId);
 
 	if (pszMsg == NULL) return;
@@ -207,6 +213,7 @@ void ShowError(
 		MessageBox(g_hwndFrame, lpBuffer, NULL, MB_OK | MB_HELP | MB_ICONEXCLAMATION);
 		LocalFree(lpBuffer);
 	}
+#endif
 }
 
 /****************************************************************************************
@@ -307,22 +314,3 @@ void ShowFatalError(
 
 	g_LastFatalErrorTime = GetTickCount();
 }
-
-/****************************************************************************************
-*
-*    ShowError_GetLastMsgId
-*
-*   
-*       
-*
-*    
-*           .
-*
-*          .
-*
-****************************************************************************************/
-
-DWORD ShowError_GetLastMsgId()
-{
-	return g_LastMsgId;
-}
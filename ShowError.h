@@ -24,7 +24,10 @@ enum FUNCTIONID
 	FUNCID_QUERY_INTERFACE = 5,
 	FUNCID_CREATE_CLIPPER = 6,
 	FUNCID_GET_FILE_SIZE = 7,
-	FUNCID_READ_FILE = 8
+	FUNCID_READ_FILE = 8,
+	FUNCID_CREATE_FILE_MAPPING = 9,
+	FUNCID_MAP_VIEW_OF_FILE = 10,
+	FUNCID_CREATE_FILE = 11
 };
 
 /****************************************************************************************
@@ -178,19 +181,3 @@ void ShowFatalError(
 	__in TEXTMESSAGEID2 MsgId,
 	__in FUNCTIONID FunctionId,
 	__in DWORD ErrorCode);
-
-/****************************************************************************************
-*
-*    ShowError_GetLastMsgId
-*
-*   
-*       
-*
-*    
-*           .
-*
-*          .
-*
-****************************************************************************************/
-
-DWORD ShowError_GetLastMsgId();
@@ -11,6 +11,7 @@
 #include <windows.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "TextMessages.h"
 #include "ShowError.h"
 #include "Song.h"
@@ -230,6 +231,8 @@ void SimpleStaveFast_SetStaveSize(
 void SimpleStaveFast_GlobalDraw(
 	__in HWND hwnd)
 {
+	TRACE_ZONE("SimpleStaveFast_GlobalDraw");
+
 	VIDEORESULT vr = Video_CheckScreenStatus();
 
 	if (vr == VIDEO_FAIL)
@@ -364,6 +367,8 @@ static void DeleteSurfaces()
 
 static bool DrawSurfaces()
 {
+	TRACE_ZONE("SimpleStaveFast DrawSurfaces");
+
 	if (!DrawBackground())
 	{
 		LOG("DrawBackground failed\n");
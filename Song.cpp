@@ -16,6 +16,7 @@
 #include <windows.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "Song.h"
 #include "MidiLibrary.h"
 #include "MidiTrack.h"
@@ -24,12 +25,76 @@
 #include "MidiSong.h"
 #include "MidiFile.h"
 
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//    ,       
+#define INITIAL_SINGING_EVENT_ARRAY_SIZE	256
+
+//        
+#define INITIAL_TEXT_BUFFER_SIZE			1024
+
+//   ,    
+#define INITIAL_MEASURE_ARRAY_SIZE			64
+
+//   ,    
+#define INITIAL_TEMPO_ARRAY_SIZE			8
+
+// ,      (    );
+//        MIDI-
+#define DEFAULT_BPM							120.0
+
+//      ,      ;
+//   ,       
+#define SECONDS_PER_WHOLE_NOTE_AT_1_BPM		240.0
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//   ;        ,  
+// ,    ,   ,  
+// ,     ,      
+// ;  ,     double,  ,  
+//  ,    
+struct SONGIMAGEHEADER
+{
+	DWORD cSingingEvents; //   
+	DWORD cchTexts; //       
+	DWORD cMeasures; //  
+	DWORD cTempos; //  
+};
+
 /****************************************************************************************
 *
 *    ,  
 *
 ****************************************************************************************/
 
+static bool GrowArray(
+	__inout void **ppArray,
+	__in DWORD cItems,
+	__in DWORD cbItem);
+
+static bool CopyArray(
+	__out void **ppDestArray,
+	__in const void *pSourceArray,
+	__in DWORD cItems,
+	__in DWORD cbItem);
+
+static ULONGLONG CalcImageSize(
+	__in const SONGIMAGEHEADER *pHeader);
+
+static PBYTE PutArray(
+	__out PBYTE pDest,
+	__in_opt const void *pSourceArray,
+	__in DWORD cbArray);
+
 static bool IsStartOfGeneralizedSyllable(
 	__in LPCWSTR pwsText,
 	__in DWORD cchText);
@@ -50,17 +115,31 @@ static bool IsStartOfGeneralizedSyllable(
 
 Song::Song()
 {
-	m_pFirstSingingEvent = NULL;
-	m_pLastSingingEvent = NULL;
-	m_pCurSingingEvent = NULL;
-
-	m_pFirstMeasure = NULL;
-	m_pLastMeasure = NULL;
-	m_pCurMeasure = NULL;
-
-	m_pFirstTempo = NULL;
-	m_pLastTempo = NULL;
-	m_pCurTempo = NULL;
+	m_pNoteNumbers = NULL;
+	m_pcuToNoteOns = NULL;
+	m_pcuNoteLengths = NULL;
+	m_piNoteTexts = NULL;
+	m_pcchNoteTexts = NULL;
+	m_cSingingEvents = 0;
+	m_cMaxSingingEvents = 0;
+	m_iCurSingingEvent = 0;
+
+	m_pwsTexts = NULL;
+	m_cchTexts = 0;
+	m_cchMaxTexts = 0;
+
+	m_pMeasures = NULL;
+	m_cMeasures = 0;
+	m_cMaxMeasures = 0;
+	m_iCurMeasure = 0;
+
+	m_pTempos = NULL;
+	m_cTempos = 0;
+	m_cMaxTempos = 0;
+	m_iCurTempo = 0;
+	m_iLastFoundTempo = 0;
+
+	m_pImageView = NULL;
 }
 
 /****************************************************************************************
@@ -99,9 +178,9 @@ Song::~Song()
 
 void Song::ResetCurrentPosition()
 {
-	m_pCurSingingEvent = m_pFirstSingingEvent;
-	m_pCurMeasure = m_pFirstMeasure;
-	m_pCurTempo = m_pFirstTempo;
+	m_iCurSingingEvent = 0;
+	m_iCurMeasure = 0;
+	m_iCurTempo = 0;
 }
 
 /****************************************************************************************
@@ -110,9 +189,9 @@ void Song::ResetCurrentPosition()
 *
 *   
 *       NoteNumber -  
-*       PauseLength -          
-*                     
-*       NoteLength -     
+*       cuToNoteOn -    (. WHOLE_NOTE_UNITS)   
+*                      
+*       cuNoteLength -     
 *		pwsNoteText -  ,   ,  
 *                       ,   ;    
 *                      NULL
@@ -122,67 +201,72 @@ void Song::ResetCurrentPosition()
 *       true,       ; false,   
 *        .
 *
-*       ,   NoteNumber, PauseLength,
-*   NoteLength, pwsNoteText  cchNoteText.
+*       ,   NoteNumber, cuToNoteOn,
+*   cuNoteLength, pwsNoteText  cchNoteText.     
+*       .
 *
 ****************************************************************************************/
 
 bool Song::AddSingingEvent(
 	__in DWORD NoteNumber,
-	__in double PauseLength,
-	__in double NoteLength,
+	__in DWORD cuToNoteOn,
+	__in DWORD cuNoteLength,
 	__in_opt LPCWSTR pwsNoteText,
 	__in DWORD cchNoteText)
 {
-	//        
-	SINGING_EVENT *pNewSingingEvent = new SINGING_EVENT;
-
-	if (pNewSingingEvent == NULL)
+	//   ,       
+	if (m_cSingingEvents == m_cMaxSingingEvents)
 	{
-		LOG("operator new failed\n");
-		return false;
-	}
-
-	//   ,        
-	LPWSTR pwsNewNoteText = NULL;
-
-	if (pwsNoteText != NULL && cchNoteText > 0)
-	{
-		//       
-		pwsNewNoteText = new WCHAR[cchNoteText];
+		//      
+		if (m_pImageView != NULL && !DetachFromImage())
+		{
+			LOG("Song::DetachFromImage failed\n");
+			return false;
+		}
 
-		if (pwsNewNoteText == NULL)
+		DWORD cNewMaxSingingEvents = (m_cMaxSingingEvents == 0) ?
+			INITIAL_SINGING_EVENT_ARRAY_SIZE : m_cMaxSingingEvents * 2;
+
+		//  -    ,    
+		//  ,  m_cMaxSingingEvents - 
+		if (!GrowArray((void **) &m_pNoteNumbers, cNewMaxSingingEvents, sizeof(DWORD)) ||
+			!GrowArray((void **) &m_pcuToNoteOns, cNewMaxSingingEvents,
+			sizeof(DWORD)) ||
+			!GrowArray((void **) &m_pcuNoteLengths, cNewMaxSingingEvents,
+			sizeof(DWORD)) ||
+			!GrowArray((void **) &m_piNoteTexts, cNewMaxSingingEvents, sizeof(DWORD)) ||
+			!GrowArray((void **) &m_pcchNoteTexts, cNewMaxSingingEvents, sizeof(DWORD)))
 		{
-			LOG("operator new failed\n");
-			delete pNewSingingEvent;
+			LOG("GrowArray failed\n");
 			return false;
 		}
 
-		//          
-		wcsncpy(pwsNewNoteText, pwsNoteText, cchNoteText);
+		m_cMaxSingingEvents = cNewMaxSingingEvents;
 	}
 
-	//      
-	pNewSingingEvent->NoteNumber = NoteNumber;
-	pNewSingingEvent->PauseLength = PauseLength;
-	pNewSingingEvent->NoteLength = NoteLength;
-	pNewSingingEvent->pwsNoteText = pwsNewNoteText;
-	pNewSingingEvent->cchNoteText = cchNoteText;
-	pNewSingingEvent->pNext = NULL;
+	//          m_pwsTexts
+	DWORD iNoteText = 0;
 
-	if (m_pFirstSingingEvent == NULL)
-	{
-		//         
-		m_pFirstSingingEvent = pNewSingingEvent;
-	}
-	else
+	if (pwsNoteText == NULL) cchNoteText = 0;
+
+	if (cchNoteText > 0)
 	{
-		//         
-		m_pLastSingingEvent->pNext = pNewSingingEvent;
+		//        
+		if (!AppendText(pwsNoteText, cchNoteText, &iNoteText))
+		{
+			LOG("Song::AppendText failed\n");
+			return false;
+		}
 	}
 
-	//      
-	m_pLastSingingEvent = pNewSingingEvent;
+	//    
+	m_pNoteNumbers[m_cSingingEvents] = NoteNumber;
+	m_pcuToNoteOns[m_cSingingEvents] = cuToNoteOn;
+	m_pcuNoteLengths[m_cSingingEvents] = cuNoteLength;
+	m_piNoteTexts[m_cSingingEvents] = iNoteText;
+	m_pcchNoteTexts[m_cSingingEvents] = cchNoteText;
+
+	m_cSingingEvents++;
 
 	return true;
 }
@@ -212,7 +296,8 @@ bool Song::AddSingingEvent(
 *
 *          .   
 *   ResetCurrentPosition         
-*   .
+*   .        ,   
+*   ;   ,    .
 *
 ****************************************************************************************/
 
@@ -224,20 +309,114 @@ bool Song::GetNextSingingEvent(
 	__out_opt DWORD *pcchNoteText)
 {
 	//    ,  false
-	if (m_pCurSingingEvent == NULL) return false;
+	if (m_iCurSingingEvent == m_cSingingEvents) return false;
+
+	if (pNoteNumber != NULL) *pNoteNumber = m_pNoteNumbers[m_iCurSingingEvent];
+	if (pPauseLength != NULL)
+	{
+		//          
+		double cuToPrevNoteOff = (m_iCurSingingEvent == 0) ? 0 :
+			(double) m_pcuToNoteOns[m_iCurSingingEvent - 1] +
+			m_pcuNoteLengths[m_iCurSingingEvent - 1];
+
+		*pPauseLength = ((double) m_pcuToNoteOns[m_iCurSingingEvent] -
+			cuToPrevNoteOff) / WHOLE_NOTE_UNITS;
+	}
+
+	if (pNoteLength != NULL)
+	{
+		*pNoteLength = (double) m_pcuNoteLengths[m_iCurSingingEvent] / WHOLE_NOTE_UNITS;
+	}
+
+	if (ppwsNoteText != NULL || pcchNoteText != NULL)
+	{
+		LPCWSTR pwsNoteText;
+		DWORD cchNoteText;
+
+		GetSingingEventText(m_iCurSingingEvent, &pwsNoteText, &cchNoteText);
 
-	if (pNoteNumber != NULL) *pNoteNumber = m_pCurSingingEvent->NoteNumber;
-	if (pPauseLength != NULL) *pPauseLength = m_pCurSingingEvent->PauseLength;
-	if (pNoteLength != NULL) *pNoteLength = m_pCurSingingEvent->NoteLength;
-	if (ppwsNoteText != NULL) *ppwsNoteText = m_pCurSingingEvent->pwsNoteText;
-	if (pcchNoteText != NULL) *pcchNoteText = m_pCurSingingEvent->cchNoteText;
+		if (ppwsNoteText != NULL) *ppwsNoteText = pwsNoteText;
+		if (pcchNoteText != NULL) *pcchNoteText = cchNoteText;
+	}
 
 	//     
-	m_pCurSingingEvent = m_pCurSingingEvent->pNext;
+	m_iCurSingingEvent++;
 
 	return true;
 }
 
+/****************************************************************************************
+*
+*    GetSingingEvents
+*
+*   
+*       ppNoteNumbers -   ,      
+*                         ;      NULL
+*       ppcuToNoteOns -   ,      
+*                           (. WHOLE_NOTE_UNITS)  
+*                          ;      NULL
+*       ppcuNoteLengths -   ,      
+*                              ;  
+*                            NULL
+*
+*    
+*           , ..     
+*        .
+*
+*         ,    
+*       .     GetNextSingingEvent,
+*             .  
+*   ,            
+*   -  .     
+*   GetSingingEventText.
+*
+****************************************************************************************/
+
+DWORD Song::GetSingingEvents(
+	__out_opt const DWORD **ppNoteNumbers,
+	__out_opt const DWORD **ppcuToNoteOns,
+	__out_opt const DWORD **ppcuNoteLengths)
+{
+	if (ppNoteNumbers != NULL) *ppNoteNumbers = m_pNoteNumbers;
+	if (ppcuToNoteOns != NULL) *ppcuToNoteOns = m_pcuToNoteOns;
+	if (ppcuNoteLengths != NULL) *ppcuNoteLengths = m_pcuNoteLengths;
+
+	return m_cSingingEvents;
+}
+
+/****************************************************************************************
+*
+*    GetSingingEventText
+*
+*   
+*       iSingingEvent -     ;    
+*                           ,  
+*                       GetSingingEvents
+*       ppwsNoteText -   ,      
+*                      ,   ,    
+*                      ,   ,  NULL,    
+*                       
+*       pcchNoteText -   ,     
+*                          ,   
+*
+*    
+*       
+*
+*         iSingingEvent.
+*
+****************************************************************************************/
+
+void Song::GetSingingEventText(
+	__in DWORD iSingingEvent,
+	__out LPCWSTR *ppwsNoteText,
+	__out DWORD *pcchNoteText)
+{
+	*pcchNoteText = m_pcchNoteTexts[iSingingEvent];
+
+	*ppwsNoteText = (*pcchNoteText == 0) ? NULL :
+		m_pwsTexts + m_piNoteTexts[iSingingEvent];
+}
+
 /****************************************************************************************
 *
 *    AddMeasure
@@ -258,33 +437,33 @@ bool Song::AddMeasure(
 	__in DWORD Numerator,
 	__in DWORD Denominator)
 {
-	//       
-	MEASURE *pNewMeasure = new MEASURE;
-
-	if (pNewMeasure == NULL)
+	//   ,       
+	if (m_cMeasures == m_cMaxMeasures)
 	{
-		LOG("operator new failed\n");
-		return false;
-	}
+		//      
+		if (m_pImageView != NULL && !DetachFromImage())
+		{
+			LOG("Song::DetachFromImage failed\n");
+			return false;
+		}
 
-	//     
-	pNewMeasure->Numerator = Numerator;
-	pNewMeasure->Denominator = Denominator;
-	pNewMeasure->pNext = NULL;
+		DWORD cNewMaxMeasures = (m_cMaxMeasures == 0) ?
+			INITIAL_MEASURE_ARRAY_SIZE : m_cMaxMeasures * 2;
 
-	if (m_pFirstMeasure == NULL)
-	{
-		//        
-		m_pFirstMeasure = pNewMeasure;
-	}
-	else
-	{
-		//        
-		m_pLastMeasure->pNext = pNewMeasure;
+		if (!GrowArray((void **) &m_pMeasures, cNewMaxMeasures, sizeof(MEASURE)))
+		{
+			LOG("GrowArray failed\n");
+			return false;
+		}
+
+		m_cMaxMeasures = cNewMaxMeasures;
 	}
 
-	//      
-	m_pLastMeasure = pNewMeasure;
+	//   
+	m_pMeasures[m_cMeasures].Numerator = Numerator;
+	m_pMeasures[m_cMeasures].Denominator = Denominator;
+
+	m_cMeasures++;
 
 	return true;
 }
@@ -314,13 +493,13 @@ bool Song::GetNextMeasure(
 	__out DWORD *pDenominator)
 {
 	//   ,  false
-	if (m_pCurMeasure == NULL) return false;
+	if (m_iCurMeasure == m_cMeasures) return false;
 
-	*pNumerator = m_pCurMeasure->Numerator;
-	*pDenominator = m_pCurMeasure->Denominator;
+	*pNumerator = m_pMeasures[m_iCurMeasure].Numerator;
+	*pDenominator = m_pMeasures[m_iCurMeasure].Denominator;
 
 	//    
-	m_pCurMeasure = m_pCurMeasure->pNext;
+	m_iCurMeasure++;
 
 	return true;
 }
@@ -336,7 +515,15 @@ bool Song::GetNextMeasure(
 *    
 *       true,    ; false,     .
 *
-*    ,   Offset  BPM,   .
+*    ,   Offset  BPM,   .  
+*        Offset.
+*
+*   
+*
+*              
+*    (..      ). 
+*     SecondsToWholeNotes      ,
+*         .
 *
 ****************************************************************************************/
 
@@ -344,33 +531,48 @@ bool Song::AddTempo(
 	__in double Offset,
 	__in double BPM)
 {
-	//       
-	TEMPO *pNewTempo = new TEMPO;
-
-	if (pNewTempo == NULL)
+	//   ,       
+	if (m_cTempos == m_cMaxTempos)
 	{
-		LOG("operator new failed\n");
-		return false;
+		//      
+		if (m_pImageView != NULL && !DetachFromImage())
+		{
+			LOG("Song::DetachFromImage failed\n");
+			return false;
+		}
+
+		DWORD cNewMaxTempos = (m_cMaxTempos == 0) ?
+			INITIAL_TEMPO_ARRAY_SIZE : m_cMaxTempos * 2;
+
+		if (!GrowArray((void **) &m_pTempos, cNewMaxTempos, sizeof(TEMPO)))
+		{
+			LOG("GrowArray failed\n");
+			return false;
+		}
+
+		m_cMaxTempos = cNewMaxTempos;
 	}
 
-	//     
-	pNewTempo->Offset = Offset;
-	pNewTempo->BPM = BPM;
-	pNewTempo->pNext = NULL;
+	//   
+	m_pTempos[m_cTempos].Offset = Offset;
+	m_pTempos[m_cTempos].BPM = BPM;
 
-	if (m_pFirstTempo == NULL)
+	//       :    
+	//   ,   -  
+	if (m_cTempos == 0)
 	{
-		//        
-		m_pFirstTempo = pNewTempo;
+		m_pTempos[m_cTempos].Seconds = Offset * SECONDS_PER_WHOLE_NOTE_AT_1_BPM /
+			DEFAULT_BPM;
 	}
 	else
 	{
-		//        
-		m_pLastTempo->pNext = pNewTempo;
+		TEMPO *pPrevTempo = &m_pTempos[m_cTempos - 1];
+
+		m_pTempos[m_cTempos].Seconds = pPrevTempo->Seconds + (Offset -
+			pPrevTempo->Offset) * SECONDS_PER_WHOLE_NOTE_AT_1_BPM / pPrevTempo->BPM;
 	}
 
-	//      
-	m_pLastTempo = pNewTempo;
+	m_cTempos++;
 
 	return true;
 }
@@ -399,84 +601,101 @@ bool Song::GetNextTempo(
 	__out double *pBPM)
 {
 	//   ,  false
-	if (m_pCurTempo == NULL) return false;
+	if (m_iCurTempo == m_cTempos) return false;
 
-	*pOffset = m_pCurTempo->Offset;
-	*pBPM = m_pCurTempo->BPM;
+	*pOffset = m_pTempos[m_iCurTempo].Offset;
+	*pBPM = m_pTempos[m_iCurTempo].BPM;
 
 	//    
-	m_pCurTempo = m_pCurTempo->pNext;
+	m_iCurTempo++;
 
 	return true;
 }
 
+/****************************************************************************************
+*
+*    SecondsToWholeNotes
+*
+*   
+*       Seconds -   :     
+*
+*    
+*               .
+*
+*               . 
+*      O(log n),  n -  ,    
+*       (,  ),   
+*     O(1).
+*
+****************************************************************************************/
+
+double Song::SecondsToWholeNotes(
+	__in double Seconds)
+{
+	//      ,     
+	if (m_cTempos == 0 || Seconds < m_pTempos[0].Seconds)
+	{
+		return Seconds * DEFAULT_BPM / SECONDS_PER_WHOLE_NOTE_AT_1_BPM;
+	}
+
+	TEMPO *pTempo = &m_pTempos[FindTempo(Seconds)];
+
+	return pTempo->Offset + (Seconds - pTempo->Seconds) * pTempo->BPM /
+		SECONDS_PER_WHOLE_NOTE_AT_1_BPM;
+}
+
 /****************************************************************************************
 *
 *    Quantize
 *
 *   
 *       StepDenominator -  ,    ,
-*                             
+*                             ; WHOLE_NOTE_UNITS
+*                             
 *
 *    
 *       true,           
 *       ;  false.
 *
-*      .
+*      :         
+*    ,   .
+*
+*   
+*
+*         ,     
+*      .       
+*   ,       .
 *
 ****************************************************************************************/
 
 bool Song::Quantize(
 	__in DWORD StepDenominator)
 {
-	// ,         
-	bool bNoEmptyNotes = true;
+	TRACE_ZONE("Song::Quantize");
 
-	//   
-	double Step = (double) 1 / StepDenominator;
+	//      
+	DWORD cuStep = WHOLE_NOTE_UNITS / StepDenominator;
 
-	//       
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
-
-	//            
-	double CurOffset = 0;
-
-	//           
-	double cwnToPrevQuantizedNoteOff = 0;
+	//      
+	DWORD cEmptyNotes = 0;
 
 	//    ;  
-	while (true)
+	for (DWORD i = 0; i < m_cSingingEvents; i++)
 	{
-		//     ,    
-		if (pCurSingingEvent == NULL) break;
+		DWORD cuToNoteOn = m_pcuToNoteOns[i];
+		DWORD cuToNoteOff = cuToNoteOn + m_pcuNoteLengths[i];
 
-		//          
-		CurOffset += pCurSingingEvent->PauseLength;
+		//        
+		DWORD cuToQuantizedNoteOn = cuToNoteOn - cuToNoteOn % cuStep;
+		DWORD cuToQuantizedNoteOff = cuToNoteOff - cuToNoteOff % cuStep;
 
-		//           
-		double cwnToQuantizedNoteOn = Step * (int) (CurOffset / Step);
+		m_pcuToNoteOns[i] = cuToQuantizedNoteOn;
+		m_pcuNoteLengths[i] = cuToQuantizedNoteOff - cuToQuantizedNoteOn;
 
-		//          
-		CurOffset += pCurSingingEvent->NoteLength;
-
-		//           
-		double cwnToQuantizedNoteOff = Step * (int) (CurOffset / Step);
-
-		//   
-		pCurSingingEvent->PauseLength = cwnToQuantizedNoteOn - cwnToPrevQuantizedNoteOff;
-		pCurSingingEvent->NoteLength = cwnToQuantizedNoteOff - cwnToQuantizedNoteOn;
-
-		//      ,  
-		if (pCurSingingEvent->NoteLength == 0) bNoEmptyNotes = false;
-
-		//    
-		cwnToPrevQuantizedNoteOff = cwnToQuantizedNoteOff;
-
-		//     
-		pCurSingingEvent = pCurSingingEvent->pNext;
+		cEmptyNotes += (cuToQuantizedNoteOff == cuToQuantizedNoteOn);
 	}
 
-	return bNoEmptyNotes;
+	return cEmptyNotes == 0;
 }
 
 /****************************************************************************************
@@ -486,7 +705,8 @@ bool Song::Quantize(
 *   
 *       LengthDenominator -  ,    ,
 *                                 
-*                           
+*                           ; WHOLE_NOTE_UNITS    
+*                           
 *
 *    
 *       true,         ;  false.
@@ -496,62 +716,48 @@ bool Song::Quantize(
 *   1/LengthDenominator,      1/LengthDenominator,  
 *         1/LengthDenominator.
 *
+*   
+*
+*       -        
+*     ,        .
+*               
+*   ,   ,       .
+*
 ****************************************************************************************/
 
 bool Song::ExtendEmptyNotes(
 	__in DWORD LengthDenominator)
 {
-	// ,         
-	bool bNoEmptyNotes = true;
+	TRACE_ZONE("Song::ExtendEmptyNotes");
 
-	//      
-	double Length = (double) 1 / LengthDenominator;
+	if (m_cSingingEvents == 0) return true;
 
-	//       
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+	//         
+	DWORD cuLength = WHOLE_NOTE_UNITS / LengthDenominator;
 
-	//    ;     
-	while (true)
-	{
-		//     ,    
-		if (pCurSingingEvent == NULL) break;
+	//     ,    
+	DWORD cEmptyNotes = 0;
 
-		//       
-		SINGING_EVENT *pNextSingingEvent = pCurSingingEvent->pNext;
+	DWORD iLast = m_cSingingEvents - 1;
 
-		if (pCurSingingEvent->NoteLength == 0)
-		{
-			//    - 
+	//     ,  ;    
+	// ,       
+	for (DWORD i = 0; i < iLast; i++)
+	{
+		bool bIsEmpty = (m_pcuNoteLengths[i] == 0);
 
-			if (pNextSingingEvent == NULL)
-			{
-				//   -   ,    
-				pCurSingingEvent->NoteLength = Length;
-			}
-			else
-			{
-				//   -    
-
-				if (pNextSingingEvent->PauseLength < Length)
-				{
-					//    
-					bNoEmptyNotes = false;
-				}
-				else
-				{
-					//        Length,
-					//       
-					pNextSingingEvent->PauseLength -= Length;
-					pCurSingingEvent->NoteLength = Length;
-				}
-			}
-		}
+		bool bHasRoom = ((LONG) (m_pcuToNoteOns[i + 1] - m_pcuToNoteOns[i]) >=
+			(LONG) cuLength);
 
-		//     
-		pCurSingingEvent = pNextSingingEvent;
+		m_pcuNoteLengths[i] += (bIsEmpty && bHasRoom) ? cuLength : 0;
+
+		cEmptyNotes += (bIsEmpty && !bHasRoom);
 	}
 
-	return bNoEmptyNotes;
+	//       
+	if (m_pcuNoteLengths[iLast] == 0) m_pcuNoteLengths[iLast] = cuLength;
+
+	return cEmptyNotes == 0;
 }
 
 /****************************************************************************************
@@ -575,12 +781,10 @@ bool Song::ExtendEmptyNotes(
 
 bool Song::HyphenateLyric()
 {
-	//       
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+	TRACE_ZONE("Song::HyphenateLyric");
 
-	//      ,    ;
-	//     NULL,    
-	SINGING_EVENT *pBookmarkedSingingEvent = NULL;
+	//    
+	DWORD iCurSingingEvent = 0;
 
 	// ,       ,   
 	// ;       
@@ -599,20 +803,19 @@ bool Song::HyphenateLyric()
 	while (true)
 	{
 		//     ,  
-		if (pCurSingingEvent == NULL) return true;
+		if (iCurSingingEvent == m_cSingingEvents) return true;
 
-		pwsNoteText = pCurSingingEvent->pwsNoteText;
-		cchNoteText = pCurSingingEvent->cchNoteText;
+		GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 
 		//      ,    
 		if (pwsNoteText != NULL) break;
 
 		//     
-		pCurSingingEvent = pCurSingingEvent->pNext;
+		iCurSingingEvent++;
 	}
 
 	//        
-	pBookmarkedSingingEvent = pCurSingingEvent;
+	DWORD iBookmarkedSingingEvent = iCurSingingEvent;
 
 	//    ,    
 	wcsncpy(pwsBookmarkedText, pwsNoteText, cchNoteText);
@@ -622,13 +825,12 @@ bool Song::HyphenateLyric()
 	while (true)
 	{
 		//     
-		pCurSingingEvent = pCurSingingEvent->pNext;
+		iCurSingingEvent++;
 
 		//     ,  
-		if (pCurSingingEvent == NULL) return true;
+		if (iCurSingingEvent == m_cSingingEvents) return true;
 
-		pwsNoteText = pCurSingingEvent->pwsNoteText;
-		cchNoteText = pCurSingingEvent->cchNoteText;
+		GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 
 		//     
 		if (pwsNoteText == NULL) continue;
@@ -642,15 +844,19 @@ bool Song::HyphenateLyric()
 			pwsBookmarkedText[cchBookmarkedText++] = L'-';
 
 			//    ,    
-			if (!SetText(pBookmarkedSingingEvent, pwsBookmarkedText, cchBookmarkedText))
+			if (!SetText(iBookmarkedSingingEvent, pwsBookmarkedText, cchBookmarkedText))
 			{
 				LOG("Song::SetText failed\n");
 				return false;
 			}
+
+			// SetText    ,    
+			//     
+			GetSingingEventText(iCurSingingEvent, &pwsNoteText, &cchNoteText);
 		}
 
 		//        
-		pBookmarkedSingingEvent = pCurSingingEvent;
+		iBookmarkedSingingEvent = iCurSingingEvent;
 
 		//    ,    
 		wcsncpy(pwsBookmarkedText, pwsNoteText, cchNoteText);
@@ -660,67 +866,377 @@ bool Song::HyphenateLyric()
 
 /****************************************************************************************
 *
-*    Free
+*    Duplicate
 *
 *   
 *       
 *
 *    
+*            Song,  NULL,    
+*       .
+*
+*      Song,   ,    
+*     .       . 
+*       ,     
+*      MIDI-;  ,    
+*           .
+*
+****************************************************************************************/
+
+Song *Song::Duplicate()
+{
+	//    Song
+	Song *pCopy = new Song;
+
+	if (pCopy == NULL)
+	{
+		LOG("operator new failed\n");
+		return NULL;
+	}
+
+	//        ,    
+	// 
+	if (!CopyArray((void **) &pCopy->m_pNoteNumbers, m_pNoteNumbers, m_cSingingEvents,
+		sizeof(DWORD)) ||
+		!CopyArray((void **) &pCopy->m_pcuToNoteOns, m_pcuToNoteOns, m_cSingingEvents,
+		sizeof(DWORD)) ||
+		!CopyArray((void **) &pCopy->m_pcuNoteLengths, m_pcuNoteLengths,
+		m_cSingingEvents, sizeof(DWORD)) ||
+		!CopyArray((void **) &pCopy->m_piNoteTexts, m_piNoteTexts, m_cSingingEvents,
+		sizeof(DWORD)) ||
+		!CopyArray((void **) &pCopy->m_pcchNoteTexts, m_pcchNoteTexts, m_cSingingEvents,
+		sizeof(DWORD)) ||
+		!CopyArray((void **) &pCopy->m_pwsTexts, m_pwsTexts, m_cchTexts,
+		sizeof(WCHAR)) ||
+		!CopyArray((void **) &pCopy->m_pMeasures, m_pMeasures, m_cMeasures,
+		sizeof(MEASURE)) ||
+		!CopyArray((void **) &pCopy->m_pTempos, m_pTempos, m_cTempos, sizeof(TEMPO)))
+	{
+		LOG("CopyArray failed\n");
+		delete pCopy;
+		return NULL;
+	}
+
+	pCopy->m_cSingingEvents = m_cSingingEvents;
+	pCopy->m_cMaxSingingEvents = m_cSingingEvents;
+
+	pCopy->m_cchTexts = m_cchTexts;
+	pCopy->m_cchMaxTexts = m_cchTexts;
+
+	pCopy->m_cMeasures = m_cMeasures;
+	pCopy->m_cMaxMeasures = m_cMeasures;
+
+	pCopy->m_cTempos = m_cTempos;
+	pCopy->m_cMaxTempos = m_cTempos;
+
+	return pCopy;
+}
+
+/****************************************************************************************
+*
+*    GetImageSize
+*
+*   
 *       
 *
-*      .
+*    
+*           .
+*
+*      ,    WriteImage.
 *
 ****************************************************************************************/
 
-void Song::Free()
+DWORD Song::GetImageSize()
+{
+	SONGIMAGEHEADER Header;
+
+	Header.cSingingEvents = m_cSingingEvents;
+	Header.cchTexts = m_cchTexts;
+	Header.cMeasures = m_cMeasures;
+	Header.cTempos = m_cTempos;
+
+	return (DWORD) CalcImageSize(&Header);
+}
+
+/****************************************************************************************
+*
+*    GetMemorySize
+*
+*   
+*       
+*
+*    
+*          .
+*
+*     ,      , 
+*      .      , 
+*       ,    .
+*
+****************************************************************************************/
+
+DWORD Song::GetMemorySize()
+{
+	return sizeof(Song) +
+		m_cMaxSingingEvents * 5 * sizeof(DWORD) +
+		m_cchMaxTexts * sizeof(WCHAR) +
+		m_cMaxMeasures * sizeof(MEASURE) +
+		m_cMaxTempos * sizeof(TEMPO);
+}
+
+/****************************************************************************************
+*
+*    WriteImage
+*
+*   
+*       pImage -   ,      ;  
+*                    ,    GetImageSize;
+*                      8 
+*
+*    
+*       
+*
+*     , .. ,        
+*   ,      .     
+*      ,    (.  AttachToImage). 
+*       .
+*
+****************************************************************************************/
+
+void Song::WriteImage(
+	__out PBYTE pImage)
 {
-	//    
+	SONGIMAGEHEADER *pHeader = (SONGIMAGEHEADER *) pImage;
+
+	pHeader->cSingingEvents = m_cSingingEvents;
+	pHeader->cchTexts = m_cchTexts;
+	pHeader->cMeasures = m_cMeasures;
+	pHeader->cTempos = m_cTempos;
+
+	PBYTE pCurByte = pImage + sizeof(SONGIMAGEHEADER);
+
+	pCurByte = PutArray(pCurByte, m_pTempos, m_cTempos * sizeof(TEMPO));
+	pCurByte = PutArray(pCurByte, m_pNoteNumbers, m_cSingingEvents * sizeof(DWORD));
+	pCurByte = PutArray(pCurByte, m_pcuToNoteOns, m_cSingingEvents * sizeof(DWORD));
+	pCurByte = PutArray(pCurByte, m_pcuNoteLengths, m_cSingingEvents * sizeof(DWORD));
+	pCurByte = PutArray(pCurByte, m_piNoteTexts, m_cSingingEvents * sizeof(DWORD));
+	pCurByte = PutArray(pCurByte, m_pcchNoteTexts, m_cSingingEvents * sizeof(DWORD));
+	pCurByte = PutArray(pCurByte, m_pMeasures, m_cMeasures * sizeof(MEASURE));
+	PutArray(pCurByte, m_pwsTexts, m_cchTexts * sizeof(WCHAR));
+}
 
-	SINGING_EVENT *pCurSingingEvent = m_pFirstSingingEvent;
+/****************************************************************************************
+*
+*    AttachToImage
+*
+*   
+*       pImage -    ,   WriteImage;  
+*                    8 
+*       cbImage -     
+*       pImageView -    ,     ;
+*                        (,   
+*                     FILE_MAP_COPY)
+*
+*    
+*       true,       ; false,  
+*        (     ,   
+*         ,         
+*        ).
+*
+*       :  ,     
+*      ,    .     
+*          Free;    
+*    ,     .
+*
+*   
+*
+*   ,    ,     ,   
+*   . ,    ,     
+*     DetachFromImage.
+*
+****************************************************************************************/
 
-	while (pCurSingingEvent != NULL)
+bool Song::AttachToImage(
+	__in PBYTE pImage,
+	__in DWORD cbImage,
+	__in PVOID pImageView)
+{
+	if (cbImage < sizeof(SONGIMAGEHEADER))
 	{
-		SINGING_EVENT *pDelSingingEvent = pCurSingingEvent;
-		pCurSingingEvent = pCurSingingEvent->pNext;
+		LOG("song image is too small\n");
+		return false;
+	}
 
-		if (pDelSingingEvent->pwsNoteText != NULL) delete pDelSingingEvent->pwsNoteText;
+	SONGIMAGEHEADER *pHeader = (SONGIMAGEHEADER *) pImage;
 
-		delete pDelSingingEvent;
+	if (CalcImageSize(pHeader) != cbImage)
+	{
+		LOG("invalid song image size\n");
+		return false;
 	}
 
-	m_pFirstSingingEvent = NULL;
-	m_pLastSingingEvent = NULL;
-	m_pCurSingingEvent = NULL;
+	PBYTE pCurByte = pImage + sizeof(SONGIMAGEHEADER);
+
+	TEMPO *pTempos = (TEMPO *) pCurByte;
+	pCurByte += pHeader->cTempos * sizeof(TEMPO);
+
+	DWORD *pNoteNumbers = (DWORD *) pCurByte;
+	pCurByte += pHeader->cSingingEvents * sizeof(DWORD);
+
+	DWORD *pcuToNoteOns = (DWORD *) pCurByte;
+	pCurByte += pHeader->cSingingEvents * sizeof(DWORD);
 
-	//   
+	DWORD *pcuNoteLengths = (DWORD *) pCurByte;
+	pCurByte += pHeader->cSingingEvents * sizeof(DWORD);
 
-	MEASURE *pCurMeasure = m_pFirstMeasure;
+	DWORD *piNoteTexts = (DWORD *) pCurByte;
+	pCurByte += pHeader->cSingingEvents * sizeof(DWORD);
 
-	while (pCurMeasure != NULL)
+	DWORD *pcchNoteTexts = (DWORD *) pCurByte;
+	pCurByte += pHeader->cSingingEvents * sizeof(DWORD);
+
+	MEASURE *pMeasures = (MEASURE *) pCurByte;
+	pCurByte += pHeader->cMeasures * sizeof(MEASURE);
+
+	WCHAR *pwsTexts = (WCHAR *) pCurByte;
+
+	// ,          
+	for (DWORD i = 0; i < pHeader->cSingingEvents; i++)
 	{
-		MEASURE *pDelMeasure = pCurMeasure;
-		pCurMeasure = pCurMeasure->pNext;
-		delete pDelMeasure;
+		if (pcchNoteTexts[i] > pHeader->cchTexts ||
+			piNoteTexts[i] > pHeader->cchTexts - pcchNoteTexts[i])
+		{
+			LOG("invalid text of singing event\n");
+			return false;
+		}
 	}
 
-	m_pFirstMeasure = NULL;
-	m_pLastMeasure = NULL;
-	m_pCurMeasure = NULL;
+	//   :      
+	for (DWORD i = 0; i < pHeader->cMeasures; i++)
+	{
+		if (pMeasures[i].Numerator == 0 || pMeasures[i].Denominator == 0)
+		{
+			LOG("invalid measure in song image\n");
+			return false;
+		}
+	}
+
+	//   :       ;
+	//   ,   NaN   
+	for (DWORD i = 0; i < pHeader->cTempos; i++)
+	{
+		if (!(pTempos[i].BPM > 0.0) || !(pTempos[i].Offset >= 0.0) ||
+			!(pTempos[i].Seconds >= 0.0) ||
+			(i > 0 && (!(pTempos[i].Offset >= pTempos[i - 1].Offset) ||
+			!(pTempos[i].Seconds >= pTempos[i - 1].Seconds))))
+		{
+			LOG("invalid tempo in song image\n");
+			return false;
+		}
+	}
+
+	//    
+	Free();
+
+	m_pNoteNumbers = pNoteNumbers;
+	m_pcuToNoteOns = pcuToNoteOns;
+	m_pcuNoteLengths = pcuNoteLengths;
+	m_piNoteTexts = piNoteTexts;
+	m_pcchNoteTexts = pcchNoteTexts;
+	m_cSingingEvents = pHeader->cSingingEvents;
+	m_cMaxSingingEvents = pHeader->cSingingEvents;
+
+	m_pwsTexts = pwsTexts;
+	m_cchTexts = pHeader->cchTexts;
+	m_cchMaxTexts = pHeader->cchTexts;
 
-	//   
+	m_pMeasures = pMeasures;
+	m_cMeasures = pHeader->cMeasures;
+	m_cMaxMeasures = pHeader->cMeasures;
 
-	TEMPO *pCurTempo = m_pFirstTempo;
+	m_pTempos = pTempos;
+	m_cTempos = pHeader->cTempos;
+	m_cMaxTempos = pHeader->cTempos;
 
-	while (pCurTempo != NULL)
+	m_pImageView = pImageView;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    Free
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .
+*
+****************************************************************************************/
+
+void Song::Free()
+{
+	//       ,    
+	if (m_pImageView != NULL)
 	{
-		TEMPO *pDelTempo = pCurTempo;
-		pCurTempo = pCurTempo->pNext;
-		delete pDelTempo;
+		UnmapViewOfFile(m_pImageView);
+		m_pImageView = NULL;
+
+		m_pNoteNumbers = NULL;
+		m_pcuToNoteOns = NULL;
+		m_pcuNoteLengths = NULL;
+		m_piNoteTexts = NULL;
+		m_pcchNoteTexts = NULL;
+		m_pwsTexts = NULL;
+		m_pMeasures = NULL;
+		m_pTempos = NULL;
 	}
 
-	m_pFirstTempo = NULL;
-	m_pLastTempo = NULL;
-	m_pCurTempo = NULL;
+	//   
+
+	if (m_pNoteNumbers != NULL) HeapFree(GetProcessHeap(), 0, m_pNoteNumbers);
+	if (m_pcuToNoteOns != NULL) HeapFree(GetProcessHeap(), 0, m_pcuToNoteOns);
+	if (m_pcuNoteLengths != NULL) HeapFree(GetProcessHeap(), 0, m_pcuNoteLengths);
+	if (m_piNoteTexts != NULL) HeapFree(GetProcessHeap(), 0, m_piNoteTexts);
+	if (m_pcchNoteTexts != NULL) HeapFree(GetProcessHeap(), 0, m_pcchNoteTexts);
+
+	m_pNoteNumbers = NULL;
+	m_pcuToNoteOns = NULL;
+	m_pcuNoteLengths = NULL;
+	m_piNoteTexts = NULL;
+	m_pcchNoteTexts = NULL;
+	m_cSingingEvents = 0;
+	m_cMaxSingingEvents = 0;
+	m_iCurSingingEvent = 0;
+
+	//     
+
+	if (m_pwsTexts != NULL) HeapFree(GetProcessHeap(), 0, m_pwsTexts);
+
+	m_pwsTexts = NULL;
+	m_cchTexts = 0;
+	m_cchMaxTexts = 0;
+
+	//   
+
+	if (m_pMeasures != NULL) HeapFree(GetProcessHeap(), 0, m_pMeasures);
+
+	m_pMeasures = NULL;
+	m_cMeasures = 0;
+	m_cMaxMeasures = 0;
+	m_iCurMeasure = 0;
+
+	//   
+
+	if (m_pTempos != NULL) HeapFree(GetProcessHeap(), 0, m_pTempos);
+
+	m_pTempos = NULL;
+	m_cTempos = 0;
+	m_cMaxTempos = 0;
+	m_iCurTempo = 0;
+	m_iLastFoundTempo = 0;
 }
 
 /****************************************************************************************
@@ -728,53 +1244,320 @@ void Song::Free()
 *    SetText
 *
 *   
-*       pSingingEvent -      
+*       iSingingEvent -     
 *		pwsNoteText -  ,   ,  
 *                       ,   ;    
-*                      NULL
+*                      NULL;       m_pwsTexts
 *       cchNoteText -     pwsNoteText
 *
 *    
 *       true,       ; false,  
 *         .
 *
-*       ,   pSingingEvent.
+*          iSingingEvent.  
+*      ,      ,   
+*      m_pwsTexts,        
+*    Free.           ,
+*           
+*   .
 *
 ****************************************************************************************/
 
 bool Song::SetText(
-	__inout SINGING_EVENT *pSingingEvent,
+	__in DWORD iSingingEvent,
 	__in_opt LPCWSTR pwsNoteText,
 	__in DWORD cchNoteText)
 {
-	//   ,        
-	LPWSTR pwsNewNoteText = NULL;
+	if (pwsNoteText == NULL) cchNoteText = 0;
 
-	if (pwsNoteText != NULL && cchNoteText > 0)
+	if (cchNoteText > m_pcchNoteTexts[iSingingEvent])
 	{
-		//       
-		pwsNewNoteText = new WCHAR[cchNoteText];
+		//       
+		if (!AppendText(pwsNoteText, cchNoteText, &m_piNoteTexts[iSingingEvent]))
+		{
+			LOG("Song::AppendText failed\n");
+			return false;
+		}
+	}
+	else if (cchNoteText > 0)
+	{
+		//      
+		wcsncpy(m_pwsTexts + m_piNoteTexts[iSingingEvent], pwsNoteText, cchNoteText);
+	}
 
-		if (pwsNewNoteText == NULL)
+	m_pcchNoteTexts[iSingingEvent] = cchNoteText;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    AppendText
+*
+*   
+*       pwsText -  ,   ;    
+*                   m_pwsTexts
+*       cchText -     pwsText
+*       piText -   ,       
+*                    m_pwsTexts
+*
+*    
+*       true,    ; false,     .
+*
+*        m_pwsTexts,    .
+*
+****************************************************************************************/
+
+bool Song::AppendText(
+	__in LPCWSTR pwsText,
+	__in DWORD cchText,
+	__out DWORD *piText)
+{
+	//  ,        
+	if (m_cchTexts + cchText > m_cchMaxTexts)
+	{
+		//      
+		if (m_pImageView != NULL && !DetachFromImage())
 		{
-			LOG("operator new failed\n");
+			LOG("Song::DetachFromImage failed\n");
 			return false;
 		}
 
-		//          
-		wcsncpy(pwsNewNoteText, pwsNoteText, cchNoteText);
+		DWORD cchNewMaxTexts = (m_cchMaxTexts == 0) ?
+			INITIAL_TEXT_BUFFER_SIZE : m_cchMaxTexts * 2;
+
+		while (m_cchTexts + cchText > cchNewMaxTexts) cchNewMaxTexts *= 2;
+
+		if (!GrowArray((void **) &m_pwsTexts, cchNewMaxTexts, sizeof(WCHAR)))
+		{
+			LOG("GrowArray failed\n");
+			return false;
+		}
+
+		m_cchMaxTexts = cchNewMaxTexts;
 	}
 
-	//     
-	if (pSingingEvent->pwsNoteText != NULL) delete pSingingEvent->pwsNoteText;
+	wcsncpy(m_pwsTexts + m_cchTexts, pwsText, cchText);
 
-	//      
-	pSingingEvent->pwsNoteText = pwsNewNoteText;
-	pSingingEvent->cchNoteText = cchNoteText;
+	*piText = m_cchTexts;
+	m_cchTexts += cchText;
 
 	return true;
 }
 
+/****************************************************************************************
+*
+*    DetachFromImage
+*
+*   
+*       
+*
+*    
+*       true,       ; false,   
+*        .
+*
+*             . 
+*    .        
+*      .
+*
+****************************************************************************************/
+
+bool Song::DetachFromImage()
+{
+	//     
+	Song *pCopy = Duplicate();
+
+	if (pCopy == NULL)
+	{
+		LOG("Song::Duplicate failed\n");
+		return false;
+	}
+
+	//   ,    Free
+	DWORD iCurSingingEvent = m_iCurSingingEvent;
+	DWORD iCurMeasure = m_iCurMeasure;
+	DWORD iCurTempo = m_iCurTempo;
+
+	//   
+	Free();
+
+	//    
+	m_pNoteNumbers = pCopy->m_pNoteNumbers;
+	m_pcuToNoteOns = pCopy->m_pcuToNoteOns;
+	m_pcuNoteLengths = pCopy->m_pcuNoteLengths;
+	m_piNoteTexts = pCopy->m_piNoteTexts;
+	m_pcchNoteTexts = pCopy->m_pcchNoteTexts;
+	m_cSingingEvents = pCopy->m_cSingingEvents;
+	m_cMaxSingingEvents = pCopy->m_cMaxSingingEvents;
+	m_iCurSingingEvent = iCurSingingEvent;
+
+	m_pwsTexts = pCopy->m_pwsTexts;
+	m_cchTexts = pCopy->m_cchTexts;
+	m_cchMaxTexts = pCopy->m_cchMaxTexts;
+
+	m_pMeasures = pCopy->m_pMeasures;
+	m_cMeasures = pCopy->m_cMeasures;
+	m_cMaxMeasures = pCopy->m_cMaxMeasures;
+	m_iCurMeasure = iCurMeasure;
+
+	m_pTempos = pCopy->m_pTempos;
+	m_cTempos = pCopy->m_cTempos;
+	m_cMaxTempos = pCopy->m_cMaxTempos;
+	m_iCurTempo = iCurTempo;
+
+	//     ,      
+	pCopy->m_pNoteNumbers = NULL;
+	pCopy->m_pcuToNoteOns = NULL;
+	pCopy->m_pcuNoteLengths = NULL;
+	pCopy->m_piNoteTexts = NULL;
+	pCopy->m_pcchNoteTexts = NULL;
+	pCopy->m_pwsTexts = NULL;
+	pCopy->m_pMeasures = NULL;
+	pCopy->m_pTempos = NULL;
+
+	delete pCopy;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    GrowArray
+*
+*   
+*       ppArray -   ,      ; 
+*                    ,      NULL
+*       cItems -     
+*       cbItem -     
+*
+*    
+*       true,    ; false,     .
+*
+*      cItems        cItems
+*   ,   .     ,  
+*    .
+*
+****************************************************************************************/
+
+static bool GrowArray(
+	__inout void **ppArray,
+	__in DWORD cItems,
+	__in DWORD cbItem)
+{
+	void *pNewArray;
+
+	if (*ppArray == NULL)
+	{
+		pNewArray = HeapAlloc(GetProcessHeap(), 0, cItems * cbItem);
+	}
+	else
+	{
+		pNewArray = HeapReAlloc(GetProcessHeap(), 0, *ppArray, cItems * cbItem);
+	}
+
+	if (pNewArray == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		return false;
+	}
+
+	*ppArray = pNewArray;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    CopyArray
+*
+*   
+*       ppDestArray -   ,      
+*                      ;   ,   NULL
+*       pSourceArray -    
+*       cItems -     
+*       cbItem -     
+*
+*    
+*       true,    ; false,     .
+*
+*             pSourceArray.
+*
+****************************************************************************************/
+
+static bool CopyArray(
+	__out void **ppDestArray,
+	__in const void *pSourceArray,
+	__in DWORD cItems,
+	__in DWORD cbItem)
+{
+	*ppDestArray = NULL;
+
+	if (cItems == 0) return true;
+
+	if (!GrowArray(ppDestArray, cItems, cbItem))
+	{
+		LOG("GrowArray failed\n");
+		return false;
+	}
+
+	CopyMemory(*ppDestArray, pSourceArray, cItems * cbItem);
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    CalcImageSize
+*
+*   
+*       pHeader -     
+*
+*    
+*              .
+*
+*            . 
+*     64- ,       
+*         .
+*
+****************************************************************************************/
+
+static ULONGLONG CalcImageSize(
+	__in const SONGIMAGEHEADER *pHeader)
+{
+	return sizeof(SONGIMAGEHEADER) +
+		(ULONGLONG) pHeader->cSingingEvents * sizeof(DWORD) * 5 +
+		(ULONGLONG) pHeader->cTempos * sizeof(double) * 3 +
+		(ULONGLONG) pHeader->cMeasures * sizeof(DWORD) * 2 +
+		(ULONGLONG) pHeader->cchTexts * sizeof(WCHAR);
+}
+
+/****************************************************************************************
+*
+*    PutArray
+*
+*   
+*       pDest -      ,    
+*       pSourceArray -    ;     
+*                      NULL,   cbArray  
+*       cbArray -    
+*
+*    
+*          ,    .
+*
+*       .
+*
+****************************************************************************************/
+
+static PBYTE PutArray(
+	__out PBYTE pDest,
+	__in_opt const void *pSourceArray,
+	__in DWORD cbArray)
+{
+	if (cbArray > 0) CopyMemory(pDest, pSourceArray, cbArray);
+
+	return pDest + cbArray;
+}
+
 /****************************************************************************************
 *
 *    IsStartOfGeneralizedSyllable
@@ -809,3 +1592,82 @@ static bool IsStartOfGeneralizedSyllable(
 
 	return false;
 }
+
+/****************************************************************************************
+*
+*    FindTempo
+*
+*   
+*       Seconds -     ;       
+*                 
+*
+*    
+*         ,     Seconds.
+*
+*       ,    Seconds.   
+*       .
+*
+*   
+*
+*     ,    ,     ,
+*          O(1).    , 
+*            ,   
+*   .
+*
+****************************************************************************************/
+
+DWORD Song::FindTempo(
+	__in double Seconds)
+{
+	DWORD iTempo = m_iLastFoundTempo;
+
+	//   [iLow, iHigh),      ,
+	//    Seconds
+	DWORD iLow;
+	DWORD iHigh;
+
+	if (m_pTempos[iTempo].Seconds <= Seconds)
+	{
+		//  ,    
+		if (iTempo + 1 == m_cTempos || Seconds < m_pTempos[iTempo + 1].Seconds)
+		{
+			return iTempo;
+		}
+
+		//     
+		if (iTempo + 2 == m_cTempos || Seconds < m_pTempos[iTempo + 2].Seconds)
+		{
+			m_iLastFoundTempo = iTempo + 1;
+			return iTempo + 1;
+		}
+
+		iLow = iTempo + 3;
+		iHigh = m_cTempos;
+	}
+	else
+	{
+		//       Seconds (  
+		// )
+		iLow = 1;
+		iHigh = iTempo;
+	}
+
+	//  
+	while (iLow < iHigh)
+	{
+		DWORD iMiddle = iLow + (iHigh - iLow) / 2;
+
+		if (m_pTempos[iMiddle].Seconds <= Seconds)
+		{
+			iLow = iMiddle + 1;
+		}
+		else
+		{
+			iHigh = iMiddle;
+		}
+	}
+
+	m_iLastFoundTempo = iLow - 1;
+
+	return iLow - 1;
+}
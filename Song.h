@@ -11,60 +11,110 @@
 *
 ****************************************************************************************/
 
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//      ;        
+//  ,        ;  
+//  256 (    1/256  )   3, 5, 7 (, 
+//  )
+#define WHOLE_NOTE_UNITS	80640
+
+/****************************************************************************************
+*
+*    Song
+*
+****************************************************************************************/
+
 class Song
 {
-	// ,     
-	struct SINGING_EVENT {
-		DWORD NoteNumber; //  
-		double PauseLength; //        
-							//   
-		double NoteLength; //     
-		LPWSTR pwsNoteText; //     ,   
-		DWORD cchNoteText; //     pwsNoteText
-		SINGING_EVENT *pNext; //     
-	};
-
-	// ,    
+	// ,  
 	struct MEASURE {
 		DWORD Numerator; //   
 		DWORD Denominator; //   
-		MEASURE *pNext; //     
 	};
 
-	// ,    
+	// ,  
 	struct TEMPO {
 		double Offset;	//         
 						//  
 		double BPM; //     
-		TEMPO *pNext; //     
+		double Seconds; //         
+						// 
 	};
 
-	//       
-	SINGING_EVENT *m_pFirstSingingEvent;
+	//     ,       
+	// ;         
+
+	//   
+	DWORD *m_pNoteNumbers;
+
+	//     (. WHOLE_NOTE_UNITS)    
+	//  
+	DWORD *m_pcuToNoteOns;
+
+	//      
+	DWORD *m_pcuNoteLengths;
+
+	//          m_pwsTexts
+	DWORD *m_piNoteTexts;
+
+	//       ;  ,  
+	//    
+	DWORD *m_pcchNoteTexts;
+
+	//     
+	DWORD m_cSingingEvents;
 
-	//       
-	SINGING_EVENT *m_pLastSingingEvent;
+	//   ,       
+	DWORD m_cMaxSingingEvents;
 
-	//       
-	SINGING_EVENT *m_pCurSingingEvent;
+	//    
+	DWORD m_iCurSingingEvent;
 
-	//      
-	MEASURE *m_pFirstMeasure;
+	// ,          
+	WCHAR *m_pwsTexts;
 
-	//      
-	MEASURE *m_pLastMeasure;
+	//      m_pwsTexts
+	DWORD m_cchTexts;
 
-	//      
-	MEASURE *m_pCurMeasure;
+	//   m_pwsTexts  
+	DWORD m_cchMaxTexts;
 
-	//      
-	TEMPO *m_pFirstTempo;
+	//  
+	MEASURE *m_pMeasures;
 
-	//      
-	TEMPO *m_pLastTempo;
+	//     m_pMeasures
+	DWORD m_cMeasures;
 
-	//      
-	TEMPO *m_pCurTempo;
+	//  ,       m_pMeasures
+	DWORD m_cMaxMeasures;
+
+	//   
+	DWORD m_iCurMeasure;
+
+	//  
+	TEMPO *m_pTempos;
+
+	//     m_pTempos
+	DWORD m_cTempos;
+
+	//  ,       m_pTempos
+	DWORD m_cMaxTempos;
+
+	//   
+	DWORD m_iCurTempo;
+
+	//  ,          ;
+	//       
+	DWORD m_iLastFoundTempo;
+
+	//    ,       (. 
+	// AttachToImage),  NULL,     
+	PVOID m_pImageView;
 
 public:
 
@@ -77,8 +127,8 @@ public:
 	//     
 	bool AddSingingEvent(
 		__in DWORD NoteNumber,
-		__in double PauseLength,
-		__in double NoteLength,
+		__in DWORD cuToNoteOn,
+		__in DWORD cuNoteLength,
 		__in_opt LPCWSTR pwsNoteText,
 		__in DWORD cchNoteText);
 
@@ -90,6 +140,18 @@ public:
 		__out_opt LPCWSTR *ppwsNoteText,
 		__out_opt DWORD *pcchNoteText);
 
+	//            
+	DWORD GetSingingEvents(
+		__out_opt const DWORD **ppNoteNumbers,
+		__out_opt const DWORD **ppcuToNoteOns,
+		__out_opt const DWORD **ppcuNoteLengths);
+
+	//       
+	void GetSingingEventText(
+		__in DWORD iSingingEvent,
+		__out LPCWSTR *ppwsNoteText,
+		__out DWORD *pcchNoteText);
+
 	//     
 	bool AddMeasure(
 		__in DWORD Numerator,
@@ -110,6 +172,10 @@ public:
 		__out double *pOffset,
 		__out double *pBPM);
 
+	//         
+	double SecondsToWholeNotes(
+		__in double Seconds);
+
 	//    
 	bool Quantize(
 		__in DWORD StepDenominator);
@@ -121,6 +187,25 @@ public:
 	//         
 	bool HyphenateLyric();
 
+	//   
+	Song *Duplicate();
+
+	//      
+	DWORD GetImageSize();
+
+	//   ,  
+	DWORD GetMemorySize();
+
+	//   
+	void WriteImage(
+		__out PBYTE pImage);
+
+	//     ,    
+	bool AttachToImage(
+		__in PBYTE pImage,
+		__in DWORD cbImage,
+		__in PVOID pImageView);
+
 	//    
 	void Free();
 
@@ -128,7 +213,20 @@ private:
 
 	//     
 	bool SetText(
-		__inout SINGING_EVENT *pSingingEvent,
+		__in DWORD iSingingEvent,
 		__in_opt LPCWSTR pwsNoteText,
 		__in DWORD cchNoteText);
+
+	//      m_pwsTexts
+	bool AppendText(
+		__in LPCWSTR pwsText,
+		__in DWORD cchText,
+		__out DWORD *piText);
+
+	//        
+	bool DetachFromImage();
+
+	//  ,     
+	DWORD FindTempo(
+		__in double Seconds);
 };
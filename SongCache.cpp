@@ -0,0 +1,768 @@
+/****************************************************************************************
+*
+*     SongCache
+*
+*       (  Song)   ,  
+*               
+*      .
+*
+*        SONGCACHEHEADER   ,  
+*   Song::WriteImage.    -    .  - 
+*         ,    , 
+*          ,     
+*    .
+*
+*               ,  
+*    :     ( ,    
+*      )    SONGCACHEINDEX   .
+*         ;     
+*     .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+
+#include "Log.h"
+#include "Song.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiPart.h"
+#include "SongCache.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//   
+#define SONG_CACHE_SIGNATURE		'SGSC'
+
+//    
+#define SONG_INDEX_SIGNATURE		'SGSI'
+
+//    ;        
+// ,      ,     
+// 
+#define SONG_CACHE_VERSION			4
+
+//       
+#define SONG_CACHE_DIRECTORY_NAME	TEXT("Singoscope")
+
+//             
+// :       ".sgc"  ".sgi"
+#define MAX_CACHE_FILE_NAME_LENGTH	21
+
+//         ,    ,
+//  
+#define SONG_CACHE_FILE_EXTENSION	TEXT("sgc")
+#define SONG_INDEX_FILE_EXTENSION	TEXT("sgi")
+#define SONG_CACHE_FILE_PATTERN		TEXT("*.sg?")
+
+//         
+#define SONG_CACHE_MAX_SIZE			(64 * 1024 * 1024)
+
+//  64-  FNV-1a
+#define FNV_OFFSET_BASIS			0xCBF29CE484222325ULL
+#define FNV_PRIME					0x00000100000001B3ULL
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//   ;    8 ,     
+//    ,    
+struct SONGCACHEHEADER
+{
+	DWORD Signature; //    SONG_CACHE_SIGNATURE
+	DWORD Version; //     SONG_CACHE_VERSION
+	ULONGLONG Key; //  
+	DWORD cbFile; //      
+	DWORD UsedQuantizeStepDenominator; //    ,  
+									   //   
+	DWORD cbImage; //     
+	DWORD Reserved; //  
+};
+
+//    
+struct SONGCACHEINDEX
+{
+	DWORD Signature; //    SONG_INDEX_SIGNATURE
+	DWORD Version; //     SONG_CACHE_VERSION
+	ULONGLONG FileKey; //    
+	ULONGLONG Key; //  ,    
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// true,       
+static bool g_bIsInitialized = false;
+
+//    
+static TCHAR g_pszCacheDirectory[MAX_PATH];
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static ULONGLONG HashBytes(
+	__in ULONGLONG Hash,
+	__in const BYTE *pBytes,
+	__in DWORD cbBytes);
+
+static void GetCacheFileName(
+	__in ULONGLONG Key,
+	__in LPCTSTR pszExtension,
+	__out LPTSTR pszFileName);
+
+static bool WriteCacheFile(
+	__in ULONGLONG Key,
+	__in LPCTSTR pszExtension,
+	__in_bcount(cbData) const void *pData,
+	__in DWORD cbData);
+
+static void TrimCache();
+
+/****************************************************************************************
+*
+*    SongCache_Init
+*
+*   
+*       
+*
+*    
+*       true,      ; false,     
+*        (      ).
+*
+*    :       ,   .
+*      ,    .
+*
+****************************************************************************************/
+
+bool SongCache_Init()
+{
+	TCHAR pszTempPath[MAX_PATH];
+
+	//        
+	DWORD cchTempPath = GetTempPath(MAX_PATH, pszTempPath);
+
+	if (cchTempPath == 0 || cchTempPath >= MAX_PATH)
+	{
+		LOG("GetTempPath failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	if (cchTempPath + lstrlen(SONG_CACHE_DIRECTORY_NAME) + MAX_CACHE_FILE_NAME_LENGTH >=
+		MAX_PATH)
+	{
+		LOG("temporary directory name is too long\n");
+		return false;
+	}
+
+	lstrcpy(g_pszCacheDirectory, pszTempPath);
+	lstrcat(g_pszCacheDirectory, SONG_CACHE_DIRECTORY_NAME);
+
+	if (!CreateDirectory(g_pszCacheDirectory, NULL) &&
+		GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		LOG("CreateDirectory failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	g_bIsInitialized = true;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    SongCache_GetKey
+*
+*   
+*       pFile -      
+*       cbFile -      
+*       DefaultCodePage -       
+*       ConcordNoteChoice -     
+*       QuantizeStepDenominator -     
+*
+*    
+*          .
+*
+*       : 64-  FNV-1a      
+*   ,       .
+*
+****************************************************************************************/
+
+ULONGLONG SongCache_GetKey(
+	__in PBYTE pFile,
+	__in DWORD cbFile,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator)
+{
+	DWORD Parameters[4];
+
+	Parameters[0] = DefaultCodePage;
+	Parameters[1] = ConcordNoteChoice;
+	Parameters[2] = QuantizeStepDenominator;
+	Parameters[3] = SONG_CACHE_VERSION;
+
+	ULONGLONG Hash = HashBytes(FNV_OFFSET_BASIS, pFile, cbFile);
+
+	return HashBytes(Hash, (const BYTE *) Parameters, sizeof(Parameters));
+}
+
+/****************************************************************************************
+*
+*    SongCache_GetFileKey
+*
+*   
+*       pszFileName -      
+*       DefaultCodePage -       
+*       ConcordNoteChoice -     
+*       QuantizeStepDenominator -     
+*       pFileKey -   ,      
+*       pcbFile -   ,        
+*                  
+*
+*    
+*       true,    ; false,      
+*          4 .
+*
+*        :   ,  , 
+*      ,    .   
+*   .    Windows    ,    
+*    .
+*
+****************************************************************************************/
+
+bool SongCache_GetFileKey(
+	__in LPCTSTR pszFileName,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator,
+	__out ULONGLONG *pFileKey,
+	__out DWORD *pcbFile)
+{
+	WIN32_FILE_ATTRIBUTE_DATA FileData;
+
+	if (!GetFileAttributesEx(pszFileName, GetFileExInfoStandard, &FileData))
+	{
+		LOG("GetFileAttributesEx failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	if (FileData.nFileSizeHigh != 0) return false;
+
+	TCHAR pszLowerFileName[MAX_PATH];
+
+	lstrcpyn(pszLowerFileName, pszFileName, MAX_PATH);
+
+	DWORD cchFileName = lstrlen(pszLowerFileName);
+
+	CharLowerBuff(pszLowerFileName, cchFileName);
+
+	DWORD Parameters[7];
+
+	Parameters[0] = FileData.nFileSizeLow;
+	Parameters[1] = FileData.ftLastWriteTime.dwLowDateTime;
+	Parameters[2] = FileData.ftLastWriteTime.dwHighDateTime;
+	Parameters[3] = DefaultCodePage;
+	Parameters[4] = ConcordNoteChoice;
+	Parameters[5] = QuantizeStepDenominator;
+	Parameters[6] = SONG_CACHE_VERSION;
+
+	ULONGLONG Hash = HashBytes(FNV_OFFSET_BASIS, (const BYTE *) pszLowerFileName,
+		cchFileName * sizeof(TCHAR));
+
+	*pFileKey = HashBytes(Hash, (const BYTE *) Parameters, sizeof(Parameters));
+	*pcbFile = FileData.nFileSizeLow;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    SongCache_FindKey
+*
+*   
+*       FileKey -  ,   SongCache_GetFileKey
+*       pKey -   ,      
+*
+*    
+*       true,       ;  false.
+*
+*        ,        
+*   ,     .
+*
+****************************************************************************************/
+
+bool SongCache_FindKey(
+	__in ULONGLONG FileKey,
+	__out ULONGLONG *pKey)
+{
+	if (!g_bIsInitialized) return false;
+
+	TCHAR pszFileName[MAX_PATH];
+	GetCacheFileName(FileKey, SONG_INDEX_FILE_EXTENSION, pszFileName);
+
+	//   ;   ,      
+	HANDLE hFile = CreateFile(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, 0, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE) return false;
+
+	SONGCACHEINDEX Index;
+
+	DWORD cbRead;
+
+	BOOL bIsRead = ReadFile(hFile, &Index, sizeof(Index), &cbRead, NULL) &&
+		cbRead == sizeof(Index);
+
+	CloseHandle(hFile);
+
+	if (!bIsRead || Index.Signature != SONG_INDEX_SIGNATURE ||
+		Index.Version != SONG_CACHE_VERSION || Index.FileKey != FileKey)
+	{
+		LOG("invalid song cache index file\n");
+		return false;
+	}
+
+	*pKey = Index.Key;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    SongCache_StoreKey
+*
+*   
+*       FileKey -  ,   SongCache_GetFileKey
+*       Key -  ,   SongCache_GetKey
+*
+*    
+*       true,       ;  false.
+*
+*           .
+*
+****************************************************************************************/
+
+bool SongCache_StoreKey(
+	__in ULONGLONG FileKey,
+	__in ULONGLONG Key)
+{
+	if (!g_bIsInitialized) return false;
+
+	SONGCACHEINDEX Index;
+
+	Index.Signature = SONG_INDEX_SIGNATURE;
+	Index.Version = SONG_CACHE_VERSION;
+	Index.FileKey = FileKey;
+	Index.Key = Key;
+
+	return WriteCacheFile(FileKey, SONG_INDEX_FILE_EXTENSION, &Index, sizeof(Index));
+}
+
+/****************************************************************************************
+*
+*    SongCache_LoadSong
+*
+*   
+*       Key -    
+*       cbFile -      
+*       pUsedQuantizeStepDenominator -   ,    
+*                                         ,  
+*                                        ;   
+*                                        NULL
+*
+*    
+*           Song  NULL,        
+*       .
+*
+*      .     ,    Song
+*       .
+*
+*   
+*
+*        FILE_MAP_COPY:    (,
+*    ),     ,    
+*    .
+*
+****************************************************************************************/
+
+Song *SongCache_LoadSong(
+	__in ULONGLONG Key,
+	__in DWORD cbFile,
+	__out_opt DWORD *pUsedQuantizeStepDenominator)
+{
+	if (!g_bIsInitialized) return NULL;
+
+	TCHAR pszFileName[MAX_PATH];
+	GetCacheFileName(Key, SONG_CACHE_FILE_EXTENSION, pszFileName);
+
+	//   ;   ,     
+	HANDLE hFile = CreateFile(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, 0, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE) return NULL;
+
+	DWORD cbCacheFile = GetFileSize(hFile, NULL);
+
+	if (cbCacheFile == INVALID_FILE_SIZE || cbCacheFile < sizeof(SONGCACHEHEADER))
+	{
+		LOG("invalid song cache file size\n");
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	//       
+	HANDLE hFileMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+	CloseHandle(hFile);
+
+	if (hFileMapping == NULL)
+	{
+		LOG("CreateFileMapping failed (error %u)\n", GetLastError());
+		return NULL;
+	}
+
+	PBYTE pView = (PBYTE) MapViewOfFile(hFileMapping, FILE_MAP_COPY, 0, 0, 0);
+
+	//         "
+	// "
+	CloseHandle(hFileMapping);
+
+	if (pView == NULL)
+	{
+		LOG("MapViewOfFile failed (error %u)\n", GetLastError());
+		return NULL;
+	}
+
+	//    
+	SONGCACHEHEADER *pHeader = (SONGCACHEHEADER *) pView;
+
+	if (pHeader->Signature != SONG_CACHE_SIGNATURE ||
+		pHeader->Version != SONG_CACHE_VERSION ||
+		pHeader->Key != Key ||
+		pHeader->cbFile != cbFile ||
+		pHeader->cbImage != cbCacheFile - sizeof(SONGCACHEHEADER))
+	{
+		LOG("invalid song cache file header\n");
+		UnmapViewOfFile(pView);
+		return NULL;
+	}
+
+	Song *pSong = new Song;
+
+	if (pSong == NULL)
+	{
+		LOG("operator new failed\n");
+		UnmapViewOfFile(pView);
+		return NULL;
+	}
+
+	//    Song   ;    
+	// 
+	if (!pSong->AttachToImage(pView + sizeof(SONGCACHEHEADER), pHeader->cbImage, pView))
+	{
+		LOG("Song::AttachToImage failed\n");
+		delete pSong;
+		UnmapViewOfFile(pView);
+		return NULL;
+	}
+
+	if (pUsedQuantizeStepDenominator != NULL)
+	{
+		*pUsedQuantizeStepDenominator = pHeader->UsedQuantizeStepDenominator;
+	}
+
+	return pSong;
+}
+
+/****************************************************************************************
+*
+*    SongCache_StoreSong
+*
+*   
+*       Key -    
+*       cbFile -      
+*       pSong -     Song
+*       UsedQuantizeStepDenominator -    ,   
+*                                      
+*
+*    
+*       true,      ;  false.
+*
+*      .       , 
+*       .
+*
+****************************************************************************************/
+
+bool SongCache_StoreSong(
+	__in ULONGLONG Key,
+	__in DWORD cbFile,
+	__in Song *pSong,
+	__in DWORD UsedQuantizeStepDenominator)
+{
+	if (!g_bIsInitialized) return false;
+
+	//      
+	DWORD cbImage = pSong->GetImageSize();
+	DWORD cbCacheFile = sizeof(SONGCACHEHEADER) + cbImage;
+
+	// ,   HeapAlloc,    8 
+	PBYTE pCacheFile = (PBYTE) HeapAlloc(GetProcessHeap(), 0, cbCacheFile);
+
+	if (pCacheFile == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		return false;
+	}
+
+	SONGCACHEHEADER *pHeader = (SONGCACHEHEADER *) pCacheFile;
+
+	pHeader->Signature = SONG_CACHE_SIGNATURE;
+	pHeader->Version = SONG_CACHE_VERSION;
+	pHeader->Key = Key;
+	pHeader->cbFile = cbFile;
+	pHeader->UsedQuantizeStepDenominator = UsedQuantizeStepDenominator;
+	pHeader->cbImage = cbImage;
+	pHeader->Reserved = 0;
+
+	pSong->WriteImage(pCacheFile + sizeof(SONGCACHEHEADER));
+
+	bool bIsStored = WriteCacheFile(Key, SONG_CACHE_FILE_EXTENSION, pCacheFile,
+		cbCacheFile);
+
+	HeapFree(GetProcessHeap(), 0, pCacheFile);
+
+	if (bIsStored) TrimCache();
+
+	return bIsStored;
+}
+
+/****************************************************************************************
+*
+*    HashBytes
+*
+*   
+*       Hash -   
+*       pBytes -    
+*       cbBytes -   
+*
+*    
+*         .
+*
+*      64-  FNV-1a.
+*
+****************************************************************************************/
+
+static ULONGLONG HashBytes(
+	__in ULONGLONG Hash,
+	__in const BYTE *pBytes,
+	__in DWORD cbBytes)
+{
+	for (DWORD i = 0; i < cbBytes; i++)
+	{
+		Hash ^= pBytes[i];
+		Hash *= FNV_PRIME;
+	}
+
+	return Hash;
+}
+
+/****************************************************************************************
+*
+*    GetCacheFileName
+*
+*   
+*       Key -     
+*       pszExtension -       
+*       pszFileName -     MAX_PATH ,   
+*                        
+*
+*    
+*       
+*
+*             Key.  
+*      SongCache_Init.
+*
+****************************************************************************************/
+
+static void GetCacheFileName(
+	__in ULONGLONG Key,
+	__in LPCTSTR pszExtension,
+	__out LPTSTR pszFileName)
+{
+	wsprintf(pszFileName, TEXT("%s\\%08X%08X.%s"), g_pszCacheDirectory,
+		(DWORD) (Key >> 32), (DWORD) Key, pszExtension);
+}
+
+/****************************************************************************************
+*
+*    WriteCacheFile
+*
+*   
+*       Key -     
+*       pszExtension -       
+*       pData -    
+*       cbData -     
+*
+*    
+*       true,    ;  false.
+*
+*           Key.
+*
+*   
+*
+*           ,  
+*     .      
+*     .
+*
+****************************************************************************************/
+
+static bool WriteCacheFile(
+	__in ULONGLONG Key,
+	__in LPCTSTR pszExtension,
+	__in_bcount(cbData) const void *pData,
+	__in DWORD cbData)
+{
+	TCHAR pszTempFileName[MAX_PATH];
+
+	if (GetTempFileName(g_pszCacheDirectory, TEXT("sgc"), 0, pszTempFileName) == 0)
+	{
+		LOG("GetTempFileName failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	HANDLE hFile = CreateFile(pszTempFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		LOG("CreateFile failed (error %u)\n", GetLastError());
+		DeleteFile(pszTempFileName);
+		return false;
+	}
+
+	DWORD cbWritten;
+
+	BOOL bIsWritten = WriteFile(hFile, pData, cbData, &cbWritten, NULL) &&
+		cbWritten == cbData;
+
+	CloseHandle(hFile);
+
+	if (!bIsWritten)
+	{
+		LOG("WriteFile failed (error %u)\n", GetLastError());
+		DeleteFile(pszTempFileName);
+		return false;
+	}
+
+	//   
+	TCHAR pszFileName[MAX_PATH];
+	GetCacheFileName(Key, pszExtension, pszFileName);
+
+	if (!MoveFileEx(pszTempFileName, pszFileName, MOVEFILE_REPLACE_EXISTING))
+	{
+		LOG("MoveFileEx failed (error %u)\n", GetLastError());
+		DeleteFile(pszTempFileName);
+		return false;
+	}
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    TrimCache
+*
+*   
+*       
+*
+*    
+*       
+*
+*       ,       ,  
+*      SONG_CACHE_MAX_SIZE.     .
+*         (,    
+*    ),      .
+*
+*   
+*
+*        .     
+*       ,      .
+*
+****************************************************************************************/
+
+static void TrimCache()
+{
+	TCHAR pszPattern[MAX_PATH];
+
+	wsprintf(pszPattern, TEXT("%s\\%s"), g_pszCacheDirectory, SONG_CACHE_FILE_PATTERN);
+
+	for (;;)
+	{
+		WIN32_FIND_DATA FindData;
+
+		HANDLE hFind = FindFirstFile(pszPattern, &FindData);
+
+		if (hFind == INVALID_HANDLE_VALUE) return;
+
+		//     
+		ULONGLONG cbTotal = 0;
+		DWORD cFiles = 0;
+
+		//       
+		TCHAR pszOldestFileName[MAX_PATH];
+		FILETIME OldestWriteTime;
+
+		do
+		{
+			if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+			cbTotal += ((ULONGLONG) FindData.nFileSizeHigh << 32) |
+				FindData.nFileSizeLow;
+
+			if (cFiles == 0 ||
+				CompareFileTime(&FindData.ftLastWriteTime, &OldestWriteTime) < 0)
+			{
+				lstrcpyn(pszOldestFileName, FindData.cFileName, MAX_PATH);
+				OldestWriteTime = FindData.ftLastWriteTime;
+			}
+
+			cFiles++;
+		}
+		while (FindNextFile(hFind, &FindData));
+
+		FindClose(hFind);
+
+		if (cbTotal <= SONG_CACHE_MAX_SIZE || cFiles <= 1) return;
+
+		TCHAR pszFileName[MAX_PATH];
+
+		if (lstrlen(g_pszCacheDirectory) + 1 + lstrlen(pszOldestFileName) >= MAX_PATH)
+		{
+			return;
+		}
+
+		wsprintf(pszFileName, TEXT("%s\\%s"), g_pszCacheDirectory, pszOldestFileName);
+
+		if (!DeleteFile(pszFileName))
+		{
+			LOG("DeleteFile failed (error %u)\n", GetLastError());
+			return;
+		}
+	}
+}
@@ -0,0 +1,176 @@
+/****************************************************************************************
+*
+*     SongCache
+*
+*       (  Song)   ,  
+*               
+*      .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*    SongCache_Init
+*
+*   
+*       
+*
+*    
+*       true,      ; false,     
+*        (      ).
+*
+*    :       ,   .
+*      ,    .
+*
+****************************************************************************************/
+
+bool SongCache_Init();
+
+/****************************************************************************************
+*
+*    SongCache_GetKey
+*
+*   
+*       pFile -      
+*       cbFile -      
+*       DefaultCodePage -       
+*       ConcordNoteChoice -     
+*       QuantizeStepDenominator -     
+*
+*    
+*          .
+*
+*       : 64-  FNV-1a      
+*   ,       .
+*
+****************************************************************************************/
+
+ULONGLONG SongCache_GetKey(
+	__in PBYTE pFile,
+	__in DWORD cbFile,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator);
+
+/****************************************************************************************
+*
+*    SongCache_GetFileKey
+*
+*   
+*       pszFileName -      
+*       DefaultCodePage -       
+*       ConcordNoteChoice -     
+*       QuantizeStepDenominator -     
+*       pFileKey -   ,      
+*       pcbFile -   ,        
+*                  
+*
+*    
+*       true,    ; false,      
+*          4 .
+*
+*        :   ,  , 
+*      ,    .   
+*   .
+*
+****************************************************************************************/
+
+bool SongCache_GetFileKey(
+	__in LPCTSTR pszFileName,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator,
+	__out ULONGLONG *pFileKey,
+	__out DWORD *pcbFile);
+
+/****************************************************************************************
+*
+*    SongCache_FindKey
+*
+*   
+*       FileKey -  ,   SongCache_GetFileKey
+*       pKey -   ,      
+*
+*    
+*       true,       ;  false.
+*
+*        ,        
+*   ,     .
+*
+****************************************************************************************/
+
+bool SongCache_FindKey(
+	__in ULONGLONG FileKey,
+	__out ULONGLONG *pKey);
+
+/****************************************************************************************
+*
+*    SongCache_StoreKey
+*
+*   
+*       FileKey -  ,   SongCache_GetFileKey
+*       Key -  ,   SongCache_GetKey
+*
+*    
+*       true,       ;  false.
+*
+*           .
+*
+****************************************************************************************/
+
+bool SongCache_StoreKey(
+	__in ULONGLONG FileKey,
+	__in ULONGLONG Key);
+
+/****************************************************************************************
+*
+*    SongCache_LoadSong
+*
+*   
+*       Key -    
+*       cbFile -      
+*       pUsedQuantizeStepDenominator -   ,    
+*                                         ,  
+*                                        ;   
+*                                        NULL
+*
+*    
+*           Song  NULL,        
+*       .
+*
+*      .     ,    Song
+*       .
+*
+****************************************************************************************/
+
+Song *SongCache_LoadSong(
+	__in ULONGLONG Key,
+	__in DWORD cbFile,
+	__out_opt DWORD *pUsedQuantizeStepDenominator);
+
+/****************************************************************************************
+*
+*    SongCache_StoreSong
+*
+*   
+*       Key -    
+*       cbFile -      
+*       pSong -     Song
+*       UsedQuantizeStepDenominator -    ,   
+*                                      
+*
+*    
+*       true,      ;  false.
+*
+*      .       , 
+*       .
+*
+****************************************************************************************/
+
+bool SongCache_StoreSong(
+	__in ULONGLONG Key,
+	__in DWORD cbFile,
+	__in Song *pSong,
+	__in DWORD UsedQuantizeStepDenominator);
@@ -12,6 +12,7 @@
 #include <tchar.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "TextMessages.h"
 #include "ShowError.h"
 #include "Song.h"
@@ -21,6 +22,7 @@
 #include "MidiLyric.h"
 #include "MidiSong.h"
 #include "MidiFile.h"
+#include "SongCache.h"
 #include "SongFile.h"
 
 /****************************************************************************************
@@ -32,6 +34,10 @@
 static LPCTSTR GetFileNameExtension(
 	__in LPCTSTR pszFileName);
 
+static void FreeFileBuffer(
+	__in PBYTE pFile,
+	__in FILEBUFFERTYPE FileBufferType);
+
 /****************************************************************************************
 *
 *   
@@ -49,6 +55,16 @@ static LPCTSTR GetFileNameExtension(
 SongFile::SongFile()
 {
 	m_pMidiFile = NULL;
+
+	m_LastResult = MIDIFILE_SUCCESS;
+	m_LastSystemError = ERROR_SUCCESS;
+	m_LastFunctionId = 0;
+
+	m_bIsSongIncomplete = false;
+
+	m_pStageProc = NULL;
+	m_pStageContext = NULL;
+	m_pCancelFlag = NULL;
 }
 
 /****************************************************************************************
@@ -94,20 +110,10 @@ bool SongFile::SetDefaultCodePage(
 	//   SetDefaultCodePage  ,  
 	if (Result == MIDIFILE_SUCCESS) return true;
 
-	switch (Result)
-	{
-		case MIDIFILE_NO_LYRIC:
-			ShowError(MSGID_NO_LYRIC);
-			break;
+	m_LastResult = Result;
+	m_LastSystemError = ERROR_SUCCESS;
 
-		case MIDIFILE_NO_VOCAL_PARTS:
-			ShowError(MSGID_NO_VOCAL_PARTS);
-			break;
-
-		case MIDIFILE_CANT_ALLOC_MEMORY:
-			ShowError(MSGID_CANT_ALLOC_MEMORY);
-			break;
-	}
+	ReportLastError(NULL);
 
 	return false;
 }
@@ -140,20 +146,51 @@ bool SongFile::SetConcordNoteChoice(
 	//   SetConcordNoteChoice  ,  
 	if (Result == MIDIFILE_SUCCESS) return true;
 
-	switch (Result)
-	{
-		case MIDIFILE_NO_VOCAL_PARTS:
-			ShowError(MSGID_NO_VOCAL_PARTS);
-			break;
+	m_LastResult = Result;
+	m_LastSystemError = ERROR_SUCCESS;
 
-		case MIDIFILE_CANT_ALLOC_MEMORY:
-			ShowError(MSGID_CANT_ALLOC_MEMORY);
-			break;
-	}
+	ReportLastError(NULL);
 
 	return false;
 }
 
+/****************************************************************************************
+*
+*    SetLoadControl
+*
+*   
+*        ,    MidiFile::SetLoadControl.
+*
+*    
+*       
+*
+*    ,     ,   . 
+*      MidiFile      LoadFile 
+*   LoadSong.   ,    ,  
+*   GetLastResult  MIDIFILE_CANCELLED.
+*
+*      ,      :  
+*      ,        ,
+*        .      
+*       GetLastResult (.  ShowLoadError).
+*
+****************************************************************************************/
+
+void SongFile::SetLoadControl(
+	__in_opt MIDIFILESTAGEPROC pStageProc,
+	__in_opt LPVOID pStageContext,
+	__in_opt volatile LONG *pCancelFlag)
+{
+	m_pStageProc = pStageProc;
+	m_pStageContext = pStageContext;
+	m_pCancelFlag = pCancelFlag;
+
+	if (m_pMidiFile != NULL)
+	{
+		m_pMidiFile->SetLoadControl(pStageProc, pStageContext, pCancelFlag);
+	}
+}
+
 /****************************************************************************************
 *
 *    LoadFile
@@ -166,31 +203,269 @@ bool SongFile::SetConcordNoteChoice(
 *                           CHOOSE_MIN_NOTE_NUMBER -    ,
 *                           CHOOSE_MAX_NOTE_NUMBER -    ,
 *                           CHOOSE_MAX_NOTE_DURATION -    
+*       LoadMode -   : LOADFILE_READ -    ,
+*                    , LOADFILE_MAP -     
+*                   ;       LOADFILE_READ
 *
 *    
 *       true,      ;  false,   .
 *
-*      .
+*      .     ,   
+*       GetLastResult.
+*
+*      LOADFILE_MAP    :  MIDI-
+*       ,      
+*     ,    .    
+*     MidiFile.   ,     , 
+*           .  
+*    ,      LOADFILE_READ.
 *
 ****************************************************************************************/
 
 bool SongFile::LoadFile(
 	__in LPCTSTR pszFileName,
 	__in UINT DefaultCodePage,
-	__in CONCORD_NOTE_CHOICE ConcordNoteChoice)
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in LOADFILEMODE LoadMode)
+{
+	TRACE_ZONE("SongFile::LoadFile");
+
+	//        - ,   
+	//    
+	Free();
+
+	m_LastResult = MIDIFILE_SUCCESS;
+	m_LastSystemError = ERROR_SUCCESS;
+	m_LastFunctionId = 0;
+
+	//   ,      
+	PBYTE pFile;
+
+	//      
+	DWORD cbFile;
+
+	//       
+	FILEBUFFERTYPE FileBufferType;
+
+	//      
+	if (!ReadSongFile(pszFileName, LoadMode, &pFile, &cbFile, &FileBufferType))
+	{
+		return false;
+	}
+
+	//     MidiFile
+	return AssignSongFile(pszFileName, pFile, cbFile, FileBufferType, DefaultCodePage,
+		ConcordNoteChoice);
+}
+
+/****************************************************************************************
+*
+*    LoadSong
+*
+*   
+*       pszFileName -   ,  ,    
+*					    
+*       DefaultCodePage -       
+*       ConcordNoteChoice -      (.  LoadFile)
+*       QuantizeStepDenominator -  ,    ,
+*                                     
+*       pUsedQuantizeStepDenominator -   ,    
+*                                         ,   
+*                                         ;  
+*                                         NULL;   
+*                                         NULL
+*       cPreviewMeasures -  ,   ,   
+*                            ;  ,    
+*                          ;       
+*
+*    
+*            Song;  NULL,   .
+*
+*    :   ,   LoadFile  CreateSong,   
+*        (.  SongCache) ,  ,   
+*   MIDI-.   MIDI-     .
+*
+*          .      
+*    ,        ,   
+*     ;    ,     
+*           .
+*
+*       ,  MIDI-   ,  
+*   GetVocalPartCount  GetPrunedCandidateCount  .
+*
+*       cPreviewMeasures     ,  
+*     ,     .    
+*   IsSongIncomplete  true,       CompleteSong;
+*         .
+*
+****************************************************************************************/
+
+Song *SongFile::LoadSong(
+	__in LPCTSTR pszFileName,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator,
+	__out_opt DWORD *pUsedQuantizeStepDenominator,
+	__in DWORD cPreviewMeasures)
 {
 	//        - ,   
 	//    
 	Free();
 
+	m_LastResult = MIDIFILE_SUCCESS;
+	m_LastSystemError = ERROR_SUCCESS;
+	m_LastFunctionId = 0;
+
+	//   ,      
+	PBYTE pFile;
+
+	//      
+	DWORD cbFile;
+
+	//       
+	FILEBUFFERTYPE FileBufferType;
+
+	//    ,     
+	DWORD UsedQuantizeStepDenominator;
+
+	//    
+	ULONGLONG Key;
+
+	//      ,    -  
+	ULONGLONG FileKey;
+
+	bool bHasFileKey = SongCache_GetFileKey(pszFileName, DefaultCodePage,
+		ConcordNoteChoice, QuantizeStepDenominator, &FileKey, &cbFile);
+
+	bool bIsKeyIndexed = bHasFileKey && SongCache_FindKey(FileKey, &Key);
+
+	Song *pSong = NULL;
+
+	if (bIsKeyIndexed)
+	{
+		pSong = SongCache_LoadSong(Key, cbFile, &UsedQuantizeStepDenominator);
+
+		if (pSong != NULL)
+		{
+			if (pUsedQuantizeStepDenominator != NULL)
+			{
+				*pUsedQuantizeStepDenominator = UsedQuantizeStepDenominator;
+			}
+
+			return pSong;
+		}
+	}
+
+	//             
+	if (!ReadSongFile(pszFileName, LOADFILE_READ, &pFile, &cbFile, &FileBufferType))
+	{
+		return NULL;
+	}
+
+	ULONGLONG ContentKey = SongCache_GetKey(pFile, cbFile, DefaultCodePage,
+		ConcordNoteChoice, QuantizeStepDenominator);
+
+	//      ,        
+	if (bHasFileKey && (!bIsKeyIndexed || Key != ContentKey))
+	{
+		if (!SongCache_StoreKey(FileKey, ContentKey))
+		{
+			LOG("SongCache_StoreKey failed\n");
+		}
+	}
+
+	Key = ContentKey;
+
+	//     
+	pSong = SongCache_LoadSong(Key, cbFile, &UsedQuantizeStepDenominator);
+
+	if (pSong != NULL)
+	{
+		FreeFileBuffer(pFile, FileBufferType);
+	}
+	else
+	{
+		//    ,   MIDI-   
+		if (!AssignSongFile(pszFileName, pFile, cbFile, FileBufferType, DefaultCodePage,
+			ConcordNoteChoice))
+		{
+			return NULL;
+		}
+
+		// , ,     
+		bool bTruncated = false;
+
+		pSong = CreateSong(QuantizeStepDenominator, &UsedQuantizeStepDenominator, 0,
+			cPreviewMeasures, &bTruncated);
+
+		if (pSong == NULL) return NULL;
+
+		if (bTruncated)
+		{
+			//  ,    CompleteSong
+			m_bIsSongIncomplete = true;
+			m_SongCacheKey = Key;
+			m_cbSongFile = cbFile;
+			m_QuantizeStepDenominator = QuantizeStepDenominator;
+		}
+		else
+		{
+			//      ;    ,  
+			//       
+			if (!SongCache_StoreSong(Key, cbFile, pSong, UsedQuantizeStepDenominator))
+			{
+				LOG("SongCache_StoreSong failed\n");
+			}
+		}
+	}
+
+	if (pUsedQuantizeStepDenominator != NULL)
+	{
+		*pUsedQuantizeStepDenominator = UsedQuantizeStepDenominator;
+	}
+
+	return pSong;
+}
+
+/****************************************************************************************
+*
+*    ReadSongFile
+*
+*   
+*       pszFileName -   ,  ,    
+*					    
+*       LoadMode -    (.  LoadFile)
+*       ppFile -   ,        
+*                 
+*       pcbFile -   ,        
+*       pFileBufferType -   ,     
+*                            
+*
+*    
+*       true,      ;  false,   .
+*
+*        .      
+*   FreeFileBuffer       MidiFile.
+*
+****************************************************************************************/
+
+bool SongFile::ReadSongFile(
+	__in LPCTSTR pszFileName,
+	__in LOADFILEMODE LoadMode,
+	__out PBYTE *ppFile,
+	__out DWORD *pcbFile,
+	__out FILEBUFFERTYPE *pFileBufferType)
+{
 	//    
 	HANDLE hFile = CreateFile(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
 		OPEN_EXISTING, 0, NULL);
 
 	if (hFile == INVALID_HANDLE_VALUE)
 	{
-		LOG("CreateFile failed (error %u)\n", GetLastError());
-		ShowError(MSGID_CANT_OPEN_FILE, GetLastError());
+		m_LastSystemError = GetLastError();
+		m_LastFunctionId = FUNCID_CREATE_FILE;
+		LOG("CreateFile failed (error %u)\n", m_LastSystemError);
+		ReportLastError(pszFileName);
 		return false;
 	}
 
@@ -199,46 +474,135 @@ bool SongFile::LoadFile(
 
 	if (cbFile == INVALID_FILE_SIZE)
 	{
-		LOG("GetFileSize failed (error %u)\n", GetLastError());
-		ShowError(MSGID_CANT_LOAD_FILE, FUNCID_GET_FILE_SIZE, GetLastError());
+		m_LastSystemError = GetLastError();
+		m_LastFunctionId = FUNCID_GET_FILE_SIZE;
+		LOG("GetFileSize failed (error %u)\n", m_LastSystemError);
+		ReportLastError(pszFileName);
 		CloseHandle(hFile);
 		return false;
 	}
 
-	//  ,       
-	PBYTE pFile = (PBYTE) HeapAlloc(GetProcessHeap(), 0, cbFile);
+	//   ,      
+	PBYTE pFile;
 
-	if (pFile == NULL)
+	//       
+	FILEBUFFERTYPE FileBufferType;
+
+	if (LoadMode == LOADFILE_MAP && cbFile > 0)
 	{
-		LOG("HeapAlloc failed\n");
-		ShowError(MSGID_CANT_ALLOC_MEMORY);
-		CloseHandle(hFile);
-		return false;
-	}
+		//   " "
+		HANDLE hFileMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (hFileMapping == NULL)
+		{
+			m_LastSystemError = GetLastError();
+			m_LastFunctionId = FUNCID_CREATE_FILE_MAPPING;
+			LOG("CreateFileMapping failed (error %u)\n", m_LastSystemError);
+			ReportLastError(pszFileName);
+			CloseHandle(hFile);
+			return false;
+		}
 
-	DWORD cbRead;
+		//        
+		pFile = (PBYTE) MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
 
-	//       
-	if (!ReadFile(hFile, pFile, cbFile, &cbRead, NULL))
+		if (pFile == NULL)
+		{
+			m_LastSystemError = GetLastError();
+			m_LastFunctionId = FUNCID_MAP_VIEW_OF_FILE;
+			LOG("MapViewOfFile failed (error %u)\n", m_LastSystemError);
+			ReportLastError(pszFileName);
+			CloseHandle(hFileMapping);
+			CloseHandle(hFile);
+			return false;
+		}
+
+		//        
+		// " "   
+		CloseHandle(hFileMapping);
+
+		FileBufferType = FILEBUFFER_MAPPED_VIEW;
+	}
+	else
 	{
-		LOG("ReadFile failed (error %u)\n", GetLastError());
-		ShowError(MSGID_CANT_LOAD_FILE, FUNCID_READ_FILE, GetLastError());
-		HeapFree(GetProcessHeap(), 0, pFile);
-		CloseHandle(hFile);
-		return false;
+		//  ,       
+		pFile = (PBYTE) HeapAlloc(GetProcessHeap(), 0, cbFile);
+
+		if (pFile == NULL)
+		{
+			m_LastResult = MIDIFILE_CANT_ALLOC_MEMORY;
+			LOG("HeapAlloc failed\n");
+			ReportLastError(pszFileName);
+			CloseHandle(hFile);
+			return false;
+		}
+
+		DWORD cbRead;
+
+		//       
+		if (!ReadFile(hFile, pFile, cbFile, &cbRead, NULL))
+		{
+			m_LastSystemError = GetLastError();
+			m_LastFunctionId = FUNCID_READ_FILE;
+			LOG("ReadFile failed (error %u)\n", m_LastSystemError);
+			ReportLastError(pszFileName);
+			HeapFree(GetProcessHeap(), 0, pFile);
+			CloseHandle(hFile);
+			return false;
+		}
+
+		FileBufferType = FILEBUFFER_HEAP;
 	}
 
 	//    
 	CloseHandle(hFile);
 
+	*ppFile = pFile;
+	*pcbFile = cbFile;
+	*pFileBufferType = FileBufferType;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    AssignSongFile
+*
+*   
+*       pszFileName -   ,  ,    
+*					    
+*       pFile -        
+*       cbFile -      
+*       FileBufferType -       
+*       DefaultCodePage -       
+*       ConcordNoteChoice -      (.  LoadFile)
+*
+*    
+*       true,      ;  false,   .
+*
+*      MidiFile         .
+*            MidiFile,   
+*    .
+*
+****************************************************************************************/
+
+bool SongFile::AssignSongFile(
+	__in LPCTSTR pszFileName,
+	__in PBYTE pFile,
+	__in DWORD cbFile,
+	__in FILEBUFFERTYPE FileBufferType,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice)
+{
 	//    MidiFile
 	m_pMidiFile = new MidiFile;
 
 	if (m_pMidiFile == NULL)
 	{
+		m_LastResult = MIDIFILE_CANT_ALLOC_MEMORY;
 		LOG("operator new failed\n");
-		ShowError(MSGID_CANT_ALLOC_MEMORY);
-		HeapFree(GetProcessHeap(), 0, pFile);
+		ReportLastError(pszFileName);
+		FreeFileBuffer(pFile, FileBufferType);
 		return false;
 	}
 
@@ -248,28 +612,173 @@ bool SongFile::LoadFile(
 	//      
 	m_pMidiFile->SetConcordNoteChoice(ConcordNoteChoice);
 
+	//  ,    ,   
+	m_pMidiFile->SetLoadControl(m_pStageProc, m_pStageContext, m_pCancelFlag);
+
 	//        
-	MIDIFILERESULT Result = m_pMidiFile->AssignFile(pFile, cbFile);
+	MIDIFILERESULT Result = m_pMidiFile->AssignFile(pFile, cbFile, FileBufferType);
+
+	m_LastResult = Result;
 
 	//   AssignFile  ,  
 	if (Result == MIDIFILE_SUCCESS) return true;
 
 	//   AssignFile   ,     
-	HeapFree(GetProcessHeap(), 0, pFile);
+	FreeFileBuffer(pFile, FileBufferType);
+
+	ReportLastError(pszFileName);
+
+	return false;
+}
+
+/****************************************************************************************
+*
+*    CheckCancelled
+*
+*   
+*       
+*
+*    
+*       true,   ;  false.
+*
+*     ,   SetLoadControl.  
+*   ,    MIDIFILE_CANCELLED,   
+*   GetLastResult.
+*
+****************************************************************************************/
+
+bool SongFile::CheckCancelled()
+{
+	if (m_pCancelFlag == NULL || *m_pCancelFlag == 0) return false;
+
+	LOG("loading cancelled\n");
+
+	m_LastResult = MIDIFILE_CANCELLED;
+	m_LastSystemError = ERROR_SUCCESS;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    ReportLastError
+*
+*   
+*       pszFileName -        NULL
+*
+*    
+*       
+*
+*         (.  ShowLoadError),  
+*      (.  SetLoadControl).
+*
+****************************************************************************************/
+
+void SongFile::ReportLastError(
+	__in_opt LPCTSTR pszFileName)
+{
+	if (m_pCancelFlag != NULL) return;
+
+	ShowLoadError(pszFileName, m_LastResult, m_LastSystemError, m_LastFunctionId);
+}
+
+/****************************************************************************************
+*
+*    GetLastResult
+*
+*   
+*       pSystemError -   ,      
+*                       , -     , 
+*                      ERROR_SUCCESS,      ;
+*                           NULL;    
+*                        NULL
+*       pFunctionId -   ,     
+*                        (. FUNCTIONID);    
+*                      NULL;       NULL
+*
+*    
+*       ,    MidiFile::AssignFile    ,
+*        MIDIFILE_CANT_ALLOC_MEMORY,        
+*           .     - 
+*        ,   MIDIFILE_SUCCESS,   
+*         ,     pSystemError.
+*
+*         LoadFile.  ,
+*          (,  
+*    )      (.  SongLoader).
+*
+****************************************************************************************/
+
+MIDIFILERESULT SongFile::GetLastResult(
+	__out_opt DWORD *pSystemError,
+	__out_opt DWORD *pFunctionId)
+{
+	if (pSystemError != NULL) *pSystemError = m_LastSystemError;
+	if (pFunctionId != NULL) *pFunctionId = m_LastFunctionId;
+
+	return m_LastResult;
+}
+
+/****************************************************************************************
+*
+*    ShowLoadError
+*
+*   
+*       pszFileName -   ,  ,    
+*					    ;      
+*                      ;      NULL
+*       Result -   (.  GetLastResult)
+*       SystemError -      ERROR_SUCCESS
+*       FunctionId -    (. FUNCTIONID)
+*
+*    
+*       
+*
+*          ,   
+*   GetLastResult.     ,    . 
+*       .
+*
+****************************************************************************************/
+
+void SongFile::ShowLoadError(
+	__in_opt LPCTSTR pszFileName,
+	__in MIDIFILERESULT Result,
+	__in DWORD SystemError,
+	__in DWORD FunctionId)
+{
+	if (SystemError != ERROR_SUCCESS)
+	{
+		if (FunctionId == FUNCID_CREATE_FILE)
+		{
+			ShowError(MSGID_CANT_OPEN_FILE, SystemError);
+		}
+		else
+		{
+			ShowError(MSGID_CANT_LOAD_FILE, (FUNCTIONID) FunctionId, SystemError);
+		}
+
+		return;
+	}
 
 	switch (Result)
 	{
 		case MIDIFILE_INVALID_FORMAT:
 		{
-			LPCTSTR pszExtension = GetFileNameExtension(pszFileName);
+			LPCTSTR pszExtension = NULL;
+
+			if (pszFileName != NULL) pszExtension = GetFileNameExtension(pszFileName);
 
-			if (_tcsicmp(pszExtension, TEXT(".mid")) == 0 ||
-				_tcsicmp(pszExtension, TEXT(".midi")) == 0 ||
-				_tcsicmp(pszExtension, TEXT(".rmi")) == 0)
+			if (pszExtension == NULL)
+			{
+				ShowError(MSGID_UNSUPPORTED_FILE_FORMAT);
+			}
+			else if (_tcsicmp(pszExtension, TEXT("mid")) == 0 ||
+				_tcsicmp(pszExtension, TEXT("midi")) == 0 ||
+				_tcsicmp(pszExtension, TEXT("rmi")) == 0)
 			{
 				ShowError(MSGID_CORRUPTED_MIDI_FILE);
 			}
-			else if (_tcsicmp(pszExtension, TEXT(".kar")) == 0)
+			else if (_tcsicmp(pszExtension, TEXT("kar")) == 0)
 			{
 				ShowError(MSGID_CORRUPTED_KAR_FILE);
 			}
@@ -296,9 +805,110 @@ bool SongFile::LoadFile(
 		case MIDIFILE_CANT_ALLOC_MEMORY:
 			ShowError(MSGID_CANT_ALLOC_MEMORY);
 			break;
+
+		case MIDIFILE_CANCELLED:
+			//   ,     
+			break;
 	}
+}
 
-	return false;
+/****************************************************************************************
+*
+*    GetVocalPartCount
+*
+*   
+*       
+*
+*    
+*         ,    ,  ,  
+*        .
+*
+*       , .. ,  
+*       .
+*
+****************************************************************************************/
+
+DWORD SongFile::GetVocalPartCount()
+{
+	if (m_pMidiFile == NULL) return 0;
+
+	return m_pMidiFile->GetVocalPartCount();
+}
+
+/****************************************************************************************
+*
+*    GetPrunedCandidateCount
+*
+*   
+*       
+*
+*    
+*         - ,  ,  ,   
+*       .
+*
+*      - ,     
+*       ,        
+*    .
+*
+****************************************************************************************/
+
+DWORD SongFile::GetPrunedCandidateCount()
+{
+	if (m_pMidiFile == NULL) return 0;
+
+	return m_pMidiFile->GetPrunedCandidateCount();
+}
+
+/****************************************************************************************
+*
+*    GetMemorySize
+*
+*   
+*       
+*
+*    
+*          .
+*
+*     ,      MIDI-
+*   (.  MidiFile::GetMemorySize).
+*
+****************************************************************************************/
+
+DWORD SongFile::GetMemorySize()
+{
+	DWORD cbMemory = sizeof(SongFile);
+
+	if (m_pMidiFile != NULL) cbMemory += sizeof(MidiFile) + m_pMidiFile->GetMemorySize();
+
+	return cbMemory;
+}
+
+/****************************************************************************************
+*
+*    GetVocalPartInfo
+*
+*   
+*        ,    MidiFile::GetVocalPartInfo.
+*
+*    
+*       true,      iVocalPart ; false,   
+*          .
+*
+*         .
+*
+****************************************************************************************/
+
+bool SongFile::GetVocalPartInfo(
+	__in DWORD iVocalPart,
+	__out_opt DWORD *piTrack,
+	__out_opt DWORD *pChannel,
+	__out_opt DWORD *pInstrument,
+	__out_opt double *pPartLyricDistance)
+{
+	if (m_pMidiFile == NULL) return false;
+
+	return m_pMidiFile->GetVocalPartInfo(iVocalPart, piTrack, pChannel, pInstrument,
+		pPartLyricDistance);
 }
 
 /****************************************************************************************
@@ -308,21 +918,67 @@ bool SongFile::LoadFile(
 *   
 *       QuantizeStepDenominator -  ,    ,
 *                                     
+*       pUsedQuantizeStepDenominator -   ,    
+*                                         ,   
+*                                         ;  
+*                                         NULL;   
+*                                         NULL
+*       iVocalPart -   ,     (. 
+*                    MidiFile::CreateSong);      
+*                    
+*       cMaxMeasures -     ,   
+*                       (.  MidiFile::CreateSong);  , 
+*                        ;      
+*                      
+*       pbTruncated -   ,     true, 
+*                         cMaxMeasures ;  
+*                      NULL;       NULL
 *
 *    
 *            Song;  NULL,    
-*       .
+*       ,      iVocalPart    
+*       .
 *
-*   C   Song,   .
+*   C   Song,   .   ,
+*             .
+*
+*     (.  SetLoadControl)     
+*   :        .
 *
 ****************************************************************************************/
 
 Song *SongFile::CreateSong(
-	__in DWORD QuantizeStepDenominator)
+	__in DWORD QuantizeStepDenominator,
+	__out_opt DWORD *pUsedQuantizeStepDenominator,
+	__in DWORD iVocalPart,
+	__in DWORD cMaxMeasures,
+	__out_opt bool *pbTruncated)
 {
+	if (m_pMidiFile == NULL || iVocalPart >= m_pMidiFile->GetVocalPartCount())
+	{
+		LOG("vocal part %u not found\n", iVocalPart);
+		return NULL;
+	}
+
 	//  ,      
 	DWORD CurQuantizeStepDenominator = QuantizeStepDenominator;
 
+	//    ,      
+	//   
+	DWORD UsedQuantizeStepDenominator;
+
+	//   ()   Song;   
+	// MIDI-  ,        
+	Song *pSourceSong = m_pMidiFile->CreateSong(iVocalPart, cMaxMeasures, pbTruncated);
+
+	if (pSourceSong == NULL)
+	{
+		LOG("MidiFile::CreateSong failed\n");
+		m_LastResult = MIDIFILE_CANT_ALLOC_MEMORY;
+		ReportLastError(NULL);
+		return NULL;
+	}
+
 	//     Song
 	Song *pSong = NULL;
 
@@ -333,16 +989,26 @@ Song *SongFile::CreateSong(
 		//    Song,    
 		if (pSong != NULL) delete pSong;
 
-		//     Song
-		pSong = m_pMidiFile->CreateSong();
+		if (CheckCancelled())
+		{
+			delete pSourceSong;
+			return NULL;
+		}
+
+		//     Song
+		pSong = pSourceSong->Duplicate();
 
 		if (pSong == NULL)
 		{
-			LOG("MidiFile::CreateSong failed\n");
-			ShowError(MSGID_CANT_ALLOC_MEMORY);
+			LOG("Song::Duplicate failed\n");
+			m_LastResult = MIDIFILE_CANT_ALLOC_MEMORY;
+			ReportLastError(NULL);
+			delete pSourceSong;
 			return NULL;
 		}
 
+		UsedQuantizeStepDenominator = CurQuantizeStepDenominator;
+
 		//         ,   
 		//      
 		if (pSong->Quantize(CurQuantizeStepDenominator)) break;
@@ -355,11 +1021,25 @@ Song *SongFile::CreateSong(
 	}
 	while (CurQuantizeStepDenominator <= 256);
 
+	delete pSourceSong;
+
+	if (pUsedQuantizeStepDenominator != NULL)
+	{
+		*pUsedQuantizeStepDenominator = UsedQuantizeStepDenominator;
+	}
+
+	if (CheckCancelled())
+	{
+		delete pSong;
+		return NULL;
+	}
+
 	//         
 	if (!pSong->HyphenateLyric())
 	{
 		LOG("Song::HyphenateLyric failed\n");
-		ShowError(MSGID_CANT_ALLOC_MEMORY);
+		m_LastResult = MIDIFILE_CANT_ALLOC_MEMORY;
+		ReportLastError(NULL);
 		delete pSong;
 		return NULL;
 	}
@@ -367,6 +1047,89 @@ Song *SongFile::CreateSong(
 	return pSong;
 }
 
+/****************************************************************************************
+*
+*    IsSongIncomplete
+*
+*   
+*       
+*
+*    
+*       true,   LoadSong    ;  false.
+*
+*    true,  ,   LoadSong,     
+*      CompleteSong.
+*
+****************************************************************************************/
+
+bool SongFile::IsSongIncomplete()
+{
+	return m_bIsSongIncomplete;
+}
+
+/****************************************************************************************
+*
+*    CompleteSong
+*
+*   
+*       pUsedQuantizeStepDenominator -   ,    
+*                                         ,   
+*                                         ;  
+*                                         NULL;   
+*                                         NULL
+*
+*    
+*            Song;  NULL,  , 
+*        LoadSong,    ,     
+*       ( GetLastResult  MIDIFILE_CANCELLED).
+*
+*     ,     LoadSong,     
+*   .       ,    , 
+*        ,        
+*    .
+*
+****************************************************************************************/
+
+Song *SongFile::CompleteSong(
+	__out_opt DWORD *pUsedQuantizeStepDenominator)
+{
+	if (!m_bIsSongIncomplete) return NULL;
+
+	//    ,     
+	DWORD UsedQuantizeStepDenominator;
+
+	Song *pSong = CreateSong(m_QuantizeStepDenominator, &UsedQuantizeStepDenominator);
+
+	if (pSong == NULL)
+	{
+		LOG("SongFile::CreateSong failed\n");
+		return NULL;
+	}
+
+	//     ,         
+	if (CheckCancelled())
+	{
+		delete pSong;
+		return NULL;
+	}
+
+	m_bIsSongIncomplete = false;
+
+	//      
+	if (!SongCache_StoreSong(m_SongCacheKey, m_cbSongFile, pSong,
+		UsedQuantizeStepDenominator))
+	{
+		LOG("SongCache_StoreSong failed\n");
+	}
+
+	if (pUsedQuantizeStepDenominator != NULL)
+	{
+		*pUsedQuantizeStepDenominator = UsedQuantizeStepDenominator;
+	}
+
+	return pSong;
+}
+
 /****************************************************************************************
 *
 *    Free
@@ -388,6 +1151,8 @@ void SongFile::Free()
 		delete m_pMidiFile;
 		m_pMidiFile = NULL;
 	}
+
+	m_bIsSongIncomplete = false;
 }
 
 /****************************************************************************************
@@ -422,3 +1187,34 @@ static LPCTSTR GetFileNameExtension(
 
 	return NULL;
 }
+
+/****************************************************************************************
+*
+*    FreeFileBuffer
+*
+*   
+*       pFile -   ,      
+*       FileBufferType -     : FILEBUFFER_HEAP - 
+*                          HeapAlloc, FILEBUFFER_MAPPED_VIEW - 
+*                          
+*
+*    
+*       
+*
+*    ,      .
+*
+****************************************************************************************/
+
+static void FreeFileBuffer(
+	__in PBYTE pFile,
+	__in FILEBUFFERTYPE FileBufferType)
+{
+	if (FileBufferType == FILEBUFFER_MAPPED_VIEW)
+	{
+		UnmapViewOfFile(pFile);
+	}
+	else
+	{
+		HeapFree(GetProcessHeap(), 0, pFile);
+	}
+}
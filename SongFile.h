@@ -8,11 +8,81 @@
 *
 ****************************************************************************************/
 
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//     
+enum LOADFILEMODE
+{
+	LOADFILE_READ, //    ,   HeapAlloc
+	LOADFILE_MAP //       
+};
+
+/****************************************************************************************
+*
+*    SongFile
+*
+****************************************************************************************/
+
 class SongFile
 {
 	//     MidiFile
 	MidiFile *m_pMidiFile;
 
+	//    
+	MIDIFILERESULT m_LastResult;
+
+	//    , -     , 
+	// ERROR_SUCCESS,     
+	DWORD m_LastSystemError;
+
+	//    (. FUNCTIONID),    
+	// m_LastSystemError
+	DWORD m_LastFunctionId;
+
+	// true,   LoadSong        
+	//  CompleteSong
+	bool m_bIsSongIncomplete;
+
+	//     ,        
+	// ,    CompleteSong  
+	ULONGLONG m_SongCacheKey;
+	DWORD m_cbSongFile;
+	DWORD m_QuantizeStepDenominator;
+
+	// ,        MidiFile,  
+	//      (.  SetLoadControl)
+	MIDIFILESTAGEPROC m_pStageProc;
+	LPVOID m_pStageContext;
+	volatile LONG *m_pCancelFlag;
+
+	//      
+	bool ReadSongFile(
+		__in LPCTSTR pszFileName,
+		__in LOADFILEMODE LoadMode,
+		__out PBYTE *ppFile,
+		__out DWORD *pcbFile,
+		__out FILEBUFFERTYPE *pFileBufferType);
+
+	//          MidiFile
+	bool AssignSongFile(
+		__in LPCTSTR pszFileName,
+		__in PBYTE pFile,
+		__in DWORD cbFile,
+		__in FILEBUFFERTYPE FileBufferType,
+		__in UINT DefaultCodePage,
+		__in CONCORD_NOTE_CHOICE ConcordNoteChoice);
+
+	//  true,   ,    MIDIFILE_CANCELLED
+	bool CheckCancelled();
+
+	//      ,     
+	void ReportLastError(
+		__in_opt LPCTSTR pszFileName);
+
 public:
 
 	SongFile();
@@ -26,15 +96,71 @@ public:
 	bool SetConcordNoteChoice(
 		__in CONCORD_NOTE_CHOICE ConcordNoteChoice);
 
+	//  ,     ,   
+	void SetLoadControl(
+		__in_opt MIDIFILESTAGEPROC pStageProc,
+		__in_opt LPVOID pStageContext,
+		__in_opt volatile LONG *pCancelFlag);
+
 	//    
 	bool LoadFile(
 		__in LPCTSTR pszFileName,
 		__in UINT DefaultCodePage,
-		__in CONCORD_NOTE_CHOICE ConcordNoteChoice);
+		__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+		__in LOADFILEMODE LoadMode = LOADFILE_READ);
+
+	//     
+	MIDIFILERESULT GetLastResult(
+		__out_opt DWORD *pSystemError = NULL,
+		__out_opt DWORD *pFunctionId = NULL);
+
+	//      
+	static void ShowLoadError(
+		__in_opt LPCTSTR pszFileName,
+		__in MIDIFILERESULT Result,
+		__in DWORD SystemError,
+		__in DWORD FunctionId);
+
+	//     
+	DWORD GetVocalPartCount();
+
+	//   ,      
+	DWORD GetPrunedCandidateCount();
+
+	//       
+	bool GetVocalPartInfo(
+		__in DWORD iVocalPart,
+		__out_opt DWORD *piTrack,
+		__out_opt DWORD *pChannel,
+		__out_opt DWORD *pInstrument,
+		__out_opt double *pPartLyricDistance);
 
 	//    Song,   
 	Song *CreateSong(
-		__in DWORD QuantizeStepDenominator);
+		__in DWORD QuantizeStepDenominator,
+		__out_opt DWORD *pUsedQuantizeStepDenominator = NULL,
+		__in DWORD iVocalPart = 0,
+		__in DWORD cMaxMeasures = 0,
+		__out_opt bool *pbTruncated = NULL);
+
+	//      ,    ,    
+	Song *LoadSong(
+		__in LPCTSTR pszFileName,
+		__in UINT DefaultCodePage,
+		__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+		__in DWORD QuantizeStepDenominator,
+		__out_opt DWORD *pUsedQuantizeStepDenominator = NULL,
+		__in DWORD cPreviewMeasures = 0);
+
+	//  true,  ,   LoadSong,   
+	bool IsSongIncomplete();
+
+	//   ,     LoadSong
+	Song *CompleteSong(
+		__out_opt DWORD *pUsedQuantizeStepDenominator = NULL);
+
+	//   ,  
+	DWORD GetMemorySize();
 
 	//    
 	void Free();
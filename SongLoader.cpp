@@ -0,0 +1,625 @@
+/****************************************************************************************
+*
+*     SongLoader
+*
+*            ,   
+*       .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+#include <tchar.h>
+
+#include "Log.h"
+#include "Trace.h"
+#include "Song.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiPart.h"
+#include "MidiLyric.h"
+#include "MidiSong.h"
+#include "MidiFile.h"
+#include "SongCache.h"
+#include "SongFile.h"
+#include "SongLoader.h"
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+SongLoader::SongLoader()
+{
+	m_pLoadProc = NULL;
+	m_pLoadContext = NULL;
+
+	m_hThread = NULL;
+	m_bCancelled = 0;
+	m_bIsLoading = false;
+	m_iLoad = 0;
+
+	m_pszFileName[0] = 0;
+	m_DefaultCodePage = CP_ACP;
+	m_ConcordNoteChoice = CHOOSE_MIN_NOTE_NUMBER;
+	m_QuantizeStepDenominator = 32;
+	m_cPreviewMeasures = 0;
+	m_iVocalPart = 0;
+
+	m_pPreviewSong = NULL;
+	m_pSongFile = NULL;
+	m_pSong = NULL;
+
+	m_LastResult = MIDIFILE_SUCCESS;
+	m_LastSystemError = ERROR_SUCCESS;
+	m_LastFunctionId = 0;
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*          .
+*
+****************************************************************************************/
+
+SongLoader::~SongLoader()
+{
+	Cancel();
+}
+
+/****************************************************************************************
+*
+*    SetLoadProc
+*
+*   
+*       pLoadProc -   ,      , 
+*                   NULL
+*       pLoadContext - ,    pLoadProc
+*
+*    
+*       
+*
+*    ,      .  
+*          (.  GetCurrentLoad),  
+*    .     ;  
+*          ,  ,  ,
+*       ,     
+*   .   ,    .
+*
+****************************************************************************************/
+
+void SongLoader::SetLoadProc(
+	__in_opt SONGLOADPROC pLoadProc,
+	__in_opt LPVOID pLoadContext)
+{
+	m_pLoadProc = pLoadProc;
+	m_pLoadContext = pLoadContext;
+}
+
+/****************************************************************************************
+*
+*    Start
+*
+*   
+*       pszFileName -   ,  ,    
+*					    
+*       DefaultCodePage -       
+*       ConcordNoteChoice -      (. 
+*                           SongFile::LoadFile)
+*       QuantizeStepDenominator -  ,    ,
+*                                     
+*       cPreviewMeasures -    ,    
+*                           (.  SongFile::LoadSong);  , 
+*                              ;   
+*                             
+*       iVocalPart -   ,    ;   
+*                     ,       ,  MIDI- 
+*                    ,      ;  
+*                      ,      ; 
+*                         
+*
+*    
+*       
+*
+*     ,   ,      
+*        .     ,  
+*    ,   .
+*
+****************************************************************************************/
+
+void SongLoader::Start(
+	__in LPCTSTR pszFileName,
+	__in UINT DefaultCodePage,
+	__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+	__in DWORD QuantizeStepDenominator,
+	__in DWORD cPreviewMeasures,
+	__in DWORD iVocalPart)
+{
+	Cancel();
+
+	lstrcpyn(m_pszFileName, pszFileName, MAX_PATH);
+	m_DefaultCodePage = DefaultCodePage;
+	m_ConcordNoteChoice = ConcordNoteChoice;
+	m_QuantizeStepDenominator = QuantizeStepDenominator;
+	m_cPreviewMeasures = cPreviewMeasures;
+	m_iVocalPart = iVocalPart;
+
+	m_LastResult = MIDIFILE_SUCCESS;
+	m_LastSystemError = ERROR_SUCCESS;
+	m_LastFunctionId = 0;
+
+	m_bCancelled = 0;
+	m_bIsLoading = true;
+	m_iLoad++;
+
+	m_hThread = CreateThread(NULL, 0, LoadThreadProc, this, 0, NULL);
+
+	if (m_hThread == NULL)
+	{
+		LOG("CreateThread failed (error %u)\n", GetLastError());
+		Load();
+	}
+}
+
+/****************************************************************************************
+*
+*    Cancel
+*
+*   
+*       
+*
+*    
+*       
+*
+*         ,     . 
+*    ,    ;   
+*    ,    -  (. 
+*   MidiFile::SetLoadControl),    .
+*
+****************************************************************************************/
+
+void SongLoader::Cancel()
+{
+	if (!m_bIsLoading) return;
+
+	InterlockedExchange(&m_bCancelled, 1);
+
+	WaitForThread();
+	FreeResult();
+
+	m_bIsLoading = false;
+}
+
+/****************************************************************************************
+*
+*    IsLoading
+*
+*   
+*       
+*
+*    
+*       true,         ;  false.
+*
+*    true,          
+*   TakeResult.
+*
+****************************************************************************************/
+
+bool SongLoader::IsLoading()
+{
+	return m_bIsLoading;
+}
+
+/****************************************************************************************
+*
+*    GetCurrentLoad
+*
+*   
+*       
+*
+*    
+*         .
+*
+*      , .. ,   
+*   SONGLOADPROC     .
+*
+****************************************************************************************/
+
+DWORD SongLoader::GetCurrentLoad()
+{
+	return m_iLoad;
+}
+
+/****************************************************************************************
+*
+*    GetFileName
+*
+*   
+*       
+*
+*    
+*          .
+*
+*     ,    (  ) .
+*
+****************************************************************************************/
+
+LPCTSTR SongLoader::GetFileName()
+{
+	return m_pszFileName;
+}
+
+/****************************************************************************************
+*
+*    TakePreviewSong
+*
+*   
+*       
+*
+*    
+*           Song,    ,  NULL,
+*            ,     .
+*
+*     ,    .   
+*     .     
+*   SONGLOAD_EVENT_PREVIEW,    .
+*
+****************************************************************************************/
+
+Song *SongLoader::TakePreviewSong()
+{
+	return (Song *) InterlockedExchangePointer((PVOID volatile *) &m_pPreviewSong, NULL);
+}
+
+/****************************************************************************************
+*
+*    TakeResult
+*
+*   
+*       ppSongFile -   ,      
+*                      SongFile,    
+*       ppSong -   ,      
+*                  
+*       piVocalPart -   ,     
+*                      ,    ;   
+*                       NULL;       NULL
+*
+*    
+*       true,    ; false,    , 
+*             .
+*
+*         .   
+*     .  ,     
+*   TakePreviewSong, .   SONGLOAD_EVENT_FINISHED 
+*      .     ,  
+*     GetLastResult.
+*
+****************************************************************************************/
+
+bool SongLoader::TakeResult(
+	__out SongFile **ppSongFile,
+	__out Song **ppSong,
+	__out_opt DWORD *piVocalPart)
+{
+	*ppSongFile = NULL;
+	*ppSong = NULL;
+
+	if (piVocalPart != NULL) *piVocalPart = 0;
+
+	if (!m_bIsLoading) return false;
+
+	WaitForThread();
+
+	*ppSongFile = m_pSongFile;
+	*ppSong = m_pSong;
+
+	if (piVocalPart != NULL) *piVocalPart = m_iVocalPart;
+
+	m_pSongFile = NULL;
+	m_pSong = NULL;
+
+	FreeResult();
+
+	m_bIsLoading = false;
+
+	return *ppSong != NULL;
+}
+
+/****************************************************************************************
+*
+*    GetLastResult
+*
+*   
+*       pSystemError -   ,      
+*                         ERROR_SUCCESS (. 
+*                      SongFile::GetLastResult);      NULL;
+*                            NULL
+*       pFunctionId -   ,     
+*                       ;      NULL;
+*                           NULL
+*
+*    
+*        : MIDIFILE_SUCCESS,     
+*          , MIDIFILE_CANCELLED,   , 
+*         (.  SongFile::GetLastResult).
+*
+*     ,   TakeResult.   
+*      ,       ;
+*           SongFile::ShowLoadError.
+*
+****************************************************************************************/
+
+MIDIFILERESULT SongLoader::GetLastResult(
+	__out_opt DWORD *pSystemError,
+	__out_opt DWORD *pFunctionId)
+{
+	if (pSystemError != NULL) *pSystemError = m_LastSystemError;
+	if (pFunctionId != NULL) *pFunctionId = m_LastFunctionId;
+
+	return m_LastResult;
+}
+
+/****************************************************************************************
+*
+*    LoadThreadProc
+*
+*   
+*       lpParameter -     SongLoader
+*
+*    
+*       .
+*
+*     .
+*
+****************************************************************************************/
+
+DWORD WINAPI SongLoader::LoadThreadProc(
+	__in LPVOID lpParameter)
+{
+	SongLoader *pLoader = (SongLoader *) lpParameter;
+
+	pLoader->Load();
+
+	TRACE_THREAD_END();
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    Load
+*
+*   
+*       
+*
+*    
+*       
+*
+*      ,   Start,     .
+*          SongFile::LoadSong,  
+*     -  SongFile::LoadFile  SongFile::CreateSong,    
+*         .     ,
+*        ( SONGLOAD_EVENT_PREVIEW),  
+*     .      SONGLOAD_EVENT_FINISHED 
+*   ,  1,   ,  0,    
+*    .
+*
+****************************************************************************************/
+
+void SongLoader::Load()
+{
+	TRACE_ZONE("SongLoader::Load");
+
+	Notify(SONGLOAD_EVENT_STAGE, SONGLOAD_STAGE_READ_FILE);
+
+	//    SongFile
+	SongFile *pSongFile = new SongFile;
+
+	if (pSongFile == NULL)
+	{
+		LOG("operator new failed\n");
+		m_LastResult = MIDIFILE_CANT_ALLOC_MEMORY;
+		Notify(SONGLOAD_EVENT_FINISHED, 0);
+		return;
+	}
+
+	pSongFile->SetLoadControl(StageProc, this, &m_bCancelled);
+
+	Song *pSong = NULL;
+
+	if (m_iVocalPart != 0)
+	{
+		//  MIDI-       
+		if (!pSongFile->LoadFile(m_pszFileName, m_DefaultCodePage, m_ConcordNoteChoice))
+		{
+			LOG("SongFile::LoadFile failed\n");
+		}
+		else if (m_bCancelled == 0)
+		{
+			//   ,      
+			if (m_iVocalPart >= pSongFile->GetVocalPartCount()) m_iVocalPart = 0;
+
+			pSong = pSongFile->CreateSong(m_QuantizeStepDenominator, NULL, m_iVocalPart);
+
+			if (pSong == NULL) LOG("SongFile::CreateSong failed\n");
+		}
+	}
+	else
+	{
+		//          
+		pSong = pSongFile->LoadSong(m_pszFileName, m_DefaultCodePage,
+			m_ConcordNoteChoice, m_QuantizeStepDenominator, NULL, m_cPreviewMeasures);
+
+		if (pSong == NULL)
+		{
+			LOG("SongFile::LoadSong failed\n");
+		}
+		else if (pSongFile->IsSongIncomplete())
+		{
+			//       
+			InterlockedExchangePointer((PVOID volatile *) &m_pPreviewSong, pSong);
+			Notify(SONGLOAD_EVENT_PREVIEW, 0);
+
+			pSong = NULL;
+
+			if (m_bCancelled == 0)
+			{
+				Notify(SONGLOAD_EVENT_STAGE, SONGLOAD_STAGE_COMPLETE_SONG);
+
+				pSong = pSongFile->CompleteSong();
+
+				if (pSong == NULL) LOG("SongFile::CompleteSong failed\n");
+			}
+		}
+	}
+
+	if (pSong == NULL)
+	{
+		//   ;      
+		m_LastResult = pSongFile->GetLastResult(&m_LastSystemError, &m_LastFunctionId);
+
+		if (m_bCancelled != 0)
+		{
+			m_LastResult = MIDIFILE_CANCELLED;
+			m_LastSystemError = ERROR_SUCCESS;
+		}
+
+		delete pSongFile;
+		pSongFile = NULL;
+	}
+	else
+	{
+		//     ,     
+		//  SongFile,      
+		pSongFile->SetLoadControl(NULL, NULL, NULL);
+	}
+
+	m_pSongFile = pSongFile;
+	m_pSong = pSong;
+
+	Notify(SONGLOAD_EVENT_FINISHED, pSong != NULL ? 1 : 0);
+}
+
+/****************************************************************************************
+*
+*    StageProc
+*
+*   
+*       Stage -       MidiFile
+*       pContext -     SongLoader
+*
+*    
+*       
+*
+*           MidiFile   
+*     .
+*
+****************************************************************************************/
+
+void SongLoader::StageProc(
+	__in MIDIFILESTAGE Stage,
+	__in LPVOID pContext)
+{
+	SongLoader *pLoader = (SongLoader *) pContext;
+
+	//             ,
+	//   SONGLOAD_STAGE_ATTACH_TRACKS
+	pLoader->Notify(SONGLOAD_EVENT_STAGE, SONGLOAD_STAGE_ATTACH_TRACKS + Stage);
+}
+
+/****************************************************************************************
+*
+*    Notify
+*
+*   
+*       Event - 
+*       Param -  
+*
+*    
+*       
+*
+*        ,   SetLoadProc.
+*
+****************************************************************************************/
+
+void SongLoader::Notify(
+	__in SONGLOADEVENT Event,
+	__in DWORD Param)
+{
+	if (m_pLoadProc != NULL) m_pLoadProc(m_iLoad, Event, Param, m_pLoadContext);
+}
+
+/****************************************************************************************
+*
+*    WaitForThread
+*
+*   
+*       
+*
+*    
+*       
+*
+*      ,   .    
+*        .
+*
+****************************************************************************************/
+
+void SongLoader::WaitForThread()
+{
+	if (m_hThread == NULL) return;
+
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
+}
+
+/****************************************************************************************
+*
+*    FreeResult
+*
+*   
+*       
+*
+*    
+*       
+*
+*        ,    . ,
+*       .
+*
+****************************************************************************************/
+
+void SongLoader::FreeResult()
+{
+	Song *pPreviewSong = TakePreviewSong();
+
+	if (pPreviewSong != NULL) delete pPreviewSong;
+
+	if (m_pSong != NULL)
+	{
+		delete m_pSong;
+		m_pSong = NULL;
+	}
+
+	if (m_pSongFile != NULL)
+	{
+		delete m_pSongFile;
+		m_pSongFile = NULL;
+	}
+}
@@ -0,0 +1,157 @@
+/****************************************************************************************
+*
+*     SongLoader
+*
+*            ,   
+*       .     ,   
+*       .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//   
+enum SONGLOADSTAGE
+{
+	SONGLOAD_STAGE_READ_FILE, //        
+	SONGLOAD_STAGE_ATTACH_TRACKS, //     
+	SONGLOAD_STAGE_FIND_LYRIC, //   
+	SONGLOAD_STAGE_FIND_VOCAL_PARTS, //   
+	SONGLOAD_STAGE_COMPLETE_SONG //   ,    
+};
+
+// ,       SONGLOADPROC
+enum SONGLOADEVENT
+{
+	SONGLOAD_EVENT_STAGE, //   ;  -  SONGLOADSTAGE
+	SONGLOAD_EVENT_PREVIEW, //    (.  TakePreviewSong)
+	SONGLOAD_EVENT_FINISHED //     (.  TakeResult)
+};
+
+// ,      ;    
+typedef void (*SONGLOADPROC)(
+	__in DWORD iLoad,
+	__in SONGLOADEVENT Event,
+	__in DWORD Param,
+	__in LPVOID pContext);
+
+/****************************************************************************************
+*
+*    SongLoader
+*
+****************************************************************************************/
+
+class SongLoader
+{
+	// ,      ,   
+	SONGLOADPROC m_pLoadProc;
+	LPVOID m_pLoadContext;
+
+	//     NULL,       
+	HANDLE m_hThread;
+
+	//    
+	volatile LONG m_bCancelled;
+
+	// true,           TakeResult
+	bool m_bIsLoading;
+
+	//   ;      Start
+	DWORD m_iLoad;
+
+	//    (.  Start)
+	TCHAR m_pszFileName[MAX_PATH];
+	UINT m_DefaultCodePage;
+	CONCORD_NOTE_CHOICE m_ConcordNoteChoice;
+	DWORD m_QuantizeStepDenominator;
+	DWORD m_cPreviewMeasures;
+	DWORD m_iVocalPart;
+
+	//  ,      TakePreviewSong,  NULL
+	Song * volatile m_pPreviewSong;
+
+	//  :   SongFile    ;  
+	//  ,     
+	SongFile *m_pSongFile;
+	Song *m_pSong;
+
+	//   ,       
+	// (.  GetLastResult)
+	MIDIFILERESULT m_LastResult;
+	DWORD m_LastSystemError;
+	DWORD m_LastFunctionId;
+
+	//   
+	static DWORD WINAPI LoadThreadProc(
+		__in LPVOID lpParameter);
+
+	//  
+	void Load();
+
+	//         MidiFile
+	static void StageProc(
+		__in MIDIFILESTAGE Stage,
+		__in LPVOID pContext);
+
+	//      m_pLoadProc
+	void Notify(
+		__in SONGLOADEVENT Event,
+		__in DWORD Param);
+
+	//   
+	void WaitForThread();
+
+	//   ,    
+	void FreeResult();
+
+public:
+
+	SongLoader();
+	~SongLoader();
+
+	//  ,      
+	void SetLoadProc(
+		__in_opt SONGLOADPROC pLoadProc,
+		__in_opt LPVOID pLoadContext);
+
+	//         
+	void Start(
+		__in LPCTSTR pszFileName,
+		__in UINT DefaultCodePage,
+		__in CONCORD_NOTE_CHOICE ConcordNoteChoice,
+		__in DWORD QuantizeStepDenominator,
+		__in DWORD cPreviewMeasures = 0,
+		__in DWORD iVocalPart = 0);
+
+	//       
+	void Cancel();
+
+	//  true,         
+	bool IsLoading();
+
+	//    
+	DWORD GetCurrentLoad();
+
+	//   ,    
+	LPCTSTR GetFileName();
+
+	//   ,    
+	Song *TakePreviewSong();
+
+	//       
+	bool TakeResult(
+		__out SongFile **ppSongFile,
+		__out Song **ppSong,
+		__out_opt DWORD *piVocalPart = NULL);
+
+	//   ,   TakeResult
+	MIDIFILERESULT GetLastResult(
+		__out_opt DWORD *pSystemError = NULL,
+		__out_opt DWORD *pFunctionId = NULL);
+};
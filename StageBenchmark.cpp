@@ -0,0 +1,764 @@
+/****************************************************************************************
+*
+*           
+*
+*     MIDI-  -       (
+*      )        ,  
+*      ,     :  
+*    MidiFile (   -  ,     
+*    ),  , ,    
+*      .     
+*   ,  - .
+*
+*            , 
+*   , , 99-        ( 
+*     -  MIDI-,   -   ). 
+*     -   JSON,      
+*    .         .
+*
+*    : SingoscopeStageBench <  > [ ]
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <locale.h>
+
+#include "Log.h"
+#include "Trace.h"
+#include "Song.h"
+#include "MidiLibrary.h"
+#include "MidiTrack.h"
+#include "MidiPart.h"
+#include "MidiLyric.h"
+#include "MidiSong.h"
+#include "MidiFile.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//      
+#define DEFAULT_REPEAT_COUNT			10
+
+//     ( ,     )
+#define QUANTIZE_STEP_DENOMINATOR		32
+
+//        
+#define INITIAL_SAMPLE_ARRAY_SIZE		256
+
+//   
+#define EXIT_CODE_SUCCESS				0
+#define EXIT_CODE_SOME_FILES_FAILED		1
+#define EXIT_CODE_INVALID_ARGUMENTS		2
+#define EXIT_CODE_FATAL_ERROR			3
+
+//   
+enum STAGE
+{
+	STAGE_ASSIGN_FILE, // MidiFile::AssignFile 
+	STAGE_ATTACH_TRACKS, //    MidiFile::AssignFile
+	STAGE_FIND_LYRIC, //     MidiFile::AssignFile
+	STAGE_FIND_VOCAL_PARTS, //     MidiFile::AssignFile
+	STAGE_CREATE_SONG, // MidiFile::CreateSong
+	STAGE_QUANTIZE, // Song::Quantize
+	STAGE_EXTEND_EMPTY_NOTES, // Song::ExtendEmptyNotes
+	STAGE_HYPHENATE_LYRIC, // Song::HyphenateLyric
+	STAGE_COUNT
+};
+
+//   
+enum RUN
+{
+	RUN_COLD, //   
+	RUN_WARM, //   
+	RUN_COUNT
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,        
+struct SAMPLES
+{
+	LONGLONG *pSamples; //      
+	DWORD cSamples; //      pSamples
+	DWORD cMaxSamples; //  ,    
+	ULONGLONG cEvents; //    
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//     
+static LPCTSTR g_pszStageNames[STAGE_COUNT] =
+{
+	TEXT("AssignFile"),
+	TEXT("AttachTracks"),
+	TEXT("FindLyric"),
+	TEXT("FindVocalParts"),
+	TEXT("CreateSong"),
+	TEXT("Quantize"),
+	TEXT("ExtendEmptyNotes"),
+	TEXT("HyphenateLyric")
+};
+
+//      
+static LPCTSTR g_pszRunNames[RUN_COUNT] =
+{
+	TEXT("cold"),
+	TEXT("warm")
+};
+
+//       
+static SAMPLES g_Samples[STAGE_COUNT][RUN_COUNT];
+
+//    
+static DWORD g_cRepeats = DEFAULT_REPEAT_COUNT;
+
+//      ,    
+static DWORD g_cFiles = 0;
+static DWORD g_cFailedFiles = 0;
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static bool BenchmarkDirectory(
+	__in LPCTSTR pszDirectory);
+
+static bool BenchmarkFile(
+	__in LPCTSTR pszFileName);
+
+static bool IsSongFileName(
+	__in LPCTSTR pszFileName);
+
+static BYTE *LoadFile(
+	__in LPCTSTR pszFileName,
+	__out DWORD *pcbFile);
+
+static bool AddSample(
+	__in STAGE Stage,
+	__in RUN Run,
+	__in LONGLONG ctElapsed,
+	__in DWORD cEvents);
+
+static void PrintResults();
+
+static int __cdecl CompareSamples(
+	const void *pSample1,
+	const void *pSample2);
+
+static void FreeSamples();
+
+/****************************************************************************************
+*
+*    _tmain
+*
+*   .   main  MSDN.
+*
+****************************************************************************************/
+
+int __cdecl _tmain(
+	int argc,
+	TCHAR *argv[])
+{
+	//   OEM-,      
+	setlocale(LC_ALL, ".OCP");
+
+	if (argc < 2 || argc > 3)
+	{
+		_tprintf(TEXT("usage: SingoscopeStageBench <directory | file> [repeats]\n"));
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	if (argc == 3)
+	{
+		g_cRepeats = _tcstoul(argv[2], NULL, 10);
+
+		if (g_cRepeats == 0)
+		{
+			_tprintf(TEXT("invalid number of repeats: %s\n"), argv[2]);
+			return EXIT_CODE_INVALID_ARGUMENTS;
+		}
+	}
+
+	DWORD Attributes = GetFileAttributes(argv[1]);
+
+	if (Attributes == INVALID_FILE_ATTRIBUTES)
+	{
+		_tprintf(TEXT("cannot access %s (error %u)\n"), argv[1], GetLastError());
+		return EXIT_CODE_INVALID_ARGUMENTS;
+	}
+
+	INITLOG(TEXT("stagebenchlog.txt"));
+	INITTRACE(TEXT("stagebenchtrace.json"));
+
+	bool bSuccess;
+
+	if (Attributes & FILE_ATTRIBUTE_DIRECTORY)
+	{
+		bSuccess = BenchmarkDirectory(argv[1]);
+	}
+	else
+	{
+		bSuccess = BenchmarkFile(argv[1]);
+	}
+
+	int ExitCode = EXIT_CODE_FATAL_ERROR;
+
+	if (bSuccess)
+	{
+		PrintResults();
+
+		ExitCode = (g_cFailedFiles == 0) ? EXIT_CODE_SUCCESS :
+			EXIT_CODE_SOME_FILES_FAILED;
+	}
+
+	FreeSamples();
+
+	UNINITTRACE();
+	UNINITLOG();
+
+	return ExitCode;
+}
+
+/****************************************************************************************
+*
+*    BenchmarkDirectory
+*
+*   
+*       pszDirectory -   ,  ,    
+*                      
+*
+*    
+*       true,    ; false,     .
+*
+*               
+*    . ,    , .
+*
+****************************************************************************************/
+
+static bool BenchmarkDirectory(
+	__in LPCTSTR pszDirectory)
+{
+	//       
+	TCHAR pszPattern[MAX_PATH];
+
+	if (lstrlen(pszDirectory) + 2 >= MAX_PATH)
+	{
+		LOG("directory name is too long\n");
+		return true;
+	}
+
+	lstrcpy(pszPattern, pszDirectory);
+	lstrcat(pszPattern, TEXT("\\*"));
+
+	WIN32_FIND_DATA FindData;
+
+	HANDLE hFind = FindFirstFile(pszPattern, &FindData);
+
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		LOG("FindFirstFile failed (error %u)\n", GetLastError());
+		return true;
+	}
+
+	bool bResult = true;
+
+	do
+	{
+		bool bIsDirectory = (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+		//         
+		if (bIsDirectory)
+		{
+			if (lstrcmp(FindData.cFileName, TEXT(".")) == 0 ||
+				lstrcmp(FindData.cFileName, TEXT("..")) == 0)
+			{
+				continue;
+			}
+		}
+		else if (!IsSongFileName(FindData.cFileName))
+		{
+			continue;
+		}
+
+		//     
+		TCHAR pszFullName[MAX_PATH];
+
+		if (lstrlen(pszDirectory) + 1 + lstrlen(FindData.cFileName) >= MAX_PATH)
+		{
+			LOG("file name is too long\n");
+			continue;
+		}
+
+		lstrcpy(pszFullName, pszDirectory);
+		lstrcat(pszFullName, TEXT("\\"));
+		lstrcat(pszFullName, FindData.cFileName);
+
+		bResult = bIsDirectory ? BenchmarkDirectory(pszFullName) :
+			BenchmarkFile(pszFullName);
+
+		if (!bResult) break;
+	}
+	while (FindNextFile(hFind, &FindData));
+
+	FindClose(hFind);
+
+	return bResult;
+}
+
+/****************************************************************************************
+*
+*    BenchmarkFile
+*
+*   
+*       pszFileName -   ,  ,    
+*                     
+*
+*    
+*       true,    (  ,     ); false,
+*           .
+*
+*     g_cRepeats         
+*   .      ,     SongFile::CreateSong,
+*       ,      
+*    ,       . ,  
+*    ,       .
+*
+****************************************************************************************/
+
+static bool BenchmarkFile(
+	__in LPCTSTR pszFileName)
+{
+	g_cFiles++;
+
+	DWORD cbFile;
+
+	BYTE *pFile = LoadFile(pszFileName, &cbFile);
+
+	if (pFile == NULL)
+	{
+		g_cFailedFiles++;
+		return true;
+	}
+
+	LARGE_INTEGER StartTime, EndTime;
+
+	for (DWORD iRepeat = 0; iRepeat < g_cRepeats; iRepeat++)
+	{
+		RUN Run = (iRepeat == 0) ? RUN_COLD : RUN_WARM;
+
+		//   MidiFile   ,   ,
+		//       
+		BYTE *pFileCopy = (BYTE *) HeapAlloc(GetProcessHeap(), 0, cbFile);
+
+		if (pFileCopy == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			HeapFree(GetProcessHeap(), 0, pFile);
+			return false;
+		}
+
+		CopyMemory(pFileCopy, pFile, cbFile);
+
+		//     MidiFile
+		// --------------------------------------
+
+		MidiFile File;
+
+		QueryPerformanceCounter(&StartTime);
+
+		MIDIFILERESULT Result = File.AssignFile(pFileCopy, cbFile);
+
+		QueryPerformanceCounter(&EndTime);
+
+		if (Result != MIDIFILE_SUCCESS)
+		{
+			//       
+			HeapFree(GetProcessHeap(), 0, pFileCopy);
+			g_cFailedFiles++;
+			break;
+		}
+
+		DWORD cMidiEvents = File.GetEventCount();
+
+		bool bAdded = AddSample(STAGE_ASSIGN_FILE, Run,
+			EndTime.QuadPart - StartTime.QuadPart, cMidiEvents);
+
+		bAdded = bAdded && AddSample(STAGE_ATTACH_TRACKS, Run,
+			File.GetStageTime(MIDIFILE_STAGE_ATTACH_TRACKS), cMidiEvents);
+
+		bAdded = bAdded && AddSample(STAGE_FIND_LYRIC, Run,
+			File.GetStageTime(MIDIFILE_STAGE_FIND_LYRIC), cMidiEvents);
+
+		bAdded = bAdded && AddSample(STAGE_FIND_VOCAL_PARTS, Run,
+			File.GetStageTime(MIDIFILE_STAGE_FIND_VOCAL_PARTS), cMidiEvents);
+
+		//  
+		// -------------
+
+		QueryPerformanceCounter(&StartTime);
+
+		Song *pSourceSong = File.CreateSong();
+
+		QueryPerformanceCounter(&EndTime);
+
+		Song *pSong = (pSourceSong != NULL) ? pSourceSong->Duplicate() : NULL;
+
+		if (!bAdded || pSong == NULL)
+		{
+			LOG("cannot create song\n");
+			delete pSourceSong;
+			HeapFree(GetProcessHeap(), 0, pFile);
+			return false;
+		}
+
+		DWORD cSingingEvents = pSourceSong->GetSingingEvents(NULL, NULL, NULL);
+
+		bAdded = AddSample(STAGE_CREATE_SONG, Run, EndTime.QuadPart - StartTime.QuadPart,
+			cSingingEvents);
+
+		//   
+		// --------------------
+
+		QueryPerformanceCounter(&StartTime);
+
+		pSong->Quantize(QUANTIZE_STEP_DENOMINATOR);
+
+		QueryPerformanceCounter(&EndTime);
+
+		bAdded = bAdded && AddSample(STAGE_QUANTIZE, Run,
+			EndTime.QuadPart - StartTime.QuadPart, cSingingEvents);
+
+		QueryPerformanceCounter(&StartTime);
+
+		pSong->ExtendEmptyNotes(QUANTIZE_STEP_DENOMINATOR);
+
+		QueryPerformanceCounter(&EndTime);
+
+		bAdded = bAdded && AddSample(STAGE_EXTEND_EMPTY_NOTES, Run,
+			EndTime.QuadPart - StartTime.QuadPart, cSingingEvents);
+
+		//  
+		// -------------
+
+		QueryPerformanceCounter(&StartTime);
+
+		bool bHyphenated = pSong->HyphenateLyric();
+
+		QueryPerformanceCounter(&EndTime);
+
+		bAdded = bAdded && bHyphenated && AddSample(STAGE_HYPHENATE_LYRIC, Run,
+			EndTime.QuadPart - StartTime.QuadPart, cSingingEvents);
+
+		delete pSong;
+		delete pSourceSong;
+
+		if (!bAdded)
+		{
+			LOG("out of memory\n");
+			HeapFree(GetProcessHeap(), 0, pFile);
+			return false;
+		}
+	}
+
+	HeapFree(GetProcessHeap(), 0, pFile);
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    IsSongFileName
+*
+*   
+*       pszFileName -   ,  ,    
+*                     
+*
+*    
+*       true,      MIDI-  -; 
+*       false.
+*
+*   ,      ,     (  
+*   ,      ).
+*
+****************************************************************************************/
+
+static bool IsSongFileName(
+	__in LPCTSTR pszFileName)
+{
+	LPCTSTR pszExtension = NULL;
+
+	for (LPCTSTR pCurChar = pszFileName; *pCurChar != 0; pCurChar++)
+	{
+		if (*pCurChar == TEXT('.')) pszExtension = pCurChar;
+	}
+
+	if (pszExtension == NULL) return false;
+
+	return _tcsicmp(pszExtension, TEXT(".mid")) == 0 ||
+		_tcsicmp(pszExtension, TEXT(".midi")) == 0 ||
+		_tcsicmp(pszExtension, TEXT(".rmi")) == 0 ||
+		_tcsicmp(pszExtension, TEXT(".kar")) == 0;
+}
+
+/****************************************************************************************
+*
+*    LoadFile
+*
+*   
+*       pszFileName -   ,  ,    
+*                     
+*       pcbFile -   ,        
+*
+*    
+*          ,    ;  NULL.
+*
+*       ,    .  
+*    HeapFree.
+*
+****************************************************************************************/
+
+static BYTE *LoadFile(
+	__in LPCTSTR pszFileName,
+	__out DWORD *pcbFile)
+{
+	HANDLE hFile = CreateFile(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		LOG("CreateFile failed (error %u)\n", GetLastError());
+		return NULL;
+	}
+
+	DWORD cbFile = GetFileSize(hFile, NULL);
+
+	if (cbFile == INVALID_FILE_SIZE || cbFile == 0)
+	{
+		LOG("GetFileSize failed (error %u)\n", GetLastError());
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	BYTE *pFile = (BYTE *) HeapAlloc(GetProcessHeap(), 0, cbFile);
+
+	if (pFile == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	DWORD cbRead;
+
+	if (!ReadFile(hFile, pFile, cbFile, &cbRead, NULL) || cbRead != cbFile)
+	{
+		LOG("ReadFile failed (error %u)\n", GetLastError());
+		HeapFree(GetProcessHeap(), 0, pFile);
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	CloseHandle(hFile);
+
+	*pcbFile = cbFile;
+
+	return pFile;
+}
+
+/****************************************************************************************
+*
+*    AddSample
+*
+*   
+*       Stage -   
+*       Run -   
+*       ctElapsed -      
+*       cEvents -  ,   
+*
+*    
+*       true,    ; false,     .
+*
+*         Stage    Run.
+*
+****************************************************************************************/
+
+static bool AddSample(
+	__in STAGE Stage,
+	__in RUN Run,
+	__in LONGLONG ctElapsed,
+	__in DWORD cEvents)
+{
+	SAMPLES *pSamples = &g_Samples[Stage][Run];
+
+	//   ,       
+	if (pSamples->cSamples == pSamples->cMaxSamples)
+	{
+		DWORD cNewMaxSamples = (pSamples->cMaxSamples == 0) ?
+			INITIAL_SAMPLE_ARRAY_SIZE : pSamples->cMaxSamples * 2;
+
+		LONGLONG *pNewSamples;
+
+		if (pSamples->pSamples == NULL)
+		{
+			pNewSamples = (LONGLONG *) HeapAlloc(GetProcessHeap(), 0,
+				cNewMaxSamples * sizeof(LONGLONG));
+		}
+		else
+		{
+			pNewSamples = (LONGLONG *) HeapReAlloc(GetProcessHeap(), 0,
+				pSamples->pSamples, cNewMaxSamples * sizeof(LONGLONG));
+		}
+
+		if (pNewSamples == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return false;
+		}
+
+		pSamples->pSamples = pNewSamples;
+		pSamples->cMaxSamples = cNewMaxSamples;
+	}
+
+	pSamples->pSamples[pSamples->cSamples++] = ctElapsed;
+	pSamples->cEvents += cEvents;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    PrintResults
+*
+*   
+*       
+*
+*    
+*       
+*
+*     :       , 
+*           ,    . 
+*      .      
+*    .
+*
+****************************************************************************************/
+
+static void PrintResults()
+{
+	LARGE_INTEGER Frequency;
+	QueryPerformanceFrequency(&Frequency);
+
+	//       
+	double MillisecondsPerTick = 1000.0 / Frequency.QuadPart;
+
+	_tprintf(TEXT("{\"files\":%u,\"failed\":%u,\"repeats\":%u}\n"), g_cFiles,
+		g_cFailedFiles, g_cRepeats);
+
+	for (DWORD iStage = 0; iStage < STAGE_COUNT; iStage++)
+	{
+		for (DWORD iRun = 0; iRun < RUN_COUNT; iRun++)
+		{
+			SAMPLES *pSamples = &g_Samples[iStage][iRun];
+
+			DWORD cSamples = pSamples->cSamples;
+
+			if (cSamples == 0) continue;
+
+			qsort(pSamples->pSamples, cSamples, sizeof(LONGLONG), CompareSamples);
+
+			LONGLONG ctTotal = 0;
+			for (DWORD i = 0; i < cSamples; i++) ctTotal += pSamples->pSamples[i];
+
+			//    99-     
+			DWORD iMedian = (cSamples - 1) / 2;
+			DWORD iP99 = (DWORD) (((ULONGLONG) cSamples * 99 + 99) / 100) - 1;
+
+			double TotalSeconds = ctTotal * MillisecondsPerTick / 1000;
+
+			_tprintf(TEXT("{\"stage\":\"%s\",\"run\":\"%s\",\"samples\":%u,")
+				TEXT("\"min_ms\":%.4f,\"median_ms\":%.4f,\"p99_ms\":%.4f,")
+				TEXT("\"events\":%I64u,\"events_per_s\":%.0f}\n"),
+				g_pszStageNames[iStage], g_pszRunNames[iRun], cSamples,
+				pSamples->pSamples[0] * MillisecondsPerTick,
+				pSamples->pSamples[iMedian] * MillisecondsPerTick,
+				pSamples->pSamples[iP99] * MillisecondsPerTick,
+				pSamples->cEvents,
+				(TotalSeconds > 0) ? pSamples->cEvents / TotalSeconds : 0.0);
+		}
+	}
+}
+
+/****************************************************************************************
+*
+*    CompareSamples
+*
+*   .   compare    qsort  MSDN.
+*
+****************************************************************************************/
+
+static int __cdecl CompareSamples(
+	const void *pSample1,
+	const void *pSample2)
+{
+	LONGLONG Sample1 = *(const LONGLONG *) pSample1;
+	LONGLONG Sample2 = *(const LONGLONG *) pSample2;
+
+	if (Sample1 < Sample2) return -1;
+	if (Sample1 > Sample2) return 1;
+
+	return 0;
+}
+
+/****************************************************************************************
+*
+*    FreeSamples
+*
+*   
+*       
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+static void FreeSamples()
+{
+	for (DWORD iStage = 0; iStage < STAGE_COUNT; iStage++)
+	{
+		for (DWORD iRun = 0; iRun < RUN_COUNT; iRun++)
+		{
+			SAMPLES *pSamples = &g_Samples[iStage][iRun];
+
+			if (pSamples->pSamples != NULL)
+			{
+				HeapFree(GetProcessHeap(), 0, pSamples->pSamples);
+			}
+
+			pSamples->pSamples = NULL;
+			pSamples->cSamples = 0;
+			pSamples->cMaxSamples = 0;
+			pSamples->cEvents = 0;
+		}
+	}
+}
@@ -14,6 +14,7 @@
 #include <tchar.h>
 
 #include "Log.h"
+#include "Trace.h"
 #include "TextMessages.h"
 #include "ShowError.h"
 #include "Song.h"
@@ -23,13 +24,38 @@
 #include "MidiLyric.h"
 #include "MidiSong.h"
 #include "MidiFile.h"
+#include "SongCache.h"
 #include "SongFile.h"
+#include "SongLoader.h"
+#include "RecentSongCache.h"
 #include "Main.h"
 #include "FrameWnd.h"
 #include "ScrollbarWnd.h"
 #include "SimpleStaveFast.h"
 #include "Resources.h"
 
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+// ,        ;  wParam
+//    (.  SongLoader::GetCurrentLoad),  lParam - 
+//  
+#define WM_SONGLOADSTAGE			(WM_APP + 1) //   
+#define WM_SONGPREVIEW				(WM_APP + 2) //   
+#define WM_SONGLOADED				(WM_APP + 3) //  
+
+//  ,   ,     
+#define PREVIEW_MEASURES			16
+
+//   ,    
+#define FRAME_WND_TITLE				TEXT("Singoscope")
+
+//    ,    
+#define RECENT_SONGS_MAX_MEMORY		(64 * 1024 * 1024)
+
 /****************************************************************************************
 *
 *    
@@ -72,6 +98,29 @@ static SongFile *g_pSongFile = NULL;
 //      Song
 static Song *g_pSong = NULL;
 
+//  ,     
+static TCHAR g_pszSongFileName[MAX_PATH];
+
+//   ,      (. 
+// SongFile::CreateSong)
+static DWORD g_iVocalPart = 0;
+
+//     SongLoader,     
+static SongLoader *g_pSongLoader = NULL;
+
+//     RecentSongCache,    
+static RecentSongCache *g_pRecentSongCache = NULL;
+
+//        ; , 
+//  g_bIsSongKeyValid  true
+static RECENTSONGKEY g_SongKey;
+static bool g_bIsSongKeyValid = false;
+
+//   ; ,   g_bIsLoadingSongKeyValid
+//  true
+static RECENTSONGKEY g_LoadingSongKey;
+static bool g_bIsLoadingSongKeyValid = false;
+
 /****************************************************************************************
 *
 *    ,  
@@ -90,6 +139,23 @@ static void DeactivateCurrentStaveDrawer();
 
 static void OpenFile();
 
+static void SelectNextVocalPart();
+
+static void ReleaseCurrentSong();
+
+static void SongLoadProc(
+	__in DWORD iLoad,
+	__in SONGLOADEVENT Event,
+	__in DWORD Param,
+	__in LPVOID pContext);
+
+static void ShowLoadStage(
+	__in DWORD Stage);
+
+static void ShowPreviewSong();
+
+static void FinishSongLoading();
+
 static bool GetSongFileName(
 	__out LPTSTR pszFileName,
 	__in DWORD cchFileName);
@@ -178,6 +244,35 @@ bool StaveWnd_Init()
 		return false;
 	}
 
+	//  ,     
+	g_pSongLoader = new SongLoader;
+
+	if (g_pSongLoader == NULL)
+	{
+		LOG("operator new failed\n");
+		ShowFatalError(MSGID_CANT_ALLOC_MEMORY);
+		return false;
+	}
+
+	g_pSongLoader->SetLoadProc(SongLoadProc, NULL);
+
+	//     
+	g_pRecentSongCache = new RecentSongCache(RECENT_SONGS_MAX_MEMORY);
+
+	if (g_pRecentSongCache == NULL)
+	{
+		LOG("operator new failed\n");
+		ShowFatalError(MSGID_CANT_ALLOC_MEMORY);
+		return false;
+	}
+
+	//   ;         
+	// ,       
+	if (!SongCache_Init())
+	{
+		LOG("SongCache_Init failed\n");
+	}
+
 	return true;
 }
 
@@ -197,6 +292,24 @@ bool StaveWnd_Init()
 
 void StaveWnd_Uninit()
 {
+	if (g_pSongLoader != NULL)
+	{
+		delete g_pSongLoader;
+		g_pSongLoader = NULL;
+	}
+
+	if (g_pRecentSongCache != NULL)
+	{
+		DWORD cHits, cMisses;
+
+		g_pRecentSongCache->GetStatistics(&cHits, &cMisses, NULL, NULL);
+
+		LOG("recent song cache: %u hits, %u misses\n", cHits, cMisses);
+
+		delete g_pRecentSongCache;
+		g_pRecentSongCache = NULL;
+	}
+
 	if (g_pszOpenFileFilter != NULL)
 	{
 		HeapFree(GetProcessHeap(), 0, g_pszOpenFileFilter);
@@ -325,13 +438,51 @@ static LRESULT CALLBACK StaveWndProc(
 					InvalidateRect(hwnd, NULL, FALSE);
 					return 0;
 				}
+
+				case IDC_NEXTVOCALPART:
+				{
+					SelectNextVocalPart();
+					InvalidateRect(hwnd, NULL, FALSE);
+					return 0;
+				}
 			}
 
 			break;
 		}
 
+		case WM_SONGLOADSTAGE:
+		{
+			//     
+			if (wParam != g_pSongLoader->GetCurrentLoad() ||
+				!g_pSongLoader->IsLoading()) return 0;
+
+			ShowLoadStage((DWORD) lParam);
+			return 0;
+		}
+
+		case WM_SONGPREVIEW:
+		{
+			if (wParam != g_pSongLoader->GetCurrentLoad() ||
+				!g_pSongLoader->IsLoading()) return 0;
+
+			ShowPreviewSong();
+			InvalidateRect(hwnd, NULL, FALSE);
+			return 0;
+		}
+
+		case WM_SONGLOADED:
+		{
+			if (wParam != g_pSongLoader->GetCurrentLoad() ||
+				!g_pSongLoader->IsLoading()) return 0;
+
+			FinishSongLoading();
+			InvalidateRect(hwnd, NULL, FALSE);
+			return 0;
+		}
+
 		case WM_DESTROY:
 		{
+			g_pSongLoader->Cancel();
 			DeactivateCurrentStaveDrawer();
 			return 0;
 		}
@@ -391,6 +542,22 @@ static void DeactivateCurrentStaveDrawer()
 *
 *     IDC_OPENFILE ( ).
 *
+*   
+*
+*        (.  SongLoader),   
+*    ,      .  
+*        ,    . 
+*       ,       
+*   PREVIEW_MEASURES   (.  ShowPreviewSong),   
+*            .   
+*   SongFile         (. 
+*   FinishSongLoading).
+*
+*   ,   ,      
+*   (.  RecentSongCache)     SongFile  
+*        .      
+*    (.  ReleaseCurrentSong).
+*
 ****************************************************************************************/
 
 static void OpenFile()
@@ -403,49 +570,344 @@ static void OpenFile()
 		return;
 	}
 
-	//    SongFile
-	SongFile *pSongFile = new SongFile;
+	//      ,     
+	//    ;     ,  
+	// ,        
+	g_bIsLoadingSongKeyValid = RecentSongCache::GetSongKey(pszFileName,
+		g_DefaultCodePage, g_ConcordNoteChoice, g_QuantizeStepDenominator,
+		&g_LoadingSongKey);
+
+	SongFile *pSongFile;
+	Song *pSong;
+	DWORD iVocalPart;
 
-	if (pSongFile == NULL)
+	if (g_bIsLoadingSongKeyValid && g_pRecentSongCache->TakeSong(&g_LoadingSongKey,
+		&pSongFile, &pSong, &iVocalPart))
 	{
-		LOG("operator new failed\n");
-		ShowError(MSGID_CANT_ALLOC_MEMORY);
+		//   ;   ,   
+		g_pSongLoader->Cancel();
+		SetWindowText(g_hwndFrame, FRAME_WND_TITLE);
+
+		//     ,      
+		ReleaseCurrentSong();
+
+		g_pSongFile = pSongFile;
+		g_pSong = pSong;
+		g_iVocalPart = iVocalPart;
+
+		g_SongKey = g_LoadingSongKey;
+		g_bIsSongKeyValid = true;
+
+		lstrcpyn(g_pszSongFileName, pszFileName, MAX_PATH);
+
+		//        
+		ActivateCurrentStaveDrawer();
+		InvalidateRect(g_hwndStave, NULL, FALSE);
 		return;
 	}
 
-	//    
-	bool bIsFileLoaded = pSongFile->LoadFile(pszFileName,
-		g_DefaultCodePage, g_ConcordNoteChoice);
+	//   ,   ,    
+	g_pSongLoader->Start(pszFileName, g_DefaultCodePage, g_ConcordNoteChoice,
+		g_QuantizeStepDenominator, PREVIEW_MEASURES);
+}
+
+/****************************************************************************************
+*
+*    SelectNextVocalPart
+*
+*   
+*       
+*
+*    
+*       
+*
+*     IDC_NEXTVOCALPART (   ).
+*           ;  
+*      .
+*
+*   
+*
+*        MIDI-.      
+*    , .. MIDI-     ,    
+*        (.  SongLoader),   
+*   ,      FinishSongLoading.   ,
+*     .
+*
+****************************************************************************************/
+
+static void SelectNextVocalPart()
+{
+	if (g_pSongLoader->IsLoading()) return;
+
+	if (g_pSongFile == NULL || g_pSong == NULL) return;
 
-	//     , 
-	if (!bIsFileLoaded)
+	//       ,      , 
+	// MIDI-   ;      (  
+	//   ,       )
+	if (g_pSongFile->GetVocalPartCount() == 0)
 	{
-		LOG("SongFile::LoadFile failed\n");
-		delete pSongFile;
+		g_LoadingSongKey = g_SongKey;
+		g_bIsLoadingSongKeyValid = g_bIsSongKeyValid;
+
+		g_pSongLoader->Start(g_pszSongFileName, g_DefaultCodePage, g_ConcordNoteChoice,
+			g_QuantizeStepDenominator, 0, g_iVocalPart + 1);
 		return;
 	}
 
-	//    Song
-	Song *pSong = pSongFile->CreateSong(g_QuantizeStepDenominator);
+	//    
+	DWORD cVocalParts = g_pSongFile->GetVocalPartCount();
+
+	//     ,    
+	if (cVocalParts < 2) return;
+
+	//    
+	DWORD iVocalPart = g_iVocalPart + 1;
+	if (iVocalPart >= cVocalParts) iVocalPart = 0;
+
+	//      
+	Song *pSong = g_pSongFile->CreateSong(g_QuantizeStepDenominator, NULL, iVocalPart);
 
 	if (pSong == NULL)
 	{
 		LOG("SongFile::CreateSong failed\n");
-		delete pSongFile;
 		return;
 	}
 
-	//     SongFile
-	if (g_pSongFile != NULL) delete g_pSongFile;
-
 	//     Song
-	if (g_pSong != NULL) delete g_pSong;
-
-	//    SongFile  
-	g_pSongFile = pSongFile;
+	delete g_pSong;
 
 	//    Song  
 	g_pSong = pSong;
+	g_iVocalPart = iVocalPart;
+
+	//        
+	ActivateCurrentStaveDrawer();
+}
+
+/****************************************************************************************
+*
+*    ReleaseCurrentSong
+*
+*   
+*       
+*
+*    
+*       
+*
+*       SongFile  Song.    ,
+*          ,  ( )
+*   .         
+*        ,       
+*      .
+*
+****************************************************************************************/
+
+static void ReleaseCurrentSong()
+{
+	if (g_pSongFile != NULL && g_pSong != NULL && g_bIsSongKeyValid)
+	{
+		g_pRecentSongCache->PutSong(&g_SongKey, g_iVocalPart, g_pSongFile, g_pSong);
+	}
+	else
+	{
+		if (g_pSongFile != NULL) delete g_pSongFile;
+		if (g_pSong != NULL) delete g_pSong;
+	}
+
+	g_pSongFile = NULL;
+	g_pSong = NULL;
+	g_bIsSongKeyValid = false;
+}
+
+/****************************************************************************************
+*
+*    SongLoadProc
+*
+*   
+*       iLoad -  
+*       Event -  
+*       Param -  
+*       pContext -  
+*
+*    
+*       
+*
+*             
+*   ,              .
+*
+****************************************************************************************/
+
+static void SongLoadProc(
+	__in DWORD iLoad,
+	__in SONGLOADEVENT Event,
+	__in DWORD Param,
+	__in LPVOID pContext)
+{
+	UINT uMsg;
+
+	switch (Event)
+	{
+		case SONGLOAD_EVENT_STAGE:
+			uMsg = WM_SONGLOADSTAGE;
+			break;
+
+		case SONGLOAD_EVENT_PREVIEW:
+			uMsg = WM_SONGPREVIEW;
+			break;
+
+		default:
+			uMsg = WM_SONGLOADED;
+			break;
+	}
+
+	PostMessage(g_hwndStave, uMsg, iLoad, Param);
+}
+
+/****************************************************************************************
+*
+*    ShowLoadStage
+*
+*   
+*       Stage -    ( SONGLOADSTAGE)
+*
+*    
+*       
+*
+*           .
+*
+****************************************************************************************/
+
+static void ShowLoadStage(
+	__in DWORD Stage)
+{
+	DWORD MsgId;
+
+	switch (Stage)
+	{
+		case SONGLOAD_STAGE_READ_FILE:
+			MsgId = MSGID_READING_FILE;
+			break;
+
+		case SONGLOAD_STAGE_ATTACH_TRACKS:
+			MsgId = MSGID_ATTACHING_TRACKS;
+			break;
+
+		case SONGLOAD_STAGE_FIND_LYRIC:
+			MsgId = MSGID_FINDING_LYRIC;
+			break;
+
+		case SONGLOAD_STAGE_FIND_VOCAL_PARTS:
+			MsgId = MSGID_FINDING_VOCAL_PARTS;
+			break;
+
+		case SONGLOAD_STAGE_COMPLETE_SONG:
+			MsgId = MSGID_COMPLETING_SONG;
+			break;
+
+		default:
+			return;
+	}
+
+	//   ;     , 
+	//    
+	TCHAR pszTitle[128];
+
+	wsprintf(pszTitle, TEXT("%s - %s"), FRAME_WND_TITLE, TextMessages_GetMessage(MsgId));
+
+	SetWindowText(g_hwndFrame, pszTitle);
+}
+
+/****************************************************************************************
+*
+*    ShowPreviewSong
+*
+*   
+*       
+*
+*    
+*       
+*
+*        .   SongFile, 
+*     ,    ,  
+*     ,       
+*   FinishSongLoading.
+*
+****************************************************************************************/
+
+static void ShowPreviewSong()
+{
+	Song *pPreviewSong = g_pSongLoader->TakePreviewSong();
+
+	if (pPreviewSong == NULL) return;
+
+	//     SongFile  Song
+	ReleaseCurrentSong();
+
+	//     
+	g_pSong = pPreviewSong;
+
+	//        
+	ActivateCurrentStaveDrawer();
+}
+
+/****************************************************************************************
+*
+*    FinishSongLoading
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .   ,   
+*    SongFile  Song   ,   
+*       .    ,   
+*    (   ,    ),  
+*      .
+*
+****************************************************************************************/
+
+static void FinishSongLoading()
+{
+	SetWindowText(g_hwndFrame, FRAME_WND_TITLE);
+
+	SongFile *pSongFile;
+	Song *pSong;
+	DWORD iVocalPart;
+
+	if (!g_pSongLoader->TakeResult(&pSongFile, &pSong, &iVocalPart))
+	{
+		LOG("SongLoader::TakeResult failed\n");
+
+		//       ,   
+		//    
+		DWORD SystemError;
+		DWORD FunctionId;
+
+		MIDIFILERESULT Result = g_pSongLoader->GetLastResult(&SystemError, &FunctionId);
+
+		SongFile::ShowLoadError(g_pSongLoader->GetFileName(), Result, SystemError,
+			FunctionId);
+
+		return;
+	}
+
+	//     SongFile  Song (   )
+	ReleaseCurrentSong();
+
+	//    SongFile  Song  
+	g_pSongFile = pSongFile;
+	g_pSong = pSong;
+
+	g_SongKey = g_LoadingSongKey;
+	g_bIsSongKeyValid = g_bIsLoadingSongKeyValid;
+
+	//   :  ,      , 
+	//      
+	lstrcpyn(g_pszSongFileName, g_pSongLoader->GetFileName(), MAX_PATH);
+
+	g_iVocalPart = iVocalPart;
 
 	//        
 	ActivateCurrentStaveDrawer();
@@ -96,6 +96,18 @@ LPCTSTR TextMessages_GetMessage(
 		case MSGID_KARAOKE_FILES:
 			return TEXT("- (*.kar)");
 
+		//       
+		case MSGID_READING_FILE:
+			return TEXT(" ...");
+		case MSGID_ATTACHING_TRACKS:
+			return TEXT(" ...");
+		case MSGID_FINDING_LYRIC:
+			return TEXT("  ...");
+		case MSGID_FINDING_VOCAL_PARTS:
+			return TEXT("  ...");
+		case MSGID_COMPLETING_SONG:
+			return TEXT(" ...");
+
 		//   
 		case MSGID_CANT_CREATE_PRIMARY_SURFACE:
 			return TEXT("    DirectDraw   ( %1)");
@@ -34,7 +34,14 @@ enum TEXTMESSAGEID0
 	MSGID_ALL_FILES = 500,
 	MSGID_ALL_SUPPORTED_FILES = 501,
 	MSGID_MIDI_FILES = 502,
-	MSGID_KARAOKE_FILES = 503
+	MSGID_KARAOKE_FILES = 503,
+
+	//       
+	MSGID_READING_FILE = 600,
+	MSGID_ATTACHING_TRACKS = 601,
+	MSGID_FINDING_LYRIC = 602,
+	MSGID_FINDING_VOCAL_PARTS = 603,
+	MSGID_COMPLETING_SONG = 604
 };
 
 //     1- 
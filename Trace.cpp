@@ -0,0 +1,489 @@
+/****************************************************************************************
+*
+*     Trace
+*
+*    :      ()  
+*    .        
+*     ;       . 
+*             Chrome
+*   Trace Event (JSON),    chrome://tracing   Perfetto.
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#ifdef TRACING
+
+#define _CRT_SECURE_NO_DEPRECATE
+
+#include <windows.h>
+#include <stdio.h>
+
+#include "Log.h"
+#include "Trace.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//     ;  
+#define TRACE_BUFFER_SIZE			16384
+
+//  ,      
+#define OUTPUT_BUFFER_SIZE			65536
+
+//          
+#define MAX_RECORD_TEXT_SIZE		512
+
+//   
+enum TRACERECORDTYPE
+{
+	TRACE_RECORD_ZONE, // 
+	TRACE_RECORD_COUNTER //  
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+// ,   
+struct TRACERECORD
+{
+	LPCSTR pszName; //    
+	DWORD ThreadId; //  ,  
+	DWORD Type; //   (   TRACERECORDTYPE)
+	DWORD Arg; //    TRACE_NO_ARG
+	LONGLONG Time; //         
+				   //   
+	LONGLONG Value; //       
+					//  
+};
+
+// ,    
+struct TRACEBUFFER
+{
+	TRACEBUFFER *pNext; //      
+	TRACEBUFFER *pNextFree; //      
+	DWORD cRecords; //  ,      ; 
+					//   i    i % TRACE_BUFFER_SIZE
+	TRACERECORD Records[TRACE_BUFFER_SIZE]; //   
+};
+
+/****************************************************************************************
+*
+*    
+*
+****************************************************************************************/
+
+//   
+static TCHAR g_pszTraceFileName[MAX_PATH];
+
+//     ,       
+static DWORD g_TlsIndex = TLS_OUT_OF_INDEXES;
+
+//  ,   ;       
+//   ,     
+static CRITICAL_SECTION g_csBuffers;
+
+//      ,   
+static TRACEBUFFER *g_pFirstBuffer = NULL;
+static TRACEBUFFER *g_pFirstFreeBuffer = NULL;
+
+//      
+static LONGLONG g_TraceStartTime;
+
+//       
+static double g_MicrosecondsPerTick;
+
+/****************************************************************************************
+*
+*    ,  
+*
+****************************************************************************************/
+
+static TRACERECORD *GetNextRecord();
+
+static void WriteTraceFile();
+
+/****************************************************************************************
+*
+*    Trace_Init
+*
+*   
+*       pszFileName -    ,     
+*                     
+*
+*    
+*       
+*
+*    .        .
+*
+****************************************************************************************/
+
+void Trace_Init(
+	__in LPCTSTR pszFileName)
+{
+	lstrcpyn(g_pszTraceFileName, pszFileName, MAX_PATH);
+
+	LARGE_INTEGER Frequency, StartTime;
+
+	QueryPerformanceFrequency(&Frequency);
+	QueryPerformanceCounter(&StartTime);
+
+	g_MicrosecondsPerTick = 1000000.0 / Frequency.QuadPart;
+	g_TraceStartTime = StartTime.QuadPart;
+
+	InitializeCriticalSection(&g_csBuffers);
+
+	g_TlsIndex = TlsAlloc();
+
+	if (g_TlsIndex == TLS_OUT_OF_INDEXES)
+	{
+		LOG("TlsAlloc failed (error %u)\n", GetLastError());
+	}
+}
+
+/****************************************************************************************
+*
+*    Trace_Uninit
+*
+*   
+*       
+*
+*    
+*       
+*
+*            .
+*   ,    ,  ,  .
+*
+****************************************************************************************/
+
+void Trace_Uninit()
+{
+	if (g_TlsIndex == TLS_OUT_OF_INDEXES) return;
+
+	WriteTraceFile();
+
+	TlsFree(g_TlsIndex);
+	g_TlsIndex = TLS_OUT_OF_INDEXES;
+
+	while (g_pFirstBuffer != NULL)
+	{
+		TRACEBUFFER *pDelBuffer = g_pFirstBuffer;
+		g_pFirstBuffer = g_pFirstBuffer->pNext;
+		HeapFree(GetProcessHeap(), 0, pDelBuffer);
+	}
+
+	g_pFirstFreeBuffer = NULL;
+
+	DeleteCriticalSection(&g_csBuffers);
+}
+
+/****************************************************************************************
+*
+*    Trace_AddZone
+*
+*   
+*       pszName -     (    
+*                   )
+*       StartTime -      
+*       Arg -   (,  )  TRACE_NO_ARG
+*
+*    
+*       
+*
+*        ,     StartTime 
+*    .    ,   GetLastError.
+*
+****************************************************************************************/
+
+void Trace_AddZone(
+	__in LPCSTR pszName,
+	__in LONGLONG StartTime,
+	__in DWORD Arg)
+{
+	LARGE_INTEGER EndTime;
+	QueryPerformanceCounter(&EndTime);
+
+	DWORD dwError = GetLastError();
+
+	TRACERECORD *pRecord = GetNextRecord();
+
+	if (pRecord != NULL)
+	{
+		pRecord->pszName = pszName;
+		pRecord->Type = TRACE_RECORD_ZONE;
+		pRecord->Arg = Arg;
+		pRecord->Time = StartTime;
+		pRecord->Value = EndTime.QuadPart - StartTime;
+	}
+
+	SetLastError(dwError);
+}
+
+/****************************************************************************************
+*
+*    Trace_AddCounter
+*
+*   
+*       pszName -     (    
+*                   )
+*       Value -  
+*
+*    
+*       
+*
+*            .  
+*    ,   GetLastError.
+*
+****************************************************************************************/
+
+void Trace_AddCounter(
+	__in LPCSTR pszName,
+	__in LONGLONG Value)
+{
+	LARGE_INTEGER Time;
+	QueryPerformanceCounter(&Time);
+
+	DWORD dwError = GetLastError();
+
+	TRACERECORD *pRecord = GetNextRecord();
+
+	if (pRecord != NULL)
+	{
+		pRecord->pszName = pszName;
+		pRecord->Type = TRACE_RECORD_COUNTER;
+		pRecord->Arg = TRACE_NO_ARG;
+		pRecord->Time = Time.QuadPart;
+		pRecord->Value = Value;
+	}
+
+	SetLastError(dwError);
+}
+
+/****************************************************************************************
+*
+*    Trace_ReleaseThread
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .     
+*   ; ,    , .
+*
+****************************************************************************************/
+
+void Trace_ReleaseThread()
+{
+	if (g_TlsIndex == TLS_OUT_OF_INDEXES) return;
+
+	TRACEBUFFER *pBuffer = (TRACEBUFFER *) TlsGetValue(g_TlsIndex);
+
+	if (pBuffer == NULL) return;
+
+	TlsSetValue(g_TlsIndex, NULL);
+
+	EnterCriticalSection(&g_csBuffers);
+
+	pBuffer->pNextFree = g_pFirstFreeBuffer;
+	g_pFirstFreeBuffer = pBuffer;
+
+	LeaveCriticalSection(&g_csBuffers);
+}
+
+/****************************************************************************************
+*
+*    GetNextRecord
+*
+*   
+*       
+*
+*    
+*            ,     
+*       ,  NULL,         .
+*
+*         ,   
+*    .      ,   , 
+*    ,   .
+*
+****************************************************************************************/
+
+static TRACERECORD *GetNextRecord()
+{
+	if (g_TlsIndex == TLS_OUT_OF_INDEXES) return NULL;
+
+	TRACEBUFFER *pBuffer = (TRACEBUFFER *) TlsGetValue(g_TlsIndex);
+
+	if (pBuffer == NULL)
+	{
+		EnterCriticalSection(&g_csBuffers);
+
+		pBuffer = g_pFirstFreeBuffer;
+
+		if (pBuffer != NULL)
+		{
+			g_pFirstFreeBuffer = pBuffer->pNextFree;
+		}
+		else
+		{
+			pBuffer = (TRACEBUFFER *) HeapAlloc(GetProcessHeap(), 0,
+				sizeof(TRACEBUFFER));
+
+			if (pBuffer != NULL)
+			{
+				pBuffer->cRecords = 0;
+				pBuffer->pNext = g_pFirstBuffer;
+				g_pFirstBuffer = pBuffer;
+			}
+		}
+
+		LeaveCriticalSection(&g_csBuffers);
+
+		if (pBuffer == NULL)
+		{
+			LOG("HeapAlloc failed\n");
+			return NULL;
+		}
+
+		TlsSetValue(g_TlsIndex, pBuffer);
+	}
+
+	TRACERECORD *pRecord =
+		&pBuffer->Records[pBuffer->cRecords++ & (TRACE_BUFFER_SIZE - 1)];
+
+	pRecord->ThreadId = GetCurrentThreadId();
+
+	return pRecord;
+}
+
+/****************************************************************************************
+*
+*    WriteTraceFile
+*
+*   
+*       
+*
+*    
+*       
+*
+*              Chrome
+*   Trace Event:  -   "X",   -   "C".
+*           .
+*
+****************************************************************************************/
+
+static void WriteTraceFile()
+{
+	HANDLE hFile = CreateFile(g_pszTraceFileName, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		LOG("CreateFile failed (error %u)\n", GetLastError());
+		return;
+	}
+
+	char *pOutput = (char *) HeapAlloc(GetProcessHeap(), 0, OUTPUT_BUFFER_SIZE);
+
+	if (pOutput == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		CloseHandle(hFile);
+		return;
+	}
+
+	DWORD ProcessId = GetCurrentProcessId();
+
+	//     pOutput    
+	DWORD cchOutput = 0;
+	DWORD cWrittenRecords = 0;
+
+	DWORD cbWritten;
+
+	lstrcpyA(pOutput, "{\"traceEvents\":[");
+	cchOutput = lstrlenA(pOutput);
+
+	TRACEBUFFER *pBuffer;
+
+	for (pBuffer = g_pFirstBuffer; pBuffer != NULL; pBuffer = pBuffer->pNext)
+	{
+		//   ,       
+		//    
+		DWORD cRecords = pBuffer->cRecords;
+		DWORD iFirstRecord = 0;
+
+		if (cRecords > TRACE_BUFFER_SIZE)
+		{
+			iFirstRecord = cRecords;
+			cRecords = TRACE_BUFFER_SIZE;
+		}
+
+		for (DWORD i = 0; i < cRecords; i++)
+		{
+			TRACERECORD *pRecord =
+				&pBuffer->Records[(iFirstRecord + i) & (TRACE_BUFFER_SIZE - 1)];
+
+			char pRecordText[MAX_RECORD_TEXT_SIZE];
+
+			double Time = (pRecord->Time - g_TraceStartTime) * g_MicrosecondsPerTick;
+
+			int cchRecord;
+
+			if (pRecord->Type == TRACE_RECORD_COUNTER)
+			{
+				cchRecord = _snprintf(pRecordText, MAX_RECORD_TEXT_SIZE,
+					"%s\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%u,\"tid\":%u,"
+					"\"ts\":%.3f,\"args\":{\"value\":%I64d}}",
+					(cWrittenRecords == 0) ? "" : ",", pRecord->pszName, ProcessId,
+					pRecord->ThreadId, Time, pRecord->Value);
+			}
+			else if (pRecord->Arg == TRACE_NO_ARG)
+			{
+				cchRecord = _snprintf(pRecordText, MAX_RECORD_TEXT_SIZE,
+					"%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+					"\"ts\":%.3f,\"dur\":%.3f}",
+					(cWrittenRecords == 0) ? "" : ",", pRecord->pszName, ProcessId,
+					pRecord->ThreadId, Time, pRecord->Value * g_MicrosecondsPerTick);
+			}
+			else
+			{
+				cchRecord = _snprintf(pRecordText, MAX_RECORD_TEXT_SIZE,
+					"%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+					"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%u}}",
+					(cWrittenRecords == 0) ? "" : ",", pRecord->pszName, ProcessId,
+					pRecord->ThreadId, Time, pRecord->Value * g_MicrosecondsPerTick,
+					pRecord->Arg);
+			}
+
+			//       ,   
+			if (cchRecord < 0 || cchRecord >= MAX_RECORD_TEXT_SIZE) continue;
+
+			if (cchOutput + cchRecord > OUTPUT_BUFFER_SIZE)
+			{
+				WriteFile(hFile, pOutput, cchOutput, &cbWritten, NULL);
+				cchOutput = 0;
+			}
+
+			CopyMemory(pOutput + cchOutput, pRecordText, cchRecord);
+			cchOutput += cchRecord;
+
+			cWrittenRecords++;
+		}
+	}
+
+	WriteFile(hFile, pOutput, cchOutput, &cbWritten, NULL);
+	WriteFile(hFile, "\n]}\n", 4, &cbWritten, NULL);
+
+	HeapFree(GetProcessHeap(), 0, pOutput);
+
+	CloseHandle(hFile);
+}
+
+#endif // #ifdef TRACING
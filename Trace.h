@@ -0,0 +1,202 @@
+/****************************************************************************************
+*
+*     Trace
+*
+*    :      ()  
+*    .        
+*     ;       . 
+*             Chrome
+*   Trace Event (JSON),    chrome://tracing   Perfetto.
+*
+*      TRACING;      
+*    .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#ifdef TRACING
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//   Arg  Trace_AddZone, ,     
+#define TRACE_NO_ARG		0xFFFFFFFF
+
+/****************************************************************************************
+*
+*    Trace_Init
+*
+*   
+*       pszFileName -    ,     
+*                     
+*
+*    
+*       
+*
+*    .        .
+*
+****************************************************************************************/
+
+void Trace_Init(
+	__in LPCTSTR pszFileName);
+
+/****************************************************************************************
+*
+*    Trace_Uninit
+*
+*   
+*       
+*
+*    
+*       
+*
+*            .
+*   ,    ,  ,  .
+*
+****************************************************************************************/
+
+void Trace_Uninit();
+
+/****************************************************************************************
+*
+*    Trace_AddZone
+*
+*   
+*       pszName -     (    
+*                   )
+*       StartTime -      
+*       Arg -   (,  )  TRACE_NO_ARG
+*
+*    
+*       
+*
+*        ,     StartTime 
+*    .    ,   GetLastError.
+*
+****************************************************************************************/
+
+void Trace_AddZone(
+	__in LPCSTR pszName,
+	__in LONGLONG StartTime,
+	__in DWORD Arg);
+
+/****************************************************************************************
+*
+*    Trace_AddCounter
+*
+*   
+*       pszName -     (    
+*                   )
+*       Value -  
+*
+*    
+*       
+*
+*            .  
+*    ,   GetLastError.
+*
+****************************************************************************************/
+
+void Trace_AddCounter(
+	__in LPCSTR pszName,
+	__in LONGLONG Value);
+
+/****************************************************************************************
+*
+*    Trace_ReleaseThread
+*
+*   
+*       
+*
+*    
+*       
+*
+*      .     
+*   ; ,    , .
+*
+****************************************************************************************/
+
+void Trace_ReleaseThread();
+
+/****************************************************************************************
+*
+*    TraceZone
+*
+*       ,      
+*      .   TRACE_ZONE 
+*   TRACE_ZONE_ARG.
+*
+****************************************************************************************/
+
+class TraceZone
+{
+public:
+
+	TraceZone(
+		__in LPCSTR pszName,
+		__in DWORD Arg)
+	{
+		m_pszName = pszName;
+		m_Arg = Arg;
+
+		QueryPerformanceCounter(&m_StartTime);
+	}
+
+	~TraceZone()
+	{
+		Trace_AddZone(m_pszName, m_StartTime.QuadPart, m_Arg);
+	}
+
+private:
+
+	//  
+	LPCSTR m_pszName;
+
+	//    TRACE_NO_ARG
+	DWORD m_Arg;
+
+	//      
+	LARGE_INTEGER m_StartTime;
+};
+
+//        TraceZone  
+// ,         
+#define TRACE_ZONE_OBJECT_NAME2(Line)	TraceZone_##Line
+#define TRACE_ZONE_OBJECT_NAME(Line)	TRACE_ZONE_OBJECT_NAME2(Line)
+
+/****************************************************************************************
+*
+*   
+*
+*   INITTRACE(pszFileName) -   (.  Trace_Init)
+*   UNINITTRACE() -     (.  Trace_Uninit)
+*   TRACE_ZONE(pszName) -         
+*   TRACE_ZONE_ARG(pszName, Arg) -  ,  TRACE_ZONE,    
+*   TRACE_COUNTER(pszName, Value) -   
+*   TRACE_THREAD_END() -    (.  Trace_ReleaseThread)
+*
+****************************************************************************************/
+
+#define INITTRACE			Trace_Init
+#define UNINITTRACE			Trace_Uninit
+#define TRACE_ZONE(pszName) \
+	TraceZone TRACE_ZONE_OBJECT_NAME(__LINE__)(pszName, TRACE_NO_ARG)
+#define TRACE_ZONE_ARG(pszName, Arg) \
+	TraceZone TRACE_ZONE_OBJECT_NAME(__LINE__)(pszName, Arg)
+#define TRACE_COUNTER		Trace_AddCounter
+#define TRACE_THREAD_END	Trace_ReleaseThread
+
+#else // #ifdef TRACING
+
+#define INITTRACE			1 ? 0 :
+#define UNINITTRACE()
+#define TRACE_ZONE(pszName)
+#define TRACE_ZONE_ARG(pszName, Arg)
+#define TRACE_COUNTER		1 ? 0 :
+#define TRACE_THREAD_END()
+
+#endif // #ifdef TRACING
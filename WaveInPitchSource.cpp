@@ -0,0 +1,295 @@
+/****************************************************************************************
+*
+*     WaveInPitchSource
+*
+*           , 
+*         .
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+#include <windows.h>
+
+#include "Log.h"
+#include "AudioRing.h"
+#include "PitchSource.h"
+#include "WaveInPitchSource.h"
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//   ,    ,  ,  
+// 
+#define BUFFER_WAIT_TIMEOUT		100
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       SampleRate -    
+*       cBufferSamples -       ; 
+*                              
+*
+*    
+*       
+*
+*     .
+*
+****************************************************************************************/
+
+WaveInPitchSource::WaveInPitchSource(
+	__in DWORD SampleRate,
+	__in DWORD cBufferSamples) : PitchSource(true)
+{
+	m_InputSampleRate = SampleRate;
+	m_cBufferSamples = cBufferSamples;
+	m_hWaveIn = NULL;
+	m_hBufferEvent = NULL;
+	m_pBufferSamples = NULL;
+	m_iCurrentBuffer = 0;
+	m_cCurrentSamplesRead = 0;
+
+	ZeroMemory(m_Headers, sizeof(m_Headers));
+}
+
+/****************************************************************************************
+*
+*   
+*
+*   
+*       
+*
+*    
+*       
+*
+*     ,       .
+*
+****************************************************************************************/
+
+WaveInPitchSource::~WaveInPitchSource()
+{
+	Stop();
+}
+
+/****************************************************************************************
+*
+*    OpenInput
+*
+*   
+*       pSampleRate -   ,     
+*                     
+*
+*    
+*       true,      ;  false.
+*
+*         (16 ,  ),   
+*        .   PitchSource::Start.
+*
+****************************************************************************************/
+
+bool WaveInPitchSource::OpenInput(
+	__out DWORD *pSampleRate)
+{
+	m_hBufferEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	if (m_hBufferEvent == NULL)
+	{
+		LOG("CreateEvent failed (error %u)\n", GetLastError());
+		return false;
+	}
+
+	m_pBufferSamples = (SHORT *) HeapAlloc(GetProcessHeap(), 0,
+		WAVEIN_BUFFER_COUNT * m_cBufferSamples * sizeof(SHORT));
+
+	if (m_pBufferSamples == NULL)
+	{
+		LOG("HeapAlloc failed\n");
+		CloseInput();
+		return false;
+	}
+
+	WAVEFORMATEX Format;
+
+	Format.wFormatTag = WAVE_FORMAT_PCM;
+	Format.nChannels = 1;
+	Format.nSamplesPerSec = m_InputSampleRate;
+	Format.wBitsPerSample = 16;
+	Format.nBlockAlign = sizeof(SHORT);
+	Format.nAvgBytesPerSec = m_InputSampleRate * sizeof(SHORT);
+	Format.cbSize = 0;
+
+	MMRESULT Result = waveInOpen(&m_hWaveIn, WAVE_MAPPER, &Format,
+		(DWORD_PTR) m_hBufferEvent, 0, CALLBACK_EVENT);
+
+	if (Result != MMSYSERR_NOERROR)
+	{
+		LOG("waveInOpen failed (error %u)\n", Result);
+		m_hWaveIn = NULL;
+		CloseInput();
+		return false;
+	}
+
+	for (DWORD i = 0; i < WAVEIN_BUFFER_COUNT; i++)
+	{
+		WAVEHDR *pHeader = &m_Headers[i];
+
+		ZeroMemory(pHeader, sizeof(WAVEHDR));
+
+		pHeader->lpData = (LPSTR) (m_pBufferSamples + i * m_cBufferSamples);
+		pHeader->dwBufferLength = m_cBufferSamples * sizeof(SHORT);
+
+		Result = waveInPrepareHeader(m_hWaveIn, pHeader, sizeof(WAVEHDR));
+
+		if (Result == MMSYSERR_NOERROR)
+		{
+			Result = waveInAddBuffer(m_hWaveIn, pHeader, sizeof(WAVEHDR));
+		}
+
+		if (Result != MMSYSERR_NOERROR)
+		{
+			LOG("waveInAddBuffer failed (error %u)\n", Result);
+			CloseInput();
+			return false;
+		}
+	}
+
+	m_iCurrentBuffer = 0;
+	m_cCurrentSamplesRead = 0;
+
+	Result = waveInStart(m_hWaveIn);
+
+	if (Result != MMSYSERR_NOERROR)
+	{
+		LOG("waveInStart failed (error %u)\n", Result);
+		CloseInput();
+		return false;
+	}
+
+	*pSampleRate = m_InputSampleRate;
+
+	return true;
+}
+
+/****************************************************************************************
+*
+*    ReadInput
+*
+*   
+*       pSamples -   ,     
+*       cSamples -    
+*
+*    
+*          ( cSamples)  ,   
+*       .
+*
+*   ,      ,     
+*         .  
+*   .
+*
+****************************************************************************************/
+
+DWORD WaveInPitchSource::ReadInput(
+	__out SHORT *pSamples,
+	__in DWORD cSamples)
+{
+	DWORD cSamplesRead = 0;
+
+	while (cSamplesRead < cSamples)
+	{
+		if (IsStopping()) return 0;
+
+		WAVEHDR *pHeader = &m_Headers[m_iCurrentBuffer];
+
+		if ((pHeader->dwFlags & WHDR_DONE) == 0)
+		{
+			WaitForSingleObject(m_hBufferEvent, BUFFER_WAIT_TIMEOUT);
+			continue;
+		}
+
+		DWORD cBufferSamples = pHeader->dwBytesRecorded / sizeof(SHORT);
+
+		DWORD cCopySamples = cBufferSamples - m_cCurrentSamplesRead;
+
+		if (cCopySamples > cSamples - cSamplesRead)
+		{
+			cCopySamples = cSamples - cSamplesRead;
+		}
+
+		CopyMemory(pSamples + cSamplesRead,
+			(SHORT *) pHeader->lpData + m_cCurrentSamplesRead,
+			cCopySamples * sizeof(SHORT));
+
+		cSamplesRead += cCopySamples;
+		m_cCurrentSamplesRead += cCopySamples;
+
+		if (m_cCurrentSamplesRead == cBufferSamples)
+		{
+			//   ;      
+			pHeader->dwFlags &= ~WHDR_DONE;
+
+			MMRESULT Result = waveInAddBuffer(m_hWaveIn, pHeader, sizeof(WAVEHDR));
+
+			if (Result != MMSYSERR_NOERROR)
+			{
+				LOG("waveInAddBuffer failed (error %u)\n", Result);
+				return 0;
+			}
+
+			m_iCurrentBuffer = (m_iCurrentBuffer + 1) % WAVEIN_BUFFER_COUNT;
+			m_cCurrentSamplesRead = 0;
+		}
+	}
+
+	return cSamplesRead;
+}
+
+/****************************************************************************************
+*
+*    CloseInput
+*
+*   
+*       
+*
+*    
+*       
+*
+*    ,     .
+*
+****************************************************************************************/
+
+void WaveInPitchSource::CloseInput()
+{
+	if (m_hWaveIn != NULL)
+	{
+		//    waveInReset     
+		waveInReset(m_hWaveIn);
+
+		for (DWORD i = 0; i < WAVEIN_BUFFER_COUNT; i++)
+		{
+			if (m_Headers[i].dwFlags & WHDR_PREPARED)
+			{
+				waveInUnprepareHeader(m_hWaveIn, &m_Headers[i], sizeof(WAVEHDR));
+			}
+		}
+
+		waveInClose(m_hWaveIn);
+		m_hWaveIn = NULL;
+	}
+
+	if (m_pBufferSamples != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, m_pBufferSamples);
+		m_pBufferSamples = NULL;
+	}
+
+	if (m_hBufferEvent != NULL)
+	{
+		CloseHandle(m_hBufferEvent);
+		m_hBufferEvent = NULL;
+	}
+}
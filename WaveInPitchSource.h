@@ -0,0 +1,70 @@
+/****************************************************************************************
+*
+*     WaveInPitchSource
+*
+*           , 
+*          ( waveIn).
+*
+*   :     , 2010
+*
+****************************************************************************************/
+
+/****************************************************************************************
+*
+*   
+*
+****************************************************************************************/
+
+//  ,       
+#define WAVEIN_BUFFER_COUNT		4
+
+/****************************************************************************************
+*
+*    WaveInPitchSource
+*
+****************************************************************************************/
+
+class WaveInPitchSource : public PitchSource
+{
+	//  
+	DWORD m_InputSampleRate;
+
+	//       
+	DWORD m_cBufferSamples;
+
+	//     NULL
+	HWAVEIN m_hWaveIn;
+
+	// ,       
+	HANDLE m_hBufferEvent;
+
+	//        
+	WAVEHDR m_Headers[WAVEIN_BUFFER_COUNT];
+	SHORT *m_pBufferSamples;
+
+	//  ,   ,     
+	//  
+	DWORD m_iCurrentBuffer;
+	DWORD m_cCurrentSamplesRead;
+
+protected:
+
+	//    
+	virtual bool OpenInput(
+		__out DWORD *pSampleRate);
+
+	//  ,   
+	virtual DWORD ReadInput(
+		__out SHORT *pSamples,
+		__in DWORD cSamples);
+
+	//    
+	virtual void CloseInput();
+
+public:
+
+	WaveInPitchSource(
+		__in DWORD SampleRate,
+		__in DWORD cBufferSamples);
+	virtual ~WaveInPitchSource();
+};